@@ -132,17 +132,27 @@ int ogs_config_read()
     return OGS_OK;
 }
 
+/*
+ * UE, session, bearer, tunnel and GTP transaction pools are segmented,
+ * so these sizes are upper bounds and memory is taken as the pools grow.
+ */
 static void recalculate_pool_size(void)
 {
 #define MAX_NUM_OF_BEARER       4   /* Num of Bearer per APN(Session) */
 #define MAX_NUM_OF_TUNNEL       3   /* Num of Tunnel per Bearer */
 #define MAX_NUM_OF_PF           16  /* Num of PacketFilter per Bearer */
+#define MAX_NUM_OF_XACT         2   /* Num of GTP Transaction per UE */
+#define MAX_NUM_OF_TIMER        8   /* Num of Timer per UE */
 
     self.pool.ue = self.max.ue * self.max.enb;
     self.pool.sess = self.pool.ue * OGS_MAX_NUM_OF_SESS;
     self.pool.bearer = self.pool.sess * MAX_NUM_OF_BEARER;
     self.pool.tunnel = self.pool.bearer * MAX_NUM_OF_TUNNEL;
     self.pool.pf = self.pool.bearer * MAX_NUM_OF_PF;
+
+    self.pool.xact = self.pool.ue * MAX_NUM_OF_XACT;
+    /* Each GTP transaction holds a response and a holding timer */
+    self.pool.timer = self.pool.ue * MAX_NUM_OF_TIMER + self.pool.xact * 2;
 }
 
 static int config_prepare(void)
@@ -167,6 +177,7 @@ static int config_prepare(void)
     self.pool.packet = MAX_NUM_OF_PACKET_POOL;
 
     ogs_pkbuf_default_init(&self.pool.defconfig);
+    self.pool.hugepage = ogs_core()->pool.hugepage;
 
     recalculate_pool_size();
 
@@ -218,6 +229,8 @@ int ogs_config_parse()
                 } else if (!strcmp(logger_key, "domain")) {
                     self.logger.domain =
                         ogs_yaml_iter_value(&logger_iter);
+                } else if (!strcmp(logger_key, "async")) {
+                    self.logger.async = ogs_yaml_iter_bool(&logger_iter);
                 }
             }
         } else if (!strcmp(root_key, "parameter")) {
@@ -253,6 +266,12 @@ int ogs_config_parse()
                 } else if (!strcmp(parameter_key, "no_slaac")) {
                     self.parameter.no_slaac =
                         ogs_yaml_iter_bool(&parameter_iter);
+                } else if (!strcmp(parameter_key, "io_uring")) {
+                    self.parameter.io_uring =
+                        ogs_yaml_iter_bool(&parameter_iter);
+                } else if (!strcmp(parameter_key, "xdp")) {
+                    self.parameter.xdp =
+                        ogs_yaml_iter_bool(&parameter_iter);
                 } else
                     ogs_warn("unknown key `%s`", parameter_key);
             }
@@ -350,6 +369,24 @@ int ogs_config_parse()
                     const char *v = ogs_yaml_iter_value(&pool_iter);
                     if (v)
                         self.pool.packet = atoi(v);
+                } else if (!strcmp(pool_key, "xact")) {
+                    const char *v = ogs_yaml_iter_value(&pool_iter);
+                    if (v)
+                        self.pool.xact = atoi(v);
+                } else if (!strcmp(pool_key, "timer")) {
+                    const char *v = ogs_yaml_iter_value(&pool_iter);
+                    if (v)
+                        self.pool.timer = atoi(v);
+                } else if (!strcmp(pool_key, "hugepage")) {
+                    const char *v = ogs_yaml_iter_value(&pool_iter);
+                    if (v && !strcmp(v, "none"))
+                        self.pool.hugepage = OGS_POOL_HUGEPAGE_NONE;
+                    else if (v && !strcmp(v, "transparent"))
+                        self.pool.hugepage = OGS_POOL_HUGEPAGE_TRANSPARENT;
+                    else if (v && !strcmp(v, "explicit"))
+                        self.pool.hugepage = OGS_POOL_HUGEPAGE_EXPLICIT;
+                    else
+                        ogs_warn("unknown hugepage `%s`", v ? v : "");
                 } else
                     ogs_warn("unknown key `%s`", pool_key);
             }
@@ -39,6 +39,7 @@ typedef struct ogs_config_s {
         const char *file;
         const char *level;
         const char *domain;
+        int async;
     } logger;
 
     struct {
@@ -54,6 +55,10 @@ typedef struct ogs_config_s {
         int prefer_ipv4;
         int multicast;
         int no_slaac;
+
+        /* I/O */
+        int io_uring;
+        int xdp;
     } parameter;
 
     ogs_sockopt_t sockopt;
@@ -79,6 +84,11 @@ typedef struct ogs_config_s {
         int bearer;
         int tunnel;
         int pf;
+
+        int xact;
+        int timer;
+
+        ogs_pool_hugepage_e hugepage;
     } pool;
 } ogs_config_t;
 
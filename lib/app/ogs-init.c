@@ -85,6 +85,10 @@ int ogs_app_initialize(const char *default_config, const char *const argv[])
      * Stage 3 : Initialize Default Memory Pool
      */
     ogs_pkbuf_default_create(&ogs_config()->pool.defconfig);
+    ogs_core()->timer.pool = ogs_config()->pool.timer;
+    ogs_core()->pool.hugepage = ogs_config()->pool.hugepage;
+    ogs_core()->socket.io_uring = ogs_config()->parameter.io_uring;
+    ogs_core()->socket.xdp = ogs_config()->parameter.xdp;
 
     /**************************************************************************
      * Stage 4 : Setup LOG Module
@@ -110,6 +114,9 @@ int ogs_app_initialize(const char *default_config, const char *const argv[])
             ogs_config()->logger.domain, ogs_config()->logger.level);
     if (rv != OGS_OK) return rv;
 
+    if (ogs_config()->logger.async)
+        ogs_log_start_async(ogs_core()->log.ring);
+
     /**************************************************************************
      * Stage 5 : Setup Database Module
      */
@@ -121,6 +128,10 @@ int ogs_app_initialize(const char *default_config, const char *const argv[])
 
 void ogs_app_terminate(void)
 {
+    /* The writer thread may cache the default pool */
+    if (ogs_config()->logger.async)
+        ogs_log_stop_async();
+
     ogs_config_final();
 
     ogs_pkbuf_default_destroy();
@@ -29,6 +29,11 @@ static ogs_core_context_t self = {
     .log.pool = 8,
     .log.domain_pool = 64,
     .log.level = OGS_LOG_DEFAULT,
+    .log.ring = 2048,
+    .log.ratelimit.interval = ogs_time_from_sec(5),
+    .log.ratelimit.burst = 10,
+
+    .pool.hugepage = OGS_POOL_HUGEPAGE_TRANSPARENT,
 
     .pkbuf.pool = 8,
     .pkbuf.config_pool = 8,
@@ -50,11 +50,14 @@
 #include "core/ogs-tcp.h"
 #include "core/ogs-queue.h"
 #include "core/ogs-poll.h"
+#include "core/ogs-shmring.h"
+#include "core/ogs-xsk.h"
 #include "core/ogs-notify.h"
 #include "core/ogs-tlv.h"
 #include "core/ogs-env.h"
 #include "core/ogs-fsm.h"
 #include "core/ogs-hash.h"
+#include "core/ogs-ohash.h"
 #include "core/ogs-misc.h"
 #include "core/ogs-getopt.h"
 #include "core/ogs-3gpp-types.h"
@@ -76,8 +79,17 @@ typedef struct {
         int pool;
         int domain_pool;
         ogs_log_level_e level;
+        int ring;       /* Records buffered in async mode */
+        struct {
+            ogs_time_t interval;
+            int burst;  /* Messages per interval at each call site */
+        } ratelimit;
     } log;
 
+    struct {
+        ogs_pool_hugepage_e hugepage;   /* Backing of large pool arrays */
+    } pool;
+
     struct {
         int pool;
         int config_pool;
@@ -85,6 +97,8 @@ typedef struct {
 
     struct {
         int pool;
+        bool io_uring;  /* Prefer io_uring to the default pollset */
+        bool xdp;       /* Add AF_XDP to the GTP-U server sockets */
     } socket;
 
     struct {
@@ -40,13 +40,31 @@ struct ogs_hash_t {
     unsigned int        count, max, seed;
     ogs_hashfunc_t      hash_func;
     ogs_hash_entry_t    *free;  /* List of recycled entries */
+
+    /*
+     * Incremental mode : while old_array is not NULL, the buckets from
+     * rehash_index to old_max have not been moved to the array yet.
+     */
+    bool                incremental;
+    ogs_hash_entry_t    **old_array;
+    unsigned int        old_max, rehash_index;
 };
 
 #define INITIAL_MAX 15 /* tunable == 2^n - 1 */
 
+/* Old buckets moved by each insert in incremental mode */
+#define REHASH_STEP 4
+
+/*
+ * The bucket array grows beyond the biggest pkbuf cluster(1MB)
+ * once the table holds more than 64K entries,
+ * so it is taken from the system allocator.
+ */
 static ogs_hash_entry_t **alloc_array(ogs_hash_t *ht, unsigned int max)
 {
-   return ogs_calloc(1, sizeof(*ht->array) * (max + 1));
+    ogs_hash_entry_t **array = calloc(max + 1, sizeof(*ht->array));
+    ogs_assert(array);
+    return array;
 }
 
 ogs_hash_t *ogs_hash_make()
@@ -64,6 +82,11 @@ ogs_hash_t *ogs_hash_make()
     ht->array = alloc_array(ht, ht->max);
     ht->hash_func = NULL;
 
+    ht->incremental = false;
+    ht->old_array = NULL;
+    ht->old_max = 0;
+    ht->rehash_index = 0;
+
     return ht;
 }
 
@@ -74,6 +97,13 @@ ogs_hash_t *ogs_hash_make_custom(ogs_hashfunc_t hash_func)
     return ht;
 }
 
+ogs_hash_t *ogs_hash_make_incremental(void)
+{
+    ogs_hash_t *ht = ogs_hash_make();
+    ht->incremental = true;
+    return ht;
+}
+
 void ogs_hash_destroy(ogs_hash_t *ht)
 {
     ogs_hash_entry_t *he = NULL, *next_he = NULL;
@@ -91,7 +121,9 @@ void ogs_hash_destroy(ogs_hash_t *ht)
         he = next_he;
     }
 
-    ogs_free(ht->array);
+    if (ht->old_array)
+        free(ht->old_array);
+    free(ht->array);
     ogs_free(ht);
 }
 
@@ -99,8 +131,16 @@ ogs_hash_index_t *ogs_hash_next(ogs_hash_index_t *hi)
 {
     hi->this = hi->next;
     while (!hi->this) {
-        if (hi->index > hi->ht->max)
-            return NULL;
+        if (hi->index > hi->ht->max) {
+            /* Then the buckets which are not rehashed yet */
+            unsigned int i = hi->index - (hi->ht->max + 1);
+            if (!hi->ht->old_array || i > hi->ht->old_max)
+                return NULL;
+
+            hi->this = hi->ht->old_array[i];
+            hi->index++;
+            continue;
+        }
 
         hi->this = hi->ht->array[hi->index++];
     }
@@ -166,11 +206,62 @@ static void expand_array(ogs_hash_t *ht)
         hi->this->next = new_array[i];
         new_array[i] = hi->this;
     }
-    ogs_free(ht->array);
+    free(ht->array);
     ht->array = new_array;
     ht->max = new_max;
 }
 
+/* Move up to n buckets from the old array */
+static void rehash_step(ogs_hash_t *ht, unsigned int n)
+{
+    ogs_hash_entry_t *he, *next_he;
+
+    while (n-- && ht->rehash_index <= ht->old_max) {
+        for (he = ht->old_array[ht->rehash_index]; he; he = next_he) {
+            unsigned int i = he->hash & ht->max;
+            next_he = he->next;
+            he->next = ht->array[i];
+            ht->array[i] = he;
+        }
+        ht->old_array[ht->rehash_index++] = NULL;
+    }
+
+    if (ht->rehash_index > ht->old_max) {
+        free(ht->old_array);
+        ht->old_array = NULL;
+    }
+}
+
+/*
+ * Instead of moving every entry at once, keep the current array as
+ * the old one and let the following inserts move it a few buckets
+ * at a time. The table doubles only after as many inserts as it has
+ * buckets, so the old array is always gone by then.
+ */
+static void expand_array_incremental(ogs_hash_t *ht)
+{
+    if (ht->old_array)
+        rehash_step(ht, ht->old_max + 1);
+
+    ht->old_array = ht->array;
+    ht->old_max = ht->max;
+    ht->rehash_index = 0;
+
+    ht->max = ht->max * 2 + 1;
+    ht->array = alloc_array(ht, ht->max);
+}
+
+static void check_expand(ogs_hash_t *ht)
+{
+    /* check that the collision rate isn't too high */
+    if (ht->count > ht->max) {
+        if (ht->incremental)
+            expand_array_incremental(ht);
+        else
+            expand_array(ht);
+    }
+}
+
 static unsigned int hashfunc_default(
         const char *char_key, int *klen, unsigned int hash)
 {
@@ -247,6 +338,10 @@ static ogs_hash_entry_t **find_entry(ogs_hash_t *ht,
     else
         hash = hashfunc_default(key, &klen, ht->seed);
 
+    /* Deletions and lookups leave the tables alone, like iterators do */
+    if (ht->old_array && val)
+        rehash_step(ht, REHASH_STEP);
+
     /* scan linked list */
     for (hep = &ht->array[hash & ht->max], he = *hep;
          he; hep = &he->next, he = *hep) {
@@ -255,6 +350,20 @@ static ogs_hash_entry_t **find_entry(ogs_hash_t *ht,
             && memcmp(he->key, key, klen) == 0)
             break;
     }
+    if (!he && ht->old_array) {
+        ogs_hash_entry_t **old_hep;
+
+        for (old_hep = &ht->old_array[hash & ht->old_max], he = *old_hep;
+             he; old_hep = &he->next, he = *old_hep) {
+            if (he->hash == hash
+                && he->klen == klen
+                && memcmp(he->key, key, klen) == 0)
+                break;
+        }
+        /* New entries always go to the end of the chain in the array */
+        if (he)
+            hep = old_hep;
+    }
     if (he || !val)
         return hep;
 
@@ -298,10 +407,7 @@ void ogs_hash_set(ogs_hash_t *ht, const void *key, int klen, const void *val)
         } else {
             /* replace entry */
             (*hep)->val = val;
-            /* check that the collision rate isn't too high */
-            if (ht->count > ht->max) {
-                expand_array(ht);
-            }
+            check_expand(ht);
         }
     }
     /* else key not present and val==NULL */
@@ -314,10 +420,7 @@ void *ogs_hash_get_or_set(ogs_hash_t *ht,
     hep = find_entry(ht, key, klen, val);
     if (*hep) {
         val = (*hep)->val;
-        /* check that the collision rate isn't too high */
-        if (ht->count > ht->max) {
-            expand_array(ht);
-        }
+        check_expand(ht);
         return (void *)val;
     }
     /* else key not present and val==NULL */
@@ -37,6 +37,11 @@ unsigned int ogs_hashfunc_default(const char *key, int *klen);
 
 ogs_hash_t *ogs_hash_make(void);
 ogs_hash_t *ogs_hash_make_custom(ogs_hashfunc_t ogs_hash_func);
+/*
+ * Spread the cost of doubling the bucket array over the following
+ * inserts instead of rehashing every entry at once.
+ */
+ogs_hash_t *ogs_hash_make_incremental(void);
 void ogs_hash_destroy(ogs_hash_t *ht);
 
 void ogs_hash_set(ogs_hash_t *ht, const void *key, int klen, const void *val);
@@ -47,6 +47,8 @@ const ogs_pollset_actions_t ogs_kqueue_actions = {
     kqueue_process,
 
     kqueue_notify_pollset,
+
+    NULL,
 };
 
 struct kqueue_context_s {
@@ -95,11 +95,72 @@ static OGS_LIST(log_list);
 static OGS_POOL(domain_pool, ogs_log_domain_t);
 static OGS_LIST(domain_list);
 
+int __ogs_log_max_level = OGS_LOG_FULL;
+
+#define OGS_LOG_RECORD_LEN  920
+#define OGS_LOG_CACHE_LINE  64
+
+/*
+ * A ring slot for async mode. It uses the same sequence scheme as
+ * OGS_QUEUE_MPSC : a producer owns the slot once it advances 'enqueue'
+ * with CAS and publishes it by storing seq = pos + 1, and the writer
+ * gives it back for the next lap with seq = pos + capacity.
+ */
+typedef struct ogs_log_record_s {
+    unsigned long       seq;
+
+    ogs_log_level_e     level;
+    int                 id;
+    ogs_err_t           err;
+    const char          *file;
+    int                 line;
+    const char          *func;
+    int                 content_only;
+    struct timeval      tv;
+
+    char                content[OGS_LOG_RECORD_LEN];
+} ogs_log_record_t;
+
+static struct {
+    ogs_log_record_t    *record;
+    unsigned long       mask;
+
+    ogs_thread_t        *thread;
+    ogs_thread_mutex_t  mutex;      /* Serializes writing to the logs */
+    ogs_thread_mutex_t  wait_mutex;
+    ogs_thread_cond_t   wait_cond;
+
+    char                pad0[OGS_LOG_CACHE_LINE];
+    volatile unsigned long enqueue;
+    volatile unsigned long dropped;
+    volatile unsigned long sync;
+    char                pad1[OGS_LOG_CACHE_LINE];
+    volatile unsigned long dequeue; /* Advanced by the writer thread */
+    volatile int        sleeping;
+    unsigned long       dropped_reported;
+    char                pad2[OGS_LOG_CACHE_LINE];
+
+    volatile int        active;     /* Messages go to the ring */
+    volatile int        locking;    /* Writing to the logs takes mutex */
+    volatile int        stop;
+
+    /* Threads which may be using the ring or the mutex, respectively */
+    volatile int        pushers;
+    volatile int        lockers;
+} async;
+
+static OGS_THREAD_LOCAL int in_writer;
+static OGS_THREAD_LOCAL int writing;
+
 static ogs_log_t *add_log(ogs_log_type_e type);
 static int file_cycle(ogs_log_t *log);
 
+static void log_write(ogs_log_level_e level, int id,
+        ogs_err_t err, const char *file, int line, const char *func,
+        int content_only, const struct timeval *tv, const char *content);
+
 static char *log_timestamp(char *buf, char *last,
-        int use_color);
+        const struct timeval *tv, int use_color);
 static char *log_domain(char *buf, char *last,
         const char *name, int use_color);
 static char *log_content(char *buf, char *last,
@@ -111,6 +172,8 @@ static char *log_linefeed(char *buf, char *last);
 static void file_writer(
         ogs_log_t *log, ogs_log_level_e level, const char *string);
 
+static void update_max_level(void);
+
 void ogs_log_init(void)
 {
     ogs_pool_init(&log_pool, ogs_core()->log.pool);
@@ -128,6 +191,9 @@ void ogs_log_final(void)
     ogs_log_t *log, *saved_log;
     ogs_log_domain_t *domain, *saved_domain;
 
+    if (async.thread)
+        ogs_log_stop_async();
+
     ogs_list_for_each_safe(&log_list, saved_log, log)
         ogs_log_remove(log);
     ogs_pool_final(&log_pool);
@@ -135,11 +201,69 @@ void ogs_log_final(void)
     ogs_list_for_each_safe(&domain_list, saved_domain, domain)
         ogs_log_remove_domain(domain);
     ogs_pool_final(&domain_pool);
+
+    __ogs_log_max_level = OGS_LOG_FULL;
+}
+
+/*
+ * A thread registers itself before it checks the flag, so that
+ * ogs_log_stop_async() can clear the flag and then wait until no thread
+ * which has seen it set is left, before it frees what the flag guards.
+ */
+static int async_enter(volatile int *users, volatile int *flag)
+{
+    ogs_atomic_inc(users);
+    ogs_atomic_fence();
+    if (ogs_atomic_load(flag))
+        return 1;
+
+    ogs_atomic_dec(users);
+    return 0;
+}
+
+static void async_leave(volatile int *users)
+{
+    ogs_atomic_dec(users);
+}
+
+static void async_wait(volatile int *users)
+{
+    ogs_atomic_fence();
+    while (ogs_atomic_load(users))
+        ogs_usleep(100);
+}
+
+/*
+ * In async mode the writer thread and callers writing synchronously
+ * share the logs, so writing to them is serialized. A thread which is
+ * already writing (e.g. an assertion fails while writing) goes ahead.
+ */
+static int lock_logs(void)
+{
+    if (writing || !ogs_atomic_load(&async.locking))
+        return 0;
+    if (!async_enter(&async.lockers, &async.locking))
+        return 0;
+
+    ogs_thread_mutex_lock(&async.mutex);
+    writing = 1;
+    return 1;
+}
+
+static void unlock_logs(int locked)
+{
+    if (!locked)
+        return;
+
+    writing = 0;
+    ogs_thread_mutex_unlock(&async.mutex);
+    async_leave(&async.lockers);
 }
 
 void ogs_log_cycle(void)
 {
     ogs_log_t *log = NULL;
+    int locked = lock_logs();
 
     ogs_list_for_each(&log_list, log) {
         switch(log->type) {
@@ -149,6 +273,8 @@ void ogs_log_cycle(void)
             break;
         }
     }
+
+    unlock_logs(locked);
 }
 
 ogs_log_t *ogs_log_add_stderr(void)
@@ -217,6 +343,7 @@ ogs_log_domain_t *ogs_log_add_domain(const char *name, ogs_log_level_e level)
     domain->level = level;
 
     ogs_list_add(&domain_list, domain);
+    update_max_level();
 
     return domain;
 }
@@ -240,6 +367,7 @@ void ogs_log_remove_domain(ogs_log_domain_t *domain)
 
     ogs_list_remove(&domain_list, domain);
     ogs_pool_free(&domain_pool, domain);
+    update_max_level();
 }
 
 void ogs_log_set_domain_level(int id, ogs_log_level_e level)
@@ -252,6 +380,7 @@ void ogs_log_set_domain_level(int id, ogs_log_level_e level)
     ogs_assert(domain);
 
     domain->level = level;
+    update_max_level();
 }
 
 ogs_log_level_e ogs_log_get_domain_level(int id)
@@ -341,6 +470,8 @@ void ogs_log_set_mask_level(const char *_mask, ogs_log_level_e level)
         ogs_list_for_each(&domain_list, domain)
             domain->level = level;
     }
+
+    update_max_level();
 }
 
 static ogs_log_level_e ogs_log_level_from_string(const char *string)
@@ -379,83 +510,310 @@ int ogs_log_config_domain(const char *domain, const char *level)
     return OGS_OK;
 }
 
+static void wake_writer(void)
+{
+    ogs_thread_mutex_lock(&async.wait_mutex);
+    ogs_thread_cond_signal(&async.wait_cond);
+    ogs_thread_mutex_unlock(&async.wait_mutex);
+}
+
+static int async_push(ogs_log_level_e level, int id,
+        ogs_err_t err, const char *file, int line, const char *func,
+        int content_only, const char *content, size_t len)
+{
+    ogs_log_record_t *record = NULL;
+    unsigned long pos;
+    long diff;
+
+    pos = ogs_atomic_load(&async.enqueue);
+    for ( ;; ) {
+        record = &async.record[pos & async.mask];
+        diff = (long)(ogs_atomic_load(&record->seq) - pos);
+        if (diff == 0) {
+            if (ogs_atomic_cas(&async.enqueue, pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            ogs_atomic_inc(&async.dropped);
+            return OGS_RETRY;
+        }
+        pos = ogs_atomic_load(&async.enqueue);
+    }
+
+    record->level = level;
+    record->id = id;
+    record->err = err;
+    record->file = file;
+    record->line = line;
+    record->func = func;
+    record->content_only = content_only;
+    ogs_gettimeofday(&record->tv);
+    memcpy(record->content, content, len + 1);
+
+    ogs_atomic_store(&record->seq, pos + 1);
+
+    /* Pairs with the fence in the writer before it goes to sleep */
+    ogs_atomic_fence();
+    if (ogs_atomic_load(&async.sleeping) &&
+        ogs_atomic_cas(&async.sleeping, 1, 0))
+        wake_writer();
+
+    return OGS_OK;
+}
+
+/* Returns the number of records written */
+static int async_drain(void)
+{
+    ogs_log_record_t *record = NULL;
+    unsigned long pos, dropped;
+    int n = 0, locked;
+
+    for ( ;; ) {
+        pos = async.dequeue;
+        record = &async.record[pos & async.mask];
+        if ((long)(ogs_atomic_load(&record->seq) - (pos + 1)) != 0)
+            break;
+
+        locked = lock_logs();
+        log_write(record->level, record->id,
+                record->err, record->file, record->line, record->func,
+                record->content_only, &record->tv, record->content);
+        unlock_logs(locked);
+
+        ogs_atomic_store(&record->seq, pos + async.mask + 1);
+        ogs_atomic_store(&async.dequeue, pos + 1);
+        n++;
+    }
+
+    dropped = ogs_atomic_load(&async.dropped);
+    if (dropped != async.dropped_reported &&
+        ogs_log_get_domain_level(OGS_LOG_DOMAIN) >= OGS_LOG_WARN) {
+        char content[OGS_HUGE_LEN];
+
+        ogs_snprintf(content, sizeof content,
+                "%lu log messages dropped (ring size %lu)",
+                dropped - async.dropped_reported, async.mask + 1);
+        async.dropped_reported = dropped;
+
+        locked = lock_logs();
+        log_write(OGS_LOG_WARN, OGS_LOG_DOMAIN,
+                0, __FILE__, __LINE__, OGS_FUNC, 0, NULL, content);
+        unlock_logs(locked);
+    }
+
+    return n;
+}
+
+static void async_writer(void *data)
+{
+    in_writer = 1;
+
+    for ( ;; ) {
+        if (async_drain())
+            continue;
+        if (ogs_atomic_load(&async.stop))
+            break;
+
+        ogs_thread_mutex_lock(&async.wait_mutex);
+        ogs_atomic_store(&async.sleeping, 1);
+        ogs_atomic_fence();
+        if ((long)(ogs_atomic_load(&async.record[
+                        async.dequeue & async.mask].seq) -
+                    (async.dequeue + 1)) != 0 &&
+            !ogs_atomic_load(&async.stop))
+            ogs_thread_cond_timedwait(&async.wait_cond, &async.wait_mutex,
+                    ogs_time_from_msec(100));
+        ogs_atomic_store(&async.sleeping, 0);
+        ogs_thread_mutex_unlock(&async.wait_mutex);
+    }
+}
+
+void ogs_log_start_async(unsigned int capacity)
+{
+    unsigned long i, size = 1;
+
+    ogs_assert(capacity);
+    ogs_assert(!async.thread);
+
+    while (size < capacity)
+        size <<= 1;
+
+    /* Larger than the biggest pkbuf cluster, so use the system allocator */
+    async.record = calloc(size, sizeof(ogs_log_record_t));
+    ogs_assert(async.record);
+    for (i = 0; i < size; i++)
+        async.record[i].seq = i;
+    async.mask = size - 1;
+
+    async.enqueue = 0;
+    async.dequeue = 0;
+    async.dropped = 0;
+    async.dropped_reported = 0;
+    async.sync = 0;
+    async.sleeping = 0;
+    async.stop = 0;
+    async.pushers = 0;
+    async.lockers = 0;
+
+    ogs_thread_mutex_init(&async.mutex);
+    ogs_thread_mutex_init(&async.wait_mutex);
+    ogs_thread_cond_init(&async.wait_cond);
+
+    ogs_atomic_store(&async.locking, 1);
+
+    async.thread = ogs_thread_create(async_writer, NULL);
+    ogs_assert(async.thread);
+
+    ogs_atomic_store(&async.active, 1);
+}
+
+/*
+ * Other threads may keep logging while this runs. Their messages are
+ * written synchronously once they see async.active cleared, and the
+ * ring and the mutexes are only released after the last thread which
+ * saw them in use has left.
+ */
+void ogs_log_stop_async(void)
+{
+    ogs_assert(async.thread);
+    ogs_assert(!in_writer);
+
+    /* From here on messages are written synchronously */
+    ogs_atomic_store(&async.active, 0);
+    async_wait(&async.pushers);
+
+    /* The ring has no producer left, so the writer empties it */
+    ogs_atomic_store(&async.stop, 1);
+    wake_writer();
+
+    ogs_thread_destroy(async.thread);
+    async.thread = NULL;
+
+    /* There is nothing left to serialize with */
+    ogs_atomic_store(&async.locking, 0);
+    async_wait(&async.lockers);
+
+    ogs_thread_cond_destroy(&async.wait_cond);
+    ogs_thread_mutex_destroy(&async.wait_mutex);
+    ogs_thread_mutex_destroy(&async.mutex);
+
+    free(async.record);
+    async.record = NULL;
+}
+
+void ogs_log_flush(void)
+{
+    unsigned long target;
+    ogs_time_t deadline;
+
+    /* The writer thread cannot wait for itself */
+    if (in_writer || !ogs_atomic_load(&async.active))
+        return;
+    if (!async_enter(&async.pushers, &async.active))
+        return;
+
+    target = ogs_atomic_load(&async.enqueue);
+    deadline = ogs_get_monotonic_time() + ogs_time_from_sec(1);
+
+    while ((long)(ogs_atomic_load(&async.dequeue) - target) < 0) {
+        if (ogs_get_monotonic_time() > deadline)
+            break;
+        wake_writer();
+        ogs_usleep(100);
+    }
+
+    async_leave(&async.pushers);
+}
+
+void ogs_log_stat(ogs_log_stat_t *stat)
+{
+    ogs_assert(stat);
+
+    memset(stat, 0, sizeof *stat);
+    if (!async.record)
+        return;
+
+    stat->capacity = async.mask + 1;
+    stat->queued = ogs_atomic_load(&async.enqueue);
+    stat->written = ogs_atomic_load(&async.dequeue);
+    stat->dropped = ogs_atomic_load(&async.dropped);
+    stat->sync = ogs_atomic_load(&async.sync);
+}
+
 void ogs_log_vprintf(ogs_log_level_e level, int id,
     ogs_err_t err, const char *file, int line, const char *func,
     int content_only, const char *format, va_list ap)
 {
-    ogs_log_t *log = NULL;
     ogs_log_domain_t *domain = NULL;
 
-    char logstr[OGS_HUGE_LEN];
-    char *p, *last;
-
-    int wrote_stderr = 0;
+    char content[OGS_HUGE_LEN];
+    size_t len;
+    int locked;
 
-    ogs_list_for_each(&log_list, log) {
+    if (!ogs_list_empty(&log_list)) {
         domain = ogs_pool_find(&domain_pool, id);
         ogs_assert(domain);
         if (domain->level < level)
             return;
+    }
 
-        p = logstr;
-        last = logstr + OGS_HUGE_LEN;
+    log_content(content, content + OGS_HUGE_LEN, format, ap);
+    len = strlen(content);
 
-        if (!content_only) {
-            if (log->print.timestamp)
-                p = log_timestamp(p, last, log->print.color);
-            if (log->print.domain)
-                p = log_domain(p, last, domain->name, log->print.color);
-            if (log->print.level)
-                p = log_level(p, last, level, log->print.color);
+    if (ogs_atomic_load(&async.active) && level != OGS_LOG_FATAL &&
+        async_enter(&async.pushers, &async.active)) {
+        if (len < OGS_LOG_RECORD_LEN) {
+            async_push(level, id,
+                    err, file, line, func, content_only, content, len);
+            async_leave(&async.pushers);
+            return;
         }
+        ogs_atomic_inc(&async.sync);
+        async_leave(&async.pushers);
+    }
 
-        p = log_content(p, last, format, ap);
+    if (level == OGS_LOG_FATAL)
+        ogs_log_flush();
 
-        if (err) {
-            char errbuf[OGS_HUGE_LEN];
-            p = ogs_slprintf(p, last, " (%d:%s)",
-                    (int)err, ogs_strerror(err, errbuf, OGS_HUGE_LEN));
-        }
-
-        if (!content_only) {
-            if (log->print.fileline)
-                p = ogs_slprintf(p, last, " (%s:%d)", file, line);
-            if (log->print.function)
-                p = ogs_slprintf(p, last, " %s()", func);
-            if (log->print.linefeed) 
-                p = log_linefeed(p, last);
-        }
+    locked = lock_logs();
+    log_write(level, id, err, file, line, func, content_only, NULL, content);
+    unlock_logs(locked);
+}
 
-        log->writer(log, level, logstr);
-        
-        if (log->type == OGS_LOG_STDERR_TYPE)
-            wrote_stderr = 1;
+/*
+ * The first ogs_core()->log.ratelimit.burst messages in each interval
+ * are let through. The first one after the interval also reports
+ * how many were suppressed at this call site.
+ */
+int ogs_log_ratelimit(ogs_log_ratelimit_t *rs, ogs_log_level_e level,
+        int id, const char *file, int line, const char *func)
+{
+    ogs_time_t now, begin;
+    int suppressed;
+
+    ogs_assert(rs);
+
+    if (level > __ogs_log_max_level || ogs_log_get_domain_level(id) < level)
+        return 0;
+
+    now = ogs_get_monotonic_time();
+    begin = ogs_atomic_load(&rs->begin);
+    if ((begin == 0 || now - begin >= ogs_core()->log.ratelimit.interval) &&
+        ogs_atomic_cas(&rs->begin, begin, now)) {
+        do {
+            suppressed = ogs_atomic_load(&rs->suppressed);
+        } while (!ogs_atomic_cas(&rs->suppressed, suppressed, 0));
+        ogs_atomic_store(&rs->printed, 0);
+
+        if (suppressed)
+            ogs_log_printf(level, id, 0, file, line, func, 0,
+                    "%d messages suppressed", suppressed);
     }
 
-    if (!wrote_stderr)
-    {
-        int use_color = 0;
-#if !defined(_WIN32)
-        use_color = 1;
-#endif
-
-        p = logstr;
-        last = logstr + OGS_HUGE_LEN;
-
-        if (!content_only) {
-            p = log_timestamp(p, last, use_color);
-            p = log_level(p, last, level, use_color);
-        }
-        p = log_content(p, last, format, ap);
-        if (!content_only) {
-            p = ogs_slprintf(p, last, " (%s:%d)", file, line);
-            p = ogs_slprintf(p, last, " %s()", func);
-            p = log_linefeed(p, last);
-        }
+    if (ogs_atomic_inc(&rs->printed) <= ogs_core()->log.ratelimit.burst)
+        return 1;
 
-        fprintf(stderr, "%s", logstr);
-        fflush(stderr);
-    }
+    ogs_atomic_inc(&rs->suppressed);
+    return 0;
 }
 
 void ogs_log_printf(ogs_log_level_e level, int id,
@@ -503,6 +861,18 @@ void ogs_log_hexdump_func(ogs_log_level_e level, int id,
     ogs_log_print(level, "%s", dumpstr);
 }
 
+static void update_max_level(void)
+{
+    ogs_log_domain_t *domain = NULL;
+    int level = OGS_LOG_NONE;
+
+    ogs_list_for_each(&domain_list, domain)
+        if (domain->level > level)
+            level = domain->level;
+
+    __ogs_log_max_level = level;
+}
+
 static ogs_log_t *add_log(ogs_log_type_e type)
 {
     ogs_log_t *log = NULL;
@@ -537,20 +907,101 @@ static int file_cycle(ogs_log_t *log)
     return 0;
 }
 
+static void log_write(ogs_log_level_e level, int id,
+        ogs_err_t err, const char *file, int line, const char *func,
+        int content_only, const struct timeval *tv, const char *content)
+{
+    ogs_log_t *log = NULL;
+    ogs_log_domain_t *domain = NULL;
+    struct timeval now;
+
+    char logstr[OGS_HUGE_LEN];
+    char *p, *last;
+
+    int wrote_stderr = 0;
+
+    if (!tv) {
+        ogs_gettimeofday(&now);
+        tv = &now;
+    }
+
+    ogs_list_for_each(&log_list, log) {
+        domain = ogs_pool_find(&domain_pool, id);
+        ogs_assert(domain);
+
+        p = logstr;
+        last = logstr + OGS_HUGE_LEN;
+
+        if (!content_only) {
+            if (log->print.timestamp)
+                p = log_timestamp(p, last, tv, log->print.color);
+            if (log->print.domain)
+                p = log_domain(p, last, domain->name, log->print.color);
+            if (log->print.level)
+                p = log_level(p, last, level, log->print.color);
+        }
+
+        p = ogs_slprintf(p, last, "%s", content);
+
+        if (err) {
+            char errbuf[OGS_HUGE_LEN];
+            p = ogs_slprintf(p, last, " (%d:%s)",
+                    (int)err, ogs_strerror(err, errbuf, OGS_HUGE_LEN));
+        }
+
+        if (!content_only) {
+            if (log->print.fileline)
+                p = ogs_slprintf(p, last, " (%s:%d)", file, line);
+            if (log->print.function)
+                p = ogs_slprintf(p, last, " %s()", func);
+            if (log->print.linefeed) 
+                p = log_linefeed(p, last);
+        }
+
+        log->writer(log, level, logstr);
+        
+        if (log->type == OGS_LOG_STDERR_TYPE)
+            wrote_stderr = 1;
+    }
+
+    if (!wrote_stderr)
+    {
+        int use_color = 0;
+#if !defined(_WIN32)
+        use_color = 1;
+#endif
+
+        p = logstr;
+        last = logstr + OGS_HUGE_LEN;
+
+        if (!content_only) {
+            p = log_timestamp(p, last, tv, use_color);
+            p = log_level(p, last, level, use_color);
+        }
+        p = ogs_slprintf(p, last, "%s", content);
+        if (!content_only) {
+            p = ogs_slprintf(p, last, " (%s:%d)", file, line);
+            p = ogs_slprintf(p, last, " %s()", func);
+            p = log_linefeed(p, last);
+        }
+
+        fprintf(stderr, "%s", logstr);
+        fflush(stderr);
+    }
+}
+
 static char *log_timestamp(char *buf, char *last,
-        int use_color)
+        const struct timeval *tv, int use_color)
 {
-    struct timeval tv;
     struct tm tm;
     char nowstr[32];
 
-    ogs_gettimeofday(&tv);
-    ogs_localtime(tv.tv_sec, &tm);
+    ogs_localtime(tv->tv_sec, &tm);
     strftime(nowstr, sizeof nowstr, "%m/%d %H:%M:%S", &tm);
 
     buf = ogs_slprintf(buf, last, "%s%s.%03d%s: ",
             use_color ? TA_FGC_GREEN : "",
-            nowstr, (int)(tv.tv_usec/1000),
+            nowstr, (int)(tv->tv_usec/1000),
             use_color ? TA_NOR : "");
 
     return buf;
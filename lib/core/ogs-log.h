@@ -32,25 +32,86 @@ extern "C" {
 #define OGS_LOG_DOMAIN      1
 #endif
 
+/*
+ * Call sites below OGS_LOG_COMPILE_LEVEL are compiled out, and their
+ * arguments are never evaluated. It is set by the 'log_level' build
+ * option, and uses the values of ogs_log_level_e.
+ */
+#ifndef OGS_LOG_COMPILE_LEVEL
+#define OGS_LOG_COMPILE_LEVEL   6   /* OGS_LOG_TRACE */
+#endif
+
+#define ogs_log_elided(level, ...) \
+    ((void)(0 ? ogs_log_message(level, 0, __VA_ARGS__) : (void)0))
+
 #define ogs_fatal(...) ogs_log_message(OGS_LOG_FATAL, 0, __VA_ARGS__)
 #define ogs_error(...) ogs_log_message(OGS_LOG_ERROR, 0, __VA_ARGS__)
 #define ogs_warn(...) ogs_log_message(OGS_LOG_WARN, 0, __VA_ARGS__)
+#if OGS_LOG_COMPILE_LEVEL >= 4
 #define ogs_info(...) ogs_log_message(OGS_LOG_INFO, 0, __VA_ARGS__)
+#else
+#define ogs_info(...) ogs_log_elided(OGS_LOG_INFO, __VA_ARGS__)
+#endif
+#if OGS_LOG_COMPILE_LEVEL >= 5
 #define ogs_debug(...) ogs_log_message(OGS_LOG_DEBUG, 0, __VA_ARGS__)
+#else
+#define ogs_debug(...) ogs_log_elided(OGS_LOG_DEBUG, __VA_ARGS__)
+#endif
+#if OGS_LOG_COMPILE_LEVEL >= 6
 #define ogs_trace(...) ogs_log_message(OGS_LOG_TRACE, 0, __VA_ARGS__)
+#else
+#define ogs_trace(...) ogs_log_elided(OGS_LOG_TRACE, __VA_ARGS__)
+#endif
 
+/*
+ * The arguments are not evaluated unless some domain logs at this level.
+ * __ogs_log_max_level is the highest level of all domains.
+ */
 #define ogs_log_message(level, err, ...) \
+    ((level) <= __ogs_log_max_level ? \
     ogs_log_printf(level, OGS_LOG_DOMAIN, \
     err, __FILE__, __LINE__, OGS_FUNC,  \
-    0, __VA_ARGS__) 
+    0, __VA_ARGS__) : (void)0)
 
 #define ogs_log_print(level, ...) \
     ogs_log_printf(level, OGS_LOG_DOMAIN, \
     0, NULL, 0, NULL,  \
     1, __VA_ARGS__) 
 
+/*
+ * Rate limited logging for messages which may fire once per packet.
+ * Each call site logs at most ogs_core()->log.ratelimit.burst messages
+ * per ogs_core()->log.ratelimit.interval, and the next message after
+ * the interval reports how many were suppressed.
+ */
+#define ogs_log_ratelimited(level, err, ...) \
+    do { \
+        static ogs_log_ratelimit_t __ogs_ratelimit; \
+        if (ogs_log_ratelimit(&__ogs_ratelimit, level, OGS_LOG_DOMAIN, \
+                __FILE__, __LINE__, OGS_FUNC)) \
+            ogs_log_message(level, err, __VA_ARGS__); \
+    } while (0)
+
+#define ogs_error_ratelimited(...) \
+    ogs_log_ratelimited(OGS_LOG_ERROR, 0, __VA_ARGS__)
+#define ogs_warn_ratelimited(...) \
+    ogs_log_ratelimited(OGS_LOG_WARN, 0, __VA_ARGS__)
+#if OGS_LOG_COMPILE_LEVEL >= 4
+#define ogs_info_ratelimited(...) \
+    ogs_log_ratelimited(OGS_LOG_INFO, 0, __VA_ARGS__)
+#else
+#define ogs_info_ratelimited(...) ogs_log_elided(OGS_LOG_INFO, __VA_ARGS__)
+#endif
+#if OGS_LOG_COMPILE_LEVEL >= 5
+#define ogs_debug_ratelimited(...) \
+    ogs_log_ratelimited(OGS_LOG_DEBUG, 0, __VA_ARGS__)
+#else
+#define ogs_debug_ratelimited(...) ogs_log_elided(OGS_LOG_DEBUG, __VA_ARGS__)
+#endif
+
 #define ogs_log_hexdump(level, _d, _l) \
-    ogs_log_hexdump_func(level, OGS_LOG_DOMAIN, _d, _l)
+    ((level) <= __ogs_log_max_level ? \
+    ogs_log_hexdump_func(level, OGS_LOG_DOMAIN, _d, _l) : (void)0)
 
 typedef enum {
     OGS_LOG_NONE,
@@ -64,6 +125,8 @@ typedef enum {
     OGS_LOG_FULL = OGS_LOG_TRACE,
 } ogs_log_level_e;
 
+extern int __ogs_log_max_level;
+
 typedef struct ogs_log_s ogs_log_t;
 typedef struct ogs_log_domain_s ogs_log_domain_t;
 
@@ -91,6 +154,37 @@ int ogs_log_config_domain(const char *domain, const char *level);
 
 void ogs_log_set_mask_level(const char *mask, ogs_log_level_e level);
 
+/*
+ * In async mode the calling thread only formats the message itself into
+ * a lock-free ring, and a writer thread adds the timestamp, domain and
+ * level and writes it to every log. A message is dropped if the ring
+ * is full. FATAL messages flush the ring first and are written from
+ * the calling thread, so they are out before ogs_abort().
+ * ogs_log_stop_async() may be called while other threads keep logging.
+ */
+void ogs_log_start_async(unsigned int capacity);
+void ogs_log_stop_async(void);
+void ogs_log_flush(void);
+
+typedef struct ogs_log_stat_s {
+    unsigned int capacity;
+    uint64_t queued;        /* Messages put in the ring */
+    uint64_t written;       /* Messages written by the writer thread */
+    uint64_t dropped;       /* Messages lost because the ring was full */
+    uint64_t sync;          /* Messages too long for a ring slot */
+} ogs_log_stat_t;
+
+void ogs_log_stat(ogs_log_stat_t *stat);
+
+typedef struct ogs_log_ratelimit_s {
+    volatile int64_t begin;     /* Start of the current interval */
+    volatile int printed;
+    volatile int suppressed;
+} ogs_log_ratelimit_t;
+
+int ogs_log_ratelimit(ogs_log_ratelimit_t *rs, ogs_log_level_e level,
+        int id, const char *file, int line, const char *func);
+
 void ogs_log_vprintf(ogs_log_level_e level, int id,
     ogs_err_t err, const char *file, int line, const char *func,
     int content_only, const char *format, va_list ap);
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ogs-core.h"
+
+/*
+ * Each slot has a control byte. An empty or deleted slot has the high bit
+ * set, and a full slot stores the low 7 bits of the key hash (H2). The
+ * remaining bits (H1) select where probing starts. Probing loads 8 control
+ * bytes into a word and matches H2 against all of them at once, so only
+ * slots with a matching H2 have their key compared.
+ *
+ * The first GROUP_WIDTH control bytes are mirrored after the end of
+ * the array, so a group starting near the end can be loaded in one go.
+ */
+#define GROUP_WIDTH         8
+
+#define CTRL_EMPTY          0x80
+#define CTRL_DELETED        0xfe
+
+#define LSBS                0x0101010101010101ULL
+#define MSBS                0x8080808080808080ULL
+
+#define INITIAL_CAPACITY    16
+
+typedef uint64_t group_t;
+
+struct ogs_ohash_s {
+    uint8_t         *ctrl;
+    unsigned char   *slot;      /* [value][key] * capacity */
+
+    unsigned int    mask;       /* capacity - 1 */
+    unsigned int    count;
+    unsigned int    growth_left;
+
+    int             klen;
+    size_t          slot_size;
+
+    uint64_t        seed;
+};
+
+#define SLOT(__hT, __iDX) ((__hT)->slot + (size_t)(__iDX) * (__hT)->slot_size)
+#define SLOT_KEY(__sLOT) ((__sLOT) + sizeof(void *))
+
+static ogs_inline group_t group_load(const uint8_t *ctrl)
+{
+    group_t g;
+    memcpy(&g, ctrl, sizeof(g));
+#if OGS_BYTE_ORDER == OGS_BIG_ENDIAN
+    g = __builtin_bswap64(g);
+#endif
+    return g;
+}
+
+/* Bit 7 of each byte is set where the control byte equals h2 */
+static ogs_inline group_t group_match(group_t g, uint8_t h2)
+{
+    group_t x = g ^ (LSBS * h2);
+    return (x - LSBS) & ~x & MSBS;
+}
+
+static ogs_inline group_t group_match_empty(group_t g)
+{
+    return g & (~g << 6) & MSBS;
+}
+
+static ogs_inline group_t group_match_empty_or_deleted(group_t g)
+{
+    return g & MSBS;
+}
+
+#if defined(__GNUC__)
+#define trailing_bytes(__mASK) (__builtin_ctzll(__mASK) >> 3)
+#define leading_bytes(__mASK) (__builtin_clzll(__mASK) >> 3)
+#else
+static ogs_inline int trailing_bytes(group_t mask)
+{
+    int n = 0;
+    while (!(mask & 0x80)) {
+        mask >>= 8;
+        n++;
+    }
+    return n;
+}
+static ogs_inline int leading_bytes(group_t mask)
+{
+    int n = 0;
+    while (!(mask & 0x8000000000000000ULL)) {
+        mask <<= 8;
+        n++;
+    }
+    return n;
+}
+#endif
+
+static ogs_inline uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static ogs_inline uint64_t hash_key(ogs_ohash_t *ht, const void *key, int klen)
+{
+    const unsigned char *p = key;
+    uint64_t h = ht->seed, word;
+    uint32_t word32;
+
+    if (klen == 4) {
+        memcpy(&word32, p, 4);
+        return mix64(h ^ word32);
+    } else if (klen == 8) {
+        memcpy(&word, p, 8);
+        return mix64(h ^ word);
+    }
+
+    h ^= (uint64_t)klen * 0x9e3779b97f4a7c15ULL;
+    while (klen >= 8) {
+        memcpy(&word, p, 8);
+        h = mix64(h ^ word);
+        p += 8;
+        klen -= 8;
+    }
+    if (klen) {
+        word = 0;
+        memcpy(&word, p, klen);
+        h = mix64(h ^ word);
+    }
+    return h;
+}
+
+static ogs_inline int key_equal(
+        const unsigned char *slot_key, const void *key, int klen)
+{
+    if (klen == 4) {
+        uint32_t a, b;
+        memcpy(&a, slot_key, 4);
+        memcpy(&b, key, 4);
+        return a == b;
+    } else if (klen == 8) {
+        uint64_t a, b;
+        memcpy(&a, slot_key, 8);
+        memcpy(&b, key, 8);
+        return a == b;
+    }
+    return memcmp(slot_key, key, klen) == 0;
+}
+
+static ogs_inline void set_ctrl(ogs_ohash_t *ht, unsigned int i, uint8_t c)
+{
+    ht->ctrl[i] = c;
+    if (i < GROUP_WIDTH)
+        ht->ctrl[ht->mask + 1 + i] = c;
+}
+
+static ogs_inline unsigned int max_growth(unsigned int capacity)
+{
+    return capacity - capacity / 8;
+}
+
+/* Returns the slot index holding the key, or -1 */
+static ogs_inline long find(
+        ogs_ohash_t *ht, const void *key, uint64_t hash, int klen)
+{
+    uint8_t h2 = hash & 0x7f;
+    unsigned int pos = (unsigned int)(hash >> 7) & ht->mask;
+    unsigned int stride = 0, i;
+    group_t g, match;
+
+    for ( ;; ) {
+        g = group_load(ht->ctrl + pos);
+        for (match = group_match(g, h2); match; match &= match - 1) {
+            i = (pos + trailing_bytes(match)) & ht->mask;
+            if (ht->ctrl[i] == h2 && key_equal(SLOT_KEY(SLOT(ht, i)), key, klen))
+                return i;
+        }
+        if (group_match_empty(g))
+            return -1;
+
+        stride += GROUP_WIDTH;
+        pos = (pos + stride) & ht->mask;
+    }
+}
+
+static unsigned int find_first_non_full(ogs_ohash_t *ht, uint64_t hash)
+{
+    unsigned int pos = (unsigned int)(hash >> 7) & ht->mask;
+    unsigned int stride = 0;
+    group_t match;
+
+    for ( ;; ) {
+        match = group_match_empty_or_deleted(group_load(ht->ctrl + pos));
+        if (match)
+            return (pos + trailing_bytes(match)) & ht->mask;
+
+        stride += GROUP_WIDTH;
+        pos = (pos + stride) & ht->mask;
+    }
+}
+
+/*
+ * Tables grow beyond the biggest pkbuf cluster(1MB) quickly,
+ * so the arrays are taken from the system allocator.
+ */
+static void alloc_table(ogs_ohash_t *ht, unsigned int capacity)
+{
+    ht->ctrl = malloc(capacity + GROUP_WIDTH);
+    ogs_assert(ht->ctrl);
+    memset(ht->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+
+    ht->slot = malloc((size_t)capacity * ht->slot_size);
+    ogs_assert(ht->slot);
+
+    ht->mask = capacity - 1;
+    ht->growth_left = max_growth(capacity);
+}
+
+static void resize(ogs_ohash_t *ht, unsigned int capacity)
+{
+    uint8_t *old_ctrl = ht->ctrl;
+    unsigned char *old_slot = ht->slot;
+    unsigned int old_capacity = ht->mask + 1;
+    unsigned int i, j;
+    uint64_t hash;
+
+    ogs_assert(capacity >= INITIAL_CAPACITY);
+    ogs_assert(max_growth(capacity) >= ht->count);
+
+    alloc_table(ht, capacity);
+
+    for (i = 0; i < old_capacity; i++) {
+        unsigned char *slot = old_slot + (size_t)i * ht->slot_size;
+
+        if (old_ctrl[i] & CTRL_EMPTY)
+            continue;
+
+        hash = hash_key(ht, SLOT_KEY(slot), ht->klen);
+        j = find_first_non_full(ht, hash);
+        set_ctrl(ht, j, hash & 0x7f);
+        memcpy(SLOT(ht, j), slot, ht->slot_size);
+    }
+    ht->growth_left -= ht->count;
+
+    free(old_slot);
+    free(old_ctrl);
+}
+
+static ogs_inline void insert(ogs_ohash_t *ht,
+        const void *key, uint64_t hash, int klen, const void *val)
+{
+    unsigned int i;
+    unsigned char *slot;
+
+    i = find_first_non_full(ht, hash);
+    if (ht->growth_left == 0 && ht->ctrl[i] != CTRL_DELETED) {
+        unsigned int capacity = ht->mask + 1;
+
+        /* Drop the tombstones unless the table is really getting full */
+        resize(ht, ht->count >= max_growth(capacity) / 2 ?
+                capacity * 2 : capacity);
+        i = find_first_non_full(ht, hash);
+    }
+
+    if (ht->ctrl[i] == CTRL_EMPTY)
+        ht->growth_left--;
+    set_ctrl(ht, i, hash & 0x7f);
+
+    slot = SLOT(ht, i);
+    memcpy(slot, &val, sizeof(void *));
+    memcpy(SLOT_KEY(slot), key, klen);
+
+    ht->count++;
+}
+
+static ogs_inline void erase(ogs_ohash_t *ht, unsigned int i)
+{
+    unsigned int before = (i - GROUP_WIDTH) & ht->mask;
+    group_t empty_after = group_match_empty(group_load(ht->ctrl + i));
+    group_t empty_before = group_match_empty(group_load(ht->ctrl + before));
+
+    /*
+     * If no window of GROUP_WIDTH slots around i was ever completely
+     * full, no probe sequence went past this slot and it can be
+     * marked empty again instead of leaving a tombstone.
+     */
+    if (empty_before && empty_after &&
+        trailing_bytes(empty_after) + leading_bytes(empty_before) <
+            GROUP_WIDTH) {
+        set_ctrl(ht, i, CTRL_EMPTY);
+        ht->growth_left++;
+    } else {
+        set_ctrl(ht, i, CTRL_DELETED);
+    }
+
+    ht->count--;
+}
+
+static ogs_inline void *slot_val(ogs_ohash_t *ht, long i)
+{
+    void *val;
+
+    if (i < 0)
+        return NULL;
+
+    memcpy(&val, SLOT(ht, i), sizeof(void *));
+    return val;
+}
+
+static ogs_inline void set(ogs_ohash_t *ht,
+        const void *key, int klen, const void *val)
+{
+    uint64_t hash = hash_key(ht, key, klen);
+    long i = find(ht, key, hash, klen);
+
+    if (i >= 0) {
+        if (val)
+            memcpy(SLOT(ht, i), &val, sizeof(void *));
+        else
+            erase(ht, i);
+    } else if (val) {
+        insert(ht, key, hash, klen, val);
+    }
+}
+
+ogs_ohash_t *ogs_ohash_create(int klen)
+{
+    ogs_ohash_t *ht = NULL;
+
+    ogs_assert(klen > 0);
+
+    ht = ogs_calloc(1, sizeof(ogs_ohash_t));
+    ogs_assert(ht);
+
+    ht->klen = klen;
+    ht->slot_size = sizeof(void *) +
+        ((klen + sizeof(void *) - 1) & ~(sizeof(void *) - 1));
+    ht->seed = ((uint64_t)ogs_random32() << 32) | ogs_random32();
+
+    alloc_table(ht, INITIAL_CAPACITY);
+
+    return ht;
+}
+
+void ogs_ohash_destroy(ogs_ohash_t *ht)
+{
+    ogs_assert(ht);
+
+    free(ht->slot);
+    free(ht->ctrl);
+    ogs_free(ht);
+}
+
+void ogs_ohash_set(ogs_ohash_t *ht, const void *key, const void *val)
+{
+    ogs_assert(ht);
+    ogs_assert(key);
+
+    set(ht, key, ht->klen, val);
+}
+
+void *ogs_ohash_get(ogs_ohash_t *ht, const void *key)
+{
+    ogs_assert(ht);
+    ogs_assert(key);
+
+    return slot_val(ht, find(ht, key, hash_key(ht, key, ht->klen), ht->klen));
+}
+
+void ogs_ohash_set_u32(ogs_ohash_t *ht, uint32_t key, const void *val)
+{
+    ogs_assert(ht);
+    ogs_assert(ht->klen == 4);
+
+    set(ht, &key, 4, val);
+}
+
+void *ogs_ohash_get_u32(ogs_ohash_t *ht, uint32_t key)
+{
+    ogs_assert(ht);
+    ogs_assert(ht->klen == 4);
+
+    return slot_val(ht, find(ht, &key, hash_key(ht, &key, 4), 4));
+}
+
+void ogs_ohash_set_u64(ogs_ohash_t *ht, uint64_t key, const void *val)
+{
+    ogs_assert(ht);
+    ogs_assert(ht->klen == 8);
+
+    set(ht, &key, 8, val);
+}
+
+void *ogs_ohash_get_u64(ogs_ohash_t *ht, uint64_t key)
+{
+    ogs_assert(ht);
+    ogs_assert(ht->klen == 8);
+
+    return slot_val(ht, find(ht, &key, hash_key(ht, &key, 8), 8));
+}
+
+unsigned int ogs_ohash_count(ogs_ohash_t *ht)
+{
+    ogs_assert(ht);
+    return ht->count;
+}
+
+void ogs_ohash_clear(ogs_ohash_t *ht)
+{
+    ogs_assert(ht);
+
+    memset(ht->ctrl, CTRL_EMPTY, ht->mask + 1 + GROUP_WIDTH);
+    ht->count = 0;
+    ht->growth_left = max_growth(ht->mask + 1);
+}
+
+int ogs_ohash_do(ogs_ohash_do_callback_fn_t *comp,
+        void *rec, ogs_ohash_t *ht)
+{
+    unsigned int i;
+    unsigned char *slot;
+    void *val;
+
+    ogs_assert(comp);
+    ogs_assert(ht);
+
+    for (i = 0; i <= ht->mask; i++) {
+        if (ht->ctrl[i] & CTRL_EMPTY)
+            continue;
+
+        slot = SLOT(ht, i);
+        memcpy(&val, slot, sizeof(void *));
+        if ((*comp)(rec, SLOT_KEY(slot), val) == 0)
+            return 0;
+    }
+
+    return 1;
+}
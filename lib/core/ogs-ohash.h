@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(OGS_CORE_INSIDE) && !defined(OGS_CORE_COMPILATION)
+#error "This header cannot be included directly."
+#endif
+
+#ifndef OGS_OHASH_H
+#define OGS_OHASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Open addressing hash table for fixed-length keys.
+ *
+ * Keys are copied into the table next to the value, and a byte of
+ * metadata per slot is probed 8 slots at a time, so a lookup usually
+ * touches one metadata word and one slot. Unlike ogs_hash_t, the caller
+ * does not need to keep the key memory alive.
+ *
+ * As with ogs_hash_set(), setting a NULL value removes the key.
+ * The _u32 and _u64 variants may only be used on tables created
+ * with a key length of 4 and 8 respectively.
+ */
+typedef struct ogs_ohash_s ogs_ohash_t;
+
+ogs_ohash_t *ogs_ohash_create(int klen);
+void ogs_ohash_destroy(ogs_ohash_t *ht);
+
+void ogs_ohash_set(ogs_ohash_t *ht, const void *key, const void *val);
+void *ogs_ohash_get(ogs_ohash_t *ht, const void *key);
+
+void ogs_ohash_set_u32(ogs_ohash_t *ht, uint32_t key, const void *val);
+void *ogs_ohash_get_u32(ogs_ohash_t *ht, uint32_t key);
+
+void ogs_ohash_set_u64(ogs_ohash_t *ht, uint64_t key, const void *val);
+void *ogs_ohash_get_u64(ogs_ohash_t *ht, uint64_t key);
+
+unsigned int ogs_ohash_count(ogs_ohash_t *ht);
+void ogs_ohash_clear(ogs_ohash_t *ht);
+
+/* Return 0 from the callback to stop the iteration */
+typedef int (ogs_ohash_do_callback_fn_t)(
+        void *rec, const void *key, void *val);
+
+int ogs_ohash_do(ogs_ohash_do_callback_fn_t *comp,
+        void *rec, ogs_ohash_t *ht);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OGS_OHASH_H */
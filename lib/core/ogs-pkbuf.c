@@ -46,6 +46,42 @@ OGS_STATIC_ASSERT(sizeof(ogs_cluster_2048_t) % sizeof(void *) == 0);
 OGS_STATIC_ASSERT(sizeof(ogs_cluster_8192_t) % sizeof(void *) == 0);
 OGS_STATIC_ASSERT(sizeof(ogs_cluster_big_t) % sizeof(void *) == 0);
 
+/*
+ * Cluster classes, from the smallest to the largest.
+ * The big cluster is too scarce to be cached by each thread.
+ */
+enum {
+    OGS_CLUSTER_128 = 0,
+    OGS_CLUSTER_256,
+    OGS_CLUSTER_512,
+    OGS_CLUSTER_1024,
+    OGS_CLUSTER_2048,
+    OGS_CLUSTER_8192,
+    OGS_CLUSTER_BIG,
+    OGS_NUM_OF_CLUSTER,
+};
+#define OGS_NUM_OF_CACHED_CLUSTER OGS_CLUSTER_BIG
+
+/*
+ * Each thread keeps a small stack (magazine) of free pkbuf headers and
+ * clusters for every pool it uses, so that the pool mutex is only taken
+ * to refill or flush half of a magazine at once.
+ */
+#define OGS_PKBUF_CACHE_SIZE        64
+#define OGS_PKBUF_MAX_CACHE_POOL    4
+
+typedef struct ogs_pkbuf_cache_s {
+    ogs_lnode_t lnode;
+
+    ogs_pkbuf_pool_t *pool;
+
+    int num_of_pkbuf;
+    ogs_pkbuf_t *pkbuf[OGS_PKBUF_CACHE_SIZE];
+
+    int num_of_cluster[OGS_NUM_OF_CACHED_CLUSTER];
+    ogs_cluster_t *cluster[OGS_NUM_OF_CACHED_CLUSTER][OGS_PKBUF_CACHE_SIZE];
+} ogs_pkbuf_cache_t;
+
 typedef struct ogs_pkbuf_pool_s {
     OGS_POOL(pkbuf, ogs_pkbuf_t);
     OGS_POOL(cluster, ogs_cluster_t);
@@ -58,16 +94,32 @@ typedef struct ogs_pkbuf_pool_s {
     OGS_POOL(cluster_8192, ogs_cluster_8192_t);
     OGS_POOL(cluster_big, ogs_cluster_big_t);
 
+    /* Magazine size of each thread cache, 0 if not cached */
+    int cache_pkbuf;
+    int cache_cluster[OGS_NUM_OF_CACHED_CLUSTER];
+    ogs_list_t cache_list;
+
     ogs_thread_mutex_t mutex;
 } ogs_pkbuf_pool_t;
 
 static OGS_POOL(pkbuf_pool, ogs_pkbuf_pool_t);
 static ogs_pkbuf_pool_t *default_pool = NULL;
 
-static ogs_cluster_t *cluster_alloc(
-        ogs_pkbuf_pool_t *pool, unsigned int size);
+static OGS_THREAD_LOCAL bool cache_enabled = false;
+static OGS_THREAD_LOCAL ogs_pkbuf_cache_t *cache_array[
+                                            OGS_PKBUF_MAX_CACHE_POOL];
+
+static int cluster_index(unsigned int size);
+static ogs_cluster_t *cluster_alloc(ogs_pkbuf_pool_t *pool, int index);
 static void cluster_free(ogs_pkbuf_pool_t *pool, ogs_cluster_t *cluster);
 
+static ogs_pkbuf_cache_t *cache_get(ogs_pkbuf_pool_t *pool);
+static void cache_refill(ogs_pkbuf_pool_t *pool,
+        ogs_pkbuf_cache_t *cache, int index);
+static void cache_flush(ogs_pkbuf_pool_t *pool,
+        ogs_pkbuf_cache_t *cache, bool all);
+static void cache_final(ogs_pkbuf_pool_t *pool);
+
 void *ogs_pkbuf_put_data(
         ogs_pkbuf_t *pkbuf, const void *data, unsigned int len)
 {
@@ -80,13 +132,34 @@ void *ogs_pkbuf_put_data(
 void ogs_pkbuf_init(void)
 {
     ogs_pool_init(&pkbuf_pool, ogs_core()->pkbuf.pool);
+
+    ogs_pkbuf_cache_init();
 }
 
 void ogs_pkbuf_final(void)
 {
+    ogs_pkbuf_cache_final();
+
     ogs_pool_final(&pkbuf_pool);
 }
 
+void ogs_pkbuf_cache_init(void)
+{
+    cache_enabled = true;
+}
+
+void ogs_pkbuf_cache_final(void)
+{
+    int i;
+
+    for (i = 0; i < OGS_PKBUF_MAX_CACHE_POOL; i++) {
+        if (cache_array[i])
+            cache_final(cache_array[i]->pool);
+    }
+
+    cache_enabled = false;
+}
+
 void ogs_pkbuf_default_init(ogs_pkbuf_config_t *config)
 {
     ogs_assert(config);
@@ -111,6 +184,13 @@ void ogs_pkbuf_default_destroy(void)
     ogs_pkbuf_pool_destroy(default_pool);
 }
 
+/*
+ * A thread may hold at most 1/16 of each pool in its magazine
+ * so that the other threads do not run out.
+ */
+#define cache_size_of(_pool) \
+    ogs_min(OGS_PKBUF_CACHE_SIZE, (_pool) / 16)
+
 ogs_pkbuf_pool_t *ogs_pkbuf_pool_create(ogs_pkbuf_config_t *config)
 {
     ogs_pkbuf_pool_t *pool = NULL;
@@ -140,6 +220,20 @@ ogs_pkbuf_pool_t *ogs_pkbuf_pool_create(ogs_pkbuf_config_t *config)
     ogs_pool_init(&pool->cluster_8192, config->cluster_8192_pool);
     ogs_pool_init(&pool->cluster_big, config->cluster_big_pool);
 
+    pool->cache_pkbuf = cache_size_of(tmp);
+    pool->cache_cluster[OGS_CLUSTER_128] =
+        cache_size_of(config->cluster_128_pool);
+    pool->cache_cluster[OGS_CLUSTER_256] =
+        cache_size_of(config->cluster_256_pool);
+    pool->cache_cluster[OGS_CLUSTER_512] =
+        cache_size_of(config->cluster_512_pool);
+    pool->cache_cluster[OGS_CLUSTER_1024] =
+        cache_size_of(config->cluster_1024_pool);
+    pool->cache_cluster[OGS_CLUSTER_2048] =
+        cache_size_of(config->cluster_2048_pool);
+    pool->cache_cluster[OGS_CLUSTER_8192] =
+        cache_size_of(config->cluster_8192_pool);
+
     return pool;
 }
 
@@ -147,6 +241,19 @@ void ogs_pkbuf_pool_destroy(ogs_pkbuf_pool_t *pool)
 {
     ogs_assert(pool);
 
+    /*
+     * The magazine of another thread cannot be flushed safely while
+     * that thread may be using it. So every other thread which used the
+     * pool must have dropped its magazine by ogs_pkbuf_cache_final(),
+     * e.g. by returning from an ogs_thread_create() function.
+     */
+    cache_final(pool);
+    if (ogs_list_first(&pool->cache_list)) {
+        ogs_fatal("%d threads still cache this pool",
+                ogs_list_count(&pool->cache_list));
+        ogs_assert_if_reached();
+    }
+
     ogs_pool_final(&pool->pkbuf);
     ogs_pool_final(&pool->cluster);
 
@@ -163,27 +270,125 @@ void ogs_pkbuf_pool_destroy(ogs_pkbuf_pool_t *pool)
     ogs_pool_free(&pkbuf_pool, pool);
 }
 
+void ogs_pkbuf_pool_stat(ogs_pkbuf_pool_t *pool, ogs_pkbuf_stat_t *stat)
+{
+    ogs_pkbuf_cache_t *cache = NULL;
+    int avail[OGS_NUM_OF_CLUSTER];
+    int i;
+
+    if (pool == NULL)
+        pool = default_pool;
+    ogs_assert(pool);
+    ogs_assert(stat);
+
+    ogs_thread_mutex_lock(&pool->mutex);
+
+    stat->pkbuf_size = ogs_pool_size(&pool->pkbuf);
+    stat->pkbuf_avail = ogs_pool_avail(&pool->pkbuf);
+
+    avail[OGS_CLUSTER_128] = ogs_pool_avail(&pool->cluster_128);
+    avail[OGS_CLUSTER_256] = ogs_pool_avail(&pool->cluster_256);
+    avail[OGS_CLUSTER_512] = ogs_pool_avail(&pool->cluster_512);
+    avail[OGS_CLUSTER_1024] = ogs_pool_avail(&pool->cluster_1024);
+    avail[OGS_CLUSTER_2048] = ogs_pool_avail(&pool->cluster_2048);
+    avail[OGS_CLUSTER_8192] = ogs_pool_avail(&pool->cluster_8192);
+    avail[OGS_CLUSTER_BIG] = ogs_pool_avail(&pool->cluster_big);
+
+    /*
+     * Cached objects are free too. The magazines of running threads
+     * may change while counting, so it is only a snapshot.
+     */
+    ogs_list_for_each(&pool->cache_list, cache) {
+        stat->pkbuf_avail += cache->num_of_pkbuf;
+        for (i = 0; i < OGS_NUM_OF_CACHED_CLUSTER; i++)
+            avail[i] += cache->num_of_cluster[i];
+    }
+
+    ogs_thread_mutex_unlock(&pool->mutex);
+
+    stat->cluster_128_avail = avail[OGS_CLUSTER_128];
+    stat->cluster_256_avail = avail[OGS_CLUSTER_256];
+    stat->cluster_512_avail = avail[OGS_CLUSTER_512];
+    stat->cluster_1024_avail = avail[OGS_CLUSTER_1024];
+    stat->cluster_2048_avail = avail[OGS_CLUSTER_2048];
+    stat->cluster_8192_avail = avail[OGS_CLUSTER_8192];
+    stat->cluster_big_avail = avail[OGS_CLUSTER_BIG];
+}
+
+void *ogs_pkbuf_pool_cluster_mem(
+        ogs_pkbuf_pool_t *pool, unsigned int size, size_t *len)
+{
+    ogs_assert(pool);
+    ogs_assert(len);
+
+    switch (size) {
+    case OGS_CLUSTER_128_SIZE:
+        *len = sizeof(ogs_cluster_128_t) * pool->cluster_128.size;
+        return pool->cluster_128.array;
+    case OGS_CLUSTER_256_SIZE:
+        *len = sizeof(ogs_cluster_256_t) * pool->cluster_256.size;
+        return pool->cluster_256.array;
+    case OGS_CLUSTER_512_SIZE:
+        *len = sizeof(ogs_cluster_512_t) * pool->cluster_512.size;
+        return pool->cluster_512.array;
+    case OGS_CLUSTER_1024_SIZE:
+        *len = sizeof(ogs_cluster_1024_t) * pool->cluster_1024.size;
+        return pool->cluster_1024.array;
+    case OGS_CLUSTER_2048_SIZE:
+        *len = sizeof(ogs_cluster_2048_t) * pool->cluster_2048.size;
+        return pool->cluster_2048.array;
+    case OGS_CLUSTER_8192_SIZE:
+        *len = sizeof(ogs_cluster_8192_t) * pool->cluster_8192.size;
+        return pool->cluster_8192.array;
+    default:
+        break;
+    }
+
+    *len = 0;
+    return NULL;
+}
+
 ogs_pkbuf_t *ogs_pkbuf_alloc(ogs_pkbuf_pool_t *pool, unsigned int size)
 {
     ogs_pkbuf_t *pkbuf = NULL;
     ogs_cluster_t *cluster = NULL;
+    ogs_pkbuf_cache_t *cache = NULL;
+    int index;
 
     if (pool == NULL)
         pool = default_pool;
     ogs_assert(pool);
 
-    ogs_thread_mutex_lock(&pool->mutex);
+    index = cluster_index(size);
 
-    cluster = cluster_alloc(pool, size);
-    ogs_assert(cluster);
+    cache = cache_get(pool);
+    if (cache && index < OGS_NUM_OF_CACHED_CLUSTER &&
+        pool->cache_cluster[index]) {
+        if (ogs_unlikely(!cache->num_of_pkbuf ||
+                    !cache->num_of_cluster[index]))
+            cache_refill(pool, cache, index);
 
-    ogs_pool_alloc(&pool->pkbuf, &pkbuf);
-    ogs_assert(pkbuf);
-    memset(pkbuf, 0, sizeof(*pkbuf));
+        if (cache->num_of_pkbuf && cache->num_of_cluster[index]) {
+            pkbuf = cache->pkbuf[--cache->num_of_pkbuf];
+            cluster = cache->cluster[index][--cache->num_of_cluster[index]];
+        }
+    }
 
-    cluster->ref++;
+    if (!pkbuf) {
+        ogs_thread_mutex_lock(&pool->mutex);
 
-    ogs_thread_mutex_unlock(&pool->mutex);
+        cluster = cluster_alloc(pool, index);
+        ogs_assert(cluster);
+
+        ogs_pool_alloc(&pool->pkbuf, &pkbuf);
+        ogs_assert(pkbuf);
+
+        ogs_thread_mutex_unlock(&pool->mutex);
+    }
+
+    memset(pkbuf, 0, sizeof(*pkbuf));
+
+    cluster->ref = 1;
 
     pkbuf->cluster = cluster;
 
@@ -203,6 +408,7 @@ void ogs_pkbuf_free(ogs_pkbuf_t *pkbuf)
 {
     ogs_pkbuf_pool_t *pool = NULL;
     ogs_cluster_t *cluster = NULL;
+    ogs_pkbuf_cache_t *cache = NULL;
     ogs_assert(pkbuf);
 
     pool = pkbuf->pool;
@@ -211,82 +417,138 @@ void ogs_pkbuf_free(ogs_pkbuf_t *pkbuf)
     cluster = pkbuf->cluster;
     ogs_assert(cluster);
 
-    ogs_thread_mutex_lock(&pool->mutex);
-
-    cluster->ref--;
-    if (cluster->ref == 0)
-        cluster_free(pool, pkbuf->cluster);
-
-    ogs_pool_free(&pool->pkbuf, pkbuf);
+    cache = cache_get(pool);
+
+    if (ogs_atomic_dec(&cluster->ref) == 0) {
+        int index = cluster_index(cluster->size);
+
+        if (cache && index < OGS_NUM_OF_CACHED_CLUSTER &&
+            pool->cache_cluster[index]) {
+            if (ogs_unlikely(cache->num_of_cluster[index] ==
+                        pool->cache_cluster[index]))
+                cache_flush(pool, cache, false);
+            cache->cluster[index][cache->num_of_cluster[index]++] = cluster;
+        } else {
+            ogs_thread_mutex_lock(&pool->mutex);
+            cluster_free(pool, cluster);
+            ogs_thread_mutex_unlock(&pool->mutex);
+        }
+    }
 
-    ogs_thread_mutex_unlock(&pool->mutex);
+    if (cache && pool->cache_pkbuf) {
+        if (ogs_unlikely(cache->num_of_pkbuf == pool->cache_pkbuf))
+            cache_flush(pool, cache, false);
+        cache->pkbuf[cache->num_of_pkbuf++] = pkbuf;
+    } else {
+        ogs_thread_mutex_lock(&pool->mutex);
+        ogs_pool_free(&pool->pkbuf, pkbuf);
+        ogs_thread_mutex_unlock(&pool->mutex);
+    }
 }
 
 ogs_pkbuf_t *ogs_pkbuf_copy(ogs_pkbuf_t *pkbuf)
 {
     ogs_pkbuf_pool_t *pool = NULL;
     ogs_pkbuf_t *newbuf = NULL;
+    ogs_pkbuf_cache_t *cache = NULL;
 
     ogs_assert(pkbuf);
     pool = pkbuf->pool;
     ogs_assert(pool);
 
-    ogs_thread_mutex_lock(&pool->mutex);
+    cache = cache_get(pool);
+    if (cache && pool->cache_pkbuf) {
+        if (ogs_unlikely(!cache->num_of_pkbuf))
+            cache_refill(pool, cache, -1);
+        if (cache->num_of_pkbuf)
+            newbuf = cache->pkbuf[--cache->num_of_pkbuf];
+    }
 
-    ogs_pool_alloc(&pool->pkbuf, &newbuf);
+    if (!newbuf) {
+        ogs_thread_mutex_lock(&pool->mutex);
+        ogs_pool_alloc(&pool->pkbuf, &newbuf);
+        ogs_thread_mutex_unlock(&pool->mutex);
+    }
     ogs_assert(newbuf);
-    memcpy(newbuf, pkbuf, sizeof *pkbuf);
 
-    newbuf->cluster->ref++;
+    memcpy(newbuf, pkbuf, sizeof *pkbuf);
 
-    ogs_thread_mutex_unlock(&pool->mutex);
+    ogs_atomic_inc(&newbuf->cluster->ref);
 
     return newbuf;
 }
 
-static ogs_cluster_t *cluster_alloc(
-        ogs_pkbuf_pool_t *pool, unsigned int size)
+static int cluster_index(unsigned int size)
+{
+    if (size <= OGS_CLUSTER_128_SIZE)
+        return OGS_CLUSTER_128;
+    else if (size <= OGS_CLUSTER_256_SIZE)
+        return OGS_CLUSTER_256;
+    else if (size <= OGS_CLUSTER_512_SIZE)
+        return OGS_CLUSTER_512;
+    else if (size <= OGS_CLUSTER_1024_SIZE)
+        return OGS_CLUSTER_1024;
+    else if (size <= OGS_CLUSTER_2048_SIZE)
+        return OGS_CLUSTER_2048;
+    else if (size <= OGS_CLUSTER_8192_SIZE)
+        return OGS_CLUSTER_8192;
+    else if (size <= OGS_CLUSTER_BIG_SIZE)
+        return OGS_CLUSTER_BIG;
+
+    ogs_fatal("invalid size = %d", size);
+    ogs_assert_if_reached();
+    return OGS_CLUSTER_BIG;
+}
+
+/* Called with pool->mutex held, returns NULL if the pool is exhausted */
+static ogs_cluster_t *cluster_alloc(ogs_pkbuf_pool_t *pool, int index)
 {
     ogs_cluster_t *cluster = NULL;
     void *buffer = NULL;
     ogs_assert(pool);
 
     ogs_pool_alloc(&pool->cluster, &cluster);
-    ogs_assert(cluster);
+    if (!cluster)
+        return NULL;
     memset(cluster, 0, sizeof(*cluster));
 
-    if (size <= OGS_CLUSTER_128_SIZE) {
+    switch (index) {
+    case OGS_CLUSTER_128:
         ogs_pool_alloc(&pool->cluster_128, (ogs_cluster_128_t**)&buffer);
-        ogs_assert(buffer);
         cluster->size = OGS_CLUSTER_128_SIZE;
-    } else if (size <= OGS_CLUSTER_256_SIZE) {
+        break;
+    case OGS_CLUSTER_256:
         ogs_pool_alloc(&pool->cluster_256, (ogs_cluster_256_t**)&buffer);
-        ogs_assert(buffer);
         cluster->size = OGS_CLUSTER_256_SIZE;
-    } else if (size <= OGS_CLUSTER_512_SIZE) {
+        break;
+    case OGS_CLUSTER_512:
         ogs_pool_alloc(&pool->cluster_512, (ogs_cluster_512_t**)&buffer);
-        ogs_assert(buffer);
         cluster->size = OGS_CLUSTER_512_SIZE;
-    } else if (size <= OGS_CLUSTER_1024_SIZE) {
+        break;
+    case OGS_CLUSTER_1024:
         ogs_pool_alloc(&pool->cluster_1024, (ogs_cluster_1024_t**)&buffer);
-        ogs_assert(buffer);
         cluster->size = OGS_CLUSTER_1024_SIZE;
-    } else if (size <= OGS_CLUSTER_2048_SIZE) {
+        break;
+    case OGS_CLUSTER_2048:
         ogs_pool_alloc(&pool->cluster_2048, (ogs_cluster_2048_t**)&buffer);
-        ogs_assert(buffer);
         cluster->size = OGS_CLUSTER_2048_SIZE;
-    } else if (size <= OGS_CLUSTER_8192_SIZE) {
+        break;
+    case OGS_CLUSTER_8192:
         ogs_pool_alloc(&pool->cluster_8192, (ogs_cluster_8192_t**)&buffer);
-        ogs_assert(buffer);
         cluster->size = OGS_CLUSTER_8192_SIZE;
-    } else if (size <= OGS_CLUSTER_BIG_SIZE) {
+        break;
+    case OGS_CLUSTER_BIG:
         ogs_pool_alloc(&pool->cluster_big, (ogs_cluster_big_t**)&buffer);
-        ogs_assert(buffer);
         cluster->size = OGS_CLUSTER_BIG_SIZE;
-    } else {
-        ogs_fatal("invalid size = %d", size);
+        break;
+    default:
         ogs_assert_if_reached();
     }
+
+    if (!buffer) {
+        ogs_pool_free(&pool->cluster, cluster);
+        return NULL;
+    }
     cluster->buffer = buffer;
 
     return cluster;
@@ -327,3 +589,134 @@ static void cluster_free(ogs_pkbuf_pool_t *pool, ogs_cluster_t *cluster)
     ogs_pool_free(&pool->cluster, cluster);
 }
 
+/*
+ * Returns the magazine of the calling thread for this pool,
+ * or NULL if the thread does not cache (e.g. foreign threads)
+ */
+static ogs_pkbuf_cache_t *cache_get(ogs_pkbuf_pool_t *pool)
+{
+    ogs_pkbuf_cache_t *cache = NULL;
+    int i;
+
+    for (i = 0; i < OGS_PKBUF_MAX_CACHE_POOL; i++) {
+        if (ogs_likely(cache_array[i] && cache_array[i]->pool == pool))
+            return cache_array[i];
+    }
+
+    if (!cache_enabled)
+        return NULL;
+
+    for (i = 0; i < OGS_PKBUF_MAX_CACHE_POOL; i++) {
+        if (!cache_array[i])
+            break;
+    }
+    if (i == OGS_PKBUF_MAX_CACHE_POOL)
+        return NULL;
+
+    /* Not from the pool itself, as ogs_malloc() comes here */
+    cache = calloc(1, sizeof *cache);
+    ogs_assert(cache);
+    cache->pool = pool;
+
+    ogs_thread_mutex_lock(&pool->mutex);
+    ogs_list_add(&pool->cache_list, cache);
+    ogs_thread_mutex_unlock(&pool->mutex);
+
+    cache_array[i] = cache;
+
+    return cache;
+}
+
+/*
+ * Fills half of the pkbuf magazine and, if index is a cached class,
+ * half of the cluster magazine
+ */
+static void cache_refill(ogs_pkbuf_pool_t *pool,
+        ogs_pkbuf_cache_t *cache, int index)
+{
+    ogs_assert(pool);
+    ogs_assert(cache);
+
+    ogs_thread_mutex_lock(&pool->mutex);
+
+    if (!cache->num_of_pkbuf) {
+        while (cache->num_of_pkbuf < (pool->cache_pkbuf + 1) / 2) {
+            ogs_pkbuf_t *pkbuf = NULL;
+
+            ogs_pool_alloc(&pool->pkbuf, &pkbuf);
+            if (!pkbuf)
+                break;
+            cache->pkbuf[cache->num_of_pkbuf++] = pkbuf;
+        }
+    }
+
+    if (index >= 0 && !cache->num_of_cluster[index]) {
+        while (cache->num_of_cluster[index] <
+                (pool->cache_cluster[index] + 1) / 2) {
+            ogs_cluster_t *cluster = cluster_alloc(pool, index);
+            if (!cluster)
+                break;
+            cache->cluster[index][cache->num_of_cluster[index]++] = cluster;
+        }
+    }
+
+    ogs_thread_mutex_unlock(&pool->mutex);
+}
+
+/* Returns every full magazine to the pool, keeping half unless all */
+static void cache_flush(ogs_pkbuf_pool_t *pool,
+        ogs_pkbuf_cache_t *cache, bool all)
+{
+    int i, keep;
+
+    ogs_assert(pool);
+    ogs_assert(cache);
+
+    ogs_thread_mutex_lock(&pool->mutex);
+
+    keep = all ? 0 : pool->cache_pkbuf / 2;
+    if (all || cache->num_of_pkbuf == pool->cache_pkbuf) {
+        while (cache->num_of_pkbuf > keep) {
+            ogs_pkbuf_t *pkbuf = cache->pkbuf[--cache->num_of_pkbuf];
+            ogs_pool_free(&pool->pkbuf, pkbuf);
+        }
+    }
+
+    for (i = 0; i < OGS_NUM_OF_CACHED_CLUSTER; i++) {
+        keep = all ? 0 : pool->cache_cluster[i] / 2;
+        if (all || cache->num_of_cluster[i] == pool->cache_cluster[i]) {
+            while (cache->num_of_cluster[i] > keep)
+                cluster_free(pool,
+                        cache->cluster[i][--cache->num_of_cluster[i]]);
+        }
+    }
+
+    ogs_thread_mutex_unlock(&pool->mutex);
+}
+
+/* Drops the magazine of the calling thread for this pool */
+static void cache_final(ogs_pkbuf_pool_t *pool)
+{
+    ogs_pkbuf_cache_t *cache = NULL;
+    int i;
+
+    ogs_assert(pool);
+
+    for (i = 0; i < OGS_PKBUF_MAX_CACHE_POOL; i++) {
+        if (cache_array[i] && cache_array[i]->pool == pool)
+            break;
+    }
+    if (i == OGS_PKBUF_MAX_CACHE_POOL)
+        return;
+
+    cache = cache_array[i];
+    cache_array[i] = NULL;
+
+    cache_flush(pool, cache, true);
+
+    ogs_thread_mutex_lock(&pool->mutex);
+    ogs_list_remove(&pool->cache_list, cache);
+    ogs_thread_mutex_unlock(&pool->mutex);
+
+    free(cache);
+}
@@ -32,7 +32,7 @@ typedef struct ogs_cluster_s {
     unsigned char *buffer;
     unsigned int size;
 
-    unsigned int ref;
+    unsigned int ref;           /* Atomic */
 } ogs_cluster_t;
 
 typedef struct ogs_pkbuf_pool_s ogs_pkbuf_pool_t;
@@ -59,15 +59,42 @@ typedef struct ogs_pkbuf_config_s {
     int cluster_big_pool;
 } ogs_pkbuf_config_t;
 
+typedef struct ogs_pkbuf_stat_s {
+    int pkbuf_size;
+    int pkbuf_avail;
+
+    int cluster_128_avail;
+    int cluster_256_avail;
+    int cluster_512_avail;
+    int cluster_1024_avail;
+    int cluster_2048_avail;
+    int cluster_8192_avail;
+    int cluster_big_avail;
+} ogs_pkbuf_stat_t;
+
 void ogs_pkbuf_init(void);
 void ogs_pkbuf_final(void);
 
+/*
+ * Enables/disables the per-thread pkbuf cache of the calling thread.
+ * ogs_thread_create() does this for its threads.
+ */
+void ogs_pkbuf_cache_init(void);
+void ogs_pkbuf_cache_final(void);
+
 void ogs_pkbuf_default_init(ogs_pkbuf_config_t *config);
 void ogs_pkbuf_default_create(ogs_pkbuf_config_t *config);
 void ogs_pkbuf_default_destroy(void);
 
 ogs_pkbuf_pool_t *ogs_pkbuf_pool_create(ogs_pkbuf_config_t *config);
 void ogs_pkbuf_pool_destroy(ogs_pkbuf_pool_t *pool);
+void ogs_pkbuf_pool_stat(ogs_pkbuf_pool_t *pool, ogs_pkbuf_stat_t *stat);
+/*
+ * Memory of all the clusters of one size, from the first to the last.
+ * It can be registered with a device, like the UMEM of AF_XDP.
+ */
+void *ogs_pkbuf_pool_cluster_mem(
+        ogs_pkbuf_pool_t *pool, unsigned int size, size_t *len);
 
 ogs_pkbuf_t *ogs_pkbuf_alloc(ogs_pkbuf_pool_t *pool, unsigned int size);
 void ogs_pkbuf_free(ogs_pkbuf_t *pkbuf);
@@ -36,6 +36,19 @@ typedef struct ogs_poll_s {
     ogs_poll_handler_f handler;
     void *data;
 
+    /* Set by ogs_pollset_add_recv() */
+    struct {
+        ogs_poll_recv_f handler;
+        void *data;
+
+        ogs_pkbuf_pool_t *pool;
+        int headroom;
+        bool socket;        /* Otherwise, TUN device or pipe */
+        bool gro;           /* UDP_GRO aggregates are split by the pollset */
+    } recv;
+
+    void *context;          /* Backend state of this poll */
+
     ogs_pollset_t *pollset;
 } ogs_poll_t;
 
@@ -47,8 +60,19 @@ typedef struct ogs_pollset_s {
         ogs_socket_t fd[2];
         ogs_poll_t *poll;
     } notify;
+
+    /* 8K buffers for the receive path of readiness backends */
+    ogs_pkbuf_t **posted;
+    /* For a UDP_GRO aggregate */
+    uint8_t *gro_buf;
 } ogs_pollset_t;
 
+void ogs_pollset_recv_handler(short when, ogs_socket_t fd, void *data);
+ogs_pkbuf_t *ogs_pollset_recv_copy(ogs_poll_t *poll, void *data, int len);
+
+/* NULL if io_uring is not available */
+const ogs_pollset_actions_t *ogs_uring_probe(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,13 +36,26 @@ ogs_pollset_t *ogs_pollset_create(void)
     ogs_pool_init(&pollset->pool, ogs_core()->socket.pool);
 
     if (ogs_pollset_actions_initialized == false) {
+        const ogs_pollset_actions_t *uring = NULL;
+
+        if (ogs_core()->socket.io_uring) {
+            uring = ogs_uring_probe();
+            if (!uring)
+                ogs_warn("io_uring is not available, "
+                        "fall back to the default pollset");
+        }
+
+        if (uring) {
+            ogs_pollset_actions = *uring;
+        } else {
 #if defined(HAVE_KQUEUE)
-        ogs_pollset_actions = ogs_kqueue_actions;;
+            ogs_pollset_actions = ogs_kqueue_actions;;
 #elif defined(HAVE_EPOLL)
-        ogs_pollset_actions = ogs_epoll_actions;;
+            ogs_pollset_actions = ogs_epoll_actions;;
 #else
-        ogs_pollset_actions = ogs_select_actions;
+            ogs_pollset_actions = ogs_select_actions;
 #endif
+        }
         ogs_pollset_actions_initialized = true;
     }
 
@@ -57,6 +70,15 @@ void ogs_pollset_destroy(ogs_pollset_t *pollset)
 
     ogs_pollset_actions.cleanup(pollset);
 
+    if (pollset->posted) {
+        int i;
+        for (i = 0; i < OGS_UDP_MAX_BATCH; i++)
+            ogs_pkbuf_free(pollset->posted[i]);
+        ogs_free(pollset->posted);
+    }
+    if (pollset->gro_buf)
+        ogs_free(pollset->gro_buf);
+
     ogs_pool_final(&pollset->pool);
     ogs_free(pollset);
 }
@@ -84,6 +106,9 @@ ogs_poll_t *ogs_pollset_add(ogs_pollset_t *pollset, short when,
     poll->handler = handler;
     poll->data = data;
 
+    memset(&poll->recv, 0, sizeof poll->recv);
+    poll->context = NULL;
+
     poll->pollset = pollset;
 
     rc = ogs_pollset_actions.add(poll, when);
@@ -96,6 +121,179 @@ ogs_poll_t *ogs_pollset_add(ogs_pollset_t *pollset, short when,
     return poll;
 }
 
+ogs_poll_t *ogs_pollset_add_recv(ogs_pollset_t *pollset, ogs_socket_t fd,
+        ogs_pkbuf_pool_t *pool, int headroom,
+        ogs_poll_recv_f handler, void *data)
+{
+    ogs_poll_t *poll = NULL;
+    int rc;
+
+    ogs_assert(pollset);
+
+    ogs_assert(fd != INVALID_SOCKET);
+    ogs_assert(handler);
+    ogs_assert(headroom >= 0 && headroom < OGS_MAX_SDU_LEN);
+
+    ogs_pool_alloc(&pollset->pool, &poll);
+    ogs_assert(poll);
+
+    rc = ogs_nonblocking(fd);
+    ogs_assert(rc == OGS_OK);
+    rc = ogs_closeonexec(fd);
+    ogs_assert(rc == OGS_OK);
+
+    poll->fd = fd;
+
+    /* Backends without add_recv drive the receive path by OGS_POLLIN */
+    poll->handler = ogs_pollset_recv_handler;
+    poll->data = poll;
+
+    memset(&poll->recv, 0, sizeof poll->recv);
+    poll->recv.handler = handler;
+    poll->recv.data = data;
+    poll->recv.pool = pool;
+    poll->recv.headroom = headroom;
+    poll->recv.socket = ogs_is_socket(fd);
+    poll->recv.gro = poll->recv.socket && ogs_udp_gro_enabled(fd);
+    poll->context = NULL;
+
+    poll->pollset = pollset;
+
+    if (ogs_pollset_actions.add_recv)
+        rc = ogs_pollset_actions.add_recv(poll);
+    else
+        rc = ogs_pollset_actions.add(poll, OGS_POLLIN);
+    if (rc != OGS_OK) {
+        ogs_error("cannot add poll");
+        ogs_pool_free(&pollset->pool, poll);
+        return NULL;
+    }
+
+    return poll;
+}
+
+/*
+ * Each aggregate is split into the datagrams coalesced by the kernel.
+ */
+static void recv_gro(ogs_poll_t *poll)
+{
+    ogs_pollset_t *pollset = NULL;
+    ogs_sockaddr_t from;
+    ogs_pkbuf_t *pkbuf = NULL;
+    int i, segsize, len;
+    ssize_t size;
+
+    pollset = poll->pollset;
+    ogs_assert(pollset);
+
+    if (!pollset->gro_buf) {
+        pollset->gro_buf = ogs_malloc(OGS_UDP_MAX_GRO_LEN);
+        ogs_assert(pollset->gro_buf);
+    }
+
+    for (i = 0; i < OGS_UDP_MAX_BATCH; i++) {
+        size = ogs_udp_recv_gro(poll->fd, pollset->gro_buf,
+                OGS_UDP_MAX_GRO_LEN, &segsize, &from);
+        if (size <= 0)
+            break;
+
+        for (len = 0; len < size; len += segsize) {
+            pkbuf = ogs_pollset_recv_copy(poll, pollset->gro_buf + len,
+                    ogs_min(segsize, size - len));
+            poll->recv.handler(poll->fd, pkbuf, &from, poll->recv.data);
+        }
+    }
+
+    if (i == 0)
+        return;
+
+    poll->recv.handler(poll->fd, NULL, NULL, poll->recv.data);
+}
+
+/*
+ * Packets are drained into the 8K buffers posted once per pollset,
+ * and copied into the best-fit cluster of the poll's pool.
+ */
+void ogs_pollset_recv_handler(short when, ogs_socket_t fd, void *data)
+{
+    ogs_poll_t *poll = data;
+    ogs_pollset_t *pollset = NULL;
+    ogs_sockaddr_t from[OGS_UDP_MAX_BATCH];
+    ogs_pkbuf_t **posted = NULL;
+    ogs_pkbuf_t *pkbuf = NULL;
+    int i, n;
+
+    ogs_assert(poll);
+    ogs_assert(poll->recv.handler);
+    pollset = poll->pollset;
+    ogs_assert(pollset);
+
+    if (poll->recv.gro) {
+        recv_gro(poll);
+        return;
+    }
+
+    if (!pollset->posted) {
+        pollset->posted = ogs_calloc(
+                OGS_UDP_MAX_BATCH, sizeof(ogs_pkbuf_t *));
+        ogs_assert(pollset->posted);
+        for (i = 0; i < OGS_UDP_MAX_BATCH; i++) {
+            pollset->posted[i] = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
+            ogs_assert(pollset->posted[i]);
+        }
+    }
+    posted = pollset->posted;
+
+    /* Re-arm the buffers trimmed by the previous batch */
+    for (i = 0; i < OGS_UDP_MAX_BATCH; i++) {
+        posted[i]->len = OGS_MAX_SDU_LEN;
+        posted[i]->tail = posted[i]->data + OGS_MAX_SDU_LEN;
+    }
+
+    if (poll->recv.socket) {
+        n = ogs_udp_recv_batch(fd, posted, from, OGS_UDP_MAX_BATCH);
+        if (n < 0)
+            return;
+    } else {
+        for (n = 0; n < OGS_UDP_MAX_BATCH; n++) {
+            ssize_t size = ogs_read(fd, posted[n]->data, posted[n]->len);
+            if (size <= 0) {
+                if (n == 0 && ogs_socket_errno != OGS_EAGAIN)
+                    ogs_log_ratelimited(OGS_LOG_WARN, ogs_socket_errno,
+                            "ogs_read() failed");
+                break;
+            }
+            ogs_pkbuf_trim(posted[n], size);
+        }
+    }
+
+    if (n == 0)
+        return;
+
+    for (i = 0; i < n; i++) {
+        pkbuf = ogs_pollset_recv_copy(poll, posted[i]->data, posted[i]->len);
+        poll->recv.handler(fd, pkbuf,
+                poll->recv.socket ? &from[i] : NULL, poll->recv.data);
+    }
+
+    poll->recv.handler(fd, NULL, NULL, poll->recv.data);
+}
+
+ogs_pkbuf_t *ogs_pollset_recv_copy(ogs_poll_t *poll, void *data, int len)
+{
+    ogs_pkbuf_t *pkbuf = NULL;
+
+    ogs_assert(poll);
+    ogs_assert(data);
+
+    pkbuf = ogs_pkbuf_alloc(poll->recv.pool, poll->recv.headroom + len);
+    ogs_assert(pkbuf);
+    ogs_pkbuf_reserve(pkbuf, poll->recv.headroom);
+    ogs_pkbuf_put_data(pkbuf, data, len);
+
+    return pkbuf;
+}
+
 void ogs_pollset_remove(ogs_poll_t *poll)
 {
     int rc;
@@ -40,6 +40,27 @@ ogs_poll_t *ogs_pollset_add(ogs_pollset_t *pollset, short when,
         ogs_socket_t fd, ogs_poll_handler_f handler, void *data);
 void ogs_pollset_remove(ogs_poll_t *poll);
 
+/*
+ * Datagram receive path
+ *
+ * The pollset receives from the socket (or TUN device) by itself and
+ * calls the handler once per packet, with the payload copied into the
+ * best-fit cluster of 'pool' behind 'headroom' bytes.
+ * The handler owns the pkbuf.
+ *
+ * Once a burst of packets is handled, the handler is called again
+ * with a NULL pkbuf so that the caller can flush its own TX batch.
+ * 'from' is NULL if 'fd' is not a socket.
+ *
+ * The handler must not remove its own poll.
+ */
+typedef void (*ogs_poll_recv_f)(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data);
+
+ogs_poll_t *ogs_pollset_add_recv(ogs_pollset_t *pollset, ogs_socket_t fd,
+        ogs_pkbuf_pool_t *pool, int headroom,
+        ogs_poll_recv_f handler, void *data);
+
 typedef struct ogs_pollset_actions_s {
     void (*init)(ogs_pollset_t *pollset);
     void (*cleanup)(ogs_pollset_t *pollset);
@@ -49,6 +70,9 @@ typedef struct ogs_pollset_actions_s {
 
     int (*poll)(ogs_pollset_t *pollset, ogs_time_t timeout);
     int (*notify)(ogs_pollset_t *pollset);
+
+    /* Optional. Otherwise, the receive path is driven by OGS_POLLIN */
+    int (*add_recv)(ogs_poll_t *poll);
 } ogs_pollset_actions_t;
 
 extern ogs_pollset_actions_t ogs_pollset_actions;
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core-config-private.h"
+
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "ogs-core.h"
+
+#if HAVE_SYS_MMAN_H && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/*
+ * Arrays of at least one hugepage are mapped directly. Smaller ones
+ * come from calloc(), which does not touch the pages it maps either.
+ */
+#define OGS_POOL_HUGEPAGE_SIZE  (2*1024*1024)
+
+static size_t mem_map_size(size_t size)
+{
+    return (size + OGS_POOL_HUGEPAGE_SIZE - 1) &
+        ~((size_t)OGS_POOL_HUGEPAGE_SIZE - 1);
+}
+
+void *ogs_pool_mem_alloc(size_t size)
+{
+#if HAVE_SYS_MMAN_H
+    static int hugetlb_failed = 0;
+    void *ptr = MAP_FAILED;
+
+    if (size >= OGS_POOL_HUGEPAGE_SIZE) {
+        size = mem_map_size(size);
+
+#ifdef MAP_HUGETLB
+        if (ogs_core()->pool.hugepage == OGS_POOL_HUGEPAGE_EXPLICIT &&
+            !hugetlb_failed) {
+            ptr = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+            if (ptr == MAP_FAILED) {
+                ogs_log_message(OGS_LOG_WARN, ogs_errno,
+                        "No hugepages for pool (vm.nr_hugepages)");
+                hugetlb_failed = 1;
+            }
+        }
+#endif
+        if (ptr == MAP_FAILED) {
+            ptr = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED)
+                return NULL;
+#ifdef MADV_HUGEPAGE
+            if (ogs_core()->pool.hugepage != OGS_POOL_HUGEPAGE_NONE)
+                madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+        }
+
+        return ptr;
+    }
+#endif
+
+    return calloc(1, size ? size : 1);
+}
+
+void ogs_pool_mem_free(void *ptr, size_t size)
+{
+    if (!ptr)
+        return;
+
+#if HAVE_SYS_MMAN_H
+    if (size >= OGS_POOL_HUGEPAGE_SIZE) {
+        munmap(ptr, mem_map_size(size));
+        return;
+    }
+#endif
+
+    free(ptr);
+}
+
+/*
+ * Chunks of a segmented pool are allocated separately, so the index of
+ * a node is found by looking for the chunk which holds it.
+ * There are at most OGS_POOL_MAX_NUM_OF_CHUNK chunks when the chunk size
+ * is OGS_POOL_CHUNK_SIZE(), and the first chunk is checked first.
+ */
+int ogs_pool_segment_index(void **chunks, int num_of_chunk,
+        int chunk, size_t size, const void *node)
+{
+    const char *p = node;
+    int i;
+
+    ogs_assert(chunks);
+    ogs_assert(node);
+
+    for (i = 0; i < num_of_chunk; i++) {
+        const char *base = chunks[i];
+
+        if (p >= base && p < base + size * chunk)
+            return i * chunk + (int)((p - base) / size) + 1;
+    }
+
+    ogs_assert_if_reached();
+    return 0;
+}
@@ -30,52 +30,165 @@ extern "C" {
 
 typedef unsigned int ogs_index_t;
 
+/*
+ * A pool is a fixed array of _size nodes by default.
+ *
+ * A segmented pool starts with one chunk of _chunk nodes, and grows
+ * by another chunk whenever it runs out, up to _max nodes. Chunks are
+ * never moved or released until ogs_pool_final(), so pointers and
+ * indexes stay valid, and the index array covers _max from the start.
+ *
+ * Nodes are handed out in index order until every node has been used
+ * once, and only then from the free list. Nothing is written at init,
+ * so memory is committed as the pool is used (see ogs_pool_mem_alloc).
+ *
+ * Every pool keeps its high-water mark and the number of failed
+ * allocations, see ogs_pool_hwm() and ogs_pool_failed().
+ */
 #define OGS_POOL(pool, type) \
     struct { \
         const char *name; \
         int head, tail; \
         int size, avail; \
         type **free, *array, **index; \
+        int max, chunk, num_of_chunk; \
+        void **chunks; \
+        int fresh; /* Nodes from here on were never allocated */ \
+        int hwm; \
+        unsigned long failed; \
     } pool
 
+#define OGS_POOL_MAX_NUM_OF_CHUNK 64
+
+/* Chunk size which grows a pool of _max nodes in at most 64 steps */
+#define OGS_POOL_CHUNK_SIZE(_max) \
+    (((_max) + OGS_POOL_MAX_NUM_OF_CHUNK - 1) / OGS_POOL_MAX_NUM_OF_CHUNK)
+
+typedef enum {
+    OGS_POOL_HUGEPAGE_NONE = 0,
+    OGS_POOL_HUGEPAGE_TRANSPARENT,  /* madvise(MADV_HUGEPAGE) */
+    OGS_POOL_HUGEPAGE_EXPLICIT,     /* MAP_HUGETLB from the reserved pages */
+} ogs_pool_hugepage_e;
+
+/*
+ * Zero-filled memory for pool arrays. Large arrays are mapped directly,
+ * so pages are only committed when first written, and are backed by
+ * hugepages as configured in ogs_core()->pool.hugepage.
+ */
+void *ogs_pool_mem_alloc(size_t size);
+void ogs_pool_mem_free(void *ptr, size_t size);
+
 #define ogs_pool_init(pool, _size) do { \
-    int i; \
     (pool)->name = #pool; \
-    (pool)->free = malloc(sizeof(*(pool)->free) * _size); \
+    (pool)->free = ogs_pool_mem_alloc(sizeof(*(pool)->free) * (_size)); \
     ogs_assert((pool)->free); \
-    (pool)->array = malloc(sizeof(*(pool)->array) * _size); \
+    (pool)->array = ogs_pool_mem_alloc(sizeof(*(pool)->array) * (_size)); \
     ogs_assert((pool)->array); \
-    (pool)->index = malloc(sizeof(*(pool)->index) * _size); \
+    (pool)->index = ogs_pool_mem_alloc(sizeof(*(pool)->index) * (_size)); \
     ogs_assert((pool)->index); \
-    (pool)->size = (pool)->avail = _size; \
+    (pool)->size = (pool)->avail = (pool)->max = _size; \
     (pool)->head = (pool)->tail = 0; \
-    for (i = 0; i < _size; i++) { \
-        (pool)->free[i] = &((pool)->array[i]); \
-        (pool)->index[i] = NULL; \
+    (pool)->chunk = (pool)->num_of_chunk = 0; \
+    (pool)->chunks = NULL; \
+    (pool)->fresh = 0; \
+    (pool)->hwm = 0; \
+    (pool)->failed = 0; \
+} while (0)
+
+#define ogs_pool_init_segmented(pool, _chunk, _max) do { \
+    ogs_assert((_chunk) > 0); \
+    (pool)->name = #pool; \
+    (pool)->chunk = _chunk; \
+    (pool)->max = (((_max) + (_chunk) - 1) / (_chunk)) * (_chunk); \
+    ogs_assert((pool)->max > 0); \
+    (pool)->chunks = calloc((pool)->max / (_chunk), sizeof(void *)); \
+    ogs_assert((pool)->chunks); \
+    (pool)->free = ogs_pool_mem_alloc( \
+            sizeof(*(pool)->free) * (pool)->max); \
+    ogs_assert((pool)->free); \
+    (pool)->index = ogs_pool_mem_alloc( \
+            sizeof(*(pool)->index) * (pool)->max); \
+    ogs_assert((pool)->index); \
+    (pool)->size = (pool)->avail = 0; \
+    (pool)->head = (pool)->tail = 0; \
+    (pool)->num_of_chunk = 0; \
+    (pool)->fresh = 0; \
+    (pool)->hwm = 0; \
+    (pool)->failed = 0; \
+    ogs_pool_grow(pool); \
+    ogs_assert((pool)->avail); \
+    (pool)->array = (pool)->chunks[0]; \
+} while (0)
+
+/* Adds a chunk to a segmented pool. Nothing happens if it fails. */
+#define ogs_pool_grow(pool) do { \
+    void *__chunk; \
+    if ((pool)->chunk && (pool)->size < (pool)->max) { \
+        __chunk = ogs_pool_mem_alloc( \
+                sizeof(*(pool)->array) * (pool)->chunk); \
+        if (__chunk) { \
+            (pool)->chunks[(pool)->num_of_chunk++] = __chunk; \
+            (pool)->size += (pool)->chunk; \
+            (pool)->avail += (pool)->chunk; \
+        } \
     } \
 } while (0)
 
 #define ogs_pool_final(pool) do { \
+    int __i; \
     if (((pool)->size != (pool)->avail)) \
         ogs_error("%d in '%s[%d]' were not released.", \
                 (pool)->size - (pool)->avail, (pool)->name, (pool)->size); \
-    free((pool)->free); \
-    free((pool)->array); \
-    free((pool)->index); \
+    ogs_pool_mem_free((pool)->free, sizeof(*(pool)->free) * (pool)->max); \
+    ogs_pool_mem_free((pool)->index, sizeof(*(pool)->index) * (pool)->max); \
+    if ((pool)->chunks) { \
+        for (__i = 0; __i < (pool)->num_of_chunk; __i++) \
+            ogs_pool_mem_free((pool)->chunks[__i], \
+                    sizeof(*(pool)->array) * (pool)->chunk); \
+        free((pool)->chunks); \
+    } else { \
+        ogs_pool_mem_free((pool)->array, \
+                sizeof(*(pool)->array) * (pool)->max); \
+    } \
 } while (0)
 
-#define ogs_pool_index(pool, node) (((node) - (pool)->array)+1)
+int ogs_pool_segment_index(void **chunks, int num_of_chunk,
+        int chunk, size_t size, const void *node);
+
+#define ogs_pool_index(pool, node) \
+    ((pool)->chunks ? \
+        ogs_pool_segment_index((pool)->chunks, (pool)->num_of_chunk, \
+            (pool)->chunk, sizeof(*(pool)->array), node) : \
+        (int)(((node) - (pool)->array)+1))
 #define ogs_pool_find(pool, _index) \
     (_index > 0) ? (pool)->index[_index-1] : NULL
 
+/* The node at index (pool)->fresh+1, which was never allocated */
+#define ogs_pool_fresh_node(pool) \
+    ((pool)->chunks ? \
+        (void *)((char *)(pool)->chunks[(pool)->fresh / (pool)->chunk] + \
+            ((pool)->fresh % (pool)->chunk) * sizeof(*(pool)->array)) : \
+        (void *)&(pool)->array[(pool)->fresh])
+
 #define ogs_pool_alloc(pool, node) do { \
     *(node) = NULL; \
+    if ((pool)->avail == 0) \
+        ogs_pool_grow(pool); \
     if ((pool)->avail > 0) { \
         (pool)->avail--; \
-        *(node) = (void*)(pool)->free[(pool)->head]; \
-        (pool)->free[(pool)->head] = NULL; \
-        (pool)->head = ((pool)->head + 1) % ((pool)->size); \
+        if ((pool)->fresh < (pool)->size) { \
+            *(node) = ogs_pool_fresh_node(pool); \
+            (pool)->fresh++; \
+        } else { \
+            *(node) = (void*)(pool)->free[(pool)->head]; \
+            (pool)->free[(pool)->head] = NULL; \
+            (pool)->head = ((pool)->head + 1) % ((pool)->max); \
+        } \
         (pool)->index[ogs_pool_index(pool, *(node))-1] = *(node); \
+        if ((pool)->size - (pool)->avail > (pool)->hwm) \
+            (pool)->hwm = (pool)->size - (pool)->avail; \
+    } else { \
+        (pool)->failed++; \
     } \
 } while (0)
 
@@ -83,13 +196,16 @@ typedef unsigned int ogs_index_t;
     if ((pool)->avail < (pool)->size) { \
         (pool)->avail++; \
         (pool)->free[(pool)->tail] = (void*)(node); \
-        (pool)->tail = ((pool)->tail + 1) % ((pool)->size); \
+        (pool)->tail = ((pool)->tail + 1) % ((pool)->max); \
         (pool)->index[ogs_pool_index(pool, node)-1] = NULL; \
     } \
 } while (0)
 
 #define ogs_pool_size(pool) ((pool)->size)
 #define ogs_pool_avail(pool) ((pool)->avail)
+#define ogs_pool_max(pool) ((pool)->max)
+#define ogs_pool_hwm(pool) ((pool)->hwm)
+#define ogs_pool_failed(pool) ((pool)->failed)
 
 #ifdef __cplusplus
 }
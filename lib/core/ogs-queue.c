@@ -22,8 +22,27 @@
 #undef OGS_LOG_DOMAIN
 #define OGS_LOG_DOMAIN __ogs_event_domain
 
+#define OGS_QUEUE_CACHE_LINE 64
+
+/*
+ * OGS_QUEUE_MPSC is a bounded ring where each cell carries a sequence
+ * number (D. Vyukov's bounded MPMC queue, with the consumer side reduced
+ * to a single thread). A producer owns a cell once it advances 'enqueue'
+ * with CAS, and publishes it by storing seq = pos + 1. The consumer
+ * releases it to the next lap by storing seq = pos + capacity.
+ */
+typedef struct ogs_queue_cell_s {
+    unsigned long       seq;
+    void                *data;
+    ogs_time_t          stamp;
+} ogs_queue_cell_t;
+
 typedef struct ogs_queue_s {
+    ogs_queue_type_e    type;
+    ogs_pollset_t       *pollset;
+
     void              **data;
+    ogs_time_t         *stamp; /**< push time of each element */
     unsigned int        nelts; /**< # elements */
     unsigned int        in;    /**< next empty location */
     unsigned int        out;   /**< next filled location */
@@ -33,7 +52,23 @@ typedef struct ogs_queue_s {
     ogs_thread_mutex_t  one_big_mutex;
     ogs_thread_cond_t   not_empty;
     ogs_thread_cond_t   not_full;
-    int                 terminated;
+
+    struct {
+        ogs_queue_cell_t    *cell;
+        unsigned long       mask;
+
+        char                pad0[OGS_QUEUE_CACHE_LINE];
+        volatile unsigned long enqueue; /**< shared by producers */
+        volatile unsigned int full;
+        char                pad1[OGS_QUEUE_CACHE_LINE];
+        unsigned long       dequeue;    /**< owned by the consumer */
+        volatile int        notified;   /**< pollset already notified */
+        char                pad2[OGS_QUEUE_CACHE_LINE];
+    } mpsc;
+
+    ogs_queue_stat_t    stat;   /**< updated by the consumer */
+
+    volatile int        terminated;
 } ogs_queue_t;
 
 /**
@@ -54,14 +89,43 @@ typedef struct ogs_queue_s {
  */
 ogs_queue_t *ogs_queue_create(unsigned int capacity)
 {
+    return ogs_queue_create_type(capacity, OGS_QUEUE_MUTEX);
+}
+
+ogs_queue_t *ogs_queue_create_type(
+        unsigned int capacity, ogs_queue_type_e type)
+{
+    unsigned long i;
     ogs_queue_t *queue = ogs_calloc(1, sizeof *queue);
     ogs_assert(queue);
+    ogs_assert(capacity);
+
+    queue->type = type;
+
+    if (type == OGS_QUEUE_MPSC) {
+        unsigned long size = 1;
+
+        while (size < capacity)
+            size <<= 1;
+
+        queue->mpsc.cell = ogs_calloc(size, sizeof(ogs_queue_cell_t));
+        ogs_assert(queue->mpsc.cell);
+        for (i = 0; i < size; i++)
+            queue->mpsc.cell[i].seq = i;
+
+        queue->mpsc.mask = size - 1;
+        queue->stat.capacity = size;
+
+        return queue;
+    }
 
     ogs_thread_mutex_init(&queue->one_big_mutex);
     ogs_thread_cond_init(&queue->not_empty);
     ogs_thread_cond_init(&queue->not_full);
 
     queue->data = ogs_calloc(1, capacity * sizeof(void*));
+    queue->stamp = ogs_calloc(1, capacity * sizeof(ogs_time_t));
+    queue->stat.capacity = capacity;
     queue->bounds = capacity;
     queue->nelts = 0;
     queue->in = 0;
@@ -77,6 +141,13 @@ void ogs_queue_destroy(ogs_queue_t *queue)
 {
     ogs_assert(queue);
 
+    if (queue->type == OGS_QUEUE_MPSC) {
+        ogs_free(queue->mpsc.cell);
+        ogs_free(queue);
+        return;
+    }
+
+    ogs_free(queue->stamp);
     ogs_free(queue->data);
 
     ogs_thread_cond_destroy(&queue->not_empty);
@@ -86,10 +157,159 @@ void ogs_queue_destroy(ogs_queue_t *queue)
     ogs_free(queue);
 }
 
+void ogs_queue_set_pollset(ogs_queue_t *queue, ogs_pollset_t *pollset)
+{
+    ogs_assert(queue);
+    queue->pollset = pollset;
+}
+
+static void queue_stat_pop(ogs_queue_t *queue,
+        unsigned int depth, ogs_time_t now, ogs_time_t stamp)
+{
+    ogs_queue_stat_t *stat = &queue->stat;
+
+    if (depth > stat->max_depth)
+        stat->max_depth = depth;
+
+    stat->popped++;
+    if (now > stamp) {
+        stat->wait_total += now - stamp;
+        if (now - stamp > stat->wait_max)
+            stat->wait_max = now - stamp;
+    }
+}
+
+static int mpsc_trypush(ogs_queue_t *queue, void *data)
+{
+    ogs_queue_cell_t *cell = NULL;
+    unsigned long pos;
+    long diff;
+
+    pos = ogs_atomic_load(&queue->mpsc.enqueue);
+    for ( ;; ) {
+        cell = &queue->mpsc.cell[pos & queue->mpsc.mask];
+        diff = (long)(ogs_atomic_load(&cell->seq) - pos);
+        if (diff == 0) {
+            if (ogs_atomic_cas(&queue->mpsc.enqueue, pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            return OGS_RETRY; /* the consumer has not released it yet */
+        }
+        pos = ogs_atomic_load(&queue->mpsc.enqueue);
+    }
+
+    cell->data = data;
+    cell->stamp = ogs_get_monotonic_time();
+    ogs_atomic_store(&cell->seq, pos + 1);
+
+    /*
+     * Only the first push after the consumer found the queue empty
+     * writes to the eventfd. See mpsc_trypop_many().
+     */
+    if (queue->pollset && ogs_atomic_cas(&queue->mpsc.notified, 0, 1))
+        ogs_pollset_notify(queue->pollset);
+
+    return OGS_OK;
+}
+
+static int mpsc_push(ogs_queue_t *queue, void *data, ogs_time_t timeout)
+{
+    int rv, full = 0;
+    ogs_time_t deadline = 0;
+
+    if (timeout > 0)
+        deadline = ogs_get_monotonic_time() + timeout;
+
+    for ( ;; ) {
+        if (ogs_atomic_load(&queue->terminated))
+            return OGS_DONE; /* no more elements ever again */
+
+        rv = mpsc_trypush(queue, data);
+        if (rv != OGS_RETRY)
+            return rv;
+
+        if (!full++)
+            ogs_atomic_inc(&queue->mpsc.full);
+
+        if (!timeout)
+            return OGS_RETRY;
+        if (deadline && ogs_get_monotonic_time() >= deadline)
+            return OGS_TIMEUP;
+
+        ogs_usleep(10);
+    }
+}
+
+static int mpsc_trypop_many(ogs_queue_t *queue, void **data, int max)
+{
+    ogs_queue_cell_t *cell = NULL;
+    unsigned long pos;
+    unsigned int depth;
+    ogs_time_t now = 0;
+    int n = 0;
+
+    if (ogs_atomic_load(&queue->terminated))
+        return OGS_DONE; /* no more elements ever again */
+
+    pos = queue->mpsc.dequeue;
+    depth = ogs_atomic_load(&queue->mpsc.enqueue) - pos;
+
+    while (n < max) {
+        cell = &queue->mpsc.cell[pos & queue->mpsc.mask];
+        if ((long)(ogs_atomic_load(&cell->seq) - (pos + 1)) < 0) {
+            if (n || !ogs_atomic_load(&queue->mpsc.notified))
+                break;
+
+            /*
+             * Clear the flag before looking again, so that a producer
+             * publishing after this point always notifies the pollset.
+             */
+            ogs_atomic_cas(&queue->mpsc.notified, 1, 0);
+            continue;
+        }
+
+        if (!now)
+            now = ogs_get_monotonic_time();
+        queue_stat_pop(queue, depth, now, cell->stamp);
+
+        data[n++] = cell->data;
+        ogs_atomic_store(&cell->seq, pos + queue->mpsc.mask + 1);
+        pos++;
+    }
+
+    queue->mpsc.dequeue = pos;
+
+    return n ? n : OGS_RETRY;
+}
+
+static int mpsc_pop(ogs_queue_t *queue, void **data, ogs_time_t timeout)
+{
+    int rv;
+    ogs_time_t deadline = 0;
+
+    if (timeout > 0)
+        deadline = ogs_get_monotonic_time() + timeout;
+
+    for ( ;; ) {
+        rv = mpsc_trypop_many(queue, data, 1);
+        if (rv == 1)
+            return OGS_OK;
+        if (rv != OGS_RETRY || !timeout)
+            return rv;
+        if (deadline && ogs_get_monotonic_time() >= deadline)
+            return OGS_TIMEUP;
+
+        ogs_usleep(10);
+    }
+}
+
 static int queue_push(ogs_queue_t *queue, void *data, ogs_time_t timeout)
 {
     int rv;
 
+    if (queue->type == OGS_QUEUE_MPSC)
+        return mpsc_push(queue, data, timeout);
+
     if (queue->terminated) {
         return OGS_DONE; /* no more elements ever again */
     }
@@ -97,6 +317,7 @@ static int queue_push(ogs_queue_t *queue, void *data, ogs_time_t timeout)
     ogs_thread_mutex_lock(&queue->one_big_mutex);
 
     if (ogs_queue_full(queue)) {
+        queue->stat.full++;
         if (!timeout) {
             ogs_thread_mutex_unlock(&queue->one_big_mutex);
             return OGS_RETRY;
@@ -132,6 +353,7 @@ static int queue_push(ogs_queue_t *queue, void *data, ogs_time_t timeout)
     }
 
     queue->data[queue->in] = data;
+    queue->stamp[queue->in] = ogs_get_monotonic_time();
     queue->in++;
     if (queue->in >= queue->bounds)
         queue->in -= queue->bounds;
@@ -142,7 +364,13 @@ static int queue_push(ogs_queue_t *queue, void *data, ogs_time_t timeout)
         ogs_thread_cond_signal(&queue->not_empty);
     }
 
+    rv = queue->nelts;
     ogs_thread_mutex_unlock(&queue->one_big_mutex);
+
+    /* The consumer drains the queue, so only wake it up when it was empty */
+    if (queue->pollset && rv == 1)
+        ogs_pollset_notify(queue->pollset);
+
     return OGS_OK;
 }
 
@@ -170,9 +398,34 @@ int ogs_queue_timedpush(ogs_queue_t *queue, void *data, ogs_time_t timeout)
  * not thread safe
  */
 unsigned int ogs_queue_size(ogs_queue_t *queue) {
+    if (queue->type == OGS_QUEUE_MPSC)
+        return ogs_atomic_load(&queue->mpsc.enqueue) - queue->mpsc.dequeue;
+
     return queue->nelts;
 }
 
+/**
+ * Counters are kept by the consumer, so call this from the consumer
+ * thread to get a consistent snapshot.
+ */
+void ogs_queue_stat(ogs_queue_t *queue, ogs_queue_stat_t *stat)
+{
+    ogs_assert(queue);
+    ogs_assert(stat);
+
+    if (queue->type == OGS_QUEUE_MUTEX)
+        ogs_thread_mutex_lock(&queue->one_big_mutex);
+
+    memcpy(stat, &queue->stat, sizeof *stat);
+    stat->depth = ogs_queue_size(queue);
+    stat->pushed = stat->popped + stat->depth;
+
+    if (queue->type == OGS_QUEUE_MPSC)
+        stat->full = ogs_atomic_load(&queue->mpsc.full);
+    else
+        ogs_thread_mutex_unlock(&queue->one_big_mutex);
+}
+
 /**
  * Retrieves the next item from the queue. If there are no
  * items available, it will either return OGS_RETRY (timeout = 0),
@@ -184,6 +437,9 @@ static int queue_pop(ogs_queue_t *queue, void **data, ogs_time_t timeout)
 {
     int rv;
 
+    if (queue->type == OGS_QUEUE_MPSC)
+        return mpsc_pop(queue, data, timeout);
+
     if (queue->terminated) {
         return OGS_DONE; /* no more elements ever again */
     }
@@ -226,6 +482,8 @@ static int queue_pop(ogs_queue_t *queue, void **data, ogs_time_t timeout)
     } 
 
     *data = queue->data[queue->out];
+    queue_stat_pop(queue, queue->nelts,
+            ogs_get_monotonic_time(), queue->stamp[queue->out]);
     queue->nelts--;
 
     queue->out++;
@@ -255,9 +513,55 @@ int ogs_queue_timedpop(ogs_queue_t *queue, void **data, ogs_time_t timeout)
     return queue_pop(queue, data, timeout);
 }
 
+/**
+ * Retrieves up to 'max' items without blocking. The mutex is taken
+ * once for the whole batch, and OGS_QUEUE_MPSC takes no lock at all.
+ */
+int ogs_queue_trypop_many(ogs_queue_t *queue, void **data, int max)
+{
+    int n = 0;
+    ogs_time_t now;
+
+    ogs_assert(queue);
+    ogs_assert(data);
+    ogs_assert(max > 0);
+
+    if (queue->type == OGS_QUEUE_MPSC)
+        return mpsc_trypop_many(queue, data, max);
+
+    if (queue->terminated) {
+        return OGS_DONE; /* no more elements ever again */
+    }
+
+    ogs_thread_mutex_lock(&queue->one_big_mutex);
+
+    now = ogs_get_monotonic_time();
+    while (n < max && !ogs_queue_empty(queue)) {
+        data[n++] = queue->data[queue->out];
+        queue_stat_pop(queue, queue->nelts, now, queue->stamp[queue->out]);
+        queue->nelts--;
+
+        queue->out++;
+        if (queue->out >= queue->bounds)
+            queue->out -= queue->bounds;
+    }
+
+    if (n && queue->full_waiters) {
+        ogs_trace("broadcast !full");
+        ogs_thread_cond_broadcast(&queue->not_full);
+    }
+
+    ogs_thread_mutex_unlock(&queue->one_big_mutex);
+
+    return n ? n : OGS_RETRY;
+}
+
 int ogs_queue_interrupt_all(ogs_queue_t *queue)
 {
     ogs_debug("interrupt all");
+    if (queue->type == OGS_QUEUE_MPSC)
+        return OGS_OK; /* waiters poll 'terminated' */
+
     ogs_thread_mutex_lock(&queue->one_big_mutex);
 
     ogs_thread_cond_broadcast(&queue->not_empty);
@@ -270,6 +574,13 @@ int ogs_queue_interrupt_all(ogs_queue_t *queue)
 
 int ogs_queue_term(ogs_queue_t *queue)
 {
+    if (queue->type == OGS_QUEUE_MPSC) {
+        ogs_atomic_store(&queue->terminated, 1);
+        if (queue->pollset)
+            ogs_pollset_notify(queue->pollset);
+        return OGS_OK;
+    }
+
     ogs_thread_mutex_lock(&queue->one_big_mutex);
 
     /* we must hold one_big_mutex when setting this... otherwise,
@@ -279,6 +590,9 @@ int ogs_queue_term(ogs_queue_t *queue)
     queue->terminated = 1;
     ogs_thread_mutex_unlock(&queue->one_big_mutex);
 
+    if (queue->pollset)
+        ogs_pollset_notify(queue->pollset);
+
     return ogs_queue_interrupt_all(queue);
 }
 
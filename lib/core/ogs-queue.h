@@ -30,19 +30,49 @@ extern "C" {
 
 typedef struct ogs_queue_s ogs_queue_t;
 
+typedef enum {
+    OGS_QUEUE_MUTEX = 0,    /* Any number of producers and consumers */
+    OGS_QUEUE_MPSC,         /* Lock-free, many producers and one consumer */
+} ogs_queue_type_e;
+
+typedef struct ogs_queue_stat_s {
+    unsigned int capacity;
+    unsigned int depth;         /* Elements waiting in the queue */
+    unsigned int max_depth;     /* Highest depth seen by the consumer */
+
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t full;              /* Pushes which found the queue full */
+
+    ogs_time_t wait_total;      /* Sum of push-to-pop latency */
+    ogs_time_t wait_max;
+} ogs_queue_stat_t;
+
 ogs_queue_t *ogs_queue_create(unsigned int capacity);
+/*
+ * OGS_QUEUE_MPSC rounds the capacity up to a power of 2. Only one thread
+ * may pop from it, and blocking push/pop spin with a short sleep.
+ */
+ogs_queue_t *ogs_queue_create_type(
+        unsigned int capacity, ogs_queue_type_e type);
 void ogs_queue_destroy(ogs_queue_t *queue);
 
+/* Notify the pollset when a push makes the queue readable */
+void ogs_queue_set_pollset(ogs_queue_t *queue, ogs_pollset_t *pollset);
+
 int ogs_queue_push(ogs_queue_t *queue, void *data);
 int ogs_queue_pop(ogs_queue_t *queue, void **data);
 
 int ogs_queue_trypush(ogs_queue_t *queue, void *data);
 int ogs_queue_trypop(ogs_queue_t *queue, void **data);
+/* Returns the number of popped elements, OGS_RETRY or OGS_DONE */
+int ogs_queue_trypop_many(ogs_queue_t *queue, void **data, int max);
 
 int ogs_queue_timedpush(ogs_queue_t *queue, void *data, ogs_time_t timeout);
 int ogs_queue_timedpop(ogs_queue_t *queue, void **data, ogs_time_t timeout);
 
 unsigned int ogs_queue_size(ogs_queue_t *queue);
+void ogs_queue_stat(ogs_queue_t *queue, ogs_queue_stat_t *stat);
 
 int ogs_queue_interrupt_all(ogs_queue_t *queue);
 int ogs_queue_term(ogs_queue_t *queue);
@@ -0,0 +1,562 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core-config-private.h"
+
+#if HAVE_SHM_OPEN
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+
+#include "ogs-core.h"
+
+#undef OGS_LOG_DOMAIN
+#define OGS_LOG_DOMAIN __ogs_sock_domain
+
+#define OGS_SHMRING_MAGIC       0x4f47534d  /* "OGSM" */
+#define OGS_SHMRING_NAME_LEN    64
+#define OGS_SHMRING_CACHE_LINE  64
+#define OGS_SHMRING_ALIGN(__sIZE) \
+    (((__sIZE) + OGS_SHMRING_CACHE_LINE - 1) & ~(OGS_SHMRING_CACHE_LINE - 1))
+
+/* Packets popped for each wakeup, before other sockets are served */
+#define OGS_SHMRING_MAX_BURST   (4 * OGS_UDP_MAX_BATCH)
+
+/*
+ * The slots follow the same protocol as OGS_QUEUE_MPSC in ogs-queue.c.
+ * A producer owns a slot once it advances 'enqueue' with CAS, and
+ * publishes it by storing seq = pos + 1. The consumer releases it to
+ * the next lap by storing seq = pos + num_of_slot.
+ */
+typedef struct ogs_shmring_slot_s {
+    volatile uint32_t   seq;
+    uint32_t            len;
+} ogs_shmring_slot_t;                       /* slot_size bytes follow */
+
+typedef struct ogs_shmring_header_s {
+    volatile uint32_t   magic;              /* Stored last by the creator */
+    uint32_t            num_of_slot;
+    uint32_t            slot_size;
+    uint32_t            stride;
+
+    int                 num_of_addr;
+    ogs_sockaddr_t      addr[OGS_SHMRING_MAX_ADDR];     /* Consumer */
+    ogs_sockaddr_t      from;                           /* Producer */
+
+    char                pad0[OGS_SHMRING_CACHE_LINE];
+    volatile uint32_t   enqueue;            /* shared by producers */
+    char                pad1[OGS_SHMRING_CACHE_LINE];
+    volatile uint32_t   dequeue;            /* owned by the consumer */
+    volatile uint32_t   notified;           /* doorbell already rung */
+    char                pad2[OGS_SHMRING_CACHE_LINE];
+} ogs_shmring_header_t;
+
+struct ogs_shmring_s {
+    char                name[OGS_SHMRING_NAME_LEN];
+
+    ogs_shmring_header_t *header;
+    uint8_t             *slot;
+    size_t              size;
+
+    /* Kept apart from the header, which the peer may overwrite */
+    uint32_t            num_of_slot;
+    uint32_t            slot_size;
+    uint32_t            stride;
+
+    ogs_socket_t        fd;                 /* Doorbell */
+#if HAVE_SYS_UN_H
+    struct sockaddr_un  bell;
+    socklen_t           bell_len;
+#endif
+    bool                listening;
+
+    /*
+     * Producer : monotonic second from which the doorbell may be rung
+     * again to look for the consumer, or 0 while the consumer is there
+     */
+    volatile uint32_t   lost;
+    volatile uint32_t   checked;            /* Last look at a full ring */
+
+    ogs_poll_t          *poll;
+    ogs_pkbuf_pool_t    *pool;
+    int                 headroom;
+    ogs_poll_recv_f     handler;
+    void                *data;
+};
+
+#define SLOT_OF(__rING, __pOS) \
+    ((ogs_shmring_slot_t *)((__rING)->slot + \
+        ((__pOS) & ((__rING)->num_of_slot - 1)) * (__rING)->stride))
+
+/* Returns false only if nobody listens to the doorbell */
+static bool ring_doorbell(ogs_shmring_t *ring)
+{
+#if HAVE_SYS_UN_H
+    char c = 0;
+
+    /* A full socket already has a wakeup pending */
+    if (sendto(ring->fd, &c, sizeof c, 0,
+                (struct sockaddr *)&ring->bell, ring->bell_len) < 0 &&
+        (errno == ECONNREFUSED || errno == ENOENT))
+        return false;
+#endif
+    return true;
+}
+
+static uint32_t ring_now(void)
+{
+    return (uint32_t)ogs_time_sec(ogs_get_monotonic_time()) + 1;
+}
+
+/*
+ * The consumer is gone, e.g. it has crashed. The producer stops using
+ * the ring so that the packets go over UDP, and looks for a consumer
+ * again at most once a second.
+ */
+static void ring_lost(ogs_shmring_t *ring)
+{
+    if (ogs_atomic_cas(&ring->lost, 0, ring_now() + 1))
+        ogs_warn("%s has no consumer, falling back to UDP", ring->name);
+}
+
+static bool ring_alive(ogs_shmring_t *ring)
+{
+    uint32_t lost, now;
+
+    lost = ogs_atomic_load(&ring->lost);
+    if (!lost)
+        return true;
+
+    now = ring_now();
+    if (now < lost || !ogs_atomic_cas(&ring->lost, lost, now + 1))
+        return false;
+    if (!ring_doorbell(ring))
+        return false;
+
+    if (ogs_atomic_cas(&ring->lost, now + 1, 0))
+        ogs_info("%s has a consumer again", ring->name);
+    return true;
+}
+
+/*
+ * A consumer which died while the doorbell was pending leaves the ring
+ * full without ever being rung again, so a full ring rings it anyway.
+ */
+static void ring_check(ogs_shmring_t *ring)
+{
+    uint32_t checked, now;
+
+    now = ring_now();
+    checked = ogs_atomic_load(&ring->checked);
+    if (now == checked || !ogs_atomic_cas(&ring->checked, checked, now))
+        return;
+
+    if (!ring_doorbell(ring))
+        ring_lost(ring);
+}
+
+#if HAVE_SHM_OPEN && HAVE_SYS_UN_H
+static int map_ring(ogs_shmring_t *ring, int num_of_slot, int slot_size)
+{
+    ogs_shmring_header_t *header = NULL;
+    struct stat st;
+    size_t stride;
+    bool created = true;
+    int fd, i;
+
+    memset(&st, 0, sizeof st);
+
+    stride = OGS_SHMRING_ALIGN(sizeof(ogs_shmring_slot_t) + slot_size);
+    ring->size = OGS_SHMRING_ALIGN(sizeof(ogs_shmring_header_t)) +
+        stride * num_of_slot;
+
+    fd = shm_open(ring->name, O_RDWR|O_CREAT|O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(ring->name, O_RDWR, 0);
+    }
+    if (fd < 0) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                "shm_open(%s) failed", ring->name);
+        return OGS_ERROR;
+    }
+
+    if (created) {
+        if (ftruncate(fd, ring->size) != 0) {
+            ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                    "ftruncate(%s) failed", ring->name);
+            close(fd);
+            shm_unlink(ring->name);
+            return OGS_ERROR;
+        }
+    } else {
+        /* The peer may still be creating it */
+        for (i = 0; i < 100; i++) {
+            if (fstat(fd, &st) == 0 && st.st_size) break;
+            ogs_msleep(10);
+        }
+        if (st.st_size != ring->size) {
+            ogs_error("%s has another size [%d:%d], remove it first",
+                    ring->name, (int)st.st_size, (int)ring->size);
+            close(fd);
+            return OGS_ERROR;
+        }
+    }
+
+    header = mmap(NULL, ring->size,
+            PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                "mmap(%s) failed", ring->name);
+        return OGS_ERROR;
+    }
+
+    ring->header = header;
+    ring->slot = (uint8_t *)header +
+        OGS_SHMRING_ALIGN(sizeof(ogs_shmring_header_t));
+    ring->num_of_slot = num_of_slot;
+    ring->slot_size = slot_size;
+    ring->stride = stride;
+
+    if (created) {
+        header->num_of_slot = num_of_slot;
+        header->slot_size = slot_size;
+        header->stride = stride;
+        for (i = 0; i < num_of_slot; i++)
+            SLOT_OF(ring, i)->seq = i;
+        ogs_atomic_store(&header->magic, OGS_SHMRING_MAGIC);
+    } else {
+        for (i = 0; i < 100; i++) {
+            if (ogs_atomic_load(&header->magic) == OGS_SHMRING_MAGIC) break;
+            ogs_msleep(10);
+        }
+        if (header->magic != OGS_SHMRING_MAGIC ||
+            header->num_of_slot != num_of_slot ||
+            header->slot_size != slot_size) {
+            ogs_error("%s is not compatible, remove it first", ring->name);
+            munmap(header, ring->size);
+            ring->header = NULL;
+            return OGS_ERROR;
+        }
+    }
+
+    return OGS_OK;
+}
+#endif
+
+ogs_shmring_t *ogs_shmring_open(
+        const char *name, int num_of_slot, int slot_size)
+{
+#if HAVE_SHM_OPEN && HAVE_SYS_UN_H
+    ogs_shmring_t *ring = NULL;
+    int rv;
+
+    ogs_assert(name);
+    ogs_assert(name[0] == '/');
+    ogs_assert(num_of_slot > 0);
+    ogs_assert(!(num_of_slot & (num_of_slot - 1)));
+    ogs_assert(slot_size > 0);
+
+    ring = ogs_calloc(1, sizeof *ring);
+    ogs_assert(ring);
+    ring->fd = INVALID_SOCKET;
+
+    ogs_cpystrn(ring->name, name, sizeof ring->name);
+
+    rv = map_ring(ring, num_of_slot, slot_size);
+    if (rv != OGS_OK) {
+        ogs_free(ring);
+        return NULL;
+    }
+
+    ring->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    ogs_assert(ring->fd != INVALID_SOCKET);
+    rv = ogs_nonblocking(ring->fd);
+    ogs_assert(rv == OGS_OK);
+
+    memset(&ring->bell, 0, sizeof ring->bell);
+    ring->bell.sun_family = AF_UNIX;
+#if defined(__linux__)
+    /* Abstract namespace, so that nothing is left behind */
+    ogs_cpystrn(ring->bell.sun_path + 1, name + 1,
+            sizeof(ring->bell.sun_path) - 1);
+    ring->bell_len = offsetof(struct sockaddr_un, sun_path) +
+        1 + strlen(ring->bell.sun_path + 1);
+#else
+    ogs_snprintf(ring->bell.sun_path, sizeof(ring->bell.sun_path),
+            "/tmp/%s.sock", name + 1);
+    ring->bell_len = sizeof(ring->bell);
+#endif
+
+    ogs_debug("shmring_open() %s [%d x %d]", name, num_of_slot, slot_size);
+
+    return ring;
+#else
+    ogs_error("Shared memory ring is not supported");
+    return NULL;
+#endif
+}
+
+void ogs_shmring_close(ogs_shmring_t *ring)
+{
+    ogs_assert(ring);
+
+    if (ring->poll)
+        ogs_pollset_remove(ring->poll);
+    if (ring->fd != INVALID_SOCKET)
+        ogs_closesocket(ring->fd);
+    /* Producers connecting from now on will not use the ring */
+    if (ring->listening)
+        ogs_atomic_store(&ring->header->num_of_addr, 0);
+#if !defined(__linux__) && HAVE_SYS_UN_H
+    if (ring->listening)
+        unlink(ring->bell.sun_path);
+#endif
+#if HAVE_SHM_OPEN
+    /* Left for the peer, and for the next run */
+    if (ring->header)
+        munmap(ring->header, ring->size);
+#endif
+
+    ogs_free(ring);
+}
+
+void ogs_shmring_connect(ogs_shmring_t *ring, ogs_sockaddr_t *addr)
+{
+    ogs_assert(ring);
+    ogs_assert(addr);
+
+    memcpy(&ring->header->from, addr, sizeof ring->header->from);
+    ring->header->from.next = NULL;
+}
+
+bool ogs_shmring_reaches(ogs_shmring_t *ring, ogs_sockaddr_t *addr)
+{
+    int i;
+
+    ogs_assert(ring);
+    ogs_assert(addr);
+
+    for (i = 0; i < ring->header->num_of_addr; i++)
+        if (ogs_sockaddr_is_equal(&ring->header->addr[i], addr))
+            return true;
+
+    return false;
+}
+
+int ogs_shmring_push(ogs_shmring_t *ring, const void *data, size_t len)
+{
+    ogs_shmring_header_t *header = NULL;
+    ogs_shmring_slot_t *slot = NULL;
+    uint32_t pos;
+    int32_t diff;
+
+    ogs_assert(ring);
+    ogs_assert(data);
+
+    header = ring->header;
+    if (len > ring->slot_size)
+        return OGS_ERROR;
+    if (!ring_alive(ring))
+        return OGS_ERROR;
+
+    pos = ogs_atomic_load(&header->enqueue);
+    for ( ;; ) {
+        slot = SLOT_OF(ring, pos);
+        diff = (int32_t)(ogs_atomic_load(&slot->seq) - pos);
+        if (diff == 0) {
+            if (ogs_atomic_cas(&header->enqueue, pos, pos + 1))
+                break;
+        } else if (diff < 0) {
+            /* the consumer has not released it yet */
+            ring_check(ring);
+            return OGS_RETRY;
+        }
+        pos = ogs_atomic_load(&header->enqueue);
+    }
+
+    memcpy(slot + 1, data, len);
+    slot->len = len;
+    ogs_atomic_store(&slot->seq, pos + 1);
+
+    return OGS_OK;
+}
+
+/*
+ * Called once after a burst of pushes. Only the first one after
+ * the consumer found the ring empty rings the doorbell.
+ */
+void ogs_shmring_notify(ogs_shmring_t *ring)
+{
+    ogs_assert(ring);
+
+    if (ogs_atomic_cas(&ring->header->notified, 0, 1) &&
+        !ring_doorbell(ring))
+        ring_lost(ring);
+}
+
+int ogs_shmring_listen(ogs_shmring_t *ring, ogs_sockaddr_t *sa_list)
+{
+#if HAVE_SYS_UN_H
+    ogs_shmring_header_t *header = NULL;
+    ogs_shmring_slot_t *slot = NULL;
+    ogs_sockaddr_t *addr = NULL;
+    uint32_t pos;
+    int n = 0;
+
+    ogs_assert(ring);
+
+#if !defined(__linux__)
+    unlink(ring->bell.sun_path);
+#endif
+    if (bind(ring->fd, (struct sockaddr *)&ring->bell, ring->bell_len) != 0) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                "bind(%s) failed. Is another consumer running?", ring->name);
+        return OGS_ERROR;
+    }
+    ring->listening = true;
+
+    /* Packets left from the last run are stale */
+    header = ring->header;
+    pos = header->dequeue;
+    for ( ;; ) {
+        slot = SLOT_OF(ring, pos);
+        if ((int32_t)(ogs_atomic_load(&slot->seq) - (pos + 1)) < 0)
+            break;
+        ogs_atomic_store(&slot->seq, pos + ring->num_of_slot);
+        pos++;
+    }
+    header->dequeue = pos;
+
+    for (addr = sa_list; addr && n < OGS_SHMRING_MAX_ADDR; addr = addr->next) {
+        memcpy(&header->addr[n], addr, sizeof header->addr[n]);
+        header->addr[n].next = NULL;
+        n++;
+    }
+    ogs_atomic_store(&header->num_of_addr, n);
+
+    return OGS_OK;
+#else
+    return OGS_ERROR;
+#endif
+}
+
+static void shmring_recv(short when, ogs_socket_t fd, void *data)
+{
+    ogs_shmring_t *ring = data;
+    ogs_shmring_header_t *header = NULL;
+    ogs_shmring_slot_t *slot = NULL;
+    ogs_pkbuf_t *pkbuf = NULL;
+    ogs_sockaddr_t from;
+    bool from_valid;
+    uint32_t pos, len;
+    char buf[16];
+    int n = 0;
+
+    ogs_assert(ring);
+    header = ring->header;
+
+    /* Every doorbell rung so far is answered by this round */
+    while (recv(fd, buf, sizeof buf, 0) > 0);
+
+    /* The handler never sees the shared memory, nor its 'next' pointer */
+    memcpy(&from, &header->from, sizeof from);
+    from.next = NULL;
+    from_valid = from.ogs_sa_family == AF_INET ||
+                from.ogs_sa_family == AF_INET6;
+
+    pos = header->dequeue;
+    while (n < OGS_SHMRING_MAX_BURST) {
+        slot = SLOT_OF(ring, pos);
+        if ((int32_t)(ogs_atomic_load(&slot->seq) - (pos + 1)) < 0) {
+            if (!ogs_atomic_load(&header->notified))
+                break;
+
+            /*
+             * Clear the flag before looking again, so that a producer
+             * publishing after this point always rings the doorbell.
+             */
+            ogs_atomic_cas(&header->notified, 1, 0);
+            continue;
+        }
+
+        /* The peer shares the memory, so the length and sender are checked */
+        len = slot->len;
+        if (len > ring->slot_size || !from_valid) {
+            ogs_error_ratelimited("%s has a corrupted slot [%u:%u:%d]",
+                    ring->name, len, ring->slot_size, from.ogs_sa_family);
+            ogs_atomic_store(&slot->seq, pos + ring->num_of_slot);
+            pos++;
+            continue;
+        }
+
+        pkbuf = ogs_pkbuf_alloc(ring->pool, ring->headroom + len);
+        ogs_assert(pkbuf);
+        ogs_pkbuf_reserve(pkbuf, ring->headroom);
+        ogs_pkbuf_put_data(pkbuf, slot + 1, len);
+
+        ogs_atomic_store(&slot->seq, pos + ring->num_of_slot);
+        pos++;
+        n++;
+
+        ring->handler(fd, pkbuf, &from, ring->data);
+    }
+    header->dequeue = pos;
+
+    if (n)
+        ring->handler(fd, NULL, NULL, ring->data);
+
+    /* Come back for the rest once the other sockets are served */
+    if (n == OGS_SHMRING_MAX_BURST)
+        ring_doorbell(ring);
+}
+
+ogs_poll_t *ogs_shmring_add_recv(ogs_pollset_t *pollset,
+        ogs_shmring_t *ring, ogs_pkbuf_pool_t *pool, int headroom,
+        ogs_poll_recv_f handler, void *data)
+{
+    ogs_assert(pollset);
+    ogs_assert(ring);
+    ogs_assert(ring->listening);
+    ogs_assert(handler);
+
+    ring->pool = pool;
+    ring->headroom = headroom;
+    ring->handler = handler;
+    ring->data = data;
+
+    ring->poll = ogs_pollset_add(pollset, OGS_POLLIN,
+            ring->fd, shmring_recv, ring);
+    ogs_assert(ring->poll);
+
+    /* Packets may have been pushed since listening */
+    ring_doorbell(ring);
+
+    return ring->poll;
+}
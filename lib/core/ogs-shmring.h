@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(OGS_CORE_INSIDE) && !defined(OGS_CORE_COMPILATION)
+#error "This header cannot be included directly."
+#endif
+
+#ifndef OGS_SHMRING_H
+#define OGS_SHMRING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Packet ring in POSIX shared memory between two processes on the
+ * same host. Any number of threads may push, and one thread pops.
+ *
+ * The consumer waits on a doorbell socket, which is rung only when
+ * it has found the ring empty, so a busy ring costs no system call.
+ * The consumer publishes its addresses with ogs_shmring_listen(),
+ * so that the producer knows which peer the ring reaches.
+ *
+ * If nobody listens to the doorbell any more, the producer stops
+ * pushing until a consumer is back.
+ */
+#define OGS_SHMRING_MAX_ADDR    4
+
+typedef struct ogs_shmring_s ogs_shmring_t;
+
+/* Creates the ring, or maps the one created by the peer */
+ogs_shmring_t *ogs_shmring_open(
+        const char *name, int num_of_slot, int slot_size);
+void ogs_shmring_close(ogs_shmring_t *ring);
+
+/* Producer */
+void ogs_shmring_connect(ogs_shmring_t *ring, ogs_sockaddr_t *addr);
+bool ogs_shmring_reaches(ogs_shmring_t *ring, ogs_sockaddr_t *addr);
+/*
+ * OGS_RETRY if the ring is full, OGS_ERROR if the packet is too long
+ * or the consumer is gone
+ */
+int ogs_shmring_push(ogs_shmring_t *ring, const void *data, size_t len);
+void ogs_shmring_notify(ogs_shmring_t *ring);
+
+/* Consumer */
+int ogs_shmring_listen(ogs_shmring_t *ring, ogs_sockaddr_t *sa_list);
+/*
+ * The pollset pops packets as if they were received on a socket.
+ * See ogs_pollset_add_recv(). 'from' is a copy of the address given to
+ * ogs_shmring_connect() by the producer. The packets are dropped
+ * while it is not an IPv4 or IPv6 address.
+ */
+ogs_poll_t *ogs_shmring_add_recv(ogs_pollset_t *pollset,
+        ogs_shmring_t *ring, ogs_pkbuf_pool_t *pool, int headroom,
+        ogs_poll_recv_f handler, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OGS_SHMRING_H */
@@ -27,6 +27,10 @@
 #include <unistd.h>
 #endif
 
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
 #include "ogs-core.h"
 
 #undef OGS_LOG_DOMAIN
@@ -66,6 +70,9 @@ void ogs_sock_destroy(ogs_sock_t *sock)
 {
     ogs_assert(sock);
 
+    if (sock->xsk)
+        ogs_xsk_close(sock->xsk);
+
     if (sock->fd != INVALID_SOCKET) {
         ogs_closesocket(sock->fd);
     }
@@ -210,7 +217,8 @@ ssize_t ogs_read(ogs_socket_t fd, void *buf, size_t len)
     ogs_assert(fd != INVALID_SOCKET);
 
     size = read(fd, buf, len);
-    if (size < 0) {
+    /* A non-blocking fd is drained until EAGAIN, which is not an error */
+    if (size < 0 && ogs_socket_errno != OGS_EAGAIN) {
         ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
                 "ogs_read(len:%d) failed", (int)size);
     }
@@ -362,6 +370,23 @@ int ogs_closeonexec(ogs_socket_t fd)
     return OGS_OK;
 }
 
+bool ogs_is_socket(ogs_socket_t fd)
+{
+#if HAVE_SYS_STAT_H && defined(S_ISSOCK)
+    struct stat st;
+
+    ogs_assert(fd != INVALID_SOCKET);
+    if (fstat(fd, &st) != 0) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno, "fstat failed");
+        return false;
+    }
+
+    return S_ISSOCK(st.st_mode);
+#else
+    return true;
+#endif
+}
+
 int ogs_listen_reusable(ogs_socket_t fd)
 {
 #if defined(SO_REUSEADDR) && !defined(_WIN32)
@@ -379,3 +404,24 @@ int ogs_listen_reusable(ogs_socket_t fd)
 
     return OGS_OK;
 }
+
+/* Several sockets may bind the same address and share its traffic */
+int ogs_listen_reusable_port(ogs_socket_t fd)
+{
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+    int rc;
+    int on = 1;
+
+    ogs_assert(fd != INVALID_SOCKET);
+    rc = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void *)&on, sizeof(int));
+    if (rc != OGS_OK) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                "setsockopt(SOL_SOCKET, SO_REUSEPORT) failed");
+        return OGS_ERROR;
+    }
+
+    return OGS_OK;
+#else
+    return OGS_ERROR;
+#endif
+}
@@ -44,6 +44,8 @@ typedef struct ogs_sock_s {
 
     ogs_sockaddr_t local_addr;
     ogs_sockaddr_t remote_addr;
+
+    struct ogs_xsk_s *xsk;      /* AF_XDP beside the socket, if any */
 } ogs_sock_t;
 
 void ogs_socket_init(void);
@@ -73,7 +75,9 @@ int ogs_closesocket(ogs_socket_t fd);
 
 int ogs_nonblocking(ogs_socket_t fd);
 int ogs_closeonexec(ogs_socket_t fd);
+bool ogs_is_socket(ogs_socket_t fd);
 int ogs_listen_reusable(ogs_socket_t fd);
+int ogs_listen_reusable_port(ogs_socket_t fd);
 
 #ifdef __cplusplus
 }
@@ -269,6 +269,12 @@ void ogs_socknode_linger(ogs_socknode_t *node, int onoff, int linger)
     node->option.l_linger = linger;
 }
 
+void ogs_socknode_reuse_port(ogs_socknode_t *node, int on)
+{
+    ogs_assert(node);
+    node->option.reuse_port = on;
+}
+
 void ogs_socknode_set_cleanup(
         ogs_socknode_t *node, void (*cleanup)(ogs_sock_t *))
 {
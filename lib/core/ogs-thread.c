@@ -64,8 +64,12 @@ static void *thread_worker(void *arg)
     ogs_thread_mutex_unlock(&thread->mutex);
 
     ogs_debug("[%p] worker signal", thread);
+    ogs_pkbuf_cache_init();
+
     thread->func(thread->data);
 
+    ogs_pkbuf_cache_final();
+
     ogs_thread_mutex_lock(&thread->mutex);
     thread->running = false;
     ogs_thread_mutex_unlock(&thread->mutex);
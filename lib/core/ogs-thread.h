@@ -67,6 +67,30 @@ static ogs_inline int ogs_thread_cond_timedwait(
 #define ogs_thread_cond_signal (void)pthread_cond_signal
 #define ogs_thread_cond_broadcast pthread_cond_broadcast
 #define ogs_thread_cond_destroy (void)pthread_cond_destroy
+#define ogs_thread_rwlock_t pthread_rwlock_t
+/*
+ * glibc prefers readers by default, so the writer can starve while
+ * user-plane workers keep overlapping on the read lock.
+ * A reader then waits for a queued writer, and must not take
+ * the read lock recursively.
+ */
+static ogs_inline void ogs_thread_rwlock_init(ogs_thread_rwlock_t *rwlock)
+{
+    pthread_rwlockattr_t attr;
+
+    (void)pthread_rwlockattr_init(&attr);
+#if defined(__GLIBC__) && defined(__USE_GNU)
+    (void)pthread_rwlockattr_setkind_np(&attr,
+            PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    (void)pthread_rwlock_init(rwlock, &attr);
+    (void)pthread_rwlockattr_destroy(&attr);
+}
+#define ogs_thread_rwlock_rdlock (void)pthread_rwlock_rdlock
+#define ogs_thread_rwlock_wrlock (void)pthread_rwlock_wrlock
+#define ogs_thread_rwlock_rdunlock (void)pthread_rwlock_unlock
+#define ogs_thread_rwlock_wrunlock (void)pthread_rwlock_unlock
+#define ogs_thread_rwlock_destroy (void)pthread_rwlock_destroy
 #define ogs_thread_id_t pthread_t
 #define ogs_thread_join(_n) pthread_join((_n), NULL)
 #else
@@ -103,6 +127,33 @@ static ogs_inline int ogs_thread_cond_destroy(ogs_thread_cond_t *_ignored)
 {
    return 0;
 }
+#define ogs_thread_rwlock_t SRWLOCK
+#define ogs_thread_rwlock_init InitializeSRWLock
+#define ogs_thread_rwlock_rdlock AcquireSRWLockShared
+#define ogs_thread_rwlock_wrlock AcquireSRWLockExclusive
+#define ogs_thread_rwlock_rdunlock ReleaseSRWLockShared
+#define ogs_thread_rwlock_wrunlock ReleaseSRWLockExclusive
+#define ogs_thread_rwlock_destroy(_n) (void)(_n)
+#endif
+
+#if defined(_MSC_VER)
+#define OGS_THREAD_LOCAL __declspec(thread)
+#define ogs_atomic_inc(_p) InterlockedIncrement((LONG volatile *)(_p))
+#define ogs_atomic_dec(_p) InterlockedDecrement((LONG volatile *)(_p))
+#define ogs_atomic_cas(_p, _o, _n) \
+    (InterlockedCompareExchange((LONG volatile *)(_p), (_n), (_o)) == (LONG)(_o))
+#define ogs_atomic_load(_p) (*(volatile LONG *)(_p))
+#define ogs_atomic_store(_p, _v) \
+    (void)InterlockedExchange((LONG volatile *)(_p), (_v))
+#define ogs_atomic_fence() MemoryBarrier()
+#else
+#define OGS_THREAD_LOCAL __thread
+#define ogs_atomic_inc(_p) __sync_add_and_fetch((_p), 1)
+#define ogs_atomic_dec(_p) __sync_sub_and_fetch((_p), 1)
+#define ogs_atomic_cas(_p, _o, _n) __sync_bool_compare_and_swap((_p), (_o), (_n))
+#define ogs_atomic_load(_p) __atomic_load_n((_p), __ATOMIC_ACQUIRE)
+#define ogs_atomic_store(_p, _v) __atomic_store_n((_p), (_v), __ATOMIC_RELEASE)
+#define ogs_atomic_fence() __sync_synchronize()
 #endif
 
 typedef struct ogs_thread_s ogs_thread_t;
@@ -22,9 +22,50 @@
 #undef OGS_LOG_DOMAIN
 #define OGS_LOG_DOMAIN __ogs_event_domain
 
+/*
+ * Hierarchical timing wheel
+ *
+ * The first level has one slot per tick (1ms) for the next 256 ticks,
+ * and each upper level has 64 slots, each covering a whole rotation of
+ * the level below. A timer is linked to the slot of its expiry, so that
+ * start and stop are O(1). When the first level wraps around, the next
+ * slot of the upper level is cascaded down.
+ *
+ * Timers further than 2^26 ticks (about 18 hours) are parked in the last
+ * level and cascaded again until they get close enough.
+ */
+#define WHEEL_TICK              1000    /* usec */
+#define WHEEL_ROOT_BITS         8
+#define WHEEL_ROOT_SIZE         (1 << WHEEL_ROOT_BITS)
+#define WHEEL_ROOT_MASK         (WHEEL_ROOT_SIZE - 1)
+#define WHEEL_LEVEL_BITS        6
+#define WHEEL_LEVEL_SIZE        (1 << WHEEL_LEVEL_BITS)
+#define WHEEL_LEVEL_MASK        (WHEEL_LEVEL_SIZE - 1)
+#define WHEEL_NUM_OF_LEVEL      3
+#define WHEEL_SHIFT(level) \
+    (WHEEL_ROOT_BITS + ((level) * WHEEL_LEVEL_BITS))
+#define WHEEL_MAX_DELTA \
+    ((int64_t)1 << WHEEL_SHIFT(WHEEL_NUM_OF_LEVEL))
+
+typedef struct ogs_timer_wheel_s {
+    ogs_time_t base;            /* Monotonic time of tick 0 */
+    int64_t tick;               /* Next tick to be processed */
+
+    ogs_list_t root[WHEEL_ROOT_SIZE];
+    ogs_list_t level[WHEEL_NUM_OF_LEVEL][WHEEL_LEVEL_SIZE];
+    int num_of_root;            /* Timers in root slots */
+    int num_of_timer;
+
+    bool next_valid;            /* next_tick is up to date */
+    int64_t next_tick;          /* Earliest expiry, -1 if none */
+} ogs_timer_wheel_t;
+
 typedef struct ogs_timer_mgr_s {
     OGS_POOL(pool, ogs_timer_t);
+    ogs_timer_mgr_type_e type;
+
     ogs_rbtree_t tree;
+    ogs_timer_wheel_t *wheel;
 } ogs_timer_mgr_t;
 
 typedef struct ogs_timer_s {
@@ -37,8 +78,183 @@ typedef struct ogs_timer_s {
     ogs_timer_mgr_t *manager;
     bool running;
     ogs_time_t timeout;;       
+
+    ogs_list_t *slot;           /* Wheel slot (or expired list) */
+    int64_t tick;               /* Wheel tick of timeout */
 } ogs_timer_t;
 
+static void wheel_link(ogs_timer_wheel_t *wheel, ogs_timer_t *timer)
+{
+    int64_t delta, tick;
+    int level;
+
+    ogs_assert(wheel);
+    ogs_assert(timer);
+
+    tick = timer->tick;
+    delta = tick - wheel->tick;
+
+    if (delta < WHEEL_ROOT_SIZE) {
+        /* Overdue timers are expired with the next tick */
+        if (delta < 0)
+            tick = wheel->tick;
+        timer->slot = &wheel->root[tick & WHEEL_ROOT_MASK];
+        wheel->num_of_root++;
+    } else {
+        if (delta >= WHEEL_MAX_DELTA)
+            tick = wheel->tick + WHEEL_MAX_DELTA - 1;
+
+        for (level = 0; level < WHEEL_NUM_OF_LEVEL - 1; level++)
+            if (delta < ((int64_t)1 << WHEEL_SHIFT(level + 1)))
+                break;
+
+        timer->slot = &wheel->level[level]
+            [(tick >> WHEEL_SHIFT(level)) & WHEEL_LEVEL_MASK];
+    }
+
+    ogs_list_add(timer->slot, &timer->lnode);
+}
+
+static void wheel_unlink(ogs_timer_wheel_t *wheel, ogs_timer_t *timer)
+{
+    ogs_assert(wheel);
+    ogs_assert(timer);
+    ogs_assert(timer->slot);
+
+    if (timer->slot >= &wheel->root[0] &&
+        timer->slot < &wheel->root[WHEEL_ROOT_SIZE])
+        wheel->num_of_root--;
+
+    ogs_list_remove(timer->slot, &timer->lnode);
+    timer->slot = NULL;
+}
+
+static void wheel_cascade(ogs_timer_wheel_t *wheel, int level, int index)
+{
+    OGS_LIST(list);
+    ogs_lnode_t *lnode = NULL;
+
+    /* Relink the slot, which is now within reach of the level below */
+    list = wheel->level[level][index];
+    ogs_list_init(&wheel->level[level][index]);
+
+    while ((lnode = ogs_list_first(&list)) != NULL) {
+        ogs_timer_t *this = ogs_rb_entry(lnode, ogs_timer_t, lnode);
+
+        ogs_list_remove(&list, lnode);
+        wheel_link(wheel, this);
+    }
+}
+
+static int64_t wheel_next_tick(ogs_timer_wheel_t *wheel)
+{
+    int64_t next = -1;
+    int i, level;
+
+    ogs_assert(wheel);
+
+    if (wheel->next_valid)
+        return wheel->next_tick;
+
+    /* Root slots are within 256 ticks, so the first one is the earliest */
+    if (wheel->num_of_root) {
+        for (i = 0; i < WHEEL_ROOT_SIZE; i++) {
+            if (ogs_list_first(
+                    &wheel->root[(wheel->tick + i) & WHEEL_ROOT_MASK])) {
+                next = wheel->tick + i;
+                break;
+            }
+        }
+    }
+
+    /*
+     * Upper slots might not be cascaded yet, so check the first slot
+     * in each level. The slot of the current index comes first
+     * if it is about to be cascaded, and last otherwise.
+     */
+    for (level = 0; level < WHEEL_NUM_OF_LEVEL; level++) {
+        int shift = WHEEL_SHIFT(level);
+        int start = (wheel->tick >> shift) & WHEEL_LEVEL_MASK;
+
+        if (wheel->tick & (((int64_t)1 << shift) - 1))
+            start++;
+
+        for (i = 0; i < WHEEL_LEVEL_SIZE; i++) {
+            ogs_list_t *slot = &wheel->level[level]
+                [(start + i) & WHEEL_LEVEL_MASK];
+            ogs_lnode_t *lnode = NULL;
+
+            if (!ogs_list_first(slot))
+                continue;
+
+            ogs_list_for_each(slot, lnode) {
+                ogs_timer_t *this = ogs_rb_entry(lnode, ogs_timer_t, lnode);
+                if (next < 0 || this->tick < next)
+                    next = this->tick;
+            }
+            break;
+        }
+    }
+
+    wheel->next_tick = next;
+    wheel->next_valid = true;
+
+    return next;
+}
+
+static void wheel_expire(ogs_timer_wheel_t *wheel,
+        ogs_time_t current, ogs_list_t *expired)
+{
+    int64_t target;
+    int level;
+
+    ogs_assert(wheel);
+    ogs_assert(expired);
+
+    target = (current - wheel->base) / WHEEL_TICK;
+
+    while (wheel->tick <= target) {
+        int index = wheel->tick & WHEEL_ROOT_MASK;
+        ogs_lnode_t *lnode = NULL;
+
+        if (!wheel->num_of_timer) {
+            wheel->tick = target + 1;
+            break;
+        }
+
+        /* Cascade the upper levels whose lower bits have wrapped */
+        if (index == 0) {
+            for (level = 0; level < WHEEL_NUM_OF_LEVEL; level++) {
+                int i = (wheel->tick >> WHEEL_SHIFT(level)) &
+                        WHEEL_LEVEL_MASK;
+                wheel_cascade(wheel, level, i);
+                if (i != 0)
+                    break;
+            }
+        }
+
+        while ((lnode = ogs_list_first(&wheel->root[index])) != NULL) {
+            ogs_timer_t *this = ogs_rb_entry(lnode, ogs_timer_t, lnode);
+
+            wheel_unlink(wheel, this);
+            wheel->num_of_timer--;
+            this->slot = expired;
+            ogs_list_add(expired, lnode);
+        }
+
+        wheel->tick++;
+
+        /* Nothing due before the next cascade */
+        if (!wheel->num_of_root) {
+            int64_t boundary = (wheel->tick + WHEEL_ROOT_MASK) &
+                    ~(int64_t)WHEEL_ROOT_MASK;
+            wheel->tick = ogs_min(boundary, target + 1);
+        }
+    }
+
+    wheel->next_valid = false;
+}
+
 static void add_timer_node(
         ogs_rbtree_t *tree, ogs_timer_t *timer, ogs_time_t duration)
 {
@@ -65,12 +281,25 @@ static void add_timer_node(
 }
 
 ogs_timer_mgr_t *ogs_timer_mgr_create(void)
+{
+    return ogs_timer_mgr_create_type(OGS_TIMER_MGR_RBTREE);
+}
+
+ogs_timer_mgr_t *ogs_timer_mgr_create_type(ogs_timer_mgr_type_e type)
 {
     ogs_timer_mgr_t *manager = ogs_calloc(1, sizeof *manager);
     ogs_assert(manager);
 
     ogs_pool_init(&manager->pool, ogs_core()->timer.pool);
 
+    manager->type = type;
+    if (type == OGS_TIMER_MGR_WHEEL) {
+        manager->wheel = ogs_calloc(1, sizeof *manager->wheel);
+        ogs_assert(manager->wheel);
+
+        manager->wheel->base = ogs_get_monotonic_time();
+    }
+
     return manager;
 }
 
@@ -78,6 +307,9 @@ void ogs_timer_mgr_destroy(ogs_timer_mgr_t *manager)
 {
     ogs_assert(manager);
 
+    if (manager->wheel)
+        ogs_free(manager->wheel);
+
     ogs_pool_final(&manager->pool);
     ogs_free(manager);
 }
@@ -122,6 +354,29 @@ void ogs_timer_start(ogs_timer_t *timer, ogs_time_t duration)
     manager = timer->manager;
     ogs_assert(manager);
 
+    if (manager->type == OGS_TIMER_MGR_WHEEL) {
+        ogs_timer_wheel_t *wheel = manager->wheel;
+        ogs_assert(wheel);
+
+        if (timer->running == true)
+            ogs_timer_stop(timer);
+
+        /* Rounded up so that the timer never expires early */
+        timer->timeout = ogs_get_monotonic_time() + duration;
+        timer->tick = (timer->timeout - wheel->base + WHEEL_TICK - 1) /
+                WHEEL_TICK;
+
+        timer->running = true;
+        wheel_link(wheel, timer);
+        wheel->num_of_timer++;
+
+        if (wheel->next_valid &&
+            (wheel->next_tick < 0 || timer->tick < wheel->next_tick))
+            wheel->next_tick = ogs_max(timer->tick, wheel->tick);
+
+        return;
+    }
+
     if (timer->running == true)
         ogs_rbtree_delete(&manager->tree, timer);
 
@@ -140,6 +395,25 @@ void ogs_timer_stop(ogs_timer_t *timer)
         return;
 
     timer->running = false;
+
+    if (manager->type == OGS_TIMER_MGR_WHEEL) {
+        ogs_timer_wheel_t *wheel = manager->wheel;
+        ogs_assert(wheel);
+
+        if ((void *)timer->slot >= (void *)wheel &&
+            (void *)timer->slot < (void *)(wheel + 1)) {
+            wheel_unlink(wheel, timer);
+            wheel->num_of_timer--;
+            if (timer->tick <= wheel->next_tick)
+                wheel->next_valid = false;
+        } else {
+            /* Already expired, but the callback is not called yet */
+            ogs_list_remove(timer->slot, &timer->lnode);
+            timer->slot = NULL;
+        }
+        return;
+    }
+
     ogs_rbtree_delete(&manager->tree, timer);
 }
 
@@ -150,6 +424,24 @@ ogs_time_t ogs_timer_mgr_next(ogs_timer_mgr_t *manager)
     ogs_assert(manager);
 
     current = ogs_get_monotonic_time();
+
+    if (manager->type == OGS_TIMER_MGR_WHEEL) {
+        ogs_timer_wheel_t *wheel = manager->wheel;
+        ogs_time_t timeout;
+        int64_t next;
+        ogs_assert(wheel);
+
+        next = wheel_next_tick(wheel);
+        if (next < 0)
+            return OGS_INFINITE_TIME;
+
+        timeout = wheel->base + next * WHEEL_TICK;
+        if (timeout > current)
+            return (timeout - current);
+        else
+            return OGS_NO_WAIT_TIME;
+    }
+
     rbnode = ogs_rbtree_first(&manager->tree);
     if (rbnode) {
         ogs_timer_t *this = ogs_rb_entry(rbnode, ogs_timer_t, rbnode);
@@ -176,6 +468,26 @@ void ogs_timer_mgr_expire(ogs_timer_mgr_t *manager)
     current = ogs_get_monotonic_time();
 
     ogs_list_init(&list);
+
+    if (manager->type == OGS_TIMER_MGR_WHEEL) {
+        ogs_assert(manager->wheel);
+
+        wheel_expire(manager->wheel, current, &list);
+
+        /* A callback may stop or restart other expired timers */
+        while ((lnode = ogs_list_first(&list)) != NULL) {
+            this = ogs_rb_entry(lnode, ogs_timer_t, lnode);
+
+            ogs_list_remove(&list, lnode);
+            this->slot = NULL;
+            this->running = false;
+
+            if (this->cb)
+                this->cb(this->data);
+        }
+        return;
+    }
+
     ogs_rbtree_for_each(&manager->tree, rbnode) {
         this = ogs_rb_entry(rbnode, ogs_timer_t, rbnode);
 
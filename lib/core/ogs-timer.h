@@ -31,7 +31,13 @@ extern "C" {
 typedef struct ogs_timer_mgr_s ogs_timer_mgr_t;
 typedef struct ogs_timer_s ogs_timer_t;;
 
+typedef enum {
+    OGS_TIMER_MGR_RBTREE = 0,
+    OGS_TIMER_MGR_WHEEL,
+} ogs_timer_mgr_type_e;
+
 ogs_timer_mgr_t *ogs_timer_mgr_create(void);
+ogs_timer_mgr_t *ogs_timer_mgr_create_type(ogs_timer_mgr_type_e type);
 void ogs_timer_mgr_destroy(ogs_timer_mgr_t *manager);
 
 ogs_timer_t *ogs_timer_add(
@@ -17,8 +17,14 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "core-config-private.h"
+
 #include "ogs-core.h"
 
+#if HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
+
 #undef OGS_LOG_DOMAIN
 #define OGS_LOG_DOMAIN __ogs_sock_domain
 
@@ -50,6 +56,11 @@ ogs_sock_t *ogs_udp_server(ogs_socknode_t *node)
             rv = ogs_listen_reusable(new->fd);
             ogs_assert(rv == OGS_OK);
 
+            if (node->option.reuse_port) {
+                rv = ogs_listen_reusable_port(new->fd);
+                ogs_assert(rv == OGS_OK);
+            }
+
             if (ogs_sock_bind(new, addr) == OGS_OK) {
                 ogs_debug("udp_server() [%s]:%d",
                         OGS_ADDR(addr, buf), OGS_PORT(addr));
@@ -139,3 +150,445 @@ int ogs_udp_connect(ogs_sock_t *sock, ogs_sockaddr_t *sa_list)
 
     return OGS_OK;
 }
+
+/*
+ * Receive up to 'num' datagrams without blocking.
+ *
+ * Each pkbuf[i] must have its len set to the room available for one
+ * datagram. On return, the received ones are trimmed to the datagram size,
+ * and the source address is stored in from[i] unless 'from' is NULL.
+ *
+ * Returns the number of datagrams received (0 if none is pending),
+ * or OGS_ERROR.
+ */
+int ogs_udp_recv_batch(ogs_socket_t fd,
+        ogs_pkbuf_t **pkbuf, ogs_sockaddr_t *from, int num)
+{
+    int n;
+
+    ogs_assert(fd != INVALID_SOCKET);
+    ogs_assert(pkbuf);
+    ogs_assert(num > 0 && num <= OGS_UDP_MAX_BATCH);
+
+#if HAVE_RECVMMSG
+    {
+        struct mmsghdr msg[OGS_UDP_MAX_BATCH];
+        struct iovec iov[OGS_UDP_MAX_BATCH];
+        int i;
+
+        memset(msg, 0, sizeof(msg[0]) * num);
+        for (i = 0; i < num; i++) {
+            ogs_assert(pkbuf[i]);
+            iov[i].iov_base = pkbuf[i]->data;
+            iov[i].iov_len = pkbuf[i]->len;
+            msg[i].msg_hdr.msg_iov = &iov[i];
+            msg[i].msg_hdr.msg_iovlen = 1;
+            if (from) {
+                memset(&from[i], 0, sizeof from[i]);
+                msg[i].msg_hdr.msg_name = &from[i].sa;
+                msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+            }
+        }
+
+        n = recvmmsg(fd, msg, num, MSG_DONTWAIT, NULL);
+        if (n < 0) {
+            if (ogs_socket_errno == OGS_EAGAIN)
+                return 0;
+            ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                    "recvmmsg(num:%d) failed", num);
+            return OGS_ERROR;
+        }
+
+        for (i = 0; i < n; i++)
+            ogs_pkbuf_trim(pkbuf[i], msg[i].msg_len);
+    }
+#else
+    for (n = 0; n < num; n++) {
+        ssize_t size;
+        socklen_t addrlen = sizeof(struct sockaddr_storage);
+        struct sockaddr *sa = NULL;
+        int flags = 0;
+
+#if defined(MSG_DONTWAIT)
+        flags = MSG_DONTWAIT;
+#else
+        /* Without MSG_DONTWAIT, only the datagram signaled by poll */
+        if (n > 0) break;
+#endif
+
+        ogs_assert(pkbuf[n]);
+        if (from) {
+            memset(&from[n], 0, sizeof from[n]);
+            sa = &from[n].sa;
+        }
+
+        size = recvfrom(fd, pkbuf[n]->data, pkbuf[n]->len, flags,
+                sa, sa ? &addrlen : NULL);
+        if (size < 0) {
+            if (ogs_socket_errno == OGS_EAGAIN)
+                break;
+            if (n > 0)
+                break;
+            ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                    "recvfrom(len:%d) failed", (int)pkbuf[n]->len);
+            return OGS_ERROR;
+        }
+
+        ogs_pkbuf_trim(pkbuf[n], size);
+    }
+#endif
+
+    return n;
+}
+
+/*
+ * Send pkbuf[i] to to[i] for all 'num' datagrams with as few system calls
+ * as possible. The pkbufs are not freed.
+ *
+ * Returns the number of datagrams sent, or OGS_ERROR if none was sent.
+ */
+int ogs_udp_sendto_batch(ogs_socket_t fd,
+        ogs_pkbuf_t **pkbuf, ogs_sockaddr_t **to, int num)
+{
+    int i, n = 0;
+
+    ogs_assert(fd != INVALID_SOCKET);
+    ogs_assert(pkbuf);
+    ogs_assert(to);
+    ogs_assert(num >= 0 && num <= OGS_UDP_MAX_BATCH);
+
+#if HAVE_SENDMMSG
+    {
+        struct mmsghdr msg[OGS_UDP_MAX_BATCH];
+        struct iovec iov[OGS_UDP_MAX_BATCH];
+        int sent;
+
+        memset(msg, 0, sizeof(msg[0]) * num);
+        for (i = 0; i < num; i++) {
+            ogs_assert(pkbuf[i]);
+            ogs_assert(to[i]);
+            iov[i].iov_base = pkbuf[i]->data;
+            iov[i].iov_len = pkbuf[i]->len;
+            msg[i].msg_hdr.msg_iov = &iov[i];
+            msg[i].msg_hdr.msg_iovlen = 1;
+            msg[i].msg_hdr.msg_name = &to[i]->sa;
+            msg[i].msg_hdr.msg_namelen = ogs_sockaddr_len(to[i]);
+        }
+
+        /* sendmmsg() may stop early, e.g. when interrupted */
+        while (n < num) {
+            sent = sendmmsg(fd, msg + n, num - n, 0);
+            if (sent <= 0) {
+                ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                        "sendmmsg(num:%d) failed", num - n);
+                break;
+            }
+            n += sent;
+        }
+    }
+#else
+    for (i = 0; i < num; i++) {
+        if (ogs_sendto(fd, pkbuf[i]->data, pkbuf[i]->len, 0, to[i]) ==
+                pkbuf[i]->len)
+            n++;
+    }
+#endif
+
+    if (num && !n)
+        return OGS_ERROR;
+
+    return n;
+}
+
+/*
+ * Whether the kernel can split a datagram sent with UDP_SEGMENT.
+ * The first call probes it, so make it before other threads may send.
+ */
+bool ogs_udp_gso_supported(void)
+{
+    static bool probed = false;
+    static bool supported = false;
+
+    if (probed)
+        return supported;
+
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    {
+        ogs_socket_t fd;
+        int size = 0;
+        socklen_t optlen = sizeof(size);
+
+        /* Old kernels ignore the cmsg, and send one big datagram */
+        fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (fd != INVALID_SOCKET) {
+            supported = getsockopt(fd, IPPROTO_UDP, UDP_SEGMENT,
+                    &size, &optlen) == 0;
+            ogs_closesocket(fd);
+        }
+    }
+#endif
+
+    probed = true;
+
+    return supported;
+}
+
+/*
+ * Let the kernel coalesce the datagrams from the same source into
+ * one aggregate, which must then be received by ogs_udp_recv_gro().
+ *
+ * Returns OGS_ERROR if the kernel cannot do it.
+ */
+int ogs_udp_set_gro(ogs_socket_t fd)
+{
+    ogs_assert(fd != INVALID_SOCKET);
+
+#if defined(UDP_GRO)
+    {
+        int on = 0;
+        socklen_t optlen = sizeof(on);
+
+        /*
+         * Readers find out by ogs_udp_gro_enabled() whether to expect
+         * an aggregate, so it is not enabled where it cannot be queried.
+         */
+        if (getsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, &optlen) != 0)
+            return OGS_ERROR;
+
+        on = 1;
+        if (setsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) != 0) {
+            ogs_log_message(OGS_LOG_WARN, ogs_socket_errno,
+                    "setsockopt(IPPROTO_UDP, UDP_GRO) failed");
+            return OGS_ERROR;
+        }
+
+        return OGS_OK;
+    }
+#else
+    return OGS_ERROR;
+#endif
+}
+
+bool ogs_udp_gro_enabled(ogs_socket_t fd)
+{
+    ogs_assert(fd != INVALID_SOCKET);
+
+#if defined(UDP_GRO)
+    {
+        int on = 0;
+        socklen_t optlen = sizeof(on);
+
+        if (getsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, &optlen) != 0)
+            return false;
+
+        return on != 0;
+    }
+#else
+    return false;
+#endif
+}
+
+/*
+ * Receive one datagram without blocking. If UDP_GRO is enabled,
+ * it may be an aggregate of datagrams of '*segsize' bytes each,
+ * except the last one which may be shorter. Otherwise '*segsize'
+ * is the size of the datagram.
+ *
+ * 'buf' should have OGS_UDP_MAX_GRO_LEN bytes, or an aggregate is cut.
+ *
+ * Returns the number of bytes received (0 if none is pending),
+ * or OGS_ERROR.
+ */
+ssize_t ogs_udp_recv_gro(ogs_socket_t fd,
+        void *buf, size_t len, int *segsize, ogs_sockaddr_t *from)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct cmsghdr *cmsg = NULL;
+    ssize_t size;
+
+    ogs_assert(fd != INVALID_SOCKET);
+    ogs_assert(buf);
+    ogs_assert(segsize);
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (from) {
+        memset(from, 0, sizeof *from);
+        msg.msg_name = &from->sa;
+        msg.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+
+    size = recvmsg(fd, &msg, MSG_DONTWAIT);
+    if (size < 0) {
+        if (ogs_socket_errno == OGS_EAGAIN)
+            return 0;
+        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                "recvmsg(len:%d) failed", (int)len);
+        return OGS_ERROR;
+    }
+
+    if (msg.msg_flags & MSG_TRUNC)
+        ogs_warn_ratelimited("recvmsg(len:%d) truncated", (int)len);
+
+    *segsize = size;
+#if defined(UDP_GRO)
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int gso_size;
+            memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+            if (gso_size > 0 && gso_size < size)
+                *segsize = gso_size;
+            break;
+        }
+    }
+#endif
+
+    return size;
+}
+
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+static bool udp_same_destination(ogs_sockaddr_t *a, ogs_sockaddr_t *b)
+{
+    if (a == b)
+        return true;
+
+    return ogs_sockaddr_is_equal(a, b) && OGS_PORT(a) == OGS_PORT(b);
+}
+#endif
+
+/*
+ * Like ogs_udp_sendto_batch(), but each run of datagrams to the same
+ * destination is sent as one UDP_SEGMENT aggregate, which the kernel
+ * or the NIC splits again. All datagrams in a run have the same size,
+ * except the last one which may be shorter.
+ *
+ * If the kernel or the egress device cannot do it, the datagrams are
+ * sent one by one and '*disabled' is set, so the caller does not try
+ * again. Nothing is coalesced while '*disabled' is true. A transient
+ * error leaves '*disabled' as it is.
+ */
+int ogs_udp_sendto_gso_batch(ogs_socket_t fd,
+        ogs_pkbuf_t **pkbuf, ogs_sockaddr_t **to, int num, bool *disabled)
+{
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    struct mmsghdr msg[OGS_UDP_MAX_BATCH];
+    struct iovec iov[OGS_UDP_MAX_BATCH];
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control[OGS_UDP_MAX_BATCH];
+    int first[OGS_UDP_MAX_BATCH + 1]; /* The first datagram of msg[m] */
+    int i, m, num_of_msg = 0, n = 0, sent;
+
+    ogs_assert(fd != INVALID_SOCKET);
+    ogs_assert(pkbuf);
+    ogs_assert(to);
+    ogs_assert(disabled);
+    ogs_assert(num >= 0 && num <= OGS_UDP_MAX_BATCH);
+
+    if (*disabled || !ogs_udp_gso_supported())
+        return ogs_udp_sendto_batch(fd, pkbuf, to, num);
+
+    i = 0;
+    while (i < num) {
+        struct msghdr *hdr = &msg[num_of_msg].msg_hdr;
+        int j = i;
+        size_t total;
+
+        ogs_assert(pkbuf[i]);
+        ogs_assert(to[i]);
+        iov[i].iov_base = pkbuf[i]->data;
+        iov[i].iov_len = pkbuf[i]->len;
+        total = pkbuf[i]->len;
+
+        while (j + 1 < num && pkbuf[j]->len == pkbuf[i]->len &&
+                pkbuf[j+1]->len && pkbuf[j+1]->len <= pkbuf[i]->len &&
+                total + pkbuf[j+1]->len <= OGS_UDP_MAX_GSO_LEN &&
+                udp_same_destination(to[j+1], to[i])) {
+            j++;
+            iov[j].iov_base = pkbuf[j]->data;
+            iov[j].iov_len = pkbuf[j]->len;
+            total += pkbuf[j]->len;
+        }
+
+        memset(hdr, 0, sizeof *hdr);
+        hdr->msg_iov = &iov[i];
+        hdr->msg_iovlen = j - i + 1;
+        hdr->msg_name = &to[i]->sa;
+        hdr->msg_namelen = ogs_sockaddr_len(to[i]);
+
+        if (j > i) {
+            struct cmsghdr *cmsg = NULL;
+            uint16_t gso_size = pkbuf[i]->len;
+
+            hdr->msg_control = control[num_of_msg].buf;
+            hdr->msg_controllen = sizeof(control[num_of_msg].buf);
+            cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(gso_size));
+            memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+        }
+
+        first[num_of_msg++] = i;
+        i = j + 1;
+    }
+    first[num_of_msg] = num;
+
+    m = 0;
+    while (m < num_of_msg) {
+        sent = sendmmsg(fd, msg + m, num_of_msg - m, 0);
+        if (sent > 0) {
+            n += first[m + sent] - first[m];
+            m += sent;
+            continue;
+        }
+
+        if (!msg[m].msg_hdr.msg_controllen) {
+            ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                    "sendmmsg(num:%d) failed", num_of_msg - m);
+            break;
+        }
+
+        /*
+         * EIO and EOPNOTSUPP mean the device cannot do it at all.
+         * EINVAL is also returned if a segment does not fit the path MTU,
+         * and EAGAIN, ENOBUFS and ENOMEM come and go under load,
+         * so only this run is sent without offload.
+         */
+        if (ogs_socket_errno == EIO || ogs_socket_errno == EOPNOTSUPP) {
+            ogs_log_message(OGS_LOG_WARN, ogs_socket_errno,
+                    "UDP GSO disabled");
+            *disabled = true;
+            sent = ogs_udp_sendto_batch(fd,
+                    pkbuf + first[m], to + first[m], num - first[m]);
+            if (sent > 0)
+                n += sent;
+            break;
+        }
+
+        sent = ogs_udp_sendto_batch(fd, pkbuf + first[m], to + first[m],
+                first[m + 1] - first[m]);
+        if (sent > 0)
+            n += sent;
+        m++;
+    }
+
+    if (num && !n)
+        return OGS_ERROR;
+
+    return n;
+#else
+    return ogs_udp_sendto_batch(fd, pkbuf, to, num);
+#endif
+}
@@ -33,6 +33,26 @@ ogs_sock_t *ogs_udp_server(ogs_socknode_t *node);
 ogs_sock_t *ogs_udp_client(ogs_socknode_t *node);
 int ogs_udp_connect(ogs_sock_t *sock, ogs_sockaddr_t *sa_list);
 
+#define OGS_UDP_MAX_BATCH       32
+
+int ogs_udp_recv_batch(ogs_socket_t fd,
+        ogs_pkbuf_t **pkbuf, ogs_sockaddr_t *from, int num);
+int ogs_udp_sendto_batch(ogs_socket_t fd,
+        ogs_pkbuf_t **pkbuf, ogs_sockaddr_t **to, int num);
+
+/* UDP payload of an aggregate, less than 64K with the IPv6 header */
+#define OGS_UDP_MAX_GSO_LEN     (65535 - 40 - 8)
+#define OGS_UDP_MAX_GRO_LEN     65535
+
+bool ogs_udp_gso_supported(void);
+int ogs_udp_sendto_gso_batch(ogs_socket_t fd,
+        ogs_pkbuf_t **pkbuf, ogs_sockaddr_t **to, int num, bool *disabled);
+
+int ogs_udp_set_gro(ogs_socket_t fd);
+bool ogs_udp_gro_enabled(ogs_socket_t fd);
+ssize_t ogs_udp_recv_gro(ogs_socket_t fd,
+        void *buf, size_t len, int *segsize, ogs_sockaddr_t *from);
+
 #ifdef __cplusplus
 }
 #endif
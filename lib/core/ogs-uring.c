@@ -0,0 +1,710 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core-config-private.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if HAVE_IO_URING
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "ogs-core.h"
+#include "ogs-poll-private.h"
+
+#if HAVE_IO_URING
+
+/*
+ * io_uring pollset
+ *
+ * The ring is driven by raw system calls, so liburing is not needed.
+ *
+ * - ogs_pollset_add() is a one-shot POLL_ADD which is armed again
+ *   once the handler returns, so it behaves like level-triggered epoll.
+ * - ogs_pollset_add_recv() is a multishot RECVMSG (socket) or
+ *   multishot READ (TUN device) from a buffer ring shared by the pollset.
+ *   Each packet is copied into the best-fit cluster, and the buffer is
+ *   returned to the ring at once.
+ *   If the kernel cannot do multishot on the fd, or the socket has
+ *   UDP_GRO, the poll falls back to POLL_ADD with the receive path of
+ *   readiness backends.
+ */
+
+/* IORING_OP_READ_MULTISHOT since Linux 6.7 */
+#define URING_OP_READ_MULTISHOT     49
+
+#ifndef POLLRDHUP
+#define POLLRDHUP                   0x2000
+#endif
+
+/* Buffers in the ring of each pollset. Must be a power of 2 */
+#define URING_NUM_OF_BUF            (2 * OGS_UDP_MAX_BATCH)
+
+/* struct io_uring_recvmsg_out and the source address precede the payload */
+#define URING_MSG_HDR_LEN \
+    (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_storage))
+#define URING_BUF_LEN               (URING_MSG_HDR_LEN + OGS_MAX_SDU_LEN)
+
+/* Buffer group of the ring */
+#define URING_BGID                  0
+
+static void uring_init(ogs_pollset_t *pollset);
+static void uring_cleanup(ogs_pollset_t *pollset);
+static int uring_add(ogs_poll_t *poll, short when);
+static int uring_remove(ogs_poll_t *poll);
+static int uring_process(ogs_pollset_t *pollset, ogs_time_t timeout);
+static int uring_add_recv(ogs_poll_t *poll);
+
+static const ogs_pollset_actions_t ogs_uring_actions = {
+    uring_init,
+    uring_cleanup,
+
+    uring_add,
+    uring_remove,
+    uring_process,
+
+    ogs_notify_pollset,
+
+    uring_add_recv,
+};
+
+typedef enum {
+    URING_POLL = 0,
+    URING_RECVMSG,
+    URING_READ,
+} uring_type_e;
+
+/*
+ * The user_data of SQE is this request, not the poll.
+ * The request stays until the kernel posts its last CQE,
+ * so that a stale CQE never reaches the poll reused for another fd.
+ */
+typedef struct uring_req_s {
+    ogs_lnode_t lnode;
+
+    ogs_poll_t *poll;       /* NULL once removed */
+    uring_type_e type;
+    short when;
+
+    bool armed;             /* The last CQE is not posted yet */
+    bool flush;             /* Packets were handed off in this round */
+
+    struct msghdr msg;      /* RECVMSG */
+} uring_req_t;
+
+struct uring_context_s {
+    int fd;
+
+    void *ring;
+    size_t ring_size;
+
+    struct {
+        unsigned *khead;
+        unsigned *ktail;
+        unsigned mask;
+        unsigned entries;
+        unsigned tail;
+
+        struct io_uring_sqe *sqes;
+        size_t sqes_size;
+    } sq;
+
+    struct {
+        unsigned *khead;
+        unsigned *ktail;
+        unsigned mask;
+
+        struct io_uring_cqe *cqes;
+    } cq;
+
+    struct {
+        struct io_uring_buf_ring *br;
+        uint8_t *base;
+        size_t size;
+        uint16_t tail;
+    } buf;
+
+    ogs_list_t req_list;
+    ogs_list_t zombie_list;
+
+    uring_req_t **flush;
+    int num_of_flush;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+        unsigned flags, void *arg, size_t argsz)
+{
+    return syscall(__NR_io_uring_enter,
+            fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nargs)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+}
+
+static int uring_register_buf_ring(int fd, void *br, unsigned entries)
+{
+    struct io_uring_buf_reg reg;
+
+    memset(&reg, 0, sizeof reg);
+    reg.ring_addr = (uintptr_t)br;
+    reg.ring_entries = entries;
+    reg.bgid = URING_BGID;
+
+    return uring_register(fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+}
+
+const ogs_pollset_actions_t *ogs_uring_probe(void)
+{
+    struct io_uring_params p;
+    size_t size = sysconf(_SC_PAGESIZE);
+    void *br = NULL;
+    int fd, rv;
+
+    memset(&p, 0, sizeof p);
+    fd = uring_setup(1, &p);
+    if (fd < 0) {
+        ogs_log_message(OGS_LOG_WARN, ogs_errno, "io_uring_setup() failed");
+        return NULL;
+    }
+
+    /* Timeout of io_uring_enter() since Linux 5.11 */
+    if (!(p.features & IORING_FEAT_EXT_ARG) ||
+        !(p.features & IORING_FEAT_NODROP) ||
+        !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        ogs_warn("io_uring features[0x%x] not supported", p.features);
+        close(fd);
+        return NULL;
+    }
+
+    /* Buffer ring since Linux 5.19 */
+    br = mmap(NULL, size, PROT_READ|PROT_WRITE,
+            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    ogs_assert(br != MAP_FAILED);
+    rv = uring_register_buf_ring(fd, br, 1);
+    if (rv < 0)
+        ogs_log_message(OGS_LOG_WARN, ogs_errno,
+                "IORING_REGISTER_PBUF_RING failed");
+
+    close(fd);
+    munmap(br, size);
+
+    return rv < 0 ? NULL : &ogs_uring_actions;
+}
+
+static void uring_buf_recycle(struct uring_context_s *context, int bid)
+{
+    struct io_uring_buf *buf = NULL;
+
+    buf = &context->buf.br->bufs[context->buf.tail & (URING_NUM_OF_BUF-1)];
+    buf->addr = (uintptr_t)(context->buf.base + bid * URING_BUF_LEN);
+    buf->len = URING_BUF_LEN;
+    buf->bid = bid;
+
+    context->buf.tail++;
+    ogs_atomic_store(&context->buf.br->tail, context->buf.tail);
+}
+
+static void uring_init(ogs_pollset_t *pollset)
+{
+    struct uring_context_s *context = NULL;
+    struct io_uring_params p;
+    unsigned entries = 1;
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    size_t br_size;
+    uint8_t *ring = NULL;
+    int i, rv;
+
+    ogs_assert(pollset);
+
+    context = ogs_calloc(1, sizeof *context);
+    ogs_assert(context);
+    pollset->context = context;
+
+    /* A poll has at most one request and one cancel in flight */
+    while (entries < 2 * ogs_core()->socket.pool)
+        entries <<= 1;
+
+    memset(&p, 0, sizeof p);
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = 4 * entries;
+    context->fd = uring_setup(entries, &p);
+    ogs_assert(context->fd >= 0);
+
+    context->ring_size = ogs_max(
+            p.sq_off.array + p.sq_entries * sizeof(unsigned),
+            p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe));
+    context->ring = mmap(NULL, context->ring_size,
+            PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+            context->fd, IORING_OFF_SQ_RING);
+    ogs_assert(context->ring != MAP_FAILED);
+    ring = context->ring;
+
+    context->sq.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    context->sq.sqes = mmap(NULL, context->sq.sqes_size,
+            PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+            context->fd, IORING_OFF_SQES);
+    ogs_assert(context->sq.sqes != MAP_FAILED);
+
+    context->sq.khead = (unsigned *)(ring + p.sq_off.head);
+    context->sq.ktail = (unsigned *)(ring + p.sq_off.tail);
+    context->sq.mask = *(unsigned *)(ring + p.sq_off.ring_mask);
+    context->sq.entries = p.sq_entries;
+    context->sq.tail = *context->sq.ktail;
+    for (i = 0; i < p.sq_entries; i++)
+        ((unsigned *)(ring + p.sq_off.array))[i] = i;
+
+    context->cq.khead = (unsigned *)(ring + p.cq_off.head);
+    context->cq.ktail = (unsigned *)(ring + p.cq_off.tail);
+    context->cq.mask = *(unsigned *)(ring + p.cq_off.ring_mask);
+    context->cq.cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+
+    /* The buffer ring is page aligned, and the buffers follow it */
+    br_size = (URING_NUM_OF_BUF * sizeof(struct io_uring_buf) +
+            pagesize - 1) & ~(pagesize - 1);
+    context->buf.size = br_size + URING_NUM_OF_BUF * URING_BUF_LEN;
+    context->buf.br = mmap(NULL, context->buf.size,
+            PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    ogs_assert(context->buf.br != MAP_FAILED);
+    context->buf.base = (uint8_t *)context->buf.br + br_size;
+
+    rv = uring_register_buf_ring(
+            context->fd, context->buf.br, URING_NUM_OF_BUF);
+    ogs_assert(rv == 0);
+    for (i = 0; i < URING_NUM_OF_BUF; i++)
+        uring_buf_recycle(context, i);
+
+    context->flush = ogs_calloc(
+            ogs_core()->socket.pool, sizeof(uring_req_t *));
+    ogs_assert(context->flush);
+
+    ogs_notify_init(pollset);
+}
+
+static unsigned uring_sq_pending(struct uring_context_s *context)
+{
+    ogs_atomic_store(context->sq.ktail, context->sq.tail);
+    return context->sq.tail - ogs_atomic_load(context->sq.khead);
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct uring_context_s *context)
+{
+    struct io_uring_sqe *sqe = NULL;
+    unsigned pending;
+    int rv;
+
+    pending = uring_sq_pending(context);
+    if (pending >= context->sq.entries) {
+        rv = uring_enter(context->fd, pending, 0, 0, NULL, 0);
+        if (rv < 0)
+            ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                    "io_uring_enter() failed");
+        ogs_assert(uring_sq_pending(context) < context->sq.entries);
+    }
+
+    sqe = &context->sq.sqes[context->sq.tail & context->sq.mask];
+    memset(sqe, 0, sizeof *sqe);
+    context->sq.tail++;
+
+    return sqe;
+}
+
+static void uring_arm(struct uring_context_s *context, uring_req_t *req)
+{
+    struct io_uring_sqe *sqe = NULL;
+    uint32_t events = 0;
+
+    ogs_assert(req);
+    ogs_assert(req->poll);
+
+    sqe = uring_get_sqe(context);
+    sqe->fd = req->poll->fd;
+    sqe->user_data = (uintptr_t)req;
+
+    switch (req->type) {
+    case URING_RECVMSG:
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (uintptr_t)&req->msg;
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = URING_BGID;
+        break;
+    case URING_READ:
+        sqe->opcode = URING_OP_READ_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = URING_BGID;
+        break;
+    default:
+        if (req->when & OGS_POLLIN)
+            events |= POLLIN|POLLRDHUP;
+        if (req->when & OGS_POLLOUT)
+            events |= POLLOUT;
+#if OGS_BYTE_ORDER == OGS_BIG_ENDIAN
+        events = (events << 16) | (events >> 16);
+#endif
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll32_events = events;
+        break;
+    }
+
+    req->armed = true;
+}
+
+static uring_req_t *uring_req_add(ogs_poll_t *poll, uring_type_e type)
+{
+    struct uring_context_s *context = NULL;
+    uring_req_t *req = NULL;
+
+    ogs_assert(poll);
+    ogs_assert(poll->pollset);
+    context = poll->pollset->context;
+    ogs_assert(context);
+
+    req = ogs_calloc(1, sizeof *req);
+    ogs_assert(req);
+
+    req->poll = poll;
+    req->type = type;
+    poll->context = req;
+
+    ogs_list_add(&context->req_list, req);
+
+    return req;
+}
+
+static void uring_cleanup(ogs_pollset_t *pollset)
+{
+    struct uring_context_s *context = NULL;
+    uring_req_t *req = NULL, *next_req = NULL;
+    int i;
+
+    ogs_assert(pollset);
+    context = pollset->context;
+    ogs_assert(context);
+
+    ogs_notify_final(pollset);
+
+    ogs_list_for_each_safe(&context->req_list, next_req, req)
+        uring_remove(req->poll);
+
+    /* Buffers are unmapped after the last CQE of every request */
+    for (i = 0; i < 10 && !ogs_list_empty(&context->zombie_list); i++)
+        uring_process(pollset, ogs_time_from_msec(100));
+
+    close(context->fd);
+
+    ogs_list_for_each_safe(&context->zombie_list, next_req, req) {
+        ogs_list_remove(&context->zombie_list, req);
+        ogs_free(req);
+    }
+
+    munmap(context->buf.br, context->buf.size);
+    munmap(context->sq.sqes, context->sq.sqes_size);
+    munmap(context->ring, context->ring_size);
+
+    ogs_free(context->flush);
+    ogs_free(context);
+}
+
+static int uring_add(ogs_poll_t *poll, short when)
+{
+    uring_req_t *req = NULL;
+
+    ogs_assert(poll);
+
+    req = uring_req_add(poll, URING_POLL);
+    req->when = when;
+
+    uring_arm(poll->pollset->context, req);
+
+    return OGS_OK;
+}
+
+static int uring_add_recv(ogs_poll_t *poll)
+{
+    uring_req_t *req = NULL;
+
+    ogs_assert(poll);
+
+    /* A GRO aggregate does not fit a buffer of the ring */
+    if (poll->recv.gro)
+        req = uring_req_add(poll, URING_POLL);
+    else if (poll->recv.socket)
+        req = uring_req_add(poll, URING_RECVMSG);
+    else
+        req = uring_req_add(poll, URING_READ);
+    req->when = OGS_POLLIN;
+
+    req->msg.msg_namelen = sizeof(struct sockaddr_storage);
+
+    uring_arm(poll->pollset->context, req);
+
+    return OGS_OK;
+}
+
+static int uring_remove(ogs_poll_t *poll)
+{
+    struct uring_context_s *context = NULL;
+    struct io_uring_sqe *sqe = NULL;
+    uring_req_t *req = NULL;
+
+    ogs_assert(poll);
+    ogs_assert(poll->pollset);
+    context = poll->pollset->context;
+    ogs_assert(context);
+    req = poll->context;
+    ogs_assert(req);
+
+    poll->context = NULL;
+    req->poll = NULL;
+
+    ogs_list_remove(&context->req_list, req);
+    ogs_list_add(&context->zombie_list, req);
+
+    if (req->armed) {
+        sqe = uring_get_sqe(context);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (uintptr_t)req;
+        sqe->user_data = 0;
+    }
+
+    return OGS_OK;
+}
+
+static void uring_handle_recv(struct uring_context_s *context,
+        uring_req_t *req, struct io_uring_cqe *cqe)
+{
+    ogs_poll_t *poll = req->poll;
+    ogs_sockaddr_t from, *pfrom = NULL;
+    ogs_pkbuf_t *pkbuf = NULL;
+    uint8_t *buf = NULL, *payload = NULL;
+    int bid, len;
+
+    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    ogs_assert(bid < URING_NUM_OF_BUF);
+    buf = context->buf.base + bid * URING_BUF_LEN;
+
+    if (!poll || cqe->res < 0)
+        goto recycle;
+
+    if (req->type == URING_RECVMSG) {
+        struct io_uring_recvmsg_out *out = (void *)buf;
+        size_t hdr_len = sizeof *out + req->msg.msg_namelen;
+
+        if (cqe->res < hdr_len)
+            goto recycle;
+        if (out->flags & MSG_TRUNC) {
+            ogs_warn_ratelimited("Truncated packet [len:%d]",
+                    out->payloadlen);
+            goto recycle;
+        }
+
+        memset(&from, 0, sizeof from);
+        memcpy(&from, buf + sizeof *out,
+                ogs_min(out->namelen, sizeof(struct sockaddr_storage)));
+        pfrom = &from;
+
+        payload = buf + hdr_len;
+        len = out->payloadlen;
+    } else {
+        payload = buf;
+        len = cqe->res;
+    }
+
+    pkbuf = ogs_pollset_recv_copy(poll, payload, len);
+    uring_buf_recycle(context, bid);
+
+    if (!req->flush) {
+        ogs_assert(context->num_of_flush < ogs_core()->socket.pool);
+        context->flush[context->num_of_flush++] = req;
+        req->flush = true;
+    }
+
+    poll->recv.handler(poll->fd, pkbuf, pfrom, poll->recv.data);
+    return;
+
+recycle:
+    uring_buf_recycle(context, bid);
+}
+
+static void uring_handle_cqe(struct uring_context_s *context,
+        uring_req_t *req, struct io_uring_cqe *cqe)
+{
+    ogs_poll_t *poll = req->poll;
+    short when = 0;
+
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+        req->armed = false;
+
+    if (req->type == URING_POLL) {
+        if (!poll)
+            return;
+
+        if (cqe->res < 0) {
+            /* Not armed again, or it would spin on the bad fd */
+            ogs_log_message(OGS_LOG_ERROR, -cqe->res, "POLL_ADD failed");
+            return;
+        }
+
+        if (cqe->res & (POLLERR|POLLHUP)) {
+            when = OGS_POLLIN|OGS_POLLOUT;
+        } else {
+            if (cqe->res & (POLLIN|POLLRDHUP))
+                when |= OGS_POLLIN;
+            if (cqe->res & POLLOUT)
+                when |= OGS_POLLOUT;
+        }
+
+        if (when)
+            poll->handler(when, poll->fd, poll->data);
+
+    } else if (cqe->flags & IORING_CQE_F_BUFFER) {
+        uring_handle_recv(context, req, cqe);
+
+    } else if (poll && cqe->res < 0) {
+        switch (cqe->res) {
+        case -ENOBUFS:
+            /* The buffers are returned by now */
+            break;
+        case -EINVAL:
+        case -EOPNOTSUPP:
+        case -EBADFD:
+            ogs_warn("Multishot %s not supported on fd[%d], "
+                    "fall back to POLL_ADD",
+                    req->type == URING_RECVMSG ? "RECVMSG" : "READ",
+                    poll->fd);
+            req->type = URING_POLL;
+            break;
+        case -EBADF:
+            ogs_log_message(OGS_LOG_ERROR, -cqe->res, "Receive failed");
+            return;
+        default:
+            ogs_log_ratelimited(OGS_LOG_WARN, -cqe->res, "Receive failed");
+            break;
+        }
+    }
+
+    /* The handler may have removed the poll */
+    if (!req->armed && req->poll)
+        uring_arm(context, req);
+}
+
+static int uring_process(ogs_pollset_t *pollset, ogs_time_t timeout)
+{
+    struct uring_context_s *context = NULL;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    uring_req_t *req = NULL, *next_req = NULL;
+    unsigned head, tail, pending;
+    int i, rv, num_of_cqe = 0;
+
+    ogs_assert(pollset);
+    context = pollset->context;
+    ogs_assert(context);
+
+    pending = uring_sq_pending(context);
+
+    head = *context->cq.khead;
+    tail = ogs_atomic_load(context->cq.ktail);
+
+    if (head == tail) {
+        memset(&arg, 0, sizeof arg);
+        if (timeout != OGS_INFINITE_TIME) {
+            ts.tv_sec = ogs_time_sec(timeout);
+            ts.tv_nsec = ogs_time_usec(timeout) * 1000;
+            arg.ts = (uintptr_t)&ts;
+        }
+
+        rv = uring_enter(context->fd, pending, 1,
+                IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG,
+                &arg, sizeof arg);
+        if (rv < 0 && ogs_errno != ETIME && ogs_errno != EINTR) {
+            ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                    "io_uring_enter() failed");
+            return OGS_ERROR;
+        }
+
+        tail = ogs_atomic_load(context->cq.ktail);
+    } else if (pending) {
+        rv = uring_enter(context->fd, pending, 0, 0, NULL, 0);
+        if (rv < 0) {
+            ogs_log_message(OGS_LOG_ERROR, ogs_errno,
+                    "io_uring_enter() failed");
+            return OGS_ERROR;
+        }
+    }
+
+    while (head != tail) {
+        struct io_uring_cqe cqe = context->cq.cqes[head & context->cq.mask];
+
+        head++;
+        ogs_atomic_store(context->cq.khead, head);
+        num_of_cqe++;
+
+        /* CQE of ASYNC_CANCEL */
+        if (!cqe.user_data)
+            continue;
+
+        uring_handle_cqe(context, (uring_req_t *)(uintptr_t)cqe.user_data,
+                &cqe);
+    }
+
+    for (i = 0; i < context->num_of_flush; i++) {
+        ogs_poll_t *poll = NULL;
+
+        req = context->flush[i];
+        req->flush = false;
+
+        poll = req->poll;
+        if (poll)
+            poll->recv.handler(poll->fd, NULL, NULL, poll->recv.data);
+    }
+    context->num_of_flush = 0;
+
+    ogs_list_for_each_safe(&context->zombie_list, next_req, req) {
+        if (!req->armed) {
+            ogs_list_remove(&context->zombie_list, req);
+            ogs_free(req);
+        }
+    }
+
+    return num_of_cqe ? OGS_OK : OGS_TIMEUP;
+}
+
+#else /* HAVE_IO_URING */
+
+const ogs_pollset_actions_t *ogs_uring_probe(void)
+{
+    return NULL;
+}
+
+#endif /* HAVE_IO_URING */
@@ -0,0 +1,764 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core-config-private.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if HAVE_IFADDRS_H
+#include <ifaddrs.h>
+#endif
+
+#if HAVE_NET_IF_H
+#include <net/if.h>
+#endif
+
+#if HAVE_SYS_IOCTL_H
+#include <sys/ioctl.h>
+#endif
+
+#if HAVE_AF_XDP
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <net/if_arp.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#endif
+
+#include "ogs-core.h"
+
+#undef OGS_LOG_DOMAIN
+#define OGS_LOG_DOMAIN __ogs_sock_domain
+
+#if HAVE_AF_XDP
+
+/*
+ * The program, the map and the socket are made with raw system calls,
+ * so libbpf and libxdp are not needed. The program is attached with
+ * a BPF link, which is detached when the process exits.
+ */
+#ifndef AF_XDP
+#define AF_XDP                  44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP                 283
+#endif
+
+#define XSK_FRAME_SIZE          2048    /* A cluster of the UMEM pool */
+#define XSK_NUM_OF_FRAME        4096
+#define XSK_RING_SIZE           1024
+#define XSK_RX_BURST            64
+#define XSK_MAX_NEIGH           256
+
+#define XSK_ETH_HLEN            14
+#define XSK_IPV4_HLEN           20
+#define XSK_UDP_HLEN            8
+#define XSK_HLEN                (XSK_ETH_HLEN + XSK_IPV4_HLEN + XSK_UDP_HLEN)
+
+/* The UMEM is mapped by ogs_pool_mem_alloc(), so it starts on a page */
+OGS_STATIC_ASSERT(XSK_FRAME_SIZE * XSK_NUM_OF_FRAME >= 2*1024*1024);
+/* Frames posted for receive, on the wire and in completion, and caches */
+OGS_STATIC_ASSERT(XSK_NUM_OF_FRAME >= 4 * XSK_RING_SIZE);
+
+typedef struct xsk_ring_s {
+    uint32_t    *producer;
+    uint32_t    *consumer;
+    void        *desc;
+    uint32_t    mask;
+
+    void        *map;
+    size_t      map_len;
+} xsk_ring_t;
+
+/* Learned from the received frames */
+typedef struct xsk_neigh_s {
+    uint32_t    addr;           /* 0 if unused */
+    uint8_t     mac[6];
+} xsk_neigh_t;
+
+struct ogs_xsk_s {
+    ogs_socket_t    fd;
+    ogs_socket_t    udp_fd;
+    char            ifname[IF_NAMESIZE];
+    int             ifindex;
+    uint8_t         mac[6];
+    uint32_t        addr;       /* Network byte order */
+    uint16_t        port;       /* Network byte order */
+
+    int             map_fd;
+    int             prog_fd;
+    int             link_fd;
+
+    ogs_pkbuf_pool_t *umem_pool;
+    uint8_t         *umem;
+    ogs_pkbuf_t     *frame[XSK_NUM_OF_FRAME];  /* Posted or being sent */
+
+    xsk_ring_t      rx, fill;   /* Used by the polling thread */
+    xsk_ring_t      tx, comp;   /* Used with the mutex held */
+
+    ogs_thread_mutex_t mutex;
+    bool            mutex_initialized;
+    int             tx_pending;
+    xsk_neigh_t     neigh[XSK_MAX_NEIGH];
+
+    ogs_poll_t      *poll;
+    ogs_pkbuf_pool_t *pool;
+    int             headroom;
+    ogs_poll_recv_f handler;
+    void            *data;
+
+    ogs_pkbuf_t     *pkbuf[XSK_RX_BURST];
+    ogs_sockaddr_t  from[XSK_RX_BURST];
+    const uint8_t   *from_mac[XSK_RX_BURST];
+};
+
+#define XSK_INSN(_code, _dst, _src, _off, _imm) \
+    { (_code), (_dst), (_src), (_off), (_imm) }
+
+#define FRAME_INDEX(__xSK, __pKBUF) \
+    (((__pKBUF)->head - (__xSK)->umem) / XSK_FRAME_SIZE)
+
+static long sys_bpf(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof *attr);
+}
+
+static int neigh_hash(uint32_t addr)
+{
+    return (addr * 2654435761u) >> 24;
+}
+
+static int find_device(ogs_xsk_t *xsk)
+{
+    struct ifaddrs *iflist = NULL, *cur = NULL;
+    struct ifreq ifr;
+
+    if (getifaddrs(&iflist) != 0) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno, "getifaddrs failed");
+        return OGS_ERROR;
+    }
+
+    for (cur = iflist; cur != NULL; cur = cur->ifa_next) {
+        ogs_sockaddr_t *addr = (ogs_sockaddr_t *)cur->ifa_addr;
+
+        if (addr && addr->ogs_sa_family == AF_INET &&
+            addr->sin.sin_addr.s_addr == xsk->addr) {
+            ogs_cpystrn(xsk->ifname, cur->ifa_name, sizeof xsk->ifname);
+            break;
+        }
+    }
+    freeifaddrs(iflist);
+
+    if (!cur)
+        return OGS_ERROR;
+
+    xsk->ifindex = if_nametoindex(xsk->ifname);
+    if (!xsk->ifindex)
+        return OGS_ERROR;
+
+    /* Frames are built with Ethernet headers */
+    memset(&ifr, 0, sizeof ifr);
+    ogs_cpystrn(ifr.ifr_name, xsk->ifname, sizeof ifr.ifr_name);
+    if (ioctl(xsk->udp_fd, SIOCGIFHWADDR, &ifr) != 0 ||
+        ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER)
+        return OGS_ERROR;
+    memcpy(xsk->mac, ifr.ifr_hwaddr.sa_data, sizeof xsk->mac);
+
+    return OGS_OK;
+}
+
+static int map_ring(ogs_xsk_t *xsk, xsk_ring_t *ring,
+        struct xdp_ring_offset *off, off_t pgoff, size_t size)
+{
+    ring->map_len = off->desc + XSK_RING_SIZE * size;
+    ring->map = mmap(NULL, ring->map_len, PROT_READ|PROT_WRITE,
+            MAP_SHARED|MAP_POPULATE, xsk->fd, pgoff);
+    if (ring->map == MAP_FAILED) {
+        ring->map = NULL;
+        return OGS_ERROR;
+    }
+
+    ring->producer = (uint32_t *)((uint8_t *)ring->map + off->producer);
+    ring->consumer = (uint32_t *)((uint8_t *)ring->map + off->consumer);
+    ring->desc = (uint8_t *)ring->map + off->desc;
+    ring->mask = XSK_RING_SIZE - 1;
+
+    return OGS_OK;
+}
+
+static int open_socket(ogs_xsk_t *xsk)
+{
+    struct xdp_umem_reg reg;
+    struct xdp_mmap_offsets off;
+    struct sockaddr_xdp sxdp;
+    socklen_t optlen;
+    size_t len;
+    int n = XSK_RING_SIZE;
+
+    ogs_pkbuf_config_t config;
+    memset(&config, 0, sizeof config);
+    config.cluster_2048_pool = XSK_NUM_OF_FRAME;
+
+    xsk->umem_pool = ogs_pkbuf_pool_create(&config);
+    ogs_assert(xsk->umem_pool);
+    xsk->umem = ogs_pkbuf_pool_cluster_mem(
+            xsk->umem_pool, XSK_FRAME_SIZE, &len);
+    ogs_assert(xsk->umem);
+    ogs_assert(((uintptr_t)xsk->umem & (sysconf(_SC_PAGESIZE) - 1)) == 0);
+
+    xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xsk->fd == INVALID_SOCKET)
+        return OGS_ERROR;
+
+    memset(&reg, 0, sizeof reg);
+    reg.addr = (uintptr_t)xsk->umem;
+    reg.len = len;
+    reg.chunk_size = XSK_FRAME_SIZE;
+    if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof reg) != 0 ||
+        setsockopt(xsk->fd, SOL_XDP,
+            XDP_UMEM_FILL_RING, &n, sizeof n) != 0 ||
+        setsockopt(xsk->fd, SOL_XDP,
+            XDP_UMEM_COMPLETION_RING, &n, sizeof n) != 0 ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &n, sizeof n) != 0 ||
+        setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &n, sizeof n) != 0)
+        return OGS_ERROR;
+
+    optlen = sizeof off;
+    if (getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) != 0)
+        return OGS_ERROR;
+
+    if (map_ring(xsk, &xsk->rx, &off.rx,
+                XDP_PGOFF_RX_RING, sizeof(struct xdp_desc)) != OGS_OK ||
+        map_ring(xsk, &xsk->tx, &off.tx,
+                XDP_PGOFF_TX_RING, sizeof(struct xdp_desc)) != OGS_OK ||
+        map_ring(xsk, &xsk->fill, &off.fr,
+                XDP_UMEM_PGOFF_FILL_RING, sizeof(uint64_t)) != OGS_OK ||
+        map_ring(xsk, &xsk->comp, &off.cr,
+                XDP_UMEM_PGOFF_COMPLETION_RING, sizeof(uint64_t)) != OGS_OK)
+        return OGS_ERROR;
+
+    /* Zero-copy if the driver can, and copy mode otherwise */
+    memset(&sxdp, 0, sizeof sxdp);
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = xsk->ifindex;
+    sxdp.sxdp_queue_id = 0;
+    if (bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof sxdp) != 0)
+        return OGS_ERROR;
+
+    return OGS_OK;
+}
+
+/*
+ * Redirects IPv4/UDP to the address and port of the socket, without
+ * IP options and fragments. The rest goes up to the kernel.
+ */
+static int load_program(ogs_xsk_t *xsk)
+{
+#define PASS 26
+    struct bpf_insn insns[] = {
+        /* r6 = ctx, r2 = data, r3 = data_end */
+        XSK_INSN(BPF_ALU64|BPF_MOV|BPF_X, BPF_REG_6, BPF_REG_1, 0, 0),
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_W, BPF_REG_2, BPF_REG_1,
+                offsetof(struct xdp_md, data), 0),
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_W, BPF_REG_3, BPF_REG_1,
+                offsetof(struct xdp_md, data_end), 0),
+        /* if (data + XSK_HLEN > data_end) goto pass */
+        XSK_INSN(BPF_ALU64|BPF_MOV|BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+        XSK_INSN(BPF_ALU64|BPF_ADD|BPF_K, BPF_REG_4, 0, 0, XSK_HLEN),
+        XSK_INSN(BPF_JMP|BPF_JGT|BPF_X, BPF_REG_4, BPF_REG_3, PASS-6, 0),
+        /* Ethernet type */
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, 12, 0),
+        XSK_INSN(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, PASS-8, htons(0x0800)),
+        /* IPv4 without options */
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, 14, 0),
+        XSK_INSN(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, PASS-10, 0x45),
+        /* UDP */
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, 23, 0),
+        XSK_INSN(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, PASS-12, IPPROTO_UDP),
+        /* Not a fragment */
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, 20, 0),
+        XSK_INSN(BPF_ALU64|BPF_AND|BPF_K, BPF_REG_5, 0, 0, htons(0x3fff)),
+        XSK_INSN(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, PASS-15, 0),
+        /* Destination address, compared in 32 bits */
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_W, BPF_REG_5, BPF_REG_2, 30, 0),
+        XSK_INSN(BPF_ALU|BPF_MOV|BPF_K, BPF_REG_7, 0, 0, xsk->addr),
+        XSK_INSN(BPF_JMP|BPF_JNE|BPF_X, BPF_REG_5, BPF_REG_7, PASS-18, 0),
+        /* Destination port */
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, 36, 0),
+        XSK_INSN(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, PASS-20, xsk->port),
+        /* return bpf_redirect_map(&map, rx_queue_index, XDP_PASS) */
+        XSK_INSN(BPF_LDX|BPF_MEM|BPF_W, BPF_REG_2, BPF_REG_6,
+                offsetof(struct xdp_md, rx_queue_index), 0),
+        XSK_INSN(BPF_LD|BPF_DW|BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, 0),
+        XSK_INSN(0, 0, 0, 0, 0),
+        XSK_INSN(BPF_ALU64|BPF_MOV|BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+        XSK_INSN(BPF_JMP|BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        XSK_INSN(BPF_JMP|BPF_EXIT, 0, 0, 0, 0),
+        /* pass: */
+        XSK_INSN(BPF_ALU64|BPF_MOV|BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+        XSK_INSN(BPF_JMP|BPF_EXIT, 0, 0, 0, 0),
+    };
+#undef PASS
+    union bpf_attr attr;
+    uint32_t key = 0;
+    int value = xsk->fd;
+
+    /* Only the first queue is bound, so the others miss and pass */
+    memset(&attr, 0, sizeof attr);
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof key;
+    attr.value_size = sizeof value;
+    attr.max_entries = 1;
+    xsk->map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+    if (xsk->map_fd < 0)
+        return OGS_ERROR;
+
+    memset(&attr, 0, sizeof attr);
+    attr.map_fd = xsk->map_fd;
+    attr.key = (uintptr_t)&key;
+    attr.value = (uintptr_t)&value;
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) != 0)
+        return OGS_ERROR;
+
+    /* The map fd is known only now */
+    insns[21].imm = xsk->map_fd;
+
+    memset(&attr, 0, sizeof attr);
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uintptr_t)insns;
+    attr.insn_cnt = OGS_ARRAY_SIZE(insns);
+    attr.license = (uintptr_t)"GPL";
+    xsk->prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+    if (xsk->prog_fd < 0)
+        return OGS_ERROR;
+
+    memset(&attr, 0, sizeof attr);
+    attr.link_create.prog_fd = xsk->prog_fd;
+    attr.link_create.target_ifindex = xsk->ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = XDP_FLAGS_DRV_MODE;
+    xsk->link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+    if (xsk->link_fd < 0) {
+        attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+        xsk->link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+    }
+    if (xsk->link_fd < 0)
+        return OGS_ERROR;
+
+    return OGS_OK;
+}
+
+ogs_xsk_t *ogs_xsk_open(ogs_sock_t *sock)
+{
+    char buf[OGS_ADDRSTRLEN];
+    ogs_xsk_t *xsk = NULL;
+    struct xdp_options opts;
+    socklen_t optlen;
+    uint32_t i;
+
+    ogs_assert(sock);
+
+    if (sock->local_addr.ogs_sa_family != AF_INET ||
+        sock->local_addr.sin.sin_addr.s_addr == INADDR_ANY) {
+        ogs_warn("AF_XDP needs an IPv4 address [%s]:%d",
+                OGS_ADDR(&sock->local_addr, buf),
+                OGS_PORT(&sock->local_addr));
+        return NULL;
+    }
+
+    xsk = ogs_calloc(1, sizeof *xsk);
+    ogs_assert(xsk);
+
+    xsk->fd = INVALID_SOCKET;
+    xsk->map_fd = xsk->prog_fd = xsk->link_fd = -1;
+    xsk->udp_fd = sock->fd;
+    xsk->addr = sock->local_addr.sin.sin_addr.s_addr;
+    xsk->port = sock->local_addr.sin.sin_port;
+
+    if (find_device(xsk) != OGS_OK) {
+        ogs_warn("No Ethernet device for AF_XDP [%s]:%d",
+                OGS_ADDR(&sock->local_addr, buf),
+                OGS_PORT(&sock->local_addr));
+        goto cleanup;
+    }
+
+    if (open_socket(xsk) != OGS_OK) {
+        ogs_log_message(OGS_LOG_WARN, ogs_socket_errno,
+                "AF_XDP socket failed on %s", xsk->ifname);
+        goto cleanup;
+    }
+
+    if (load_program(xsk) != OGS_OK) {
+        ogs_log_message(OGS_LOG_WARN, ogs_errno,
+                "XDP program failed on %s", xsk->ifname);
+        goto cleanup;
+    }
+
+    /* Every frame of the fill ring is posted for receive */
+    for (i = 0; i < XSK_RING_SIZE; i++) {
+        ogs_pkbuf_t *pkbuf = ogs_pkbuf_alloc(xsk->umem_pool, XSK_FRAME_SIZE);
+        ogs_assert(pkbuf);
+
+        xsk->frame[FRAME_INDEX(xsk, pkbuf)] = pkbuf;
+        ((uint64_t *)xsk->fill.desc)[i] = pkbuf->head - xsk->umem;
+    }
+    ogs_atomic_store(xsk->fill.producer, XSK_RING_SIZE);
+
+    ogs_thread_mutex_init(&xsk->mutex);
+    xsk->mutex_initialized = true;
+
+    memset(&opts, 0, sizeof opts);
+    optlen = sizeof opts;
+    getsockopt(xsk->fd, SOL_XDP, XDP_OPTIONS, &opts, &optlen);
+
+    ogs_info("xsk_open() [%s]:%d on %s (%s)",
+            OGS_ADDR(&sock->local_addr, buf), OGS_PORT(&sock->local_addr),
+            xsk->ifname,
+            opts.flags & XDP_OPTIONS_ZEROCOPY ? "zero-copy" : "copy mode");
+
+    return xsk;
+
+cleanup:
+    ogs_xsk_close(xsk);
+    return NULL;
+}
+
+void ogs_xsk_close(ogs_xsk_t *xsk)
+{
+    int i;
+
+    ogs_assert(xsk);
+
+    if (xsk->poll)
+        ogs_pollset_remove(xsk->poll);
+
+    /* The program is detached with its link */
+    if (xsk->link_fd >= 0)
+        close(xsk->link_fd);
+    if (xsk->prog_fd >= 0)
+        close(xsk->prog_fd);
+    if (xsk->map_fd >= 0)
+        close(xsk->map_fd);
+
+    if (xsk->rx.map) munmap(xsk->rx.map, xsk->rx.map_len);
+    if (xsk->tx.map) munmap(xsk->tx.map, xsk->tx.map_len);
+    if (xsk->fill.map) munmap(xsk->fill.map, xsk->fill.map_len);
+    if (xsk->comp.map) munmap(xsk->comp.map, xsk->comp.map_len);
+
+    if (xsk->fd != INVALID_SOCKET)
+        ogs_closesocket(xsk->fd);
+
+    for (i = 0; i < XSK_NUM_OF_FRAME; i++)
+        if (xsk->frame[i])
+            ogs_pkbuf_free(xsk->frame[i]);
+    if (xsk->umem_pool)
+        ogs_pkbuf_pool_destroy(xsk->umem_pool);
+
+    if (xsk->mutex_initialized)
+        ogs_thread_mutex_destroy(&xsk->mutex);
+
+    ogs_free(xsk);
+}
+
+/* Called with the mutex held */
+static void xsk_learn(ogs_xsk_t *xsk, uint32_t addr, const uint8_t *mac)
+{
+    xsk_neigh_t *neigh = &xsk->neigh[neigh_hash(addr)];
+
+    /* The last one seen wins a slot */
+    neigh->addr = addr;
+    memcpy(neigh->mac, mac, sizeof neigh->mac);
+}
+
+/* Returns the UDP payload, or NULL if the frame is not for the socket */
+static uint8_t *xsk_parse(ogs_xsk_t *xsk,
+        uint8_t *frame, uint32_t len, ogs_sockaddr_t *from, int *plen)
+{
+    uint8_t *ip = frame + XSK_ETH_HLEN;
+    uint8_t *udp = ip + XSK_IPV4_HLEN;
+    uint16_t ulen;
+
+    if (len < XSK_HLEN || ip[0] != 0x45 || ip[9] != IPPROTO_UDP)
+        return NULL;
+
+    memcpy(&ulen, udp + 4, sizeof ulen);
+    ulen = ntohs(ulen);
+    if (ulen < XSK_UDP_HLEN || ulen > len - XSK_ETH_HLEN - XSK_IPV4_HLEN)
+        return NULL;
+
+    memset(from, 0, sizeof *from);
+    from->sin.sin_family = AF_INET;
+    memcpy(&from->sin.sin_addr, ip + 12, sizeof from->sin.sin_addr);
+    memcpy(&from->sin.sin_port, udp, sizeof from->sin.sin_port);
+
+    *plen = ulen - XSK_UDP_HLEN;
+    return udp + XSK_UDP_HLEN;
+}
+
+static void xsk_recv(short when, ogs_socket_t fd, void *data)
+{
+    ogs_xsk_t *xsk = data;
+    struct xdp_desc *desc = NULL;
+    uint32_t cons, prod, fill;
+    int i, n, count = 0;
+
+    ogs_assert(xsk);
+
+    cons = *xsk->rx.consumer;
+    prod = ogs_atomic_load(xsk->rx.producer);
+    n = ogs_min(prod - cons, XSK_RX_BURST);
+    if (!n)
+        return;
+
+    fill = *xsk->fill.producer;
+    for (i = 0; i < n; i++) {
+        ogs_pkbuf_t *posted = NULL;
+        uint8_t *payload = NULL;
+        int plen = 0;
+
+        desc = &((struct xdp_desc *)xsk->rx.desc)[(cons + i) & xsk->rx.mask];
+        posted = xsk->frame[desc->addr / XSK_FRAME_SIZE];
+        ogs_assert(posted);
+
+        payload = xsk_parse(xsk, xsk->umem + desc->addr, desc->len,
+                &xsk->from[count], &plen);
+        if (payload) {
+            ogs_pkbuf_t *pkbuf = ogs_pkbuf_alloc(
+                    xsk->pool, xsk->headroom + plen);
+            ogs_assert(pkbuf);
+            ogs_pkbuf_reserve(pkbuf, xsk->headroom);
+            ogs_pkbuf_put_data(pkbuf, payload, plen);
+
+            xsk->pkbuf[count] = pkbuf;
+            xsk->from_mac[count] = xsk->umem + desc->addr + 6;
+            count++;
+        }
+
+        /* The frame is posted again, as it was taken from the fill ring */
+        ((uint64_t *)xsk->fill.desc)[fill++ & xsk->fill.mask] =
+            posted->head - xsk->umem;
+    }
+
+    /* Source MAC addresses are read before the frames are refilled */
+    ogs_thread_mutex_lock(&xsk->mutex);
+    for (i = 0; i < count; i++)
+        xsk_learn(xsk, xsk->from[i].sin.sin_addr.s_addr, xsk->from_mac[i]);
+    ogs_thread_mutex_unlock(&xsk->mutex);
+
+    ogs_atomic_store(xsk->rx.consumer, cons + n);
+    ogs_atomic_store(xsk->fill.producer, fill);
+
+    for (i = 0; i < count; i++)
+        xsk->handler(xsk->udp_fd, xsk->pkbuf[i], &xsk->from[i], xsk->data);
+    if (count)
+        xsk->handler(xsk->udp_fd, NULL, NULL, xsk->data);
+}
+
+ogs_poll_t *ogs_xsk_add_recv(ogs_pollset_t *pollset,
+        ogs_xsk_t *xsk, ogs_pkbuf_pool_t *pool, int headroom,
+        ogs_poll_recv_f handler, void *data)
+{
+    ogs_assert(pollset);
+    ogs_assert(xsk);
+    ogs_assert(handler);
+
+    xsk->pool = pool;
+    xsk->headroom = headroom;
+    xsk->handler = handler;
+    xsk->data = data;
+
+    xsk->poll = ogs_pollset_add(pollset, OGS_POLLIN, xsk->fd, xsk_recv, xsk);
+    ogs_assert(xsk->poll);
+
+    return xsk->poll;
+}
+
+/* Called with the mutex held */
+static void xsk_complete(ogs_xsk_t *xsk)
+{
+    uint32_t cons, prod;
+
+    cons = *xsk->comp.consumer;
+    prod = ogs_atomic_load(xsk->comp.producer);
+    while (cons != prod) {
+        uint64_t addr = ((uint64_t *)xsk->comp.desc)[cons & xsk->comp.mask];
+        int index = addr / XSK_FRAME_SIZE;
+
+        ogs_assert(xsk->frame[index]);
+        ogs_pkbuf_free(xsk->frame[index]);
+        xsk->frame[index] = NULL;
+        cons++;
+    }
+    ogs_atomic_store(xsk->comp.consumer, cons);
+}
+
+static uint16_t ip_cksum(const uint8_t *ip)
+{
+    uint32_t sum = 0;
+    uint16_t word;
+    int i;
+
+    for (i = 0; i < XSK_IPV4_HLEN; i += 2) {
+        memcpy(&word, ip + i, sizeof word);
+        sum += word;
+    }
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return ~sum;
+}
+
+int ogs_xsk_sendto(ogs_xsk_t *xsk,
+        ogs_pkbuf_t *pkbuf, const ogs_sockaddr_t *to)
+{
+    xsk_neigh_t *neigh = NULL;
+    struct xdp_desc *desc = NULL;
+    ogs_pkbuf_t *frame = NULL;
+    uint8_t *eth, *ip, *udp;
+    uint32_t prod;
+    uint16_t word;
+
+    ogs_assert(xsk);
+    ogs_assert(pkbuf);
+    ogs_assert(to);
+
+    if (to->ogs_sa_family != AF_INET ||
+        XSK_HLEN + pkbuf->len > XSK_FRAME_SIZE)
+        return OGS_RETRY;
+
+    ogs_thread_mutex_lock(&xsk->mutex);
+
+    xsk_complete(xsk);
+
+    neigh = &xsk->neigh[neigh_hash(to->sin.sin_addr.s_addr)];
+    prod = *xsk->tx.producer;
+    if (neigh->addr != to->sin.sin_addr.s_addr ||
+        prod - ogs_atomic_load(xsk->tx.consumer) == XSK_RING_SIZE) {
+        ogs_thread_mutex_unlock(&xsk->mutex);
+        return OGS_RETRY;
+    }
+
+    frame = ogs_pkbuf_alloc(xsk->umem_pool, XSK_FRAME_SIZE);
+    ogs_assert(frame);
+
+    eth = frame->head;
+    memcpy(eth, neigh->mac, 6);
+    memcpy(eth + 6, xsk->mac, 6);
+    word = htons(0x0800);
+    memcpy(eth + 12, &word, sizeof word);
+
+    ip = eth + XSK_ETH_HLEN;
+    ip[0] = 0x45;
+    ip[1] = 0;
+    word = htons(XSK_IPV4_HLEN + XSK_UDP_HLEN + pkbuf->len);
+    memcpy(ip + 2, &word, sizeof word);
+    memset(ip + 4, 0, 2);
+    word = htons(0x4000); /* Don't fragment */
+    memcpy(ip + 6, &word, sizeof word);
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    memset(ip + 10, 0, 2);
+    memcpy(ip + 12, &xsk->addr, 4);
+    memcpy(ip + 16, &to->sin.sin_addr, 4);
+    word = ip_cksum(ip);
+    memcpy(ip + 10, &word, sizeof word);
+
+    /* No UDP checksum over IPv4 */
+    udp = ip + XSK_IPV4_HLEN;
+    memcpy(udp, &xsk->port, 2);
+    memcpy(udp + 2, &to->sin.sin_port, 2);
+    word = htons(XSK_UDP_HLEN + pkbuf->len);
+    memcpy(udp + 4, &word, sizeof word);
+    memset(udp + 6, 0, 2);
+
+    memcpy(udp + XSK_UDP_HLEN, pkbuf->data, pkbuf->len);
+
+    desc = &((struct xdp_desc *)xsk->tx.desc)[prod & xsk->tx.mask];
+    desc->addr = frame->head - xsk->umem;
+    desc->len = XSK_HLEN + pkbuf->len;
+    desc->options = 0;
+    xsk->frame[FRAME_INDEX(xsk, frame)] = frame;
+
+    ogs_atomic_store(xsk->tx.producer, prod + 1);
+    xsk->tx_pending++;
+
+    ogs_thread_mutex_unlock(&xsk->mutex);
+
+    return OGS_OK;
+}
+
+void ogs_xsk_flush(ogs_xsk_t *xsk)
+{
+    int pending;
+
+    ogs_assert(xsk);
+
+    ogs_thread_mutex_lock(&xsk->mutex);
+    pending = xsk->tx_pending;
+    xsk->tx_pending = 0;
+    ogs_thread_mutex_unlock(&xsk->mutex);
+
+    if (!pending)
+        return;
+
+    /* The copy mode sends only in this system call */
+    if (sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+        errno != EAGAIN && errno != EBUSY && errno != ENOBUFS &&
+        errno != ENETDOWN)
+        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                "sendto(AF_XDP) failed");
+}
+
+#else /* HAVE_AF_XDP */
+
+ogs_xsk_t *ogs_xsk_open(ogs_sock_t *sock)
+{
+    ogs_warn("AF_XDP is not supported");
+    return NULL;
+}
+
+void ogs_xsk_close(ogs_xsk_t *xsk)
+{
+    ogs_assert_if_reached();
+}
+
+ogs_poll_t *ogs_xsk_add_recv(ogs_pollset_t *pollset,
+        ogs_xsk_t *xsk, ogs_pkbuf_pool_t *pool, int headroom,
+        ogs_poll_recv_f handler, void *data)
+{
+    ogs_assert_if_reached();
+    return NULL;
+}
+
+int ogs_xsk_sendto(ogs_xsk_t *xsk,
+        ogs_pkbuf_t *pkbuf, const ogs_sockaddr_t *to)
+{
+    ogs_assert_if_reached();
+    return OGS_ERROR;
+}
+
+void ogs_xsk_flush(ogs_xsk_t *xsk)
+{
+    ogs_assert_if_reached();
+}
+
+#endif /* HAVE_AF_XDP */
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(OGS_CORE_INSIDE) && !defined(OGS_CORE_COMPILATION)
+#error "This header cannot be included directly."
+#endif
+
+#ifndef OGS_XSK_H
+#define OGS_XSK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * AF_XDP socket beside a UDP server socket (Linux only)
+ *
+ * An XDP program on the device with the address of the UDP socket
+ * redirects the IPv4 datagrams to that address and port into the
+ * AF_XDP socket bound to the first queue. Everything else, including
+ * the other queues, still reaches the UDP socket.
+ *
+ * The UMEM is the memory of the 2048-byte clusters of a pkbuf pool,
+ * so every frame is a pkbuf. The driver mode is preferred, and the copy
+ * mode of the generic XDP is used otherwise, e.g. on veth.
+ */
+typedef struct ogs_xsk_s ogs_xsk_t;
+
+/* NULL if AF_XDP cannot be used, so the UDP socket is used alone */
+ogs_xsk_t *ogs_xsk_open(ogs_sock_t *sock);
+void ogs_xsk_close(ogs_xsk_t *xsk);
+
+/*
+ * Each datagram is copied into the best-fit cluster of the pool, and its
+ * frame goes back to the device at once. The handler is called with
+ * the fd of the UDP socket, as in ogs_pollset_add_recv().
+ */
+ogs_poll_t *ogs_xsk_add_recv(ogs_pollset_t *pollset,
+        ogs_xsk_t *xsk, ogs_pkbuf_pool_t *pool, int headroom,
+        ogs_poll_recv_f handler, void *data);
+
+/*
+ * Queues a copy of the datagram, which is sent by ogs_xsk_flush().
+ * Any thread may call them. OGS_RETRY if the MAC address of the peer
+ * has not been seen yet or the ring is full, so the caller has to send
+ * it on the UDP socket.
+ */
+int ogs_xsk_sendto(ogs_xsk_t *xsk,
+        ogs_pkbuf_t *pkbuf, const ogs_sockaddr_t *to);
+void ogs_xsk_flush(ogs_xsk_t *xsk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OGS_XSK_H */
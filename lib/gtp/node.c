@@ -48,6 +48,8 @@ ogs_gtp_node_t *ogs_gtp_node_new(ogs_sockaddr_t *sa_list)
 
     ogs_list_init(&node->local_list);
     ogs_list_init(&node->remote_list);
+    node->local_hash = ogs_ohash_create(sizeof(uint32_t));
+    node->remote_hash = ogs_ohash_create(sizeof(uint32_t));
 
     return node;
 }
@@ -60,6 +62,8 @@ void ogs_gtp_node_free(ogs_gtp_node_t *node)
         ogs_sock_destroy(node->sock);
 
     ogs_gtp_xact_delete_all(node);
+    ogs_ohash_destroy(node->local_hash);
+    ogs_ohash_destroy(node->remote_hash);
 
     ogs_freeaddrinfo(node->sa_list);
     ogs_pool_free(&pool, node);
@@ -46,9 +46,12 @@ typedef struct ogs_gtp_node_s {
     ogs_sock_t      *sock;          /* Socket Instance */
     ogs_ip_t        ip;             /* Socket Address */
     ogs_sockaddr_t  remote_addr;    /* Connected Address */
+    ogs_shmring_t   *shm;           /* GTP-U to a co-located peer */
 
     ogs_list_t      local_list;    
     ogs_list_t      remote_list;   
+    ogs_ohash_t     *local_hash;    /* Local transactions by XID */
+    ogs_ohash_t     *remote_hash;   /* Remote transactions by XID */
 } ogs_gtp_node_t;
 
 int ogs_gtp_node_init(int size);
@@ -19,6 +19,10 @@
 
 #include "ogs-gtp.h"
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
+
 ogs_sock_t *ogs_gtp_server(ogs_socknode_t *node)
 {
     char buf[OGS_ADDRSTRLEN];
@@ -34,6 +38,74 @@ ogs_sock_t *ogs_gtp_server(ogs_socknode_t *node)
     return gtp;
 }
 
+/*
+ * GTP-U server with UDP GRO, so a burst from the same peer is received
+ * at once. The pollset splits it again for ogs_pollset_add_recv().
+ */
+ogs_sock_t *ogs_gtpu_server(ogs_socknode_t *node)
+{
+    ogs_sock_t *gtp;
+
+    gtp = ogs_gtp_server(node);
+    ogs_assert(gtp);
+
+    if (ogs_udp_set_gro(gtp->fd) != OGS_OK)
+        ogs_warn("UDP GRO not supported");
+
+    /* Probed here before the user-plane threads send */
+    if (!ogs_udp_gso_supported())
+        ogs_warn("UDP GSO not supported");
+
+    /* The AF_XDP socket is bound to one queue, not one of many sockets */
+    if (ogs_core()->socket.xdp && !node->option.reuse_port)
+        gtp->xsk = ogs_xsk_open(gtp);
+
+    return gtp;
+}
+
+/*
+ * Spread GTP-U among the sockets bound to the same address with
+ * SO_REUSEPORT by TEID, so every packet of a tunnel reaches the same
+ * socket. The classic BPF program sees the UDP payload and returns
+ * the index of the socket in the order they were bound.
+ */
+int ogs_gtpu_steer_by_teid(ogs_sock_t *sock, int num_of_sock)
+{
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+    int rc;
+    struct sock_filter code[] = {
+        /* A = TEID in GTPv1-U header */
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 4),
+        /* A = A % num_of_sock */
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, 0),
+        /* Return the index of the socket */
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog;
+
+    ogs_assert(sock);
+    ogs_assert(num_of_sock > 0);
+
+    code[1].k = num_of_sock;
+
+    memset(&prog, 0, sizeof prog);
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+
+    rc = setsockopt(sock->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+            &prog, sizeof prog);
+    if (rc != 0) {
+        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                "setsockopt(SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF) failed");
+        return OGS_ERROR;
+    }
+
+    return OGS_OK;
+#else
+    return OGS_ERROR;
+#endif
+}
+
 int ogs_gtp_connect(ogs_sock_t *ipv4, ogs_sock_t *ipv6, ogs_gtp_node_t *gnode)
 {
     ogs_sockaddr_t *addr;
@@ -76,6 +148,66 @@ int ogs_gtp_connect(ogs_sock_t *ipv4, ogs_sock_t *ipv6, ogs_gtp_node_t *gnode)
     return OGS_OK;
 }
 
+ogs_shmring_t *ogs_gtp_open_shm(const char *name, const char *dir)
+{
+    char path[OGS_MAX_FILEPATH_LEN];
+
+    ogs_assert(name);
+    ogs_assert(dir);
+
+    ogs_snprintf(path, sizeof path, "%s.%s", name, dir);
+    return ogs_shmring_open(path,
+            OGS_GTPU_SHM_NUM_OF_SLOT, OGS_GTPU_SHM_SLOT_SIZE);
+}
+
+/* The addresses of the GTP-U servers are published to the producer */
+int ogs_gtp_listen_shm(
+        ogs_shmring_t *ring, ogs_list_t *list, ogs_list_t *list6)
+{
+    ogs_socknode_t *node = NULL;
+    ogs_sockaddr_t *sa_list = NULL, **tail = &sa_list;
+    int rv;
+
+    ogs_assert(ring);
+    ogs_assert(list);
+    ogs_assert(list6);
+
+    ogs_list_for_each(list, node) {
+        rv = ogs_copyaddrinfo(tail, node->addr);
+        ogs_assert(rv == OGS_OK);
+        while (*tail)
+            tail = &(*tail)->next;
+    }
+    ogs_list_for_each(list6, node) {
+        rv = ogs_copyaddrinfo(tail, node->addr);
+        ogs_assert(rv == OGS_OK);
+        while (*tail)
+            tail = &(*tail)->next;
+    }
+
+    rv = ogs_shmring_listen(ring, sa_list);
+    ogs_freeaddrinfo(sa_list);
+
+    return rv;
+}
+
+void ogs_gtp_connect_shm(ogs_gtp_node_t *gnode, ogs_shmring_t *ring)
+{
+    char buf[OGS_ADDRSTRLEN];
+
+    ogs_assert(gnode);
+
+    if (!ring || gnode->shm)
+        return;
+
+    if (ogs_shmring_reaches(ring, &gnode->remote_addr)) {
+        gnode->shm = ring;
+        ogs_info("gtp_connect() [%s]:%d through shared memory",
+                OGS_ADDR(&gnode->remote_addr, buf),
+                OGS_PORT(&gnode->remote_addr));
+    }
+}
+
 ogs_sock_t *ogs_gtp_local_sock_first(ogs_list_t *list)
 {
     ogs_socknode_t *snode = NULL;
@@ -136,6 +268,11 @@ int ogs_gtp_sendto(ogs_gtp_node_t *gnode, ogs_pkbuf_t *pkbuf)
     addr = &gnode->remote_addr;
     ogs_assert(addr);
 
+    if (sock->xsk && ogs_xsk_sendto(sock->xsk, pkbuf, addr) == OGS_OK) {
+        ogs_xsk_flush(sock->xsk);
+        return OGS_OK;
+    }
+
     sent = ogs_sendto(sock->fd, pkbuf->data, pkbuf->len, 0, addr);
     if (sent < 0 || sent != pkbuf->len) {
         ogs_error("ogs_send() failed");
@@ -145,6 +282,122 @@ int ogs_gtp_sendto(ogs_gtp_node_t *gnode, ogs_pkbuf_t *pkbuf)
     return OGS_OK;
 }
 
+/* The batch takes ownership of pkbuf, which is freed once it is sent */
+int ogs_gtp_batch_sendto(ogs_gtp_batch_t *batch,
+        ogs_gtp_node_t *gnode, ogs_pkbuf_t *pkbuf)
+{
+    int rv = OGS_OK;
+
+    ogs_assert(batch);
+    ogs_assert(gnode);
+    ogs_assert(gnode->sock);
+    ogs_assert(pkbuf);
+
+    if (gnode->shm) {
+        if (batch->shm && batch->shm != gnode->shm)
+            ogs_shmring_notify(batch->shm);
+
+        if (ogs_shmring_push(gnode->shm, pkbuf->data, pkbuf->len) == OGS_OK) {
+            batch->shm = gnode->shm;
+            ogs_pkbuf_free(pkbuf);
+            return OGS_OK;
+        }
+    }
+
+    if (gnode->sock->xsk) {
+        if (batch->xsk && batch->xsk != gnode->sock->xsk)
+            ogs_xsk_flush(batch->xsk);
+
+        if (ogs_xsk_sendto(gnode->sock->xsk,
+                    pkbuf, &gnode->remote_addr) == OGS_OK) {
+            batch->xsk = gnode->sock->xsk;
+            ogs_pkbuf_free(pkbuf);
+            return OGS_OK;
+        }
+    }
+
+    if (batch->num_of_pkbuf == OGS_UDP_MAX_BATCH ||
+        (batch->num_of_pkbuf && batch->sock != gnode->sock))
+        rv = ogs_gtp_batch_flush(batch);
+
+    batch->sock = gnode->sock;
+    batch->pkbuf[batch->num_of_pkbuf] = pkbuf;
+    batch->addr[batch->num_of_pkbuf] = &gnode->remote_addr;
+    batch->num_of_pkbuf++;
+
+    return rv;
+}
+
+/*
+ * Move the packets to the same gnode next to each other, so that
+ * they can be coalesced. The order to each gnode is kept.
+ */
+static void batch_group_by_gnode(ogs_gtp_batch_t *batch)
+{
+    int i, j, k;
+
+    for (i = 0; i < batch->num_of_pkbuf; i = j) {
+        ogs_sockaddr_t *addr = batch->addr[i];
+
+        j = i + 1;
+        for (k = j; k < batch->num_of_pkbuf; k++) {
+            ogs_pkbuf_t *pkbuf = NULL;
+            int l;
+
+            if (batch->addr[k] != addr)
+                continue;
+
+            pkbuf = batch->pkbuf[k];
+            for (l = k; l > j; l--) {
+                batch->pkbuf[l] = batch->pkbuf[l-1];
+                batch->addr[l] = batch->addr[l-1];
+            }
+            batch->pkbuf[j] = pkbuf;
+            batch->addr[j] = addr;
+            j++;
+        }
+    }
+}
+
+int ogs_gtp_batch_flush(ogs_gtp_batch_t *batch)
+{
+    int i, sent;
+
+    ogs_assert(batch);
+
+    if (batch->shm) {
+        ogs_shmring_notify(batch->shm);
+        batch->shm = NULL;
+    }
+
+    if (batch->xsk) {
+        ogs_xsk_flush(batch->xsk);
+        batch->xsk = NULL;
+    }
+
+    if (!batch->num_of_pkbuf)
+        return OGS_OK;
+
+    ogs_assert(batch->sock);
+
+    if (!batch->no_gso)
+        batch_group_by_gnode(batch);
+
+    sent = ogs_udp_sendto_gso_batch(batch->sock->fd,
+            batch->pkbuf, batch->addr, batch->num_of_pkbuf, &batch->no_gso);
+    if (sent != batch->num_of_pkbuf)
+        ogs_error("ogs_udp_sendto_gso_batch() failed [%d/%d]",
+                sent, batch->num_of_pkbuf);
+
+    for (i = 0; i < batch->num_of_pkbuf; i++)
+        ogs_pkbuf_free(batch->pkbuf[i]);
+
+    batch->num_of_pkbuf = 0;
+    batch->sock = NULL;
+
+    return sent == i ? OGS_OK : OGS_ERROR;
+}
+
 ogs_pkbuf_t *ogs_gtp_handle_echo_req(ogs_pkbuf_t *pkb)
 {
     ogs_gtp_header_t *gtph = NULL;
@@ -31,14 +31,60 @@ extern "C" {
 typedef struct ogs_gtp_xact_s ogs_gtp_xact_t;
 
 ogs_sock_t *ogs_gtp_server(ogs_socknode_t *node);
+ogs_sock_t *ogs_gtpu_server(ogs_socknode_t *node);
+int ogs_gtpu_steer_by_teid(ogs_sock_t *sock, int num_of_sock);
 int ogs_gtp_connect(ogs_sock_t *ipv4, ogs_sock_t *ipv6, ogs_gtp_node_t *gnode);
 
+/*
+ * G-PDUs to a peer on the same host can be handed off through
+ * a shared-memory ring instead of the loopback. The ring is used
+ * only when its consumer listens on the address of gnode.
+ */
+#define OGS_GTPU_SHM_NUM_OF_SLOT    4096
+#define OGS_GTPU_SHM_SLOT_SIZE      2048
+
+/* Ring 'name.dir', e.g. "/open5gs-s5u.ul" for the uplink */
+ogs_shmring_t *ogs_gtp_open_shm(const char *name, const char *dir);
+int ogs_gtp_listen_shm(
+        ogs_shmring_t *ring, ogs_list_t *list, ogs_list_t *list6);
+void ogs_gtp_connect_shm(ogs_gtp_node_t *gnode, ogs_shmring_t *ring);
+
 ogs_sock_t *ogs_gtp_local_sock_first(ogs_list_t *list);
 ogs_sockaddr_t *ogs_gtp_local_addr_first(ogs_list_t *list);
 
 int ogs_gtp_send(ogs_gtp_node_t *gnode, ogs_pkbuf_t *pkbuf);
 int ogs_gtp_sendto(ogs_gtp_node_t *gnode, ogs_pkbuf_t *pkbuf);
 
+/*
+ * Egress queue of one thread, flushed with a single
+ * ogs_udp_sendto_gso_batch() per socket. The packets to the same gnode
+ * are sent as one UDP GSO aggregate while they have the same size.
+ * The queued gnodes must stay alive until the flush.
+ *
+ * The packets to a gnode with a shared-memory ring are pushed at once,
+ * and the consumer is woken up by the flush. If the ring is full or
+ * its consumer is gone, they are sent over UDP instead. The same goes for a socket with
+ * AF_XDP, whose queued frames are sent by the flush.
+ *
+ * The packets of a gnode may therefore arrive out of order: those sent
+ * over UDP while the ring is full can overtake those still queued in
+ * the ring. GTP-U does not promise the order, and TCP recovers from it.
+ */
+typedef struct ogs_gtp_batch_s {
+    ogs_sock_t      *sock;
+    ogs_shmring_t   *shm;       /* Ring to be notified on flush */
+    ogs_xsk_t       *xsk;       /* AF_XDP socket to be flushed */
+    int             num_of_pkbuf;
+    ogs_pkbuf_t     *pkbuf[OGS_UDP_MAX_BATCH];
+    ogs_sockaddr_t  *addr[OGS_UDP_MAX_BATCH];
+
+    bool            no_gso;     /* Set once the egress device refused it */
+} ogs_gtp_batch_t;
+
+int ogs_gtp_batch_sendto(ogs_gtp_batch_t *batch,
+        ogs_gtp_node_t *gnode, ogs_pkbuf_t *pkbuf);
+int ogs_gtp_batch_flush(ogs_gtp_batch_t *batch);
+
 ogs_pkbuf_t *ogs_gtp_handle_echo_req(ogs_pkbuf_t *pkt);
 void ogs_gtp_send_error_message(
         ogs_gtp_xact_t *xact, uint32_t teid, uint8_t type, uint8_t cause_value);
@@ -40,6 +40,7 @@ static ogs_timer_mgr_t *g_timer_mgr = NULL;
 static uint32_t g_xact_id = 0;
 
 static OGS_POOL(pool, ogs_gtp_xact_t);
+static ogs_gtp_xact_stat_t xact_stat;
 
 static ogs_gtp_xact_stage_t ogs_gtp_xact_get_stage(uint8_t type, uint32_t sqn);
 static int ogs_gtp_xact_delete(ogs_gtp_xact_t *xact);
@@ -47,11 +48,54 @@ static int ogs_gtp_xact_delete(ogs_gtp_xact_t *xact);
 static void response_timeout(void *data);
 static void holding_timeout(void *data);
 
+static ogs_ohash_t *xact_hash(ogs_gtp_xact_t *xact)
+{
+    ogs_assert(xact);
+    ogs_assert(xact->gnode);
+
+    return xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
+            xact->gnode->local_hash : xact->gnode->remote_hash;
+}
+
+static void xact_link(ogs_gtp_xact_t *xact)
+{
+    ogs_ohash_t *hash = xact_hash(xact);
+    ogs_assert(hash);
+
+    ogs_list_add(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?  
+            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+
+    ogs_ohash_set_u32(hash, xact->xid, xact);
+
+    if (xact->org == OGS_GTP_LOCAL_ORIGINATOR)
+        xact_stat.local++;
+    else
+        xact_stat.remote++;
+}
+
+static void xact_unlink(ogs_gtp_xact_t *xact)
+{
+    ogs_ohash_t *hash = xact_hash(xact);
+    ogs_assert(hash);
+
+    ogs_list_remove(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
+            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+
+    if (ogs_ohash_get_u32(hash, xact->xid) == xact)
+        ogs_ohash_set_u32(hash, xact->xid, NULL);
+
+    if (xact->org == OGS_GTP_LOCAL_ORIGINATOR)
+        xact_stat.local--;
+    else
+        xact_stat.remote--;
+}
+
 int ogs_gtp_xact_init(ogs_timer_mgr_t *timer_mgr, int size)
 {
     ogs_assert(ogs_gtp_xact_initialized == 0);
 
-    ogs_pool_init(&pool, size);
+    ogs_pool_init_segmented(&pool, OGS_POOL_CHUNK_SIZE(size), size);
+    memset(&xact_stat, 0, sizeof xact_stat);
 
     g_xact_id = 0;
     g_timer_mgr = timer_mgr;
@@ -83,7 +127,12 @@ ogs_gtp_xact_t *ogs_gtp_xact_local_create(ogs_gtp_node_t *gnode,
     ogs_assert(gnode);
 
     ogs_pool_alloc(&pool, &xact);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited("GTP transaction pool exhausted [%d]",
+                ogs_pool_size(&pool));
+        xact_stat.exhausted++;
+        return NULL;
+    }
     memset(xact, 0, sizeof *xact);
     xact->index = ogs_pool_index(&pool, xact);
 
@@ -101,8 +150,7 @@ ogs_gtp_xact_t *ogs_gtp_xact_local_create(ogs_gtp_node_t *gnode,
     ogs_assert(xact->tm_holding);
     xact->holding_rcount = GTP_T3_DUPLICATED_RETRY_COUNT;
 
-    ogs_list_add(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?  
-            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+    xact_link(xact);
 
     rv = ogs_gtp_xact_update_tx(xact, hdesc, pkbuf);
     ogs_assert(rv == OGS_OK);
@@ -124,7 +172,12 @@ ogs_gtp_xact_t *ogs_gtp_xact_remote_create(ogs_gtp_node_t *gnode, uint32_t sqn)
     ogs_assert(gnode);
 
     ogs_pool_alloc(&pool, &xact);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited("GTP transaction pool exhausted [%d]",
+                ogs_pool_size(&pool));
+        xact_stat.exhausted++;
+        return NULL;
+    }
     memset(xact, 0, sizeof *xact);
     xact->index = ogs_pool_index(&pool, xact);
 
@@ -140,8 +193,7 @@ ogs_gtp_xact_t *ogs_gtp_xact_remote_create(ogs_gtp_node_t *gnode, uint32_t sqn)
     ogs_assert(xact->tm_holding);
     xact->holding_rcount = GTP_T3_DUPLICATED_RETRY_COUNT;
 
-    ogs_list_add(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?  
-            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+    xact_link(xact);
 
     ogs_debug("[%d] %s Create  peer [%s]:%d",
             xact->xid,
@@ -504,6 +556,8 @@ static void response_timeout(void *data)
         pkbuf = xact->seq[xact->step-1].pkbuf;
         ogs_assert(pkbuf);
 
+        xact_stat.retransmitted++;
+
         if (ogs_gtp_sendto(xact->gnode, pkbuf) != OGS_OK) {
             ogs_error("ogs_gtp_sendto() failed");
             goto out;
@@ -517,6 +571,8 @@ static void response_timeout(void *data)
                 OGS_ADDR(&xact->gnode->remote_addr, buf),
                 OGS_PORT(&xact->gnode->remote_addr));
 
+        xact_stat.timedout++;
+
         if (xact->cb)
             xact->cb(xact, xact->data);
 
@@ -574,7 +630,10 @@ int ogs_gtp_xact_receive(
     new = ogs_gtp_xact_find_by_xid(gnode, h->type, OGS_GTP_SQN_TO_XID(h->sqn));
     if (!new)
         new = ogs_gtp_xact_remote_create(gnode, h->sqn);
-    ogs_assert(new);
+    if (!new) {
+        /* Drop it. The peer will retransmit the request */
+        return OGS_ERROR;
+    }
 
     ogs_debug("[%d] %s Receive peer [%s]:%d",
             new->xid,
@@ -597,6 +656,17 @@ ogs_gtp_xact_t *ogs_gtp_xact_find(ogs_index_t index)
     return ogs_pool_find(&pool, index);
 }
 
+void ogs_gtp_xact_stat(ogs_gtp_xact_stat_t *stat)
+{
+    ogs_assert(stat);
+
+    memcpy(stat, &xact_stat, sizeof *stat);
+    stat->size = ogs_pool_size(&pool);
+    stat->avail = ogs_pool_avail(&pool);
+    stat->max = ogs_pool_max(&pool);
+    stat->hwm = ogs_pool_hwm(&pool);
+}
+
 static ogs_gtp_xact_stage_t ogs_gtp_xact_get_stage(uint8_t type, uint32_t xid)
 {
     ogs_gtp_xact_stage_t stage = GTP_XACT_UNKNOWN_STAGE;
@@ -651,39 +721,37 @@ ogs_gtp_xact_t *ogs_gtp_xact_find_by_xid(
 {
     char buf[OGS_ADDRSTRLEN];
 
-    ogs_list_t *list = NULL;
+    ogs_ohash_t *hash = NULL;
     ogs_gtp_xact_t *xact = NULL;
 
     ogs_assert(gnode);
 
     switch (ogs_gtp_xact_get_stage(type, xid)) {
     case GTP_XACT_INITIAL_STAGE:
-        list = &gnode->remote_list;
+        hash = gnode->remote_hash;
         break;
     case GTP_XACT_INTERMEDIATE_STAGE:
-        list = &gnode->local_list;
+        hash = gnode->local_hash;
         break;
     case GTP_XACT_FINAL_STAGE:
         if (xid & GTP_MAX_XACT_ID)
-            list = &gnode->remote_list;
+            hash = gnode->remote_hash;
         else
-            list = &gnode->local_list;
+            hash = gnode->local_hash;
         break;
     default:
         ogs_assert_if_reached();
         break;
     }
 
-    ogs_assert(list);
-    ogs_list_for_each(list, xact) {
-        if (xact->xid == xid) {
-            ogs_debug("[%d] %s Find    peer [%s]:%d",
-                    xact->xid,
-                    xact->org == OGS_GTP_LOCAL_ORIGINATOR ? "LOCAL " : "REMOTE",
-                    OGS_ADDR(&gnode->remote_addr, buf),
-                    OGS_PORT(&gnode->remote_addr));
-            break;
-        }
+    ogs_assert(hash);
+    xact = ogs_ohash_get_u32(hash, xid);
+    if (xact) {
+        ogs_debug("[%d] %s Find    peer [%s]:%d",
+                xact->xid,
+                xact->org == OGS_GTP_LOCAL_ORIGINATOR ? "LOCAL " : "REMOTE",
+                OGS_ADDR(&gnode->remote_addr, buf),
+                OGS_PORT(&gnode->remote_addr));
     }
 
     return xact;
@@ -741,8 +809,7 @@ static int ogs_gtp_xact_delete(ogs_gtp_xact_t *xact)
     if (xact->assoc_xact)
         ogs_gtp_xact_deassociate(xact, xact->assoc_xact);
 
-    ogs_list_remove(xact->org == OGS_GTP_LOCAL_ORIGINATOR ?
-            &xact->gnode->local_list : &xact->gnode->remote_list, xact);
+    xact_unlink(xact);
     ogs_pool_free(&pool, xact);
 
     return OGS_OK;
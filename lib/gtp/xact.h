@@ -63,6 +63,20 @@ typedef struct ogs_gtp_xact_s {
     struct ogs_gtp_xact_s *assoc_xact; /**< Associated transaction */
 } ogs_gtp_xact_t;
 
+typedef struct ogs_gtp_xact_stat_s {
+    int             size;           /**< Size of transaction pool */
+    int             avail;          /**< Available transactions in pool */
+    int             max;            /**< Size the pool may grow to */
+    int             hwm;            /**< Most transactions ever in use */
+
+    int             local;          /**< Outstanding local transactions */
+    int             remote;         /**< Outstanding remote transactions */
+
+    uint64_t        retransmitted;  /**< Requests retransmitted on T3 */
+    uint64_t        timedout;       /**< Transactions given up on T3 */
+    uint64_t        exhausted;      /**< Allocations failed on empty pool */
+} ogs_gtp_xact_stat_t;
+
 int ogs_gtp_xact_init(ogs_timer_mgr_t *timer_mgr, int size);
 int ogs_gtp_xact_final(void);
 
@@ -83,6 +97,7 @@ int ogs_gtp_xact_receive(ogs_gtp_node_t *gnode,
         ogs_gtp_header_t *h, ogs_gtp_xact_t **xact);
 
 ogs_gtp_xact_t *ogs_gtp_xact_find(ogs_index_t index);
+void ogs_gtp_xact_stat(ogs_gtp_xact_stat_t *stat);
 ogs_gtp_xact_t *ogs_gtp_xact_find_by_xid(
         ogs_gtp_node_t *gnode, uint8_t type, uint32_t xid);
 void ogs_gtp_xact_associate(ogs_gtp_xact_t *xact1, ogs_gtp_xact_t *xact2);
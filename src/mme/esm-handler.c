@@ -99,7 +99,13 @@ int esm_handle_pdn_connectivity_request(mme_bearer_t *bearer,
     if (sess->pdn) {
         ogs_debug("    APN[%s]", sess->pdn->apn);
         rv = mme_gtp_send_create_session_request(sess);
-        ogs_assert(rv == OGS_OK);
+        if (rv != OGS_OK) {
+            rv = nas_send_pdn_connectivity_reject(
+                    sess, ESM_CAUSE_NETWORK_FAILURE);
+            ogs_assert(rv == OGS_OK);
+
+            return OGS_ERROR;
+        }
     } else {
         rv = nas_send_pdn_connectivity_reject(
                 sess, ESM_CAUSE_MISSING_OR_UNKNOWN_APN);
@@ -148,7 +154,13 @@ int esm_handle_information_response(mme_sess_t *sess,
             }
         } else {
             rv = mme_gtp_send_create_session_request(sess);
-            ogs_assert(rv == OGS_OK);
+            if (rv != OGS_OK) {
+                rv = nas_send_pdn_connectivity_reject(
+                        sess, ESM_CAUSE_NETWORK_FAILURE);
+                ogs_assert(rv == OGS_OK);
+
+                return OGS_ERROR;
+            }
         }
     } else {
         rv = nas_send_pdn_connectivity_reject(
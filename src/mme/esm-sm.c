@@ -111,7 +111,7 @@ void esm_state_inactive(ogs_fsm_t *s, mme_event_t *e)
              *          E-RAB Setup Response is received */
             if (MME_HAVE_ENB_S1U_PATH(bearer)) {
                 rv = mme_gtp_send_modify_bearer_request(bearer, 0);
-                ogs_assert(rv == OGS_OK);
+                ogs_expect(rv == OGS_OK);
             }
 
             rv = nas_send_activate_all_dedicated_bearers(bearer);
@@ -217,7 +217,7 @@ void esm_state_active(ogs_fsm_t *s, mme_event_t *e)
                     mme_ue->imsi_bcd, sess->pti, bearer->ebi);
             if (MME_HAVE_SGW_S1U_PATH(sess)) {
                 rv = mme_gtp_send_delete_session_request(sess);
-                ogs_assert(rv == OGS_OK);
+                ogs_expect(rv == OGS_OK);
             } else {
                 rv = nas_send_deactivate_bearer_context_request(bearer);
                 ogs_assert(rv == OGS_OK);
@@ -126,17 +126,25 @@ void mme_context_init()
 
     ogs_pool_init(&mme_enb_pool, ogs_config()->max.enb);
 
-    ogs_pool_init(&mme_ue_pool, ogs_config()->pool.ue);
-    ogs_pool_init(&enb_ue_pool, ogs_config()->pool.ue);
-    ogs_pool_init(&mme_sess_pool, ogs_config()->pool.sess);
-    ogs_pool_init(&mme_bearer_pool, ogs_config()->pool.bearer);
+    ogs_pool_init_segmented(&mme_ue_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.ue),
+            ogs_config()->pool.ue);
+    ogs_pool_init_segmented(&enb_ue_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.ue),
+            ogs_config()->pool.ue);
+    ogs_pool_init_segmented(&mme_sess_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.sess),
+            ogs_config()->pool.sess);
+    ogs_pool_init_segmented(&mme_bearer_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.bearer),
+            ogs_config()->pool.bearer);
     ogs_pool_init(&self.m_tmsi, ogs_config()->pool.ue);
 
     self.enb_addr_hash = ogs_hash_make();
-    self.enb_id_hash = ogs_hash_make();
-    self.mme_ue_s1ap_id_hash = ogs_hash_make();
-    self.imsi_ue_hash = ogs_hash_make();
-    self.guti_ue_hash = ogs_hash_make();
+    self.enb_id_hash = ogs_ohash_create(sizeof(uint32_t));
+    self.mme_ue_s1ap_id_hash = ogs_ohash_create(sizeof(uint32_t));
+    self.imsi_ue_hash = ogs_hash_make_incremental();
+    self.guti_ue_hash = ogs_ohash_create(sizeof(ogs_nas_guti_t));
 
     ogs_list_init(&self.mme_ue_list);
 
@@ -158,14 +166,14 @@ void mme_context_final()
     ogs_assert(self.enb_addr_hash);
     ogs_hash_destroy(self.enb_addr_hash);
     ogs_assert(self.enb_id_hash);
-    ogs_hash_destroy(self.enb_id_hash);
+    ogs_ohash_destroy(self.enb_id_hash);
 
     ogs_assert(self.mme_ue_s1ap_id_hash);
-    ogs_hash_destroy(self.mme_ue_s1ap_id_hash);
+    ogs_ohash_destroy(self.mme_ue_s1ap_id_hash);
     ogs_assert(self.imsi_ue_hash);
     ogs_hash_destroy(self.imsi_ue_hash);
     ogs_assert(self.guti_ue_hash);
-    ogs_hash_destroy(self.guti_ue_hash);
+    ogs_ohash_destroy(self.guti_ue_hash);
 
     ogs_pool_final(&self.m_tmsi);
     ogs_pool_final(&mme_bearer_pool);
@@ -1900,6 +1908,7 @@ mme_enb_t *mme_enb_add(ogs_sock_t *sock, ogs_sockaddr_t *addr)
     }
 
     ogs_list_init(&enb->enb_ue_list);
+    enb->enb_ue_s1ap_id_hash = ogs_ohash_create(sizeof(uint32_t));
 
     if (enb->sock_type == SOCK_STREAM) {
         enb->poll = ogs_pollset_add(mme_self()->pollset,
@@ -1935,9 +1944,10 @@ int mme_enb_remove(mme_enb_t *enb)
     ogs_fsm_delete(&enb->sm);
 
     ogs_hash_set(self.enb_addr_hash, enb->addr, sizeof(ogs_sockaddr_t), NULL);
-    ogs_hash_set(self.enb_id_hash, &enb->enb_id, sizeof(enb->enb_id), NULL);
+    ogs_ohash_set_u32(self.enb_id_hash, enb->enb_id, NULL);
 
     enb_ue_remove_in_enb(enb);
+    ogs_ohash_destroy(enb->enb_ue_s1ap_id_hash);
 
     if (enb->sock_type == SOCK_STREAM) {
         ogs_pollset_remove(enb->poll);
@@ -1974,7 +1984,7 @@ mme_enb_t *mme_enb_find_by_addr(ogs_sockaddr_t *addr)
 
 mme_enb_t *mme_enb_find_by_enb_id(uint32_t enb_id)
 {
-    return (mme_enb_t *)ogs_hash_get(self.enb_id_hash, &enb_id, sizeof(enb_id));
+    return (mme_enb_t *)ogs_ohash_get_u32(self.enb_id_hash, enb_id);
 }
 
 int mme_enb_set_enb_id(mme_enb_t *enb, uint32_t enb_id)
@@ -1982,7 +1992,7 @@ int mme_enb_set_enb_id(mme_enb_t *enb, uint32_t enb_id)
     ogs_assert(enb);
 
     enb->enb_id = enb_id;
-    ogs_hash_set(self.enb_id_hash, &enb->enb_id, sizeof(enb->enb_id), enb);
+    ogs_ohash_set_u32(self.enb_id_hash, enb->enb_id, enb);
 
     return OGS_OK;
 }
@@ -2028,8 +2038,7 @@ enb_ue_t *enb_ue_add(mme_enb_t *enb)
 
     enb_ue->enb = enb;
 
-    ogs_hash_set(self.mme_ue_s1ap_id_hash, &enb_ue->mme_ue_s1ap_id, 
-            sizeof(enb_ue->mme_ue_s1ap_id), enb_ue);
+    ogs_ohash_set_u32(self.mme_ue_s1ap_id_hash, enb_ue->mme_ue_s1ap_id, enb_ue);
     ogs_list_add(&enb->enb_ue_list, enb_ue);
 
     stats_add_ue();
@@ -2040,7 +2049,26 @@ enb_ue_t *enb_ue_add(mme_enb_t *enb)
 unsigned int enb_ue_count()
 {
     ogs_assert(self.mme_ue_s1ap_id_hash);
-    return ogs_hash_count(self.mme_ue_s1ap_id_hash);
+    return ogs_ohash_count(self.mme_ue_s1ap_id_hash);
+}
+
+static void enb_ue_unhash_enb_ue_s1ap_id(enb_ue_t *enb_ue)
+{
+    mme_enb_t *enb = NULL;
+
+    ogs_assert(enb_ue);
+    enb = enb_ue->enb;
+    ogs_assert(enb);
+    ogs_assert(enb->enb_ue_s1ap_id_hash);
+
+    if (enb_ue->enb_ue_s1ap_id == INVALID_UE_S1AP_ID)
+        return;
+
+    /* The eNB may have re-used this ID for a newer context */
+    if (ogs_ohash_get_u32(enb->enb_ue_s1ap_id_hash,
+                enb_ue->enb_ue_s1ap_id) == enb_ue)
+        ogs_ohash_set_u32(enb->enb_ue_s1ap_id_hash,
+                enb_ue->enb_ue_s1ap_id, NULL);
 }
 
 void enb_ue_remove(enb_ue_t *enb_ue)
@@ -2053,8 +2081,8 @@ void enb_ue_remove(enb_ue_t *enb_ue)
     enb_ue_deassociate(enb_ue);
 
     ogs_list_remove(&enb_ue->enb->enb_ue_list, enb_ue);
-    ogs_hash_set(self.mme_ue_s1ap_id_hash, &enb_ue->mme_ue_s1ap_id, 
-            sizeof(enb_ue->mme_ue_s1ap_id), NULL);
+    enb_ue_unhash_enb_ue_s1ap_id(enb_ue);
+    ogs_ohash_set_u32(self.mme_ue_s1ap_id_hash, enb_ue->mme_ue_s1ap_id, NULL);
 
     stats_remove_ue();
 
@@ -2084,6 +2112,14 @@ void enb_ue_switch_to_enb(enb_ue_t *enb_ue, mme_enb_t *new_enb)
     /* Remove from the old enb */
     ogs_list_remove(&enb_ue->enb->enb_ue_list, enb_ue);
 
+    /*
+     * ENB-UE-S1AP-ID is allocated by the eNB, so the old one means nothing
+     * to the new enb. The caller sets the new one with
+     * enb_ue_set_enb_ue_s1ap_id() after switching.
+     */
+    enb_ue_unhash_enb_ue_s1ap_id(enb_ue);
+    enb_ue->enb_ue_s1ap_id = INVALID_UE_S1AP_ID;
+
     /* Add to the new enb */
     ogs_list_add(&new_enb->enb_ue_list, enb_ue);
 
@@ -2091,27 +2127,33 @@ void enb_ue_switch_to_enb(enb_ue_t *enb_ue, mme_enb_t *new_enb)
     enb_ue->enb = new_enb;
 }
 
-enb_ue_t *enb_ue_find_by_enb_ue_s1ap_id(
-        mme_enb_t *enb, uint32_t enb_ue_s1ap_id)
+void enb_ue_set_enb_ue_s1ap_id(enb_ue_t *enb_ue, uint32_t enb_ue_s1ap_id)
 {
-    enb_ue_t *enb_ue = NULL;
-    
-    enb_ue = enb_ue_first_in_enb(enb);
-    while (enb_ue) {
-        if (enb_ue_s1ap_id == enb_ue->enb_ue_s1ap_id)
-            break;
+    mme_enb_t *enb = NULL;
 
-        enb_ue = enb_ue_next_in_enb(enb_ue);
-    }
+    ogs_assert(enb_ue);
+    enb = enb_ue->enb;
+    ogs_assert(enb);
+    ogs_assert(enb->enb_ue_s1ap_id_hash);
 
-    return enb_ue;
+    enb_ue_unhash_enb_ue_s1ap_id(enb_ue);
+
+    enb_ue->enb_ue_s1ap_id = enb_ue_s1ap_id;
+    ogs_ohash_set_u32(enb->enb_ue_s1ap_id_hash, enb_ue_s1ap_id, enb_ue);
+}
+
+enb_ue_t *enb_ue_find_by_enb_ue_s1ap_id(
+        mme_enb_t *enb, uint32_t enb_ue_s1ap_id)
+{
+    ogs_assert(enb);
+    ogs_assert(enb->enb_ue_s1ap_id_hash);
+    return ogs_ohash_get_u32(enb->enb_ue_s1ap_id_hash, enb_ue_s1ap_id);
 }
 
 enb_ue_t *enb_ue_find_by_mme_ue_s1ap_id(uint32_t mme_ue_s1ap_id)
 {
     ogs_assert(self.mme_ue_s1ap_id_hash);
-    return ogs_hash_get(self.mme_ue_s1ap_id_hash, 
-            &mme_ue_s1ap_id, sizeof(mme_ue_s1ap_id));
+    return ogs_ohash_get_u32(self.mme_ue_s1ap_id_hash, mme_ue_s1ap_id);
 }
 
 enb_ue_t *enb_ue_first_in_enb(mme_enb_t *enb)
@@ -2140,8 +2182,7 @@ static int mme_ue_new_guti(mme_ue_t *mme_ue)
     if (mme_ue->m_tmsi) {
         /* MME has a VALID GUTI
          * As such, we need to remove previous GUTI in hash table */
-        ogs_hash_set(self.guti_ue_hash,
-                &mme_ue->guti, sizeof(ogs_nas_guti_t), NULL);
+        ogs_ohash_set(self.guti_ue_hash, &mme_ue->guti, NULL);
         ogs_assert(mme_m_tmsi_free(mme_ue->m_tmsi) == OGS_OK);
     }
 
@@ -2155,7 +2196,7 @@ static int mme_ue_new_guti(mme_ue_t *mme_ue)
     mme_ue->m_tmsi = mme_m_tmsi_alloc();
     ogs_assert(mme_ue->m_tmsi);
     mme_ue->guti.m_tmsi = *(mme_ue->m_tmsi);
-    ogs_hash_set(self.guti_ue_hash, &mme_ue->guti, sizeof(ogs_nas_guti_t), mme_ue);
+    ogs_ohash_set(self.guti_ue_hash, &mme_ue->guti, mme_ue);
 
     return OGS_OK;
 }
@@ -2256,8 +2297,7 @@ void mme_ue_remove(mme_ue_t *mme_ue)
 
     /* Clear hash table */
     if (mme_ue->m_tmsi) {
-        ogs_hash_set(self.guti_ue_hash,
-                &mme_ue->guti, sizeof(ogs_nas_guti_t), NULL);
+        ogs_ohash_set(self.guti_ue_hash, &mme_ue->guti, NULL);
         ogs_assert(mme_m_tmsi_free(mme_ue->m_tmsi) == OGS_OK);
     }
     if (mme_ue->imsi_len != 0)
@@ -2322,8 +2362,7 @@ mme_ue_t *mme_ue_find_by_guti(ogs_nas_guti_t *guti)
 {
     ogs_assert(guti);
 
-    return (mme_ue_t *)ogs_hash_get(
-            self.guti_ue_hash, guti, sizeof(ogs_nas_guti_t));
+    return (mme_ue_t *)ogs_ohash_get(self.guti_ue_hash, guti);
 }
 
 mme_ue_t *mme_ue_find_by_teid(uint32_t teid)
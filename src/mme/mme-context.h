@@ -148,10 +148,10 @@ typedef struct mme_context_s {
     ogs_list_t      mme_ue_list;
 
     ogs_hash_t      *enb_addr_hash;         /* hash table for ENB Address */
-    ogs_hash_t      *enb_id_hash;           /* hash table for ENB-ID */
-    ogs_hash_t      *mme_ue_s1ap_id_hash;   /* hash table for MME-UE-S1AP-ID */
+    ogs_ohash_t     *enb_id_hash;           /* hash table for ENB-ID */
+    ogs_ohash_t     *mme_ue_s1ap_id_hash;   /* hash table for MME-UE-S1AP-ID */
     ogs_hash_t      *imsi_ue_hash;          /* hash table (IMSI : MME_UE) */
-    ogs_hash_t      *guti_ue_hash;          /* hash table (GUTI : MME_UE) */
+    ogs_ohash_t     *guti_ue_hash;          /* hash table (GUTI : MME_UE) */
 
     /* System */
     ogs_queue_t     *queue;         /* Queue for processing MME control */
@@ -234,6 +234,7 @@ typedef struct mme_enb_s {
     ogs_tai_t       supported_ta_list[OGS_MAX_NUM_OF_TAI * MAX_NUM_OF_BPLMN];
 
     ogs_list_t      enb_ue_list;
+    ogs_ohash_t     *enb_ue_s1ap_id_hash;   /* hash table for ENB-UE-S1AP-ID */
 
 } mme_enb_t;
 
@@ -671,6 +672,7 @@ unsigned int enb_ue_count(void);
 void enb_ue_remove(enb_ue_t *enb_ue);
 void enb_ue_remove_in_enb(mme_enb_t *enb);
 void enb_ue_switch_to_enb(enb_ue_t *enb_ue, mme_enb_t *new_enb);
+void enb_ue_set_enb_ue_s1ap_id(enb_ue_t *enb_ue, uint32_t enb_ue_s1ap_id);
 enb_ue_t *enb_ue_find_by_enb_ue_s1ap_id(
         mme_enb_t *enb, uint32_t enb_ue_s1ap_id);
 enb_ue_t *enb_ue_find_by_mme_ue_s1ap_id(uint32_t mme_ue_s1ap_id);
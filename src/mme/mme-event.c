@@ -27,18 +27,18 @@
 #define EVENT_POOL 32 /* FIXME : 32 */
 void mme_event_init(void)
 {
-    mme_self()->queue = ogs_queue_create(EVENT_POOL);
-    ogs_assert(mme_self()->queue);
-    mme_self()->timer_mgr = ogs_timer_mgr_create();
-    ogs_assert(mme_self()->timer_mgr);
     mme_self()->pollset = ogs_pollset_create();
     ogs_assert(mme_self()->pollset);
+    mme_self()->queue = ogs_queue_create_type(EVENT_POOL, OGS_QUEUE_MPSC);
+    ogs_assert(mme_self()->queue);
+    ogs_queue_set_pollset(mme_self()->queue, mme_self()->pollset);
+    mme_self()->timer_mgr = ogs_timer_mgr_create_type(OGS_TIMER_MGR_WHEEL);
+    ogs_assert(mme_self()->timer_mgr);
 }
 
 void mme_event_term(void)
 {
     ogs_queue_term(mme_self()->queue);
-    ogs_pollset_notify(mme_self()->pollset);
 }
 
 void mme_event_final(void)
@@ -150,9 +150,4 @@ void mme_sctp_event_push(mme_event_e id,
             ogs_pkbuf_free(e->pkbuf);
         mme_event_free(e);
     }
-#if HAVE_USRSCTP
-    else {
-        ogs_pollset_notify(mme_self()->pollset);
-    }
-#endif
 }
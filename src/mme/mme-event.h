@@ -94,6 +94,9 @@ typedef struct mme_event_s {
     ogs_timer_t *timer;
 } mme_event_t;
 
+/* Events popped at once by the main loop */
+#define MAX_NUM_OF_EVENT_BATCH 32
+
 void mme_event_init(void);
 void mme_event_term(void);
 void mme_event_final(void);
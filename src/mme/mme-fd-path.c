@@ -378,8 +378,6 @@ out:
             ogs_error("ogs_queue_push() failed:%d", (int)rv);
             ogs_pkbuf_free(e->pkbuf);
             mme_event_free(e);
-        } else {
-            ogs_pollset_notify(mme_self()->pollset);
         }
     }
 
@@ -1033,8 +1031,6 @@ static void mme_s6a_ula_cb(void *data, struct msg **msg)
             ogs_error("ogs_queue_push() failed:%d", (int)rv);
             ogs_pkbuf_free(e->pkbuf);
             mme_event_free(e);
-        } else {
-            ogs_pollset_notify(mme_self()->pollset);
         }
     }
 
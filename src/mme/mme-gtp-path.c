@@ -26,36 +26,25 @@
 #include "mme-s11-build.h"
 #include "mme-sm.h"
 
-static void _gtpv2_c_recv_cb(short when, ogs_socket_t fd, void *data)
+static void _gtpv2_c_recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
 {
     int rv;
     char buf[OGS_ADDRSTRLEN];
 
-    ssize_t size;
     mme_event_t *e = NULL;
-    ogs_pkbuf_t *pkbuf = NULL;
-    ogs_sockaddr_t from;
     mme_sgw_t *sgw = NULL;
 
     ogs_assert(fd != INVALID_SOCKET);
 
-    pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
-    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN);
-
-    size = ogs_recvfrom(fd, pkbuf->data, pkbuf->len, 0, &from);
-    if (size <= 0) {
-        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
-                "ogs_recvfrom() failed");
-        ogs_pkbuf_free(pkbuf);
+    if (!pkbuf)
         return;
-    }
+    ogs_assert(from);
 
-    ogs_pkbuf_trim(pkbuf, size);
-
-    sgw = mme_sgw_find_by_addr(&from);
+    sgw = mme_sgw_find_by_addr(from);
     if (!sgw) {
-        ogs_error("Unknown SGW : %s", OGS_ADDR(&from, buf));
-        ogs_pkbuf_free(e->pkbuf);
+        ogs_error("Unknown SGW : %s", OGS_ADDR(from, buf));
+        ogs_pkbuf_free(pkbuf);
         return;
     }
     ogs_assert(sgw->gnode);
@@ -121,15 +110,15 @@ int mme_gtp_open(void)
         sock = ogs_gtp_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(mme_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv2_c_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(mme_self()->pollset,
+                sock->fd, NULL, 0, _gtpv2_c_recv_cb, sock);
     }
     ogs_list_for_each(&mme_self()->gtpc_list6, node) {
         sock = ogs_gtp_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(mme_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv2_c_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(mme_self()->pollset,
+                sock->fd, NULL, 0, _gtpv2_c_recv_cb, sock);
     }
 
     mme_self()->gtpc_sock = ogs_gtp_local_sock_first(&mme_self()->gtpc_list);
@@ -179,7 +168,11 @@ int mme_gtp_send_create_session_request(mme_sess_t *sess)
     ogs_assert(rv == OGS_OK);
 
     xact = ogs_gtp_xact_local_create(mme_ue->gnode, &h, pkbuf, timeout, mme_ue);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited("[Create Session Request] No GTP transaction");
+        ogs_pkbuf_free(pkbuf);
+        return OGS_ERROR;
+    }
 
     rv = ogs_gtp_xact_commit(xact);
     ogs_assert(rv == OGS_OK);
@@ -212,7 +205,11 @@ int mme_gtp_send_modify_bearer_request(
     ogs_assert(rv == OGS_OK);
 
     xact = ogs_gtp_xact_local_create(mme_ue->gnode, &h, pkbuf, timeout, mme_ue);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited("[Modify Bearer Request] No GTP transaction");
+        ogs_pkbuf_free(pkbuf);
+        return OGS_ERROR;
+    }
 
     rv = ogs_gtp_xact_commit(xact);
     ogs_assert(rv == OGS_OK);
@@ -240,7 +237,11 @@ int mme_gtp_send_delete_session_request(mme_sess_t *sess)
     ogs_assert(rv == OGS_OK);
 
     xact = ogs_gtp_xact_local_create(mme_ue->gnode, &h, s11buf, timeout, sess);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited("[Delete Session Request] No GTP transaction");
+        ogs_pkbuf_free(s11buf);
+        return OGS_ERROR;
+    }
 
     rv = ogs_gtp_xact_commit(xact);
     ogs_assert(rv == OGS_OK);
@@ -276,7 +277,7 @@ void mme_gtp_send_delete_all_sessions(mme_ue_t *mme_ue)
                 ogs_warn("PDN will disconnect[EBI:%d]", bearer->ebi);
             } else {
                 rv = mme_gtp_send_delete_session_request(sess);
-                ogs_assert(rv == OGS_OK);
+                ogs_expect(rv == OGS_OK);
             }
         } else {
             mme_sess_remove(sess);
@@ -399,7 +400,12 @@ void mme_gtp_send_release_access_bearers_request(mme_ue_t *mme_ue)
     ogs_assert(rv == OGS_OK);
 
     xact = ogs_gtp_xact_local_create(mme_ue->gnode, &h, pkbuf, timeout, mme_ue);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited(
+                "[Release Access Bearers Request] No GTP transaction");
+        ogs_pkbuf_free(pkbuf);
+        return;
+    }
 
     rv = ogs_gtp_xact_commit(xact);
     ogs_assert(rv == OGS_OK);
@@ -424,7 +430,12 @@ int mme_gtp_send_create_indirect_data_forwarding_tunnel_request(
     ogs_assert(rv == OGS_OK);
 
     xact = ogs_gtp_xact_local_create(mme_ue->gnode, &h, pkbuf, timeout, mme_ue);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited(
+                "[Create Indirect Tunnel Request] No GTP transaction");
+        ogs_pkbuf_free(pkbuf);
+        return OGS_ERROR;
+    }
 
     rv = ogs_gtp_xact_commit(xact);
     ogs_assert(rv == OGS_OK);
@@ -450,7 +461,12 @@ int mme_gtp_send_delete_indirect_data_forwarding_tunnel_request(
     ogs_pkbuf_reserve(pkbuf, OGS_TLV_MAX_HEADROOM);
 
     xact = ogs_gtp_xact_local_create(mme_ue->gnode, &h, pkbuf, timeout, mme_ue);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited(
+                "[Delete Indirect Tunnel Request] No GTP transaction");
+        ogs_pkbuf_free(pkbuf);
+        return OGS_ERROR;
+    }
 
     rv = ogs_gtp_xact_commit(xact);
     ogs_assert(rv == OGS_OK);
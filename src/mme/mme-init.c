@@ -39,7 +39,8 @@ int mme_initialize()
     mme_context_init();
     mme_event_init();
 
-    rv = ogs_gtp_xact_init(mme_self()->timer_mgr, 512);
+    rv = ogs_gtp_xact_init(mme_self()->timer_mgr,
+            ogs_config()->pool.xact);
     if (rv != OGS_OK) return rv;
 
     rv = mme_context_parse_config();
@@ -97,9 +98,11 @@ static void mme_main(void *data)
          * For example, if UE Context Release Complete is received,
          * the MME_TIMER_UE_CONTEXT_RELEASE is first stopped */
         for ( ;; ) {
-            mme_event_t *e = NULL;
+            mme_event_t *e[MAX_NUM_OF_EVENT_BATCH];
+            int i;
 
-            rv = ogs_queue_trypop(mme_self()->queue, (void**)&e);
+            rv = ogs_queue_trypop_many(mme_self()->queue,
+                    (void**)e, MAX_NUM_OF_EVENT_BATCH);
             ogs_assert(rv != OGS_ERROR);
 
             if (rv == OGS_DONE)
@@ -108,18 +111,22 @@ static void mme_main(void *data)
             if (rv == OGS_RETRY)
                 break;
 
-            ogs_assert(e);
-            ogs_fsm_dispatch(&mme_sm, e);
-            mme_event_free(e);
+            for (i = 0; i < rv; i++) {
+                ogs_assert(e[i]);
+                ogs_fsm_dispatch(&mme_sm, e[i]);
+                mme_event_free(e[i]);
+            }
         }
 
         ogs_timer_mgr_expire(mme_self()->timer_mgr);
 
         /* AND THEN, process the TIMER. */
         for ( ;; ) {
-            mme_event_t *e = NULL;
+            mme_event_t *e[MAX_NUM_OF_EVENT_BATCH];
+            int i;
 
-            rv = ogs_queue_trypop(mme_self()->queue, (void**)&e);
+            rv = ogs_queue_trypop_many(mme_self()->queue,
+                    (void**)e, MAX_NUM_OF_EVENT_BATCH);
             ogs_assert(rv != OGS_ERROR);
 
             if (rv == OGS_DONE)
@@ -128,9 +135,11 @@ static void mme_main(void *data)
             if (rv == OGS_RETRY)
                 break;
 
-            ogs_assert(e);
-            ogs_fsm_dispatch(&mme_sm, e);
-            mme_event_free(e);
+            for (i = 0; i < rv; i++) {
+                ogs_assert(e[i]);
+                ogs_fsm_dispatch(&mme_sm, e[i]);
+                mme_event_free(e[i]);
+            }
         }
     }
 done:
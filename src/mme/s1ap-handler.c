@@ -228,7 +228,7 @@ void s1ap_handle_initial_ue_message(mme_enb_t *enb, ogs_s1ap_message_t *message)
         enb_ue = enb_ue_add(enb);
         ogs_assert(enb_ue);
 
-        enb_ue->enb_ue_s1ap_id = *ENB_UE_S1AP_ID;
+        enb_ue_set_enb_ue_s1ap_id(enb_ue, *ENB_UE_S1AP_ID);
 
         /* Find MME_UE if S_TMSI included */
         if (S_TMSI) {
@@ -506,7 +506,7 @@ void s1ap_handle_initial_context_setup_response(
                 uli_presence = 1;
             }
             rv = mme_gtp_send_modify_bearer_request(bearer, uli_presence);
-            ogs_assert(rv == OGS_OK);
+            ogs_expect(rv == OGS_OK);
         }
     }
 
@@ -803,7 +803,7 @@ void s1ap_handle_e_rab_setup_response(
 
             if (bearer->ebi == linked_bearer->ebi) {
                 rv = mme_gtp_send_modify_bearer_request(bearer, 0);
-                ogs_assert(rv == OGS_OK);
+                ogs_expect(rv == OGS_OK);
             } else {
                 rv = mme_gtp_send_create_bearer_response(bearer);
                 ogs_assert(rv == OGS_OK);
@@ -983,7 +983,7 @@ void s1ap_handle_ue_context_release_complete(
         if (mme_ue_have_indirect_tunnel(mme_ue)) {
             rv = mme_gtp_send_delete_indirect_data_forwarding_tunnel_request(
                     mme_ue);
-            ogs_assert(rv == OGS_OK);
+            ogs_expect(rv == OGS_OK);
         } else {
             ogs_warn("Check your eNodeB");
             ogs_warn("  There is no INDIRECT TUNNEL");
@@ -1125,7 +1125,9 @@ void s1ap_handle_path_switch_request(
         return;
     }
 
-    enb_ue->enb_ue_s1ap_id = *ENB_UE_S1AP_ID;
+    /* Switch to enb */
+    enb_ue_switch_to_enb(enb_ue, enb);
+    enb_ue_set_enb_ue_s1ap_id(enb_ue, *ENB_UE_S1AP_ID);
 
     memcpy(&enb_ue->saved.tai.plmn_id, pLMNidentity->buf, 
             sizeof(enb_ue->saved.tai.plmn_id));
@@ -1193,11 +1195,8 @@ void s1ap_handle_path_switch_request(
                 mme_ue, GTP_COUNTER_MODIFY_BEARER_BY_PATH_SWITCH);
 
         rv = mme_gtp_send_modify_bearer_request(bearer, 1);
-        ogs_assert(rv == OGS_OK);
+        ogs_expect(rv == OGS_OK);
     }
-
-    /* Switch to enb */
-    enb_ue_switch_to_enb(enb_ue, enb);
 }
 
 void s1ap_handle_enb_configuration_transfer(
@@ -1465,7 +1464,7 @@ void s1ap_handle_handover_request_ack(mme_enb_t *enb, ogs_s1ap_message_t *messag
     target_ue = enb_ue_find_by_mme_ue_s1ap_id(*MME_UE_S1AP_ID);
     ogs_assert(target_ue);
 
-    target_ue->enb_ue_s1ap_id = *ENB_UE_S1AP_ID;
+    enb_ue_set_enb_ue_s1ap_id(target_ue, *ENB_UE_S1AP_ID);
 
     source_ue = target_ue->source_ue;
     ogs_assert(source_ue);
@@ -1528,7 +1527,7 @@ void s1ap_handle_handover_request_ack(mme_enb_t *enb, ogs_s1ap_message_t *messag
     if (mme_ue_have_indirect_tunnel(mme_ue) == 1) {
         rv = mme_gtp_send_create_indirect_data_forwarding_tunnel_request(
                 mme_ue);
-        ogs_assert(rv == OGS_OK);
+        ogs_expect(rv == OGS_OK);
     } else {
         rv = s1ap_send_handover_command(source_ue);
         ogs_assert(rv == OGS_OK);
@@ -1875,7 +1874,7 @@ void s1ap_handle_handover_notification(mme_enb_t *enb, ogs_s1ap_message_t *messa
                     mme_ue, GTP_COUNTER_MODIFY_BEARER_BY_HANDOVER_NOTIFY);
 
             rv = mme_gtp_send_modify_bearer_request(bearer, 1);
-            ogs_assert(rv == OGS_OK);
+            ogs_expect(rv == OGS_OK);
 
             bearer = mme_bearer_next(bearer);
         }
@@ -32,13 +32,17 @@
 
 #if defined(__linux__)
 #include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
 #endif
 
 #ifndef IFNAMSIZ
 #define IFNAMSIZ 32
 #endif
 
-ogs_socket_t ogs_tun_open(char *ifname, int len, int is_tap)
+ogs_socket_t ogs_tun_open(char *ifname, int len, int is_tap,
+        int is_multi_queue, int is_offload)
 {
     ogs_socket_t fd = INVALID_SOCKET;
 #if defined(__linux__)
@@ -49,6 +53,24 @@ ogs_socket_t ogs_tun_open(char *ifname, int len, int is_tap)
 
     ogs_assert(ifname);
 
+    if (is_multi_queue) {
+#if defined(IFF_MULTI_QUEUE)
+        flags |= IFF_MULTI_QUEUE;
+#else
+        ogs_error("Multi-queue TUN not supported : dev[%s]", ifname);
+        return INVALID_SOCKET;
+#endif
+    }
+
+    if (is_offload) {
+#if defined(IFF_VNET_HDR)
+        flags |= IFF_VNET_HDR;
+#else
+        ogs_error("TUN offload not supported : dev[%s]", ifname);
+        return INVALID_SOCKET;
+#endif
+    }
+
     fd = open(dev, O_RDWR);
     if (fd < 0)
     {
@@ -62,6 +84,16 @@ ogs_socket_t ogs_tun_open(char *ifname, int len, int is_tap)
 
     ogs_assert(ifname);
 
+    if (is_multi_queue) {
+        ogs_error("Multi-queue TUN not supported : dev[%s]", ifname);
+        return INVALID_SOCKET;
+    }
+
+    if (is_offload) {
+        ogs_error("TUN offload not supported : dev[%s]", ifname);
+        return INVALID_SOCKET;
+    }
+
 #define TUNTAP_ID_MAX 255
     for (tun = 0; tun < TUNTAP_ID_MAX; tun++)
     {
@@ -93,6 +125,20 @@ ogs_socket_t ogs_tun_open(char *ifname, int len, int is_tap)
                 "ioctl() failed : dev[%s] flags[0x%x]", dev, flags);
         goto cleanup;
     }
+
+#if defined(IFF_VNET_HDR)
+    /* The kernel then hands over TCP super-packets with partial checksum */
+    if (is_offload) {
+        rc = ioctl(fd, TUNSETOFFLOAD,
+                TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN);
+        if (rc < 0)
+        {
+            ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
+                    "ioctl(TUNSETOFFLOAD) failed : dev[%s]", ifname);
+            goto cleanup;
+        }
+    }
+#endif
 #endif
 
     return fd;
@@ -383,3 +429,253 @@ int ogs_tun_set_ip(char *ifname, ogs_ipsubnet_t *gw, ogs_ipsubnet_t *sub)
 
     return rv;
 }
+
+#if defined(__linux__) && defined(IFF_VNET_HDR)
+
+#define TUN_TCP_SEQ_OFFSET      4
+#define TUN_TCP_FLAGS_OFFSET    13
+#define TUN_TCP_CSUM_OFFSET     16
+
+#define TUN_TCP_FIN             0x01
+#define TUN_TCP_PSH             0x08
+#define TUN_TCP_CWR             0x80
+
+static uint32_t tun_csum_add(uint32_t sum, const uint8_t *p, int len)
+{
+    while (len > 1) {
+        sum += (p[0] << 8) | p[1];
+        p += 2;
+        len -= 2;
+    }
+    if (len)
+        sum += p[0] << 8;
+
+    return sum;
+}
+
+static void tun_csum_store(uint8_t *p, uint32_t sum)
+{
+    uint16_t csum;
+
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    csum = ~sum;
+
+    /* 0xffff is the same as 0 in one's complement, but valid for UDP */
+    if (!csum)
+        csum = 0xffff;
+
+    p[0] = csum >> 8;
+    p[1] = csum & 0xff;
+}
+
+ssize_t ogs_tun_read_gso(ogs_socket_t fd,
+        void *buf, size_t len, ogs_tun_gso_t *gso)
+{
+    struct virtio_net_hdr *vnet_h = buf;
+    int gso_type, csum_start, csum_offset, ip_len;
+    uint8_t *p = NULL;
+    ssize_t size;
+
+    ogs_assert(buf);
+    ogs_assert(len > sizeof *vnet_h);
+    ogs_assert(gso);
+
+    size = read(fd, buf, len);
+    if (size <= 0)
+        return size;
+
+    /* A packet with no segment is skipped by ogs_tun_gso_next() */
+    memset(gso, 0, sizeof *gso);
+    if (size <= (ssize_t)sizeof *vnet_h) {
+        ogs_error_ratelimited("Truncated TUN packet [%d]", (int)size);
+        return size;
+    }
+
+    p = (uint8_t *)buf + sizeof *vnet_h;
+    ip_len = size - sizeof *vnet_h;
+    gso_type = vnet_h->gso_type & ~VIRTIO_NET_HDR_GSO_ECN;
+
+    if (!(vnet_h->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM)) {
+        if (gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+            ogs_error_ratelimited("No partial checksum in GSO [%d]",
+                    gso_type);
+            return size;
+        }
+        gso->data = p;
+        gso->len = ip_len;
+        return size;
+    }
+
+    csum_start = vnet_h->csum_start;
+    csum_offset = vnet_h->csum_offset;
+    if (csum_start + csum_offset + 2 > ip_len) {
+        ogs_error_ratelimited("Invalid partial checksum [%d:%d/%d]",
+                csum_start, csum_offset, ip_len);
+        return size;
+    }
+
+    if (gso_type == VIRTIO_NET_HDR_GSO_NONE) {
+        /* The checksum field holds the pseudo-header sum */
+        tun_csum_store(p + csum_start + csum_offset,
+                tun_csum_add(0, p + csum_start, ip_len - csum_start));
+
+        gso->data = p;
+        gso->len = ip_len;
+        return size;
+    }
+
+    if (gso_type != VIRTIO_NET_HDR_GSO_TCPV4 &&
+        gso_type != VIRTIO_NET_HDR_GSO_TCPV6) {
+        ogs_error_ratelimited("GSO type not supported [%d]", gso_type);
+        return size;
+    }
+
+    /* The TCP header is at csum_start, and its checksum follows */
+    gso->tcp_offset = csum_start;
+    gso->hdr_len = csum_start + (p[csum_start + 12] >> 4) * 4;
+    gso->gso_size = vnet_h->gso_size;
+    if (!gso->gso_size || gso->hdr_len >= ip_len) {
+        ogs_error_ratelimited("Invalid TSO packet [%d:%d/%d]",
+                gso->hdr_len, gso->gso_size, ip_len);
+        memset(gso, 0, sizeof *gso);
+        return size;
+    }
+
+    gso->data = p;
+    gso->len = ip_len;
+
+    return size;
+}
+
+ogs_pkbuf_t *ogs_tun_gso_next(ogs_tun_gso_t *gso,
+        ogs_pkbuf_pool_t *pool, int headroom)
+{
+    ogs_pkbuf_t *pkbuf = NULL;
+    uint8_t *ip = NULL, *tcp = NULL;
+    int payload, tcp_len;
+    uint32_t seq, sum;
+    uint16_t id;
+
+    ogs_assert(gso);
+
+    if (!gso->len)
+        return NULL;
+
+    if (!gso->gso_size) {
+        if (gso->index++)
+            return NULL;
+
+        pkbuf = ogs_pkbuf_alloc(pool, headroom + gso->len);
+        ogs_assert(pkbuf);
+        ogs_pkbuf_reserve(pkbuf, headroom);
+        ogs_pkbuf_put_data(pkbuf, gso->data, gso->len);
+
+        return pkbuf;
+    }
+
+    payload = gso->len - gso->hdr_len - gso->offset;
+    if (payload <= 0)
+        return NULL;
+    payload = ogs_min(payload, gso->gso_size);
+
+    pkbuf = ogs_pkbuf_alloc(pool, headroom + gso->hdr_len + payload);
+    ogs_assert(pkbuf);
+    ogs_pkbuf_reserve(pkbuf, headroom);
+    ogs_pkbuf_put_data(pkbuf, gso->data, gso->hdr_len);
+    ogs_pkbuf_put_data(pkbuf,
+            gso->data + gso->hdr_len + gso->offset, payload);
+
+    ip = pkbuf->data;
+    tcp = ip + gso->tcp_offset;
+    tcp_len = gso->hdr_len - gso->tcp_offset + payload;
+
+    if ((ip[0] >> 4) == 4) {
+        ip[2] = (gso->hdr_len + payload) >> 8;
+        ip[3] = (gso->hdr_len + payload) & 0xff;
+        id = ((ip[4] << 8) | ip[5]) + gso->index;
+        ip[4] = id >> 8;
+        ip[5] = id & 0xff;
+        ip[10] = ip[11] = 0;
+        tun_csum_store(ip + 10, tun_csum_add(0, ip, (ip[0] & 0x0f) * 4));
+
+        sum = tun_csum_add(0, ip + 12, 8);  /* Source, Destination */
+    } else {
+        ip[4] = (gso->hdr_len - 40 + payload) >> 8;
+        ip[5] = (gso->hdr_len - 40 + payload) & 0xff;
+
+        sum = tun_csum_add(0, ip + 8, 32);  /* Source, Destination */
+    }
+    sum += IPPROTO_TCP + tcp_len;
+
+    seq = ((uint32_t)tcp[TUN_TCP_SEQ_OFFSET] << 24) |
+        (tcp[TUN_TCP_SEQ_OFFSET+1] << 16) |
+        (tcp[TUN_TCP_SEQ_OFFSET+2] << 8) | tcp[TUN_TCP_SEQ_OFFSET+3];
+    seq += gso->offset;
+    tcp[TUN_TCP_SEQ_OFFSET] = seq >> 24;
+    tcp[TUN_TCP_SEQ_OFFSET+1] = (seq >> 16) & 0xff;
+    tcp[TUN_TCP_SEQ_OFFSET+2] = (seq >> 8) & 0xff;
+    tcp[TUN_TCP_SEQ_OFFSET+3] = seq & 0xff;
+
+    /* CWR only in the first segment, FIN and PSH only in the last one */
+    if (gso->index)
+        tcp[TUN_TCP_FLAGS_OFFSET] &= ~TUN_TCP_CWR;
+    if (gso->hdr_len + gso->offset + payload < gso->len)
+        tcp[TUN_TCP_FLAGS_OFFSET] &= ~(TUN_TCP_FIN | TUN_TCP_PSH);
+
+    tcp[TUN_TCP_CSUM_OFFSET] = tcp[TUN_TCP_CSUM_OFFSET+1] = 0;
+    tun_csum_store(tcp + TUN_TCP_CSUM_OFFSET, tun_csum_add(sum, tcp, tcp_len));
+
+    gso->offset += payload;
+    gso->index++;
+
+    return pkbuf;
+}
+
+ssize_t ogs_tun_write_offload(ogs_socket_t fd, void *buf, size_t len)
+{
+    struct virtio_net_hdr vnet_h;
+    struct iovec iov[2];
+    ssize_t size;
+
+    ogs_assert(buf);
+
+    /* The checksums of the UE are verified by the kernel */
+    memset(&vnet_h, 0, sizeof vnet_h);
+
+    iov[0].iov_base = &vnet_h;
+    iov[0].iov_len = sizeof vnet_h;
+    iov[1].iov_base = buf;
+    iov[1].iov_len = len;
+
+    size = writev(fd, iov, 2);
+    if (size <= 0)
+        return size;
+
+    return size - sizeof vnet_h;
+}
+
+#else
+
+ssize_t ogs_tun_read_gso(ogs_socket_t fd,
+        void *buf, size_t len, ogs_tun_gso_t *gso)
+{
+    /* ogs_tun_open() refuses is_offload */
+    ogs_assert_if_reached();
+    return -1;
+}
+
+ogs_pkbuf_t *ogs_tun_gso_next(ogs_tun_gso_t *gso,
+        ogs_pkbuf_pool_t *pool, int headroom)
+{
+    ogs_assert_if_reached();
+    return NULL;
+}
+
+ssize_t ogs_tun_write_offload(ogs_socket_t fd, void *buf, size_t len)
+{
+    ogs_assert_if_reached();
+    return -1;
+}
+
+#endif
@@ -26,9 +26,44 @@
 extern "C" {
 #endif
 
-ogs_socket_t ogs_tun_open(char *ifname, int len, int is_tap);
+ogs_socket_t ogs_tun_open(char *ifname, int len, int is_tap,
+        int is_multi_queue, int is_offload);
 int ogs_tun_set_ip(char *ifname, ogs_ipsubnet_t *gw,  ogs_ipsubnet_t *sub);
 
+/*
+ * With is_offload, the TUN device is opened with IFF_VNET_HDR and
+ * the kernel passes TCP super-packets of up to 64K (TSO) as they are.
+ * Each packet read or written is preceded by a virtio_net_hdr.
+ *
+ * ogs_tun_read_gso() reads one packet into buf, and ogs_tun_gso_next()
+ * then returns its MTU-sized segments one by one, with the IP and TCP
+ * headers and checksums fixed up. A packet without TSO is returned
+ * as a single segment, with its partial checksum completed.
+ */
+#define OGS_TUN_MAX_GSO_LEN     (65536 + 128)
+
+typedef struct ogs_tun_gso_s {
+    uint8_t     *data;          /* IP packet following the virtio_net_hdr */
+    int         len;
+    int         tcp_offset;     /* TCP header following the IP headers */
+    int         hdr_len;        /* IP and TCP headers of each segment */
+    int         gso_size;       /* TCP payload of each segment, 0 if no TSO */
+    int         offset;         /* Next byte of the TCP payload */
+    int         index;          /* Number of segments returned so far */
+} ogs_tun_gso_t;
+
+ssize_t ogs_tun_read_gso(ogs_socket_t fd,
+        void *buf, size_t len, ogs_tun_gso_t *gso);
+ogs_pkbuf_t *ogs_tun_gso_next(ogs_tun_gso_t *gso,
+        ogs_pkbuf_pool_t *pool, int headroom);
+
+/*
+ * The uplink packets are written with an empty virtio_net_hdr, which
+ * IFF_VNET_HDR requires. Nothing is offloaded for the uplink on purpose:
+ * the checksums come from the UE, so the kernel must still verify them.
+ */
+ssize_t ogs_tun_write_offload(ogs_socket_t fd, void *buf, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,6 +18,7 @@
  */
 
 #include "pgw-context.h"
+#include "pgw-ipfw.h"
 
 static pgw_context_t self;
 static ogs_diam_config_t g_diam_conf;
@@ -74,15 +75,25 @@ void pgw_context_init(void)
     ogs_list_init(&self.subnet_list);
     ogs_pool_init(&pgw_subnet_pool, MAX_NUM_OF_SUBNET);
 
-    ogs_pool_init(&pgw_sess_pool, ogs_config()->pool.sess);
-    ogs_pool_init(&pgw_bearer_pool, ogs_config()->pool.bearer);
+    ogs_pool_init_segmented(&pgw_sess_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.sess),
+            ogs_config()->pool.sess);
+    ogs_pool_init_segmented(&pgw_bearer_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.bearer),
+            ogs_config()->pool.bearer);
 
-    ogs_pool_init(&pgw_pf_pool, ogs_config()->pool.pf);
+    ogs_pool_init_segmented(&pgw_pf_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.pf),
+            ogs_config()->pool.pf);
 
-    self.sess_hash = ogs_hash_make();
+    self.sess_hash = ogs_hash_make_incremental();
+    self.ipv4_hash = ogs_ohash_create(OGS_IPV4_LEN);
+    self.ipv6_hash = ogs_ohash_create(OGS_IPV6_LEN);
 
     ogs_list_init(&self.sess_list);
 
+    ogs_thread_rwlock_init(&self.sess_rwlock);
+
     context_initiaized = 1;
 }
 
@@ -97,6 +108,12 @@ void pgw_context_final(void)
 
     ogs_assert(self.sess_hash);
     ogs_hash_destroy(self.sess_hash);
+    ogs_assert(self.ipv4_hash);
+    ogs_ohash_destroy(self.ipv4_hash);
+    ogs_assert(self.ipv6_hash);
+    ogs_ohash_destroy(self.ipv6_hash);
+
+    ogs_thread_rwlock_destroy(&self.sess_rwlock);
 
     ogs_pool_final(&pgw_bearer_pool);
     ogs_pool_final(&pgw_sess_pool);
@@ -126,6 +143,9 @@ static int pgw_context_prepare(void)
 
     self.tun_ifname = "ogstun";
 
+#define DEFAULT_FLOW_CACHE_SIZE     65536
+    self.flow_cache.size = DEFAULT_FLOW_CACHE_SIZE;
+
     return OGS_OK;
 }
 
@@ -156,6 +176,11 @@ static int pgw_context_validation(void)
                 ogs_config()->file);
         return OGS_ERROR;
     }
+    if (self.num_of_worker < 0 || self.num_of_worker > MAX_NUM_OF_WORKER) {
+        ogs_error("Invalid pgw.worker [%d] in '%s'",
+                self.num_of_worker, ogs_config()->file);
+        return OGS_ERROR;
+    }
     return OGS_OK;
 }
 
@@ -743,6 +768,16 @@ int pgw_context_parse_config(void)
                     } while (
                         ogs_yaml_iter_type(&dns_iter) ==
                             YAML_SEQUENCE_NODE);
+                } else if (!strcmp(pgw_key, "flow_cache")) {
+                    const char *v = ogs_yaml_iter_value(&pgw_iter);
+                    if (v) self.flow_cache.size = atoi(v);
+                } else if (!strcmp(pgw_key, "worker")) {
+                    const char *v = ogs_yaml_iter_value(&pgw_iter);
+                    if (v) self.num_of_worker = atoi(v);
+                } else if (!strcmp(pgw_key, "s5u_shm")) {
+                    self.s5u_shm.name = ogs_yaml_iter_value(&pgw_iter);
+                } else if (!strcmp(pgw_key, "tun_offload")) {
+                    self.tun_offload = ogs_yaml_iter_bool(&pgw_iter);
                 }
                 else
                     ogs_warn("unknown key `%s`", pgw_key);
@@ -789,6 +824,8 @@ pgw_sess_t *pgw_sess_add(
 
     sess->gnode = NULL;
 
+    pgw_dl_filter_invalidate(sess);
+
     sess->pgw_s5c_teid = sess->index;  /* derived from an index */
 
     /* Set IMSI */
@@ -849,6 +886,12 @@ pgw_sess_t *pgw_sess_add(
             imsi, imsi_len, apn);
     ogs_hash_set(self.sess_hash, sess->hash_keybuf, sess->hash_keylen, sess);
 
+    /* Downlink packets are matched to the session by UE IP address */
+    if (sess->ipv4)
+        ogs_ohash_set_u32(self.ipv4_hash, sess->ipv4->addr[0], sess);
+    if (sess->ipv6)
+        ogs_ohash_set(self.ipv6_hash, sess->ipv6->addr, sess);
+
     ogs_list_add(&self.sess_list, sess);
     
     stats_add_session();
@@ -864,12 +907,20 @@ int pgw_sess_remove(pgw_sess_t *sess)
 
     ogs_hash_set(self.sess_hash, sess->hash_keybuf, sess->hash_keylen, NULL);
 
-    if (sess->ipv4)
+    if (sess->ipv4) {
+        if (ogs_ohash_get_u32(self.ipv4_hash, sess->ipv4->addr[0]) == sess)
+            ogs_ohash_set_u32(self.ipv4_hash, sess->ipv4->addr[0], NULL);
         pgw_ue_ip_free(sess->ipv4);
-    if (sess->ipv6)
+    }
+    if (sess->ipv6) {
+        if (ogs_ohash_get(self.ipv6_hash, sess->ipv6->addr) == sess)
+            ogs_ohash_set(self.ipv6_hash, sess->ipv6->addr, NULL);
         pgw_ue_ip_free(sess->ipv6);
+    }
 
     pgw_bearer_remove_all(sess);
+    pgw_dl_filter_invalidate(sess);
+    pgw_dl_filter_free(sess);
 
     ogs_pool_free(&pgw_sess_pool, sess);
 
@@ -909,6 +960,19 @@ pgw_sess_t *pgw_sess_find_by_imsi_apn(
     return (pgw_sess_t *)ogs_hash_get(self.sess_hash, keybuf, keylen);
 }
 
+pgw_sess_t *pgw_sess_find_by_ipv4(uint32_t addr)
+{
+    ogs_assert(self.ipv4_hash);
+    return (pgw_sess_t *)ogs_ohash_get_u32(self.ipv4_hash, addr);
+}
+
+pgw_sess_t *pgw_sess_find_by_ipv6(uint32_t *addr6)
+{
+    ogs_assert(self.ipv6_hash);
+    ogs_assert(addr6);
+    return (pgw_sess_t *)ogs_ohash_get(self.ipv6_hash, addr6);
+}
+
 pgw_sess_t *pgw_sess_add_by_message(ogs_gtp_message_t *message)
 {
     pgw_sess_t *sess = NULL;
@@ -1020,6 +1084,7 @@ int pgw_bearer_remove(pgw_bearer_t *bearer)
         ogs_free(bearer->name);
 
     pgw_pf_remove_all(bearer);
+    pgw_dl_filter_invalidate(bearer->sess);
 
     ogs_pool_free(&pgw_bearer_pool, bearer);
 
@@ -1150,6 +1215,8 @@ pgw_pf_t *pgw_pf_add(pgw_bearer_t *bearer, uint32_t precedence)
 
     ogs_list_add(&bearer->pf_list, pf);
 
+    pgw_dl_filter_invalidate(bearer->sess);
+
     return pf;
 }
 
@@ -1159,6 +1226,8 @@ int pgw_pf_remove(pgw_pf_t *pf)
     ogs_assert(pf->bearer);
 
     ogs_list_remove(&pf->bearer->pf_list, pf);
+    pgw_dl_filter_invalidate(pf->bearer->sess);
+
     ogs_pool_free(&pgw_pf_pool, pf);
 
     return OGS_OK;
@@ -1198,95 +1267,92 @@ pgw_pf_t *pgw_pf_next(pgw_pf_t *pf)
     return ogs_list_next(pf);
 }
 
-int pgw_ue_pool_generate(void)
+/*
+ * UE addresses are generated as the pool is used, in the same order as
+ * the pool indexes, instead of writing every pgw_ue_ip_t at startup.
+ * The next address is always generated in advance, so that the pool
+ * size can be trimmed as soon as the ranges are used up.
+ */
+static void ue_ip_range_init(pgw_subnet_t *subnet)
 {
-    int i, rv;
-    pgw_subnet_t *subnet = NULL;
-
-    for (subnet = pgw_subnet_first(); 
-        subnet; subnet = pgw_subnet_next(subnet)) {
-        int maxbytes = 0;
-        int lastindex = 0;
-        uint32_t start[4], end[4], broadcast[4];
-        int rangeindex, num_of_range;
-        int poolindex;
-        int inc;
-
-        if (subnet->family == AF_INET) {
-            maxbytes = 4;
-            lastindex = 0;
-        }
-        else if (subnet->family == AF_INET6) {
-            maxbytes = 16;
-            lastindex = 3;
-        }
+    int rv, i;
+    int maxbytes = subnet->family == AF_INET ? 4 : 16;
+    int lastindex = subnet->family == AF_INET ? 0 : 3;
+    int r = subnet->gen.range;
+
+    if (subnet->num_of_range && subnet->range[r].low) {
+        ogs_ipsubnet_t low;
+        rv = ogs_ipsubnet(&low, subnet->range[r].low, NULL);
+        ogs_assert(rv == OGS_OK);
+        memcpy(subnet->gen.start, low.sub, maxbytes);
+    } else {
+        memcpy(subnet->gen.start, subnet->sub.sub, maxbytes);
+    }
 
-        for (i = 0; i < 4; i++) {
-            broadcast[i] = subnet->sub.sub[i] + ~subnet->sub.mask[i];
-        }
+    if (subnet->num_of_range && subnet->range[r].high) {
+        ogs_ipsubnet_t high;
+        rv = ogs_ipsubnet(&high, subnet->range[r].high, NULL);
+        ogs_assert(rv == OGS_OK);
+        high.sub[lastindex] += htonl(1);
+        memcpy(subnet->gen.end, high.sub, maxbytes);
+    } else {
+        /* Broadcast */
+        for (i = 0; i < 4; i++)
+            subnet->gen.end[i] = subnet->sub.sub[i] + ~subnet->sub.mask[i];
+    }
 
-        num_of_range = subnet->num_of_range;
-        if (!num_of_range) num_of_range = 1;
-
-        poolindex = 0;
-        for (rangeindex = 0; rangeindex < num_of_range; rangeindex++) {
-
-            if (subnet->num_of_range &&
-                subnet->range[rangeindex].low) {
-                ogs_ipsubnet_t low;
-                rv = ogs_ipsubnet(
-                        &low, subnet->range[rangeindex].low, NULL);
-                ogs_assert(rv == OGS_OK);
-                memcpy(start, low.sub, maxbytes);
-            } else {
-                memcpy(start, subnet->sub.sub, maxbytes);
-            }
+    subnet->gen.inc = 0;
+}
 
-            if (subnet->num_of_range &&
-                subnet->range[rangeindex].high) {
-                ogs_ipsubnet_t high;
-                rv = ogs_ipsubnet(
-                        &high, subnet->range[rangeindex].high, NULL);
-                ogs_assert(rv == OGS_OK);
-                high.sub[lastindex] += htonl(1);
-                memcpy(end, high.sub, maxbytes);
-            } else {
-                memcpy(end, broadcast, maxbytes);
-            }
+static bool ue_ip_generate_next(pgw_subnet_t *subnet)
+{
+    int maxbytes = subnet->family == AF_INET ? 4 : 16;
+    int lastindex = subnet->family == AF_INET ? 0 : 3;
+    int num_of_range = subnet->num_of_range ? subnet->num_of_range : 1;
+    uint32_t *addr = subnet->gen.next;
+
+    while (subnet->gen.range < num_of_range) {
+        memcpy(addr, subnet->gen.start, maxbytes);
+        addr[lastindex] += htonl(subnet->gen.inc);
+        subnet->gen.inc++;
+
+        if (memcmp(addr, subnet->gen.end, maxbytes) == 0) {
+            subnet->gen.range++;
+            if (subnet->gen.range < num_of_range)
+                ue_ip_range_init(subnet);
+            continue;
+        }
 
-            inc = 0;
-            while(poolindex < ogs_config()->pool.sess) {
-                pgw_ue_ip_t *ue_ip = NULL;
+        /* Exclude Network Address */
+        if (memcmp(addr, subnet->sub.sub, maxbytes) == 0)
+            continue;
 
-                ue_ip = &subnet->pool.array[poolindex];
-                ogs_assert(ue_ip);
-                memset(ue_ip, 0, sizeof *ue_ip);
-                ue_ip->subnet = subnet;
+        /* Exclude TUN IP Address */
+        if (memcmp(addr, subnet->gw.sub, maxbytes) == 0)
+            continue;
 
-                memcpy(ue_ip->addr, start, maxbytes);
-                ue_ip->addr[lastindex] += htonl(inc);
-                inc++;
+        return true;
+    }
 
-                if (memcmp(ue_ip->addr, end, maxbytes) == 0)
-                    break;
+    /* No more addresses : the pool ends with the ones handed out */
+    subnet->pool.avail -= subnet->pool.size - subnet->gen.count;
+    subnet->pool.size = subnet->gen.count;
 
-                /* Exclude Network Address */
-                if (memcmp(ue_ip->addr, subnet->sub.sub, maxbytes) == 0)
-                    continue;
+    return false;
+}
 
-                /* Exclude TUN IP Address */
-                if (memcmp(ue_ip->addr, subnet->gw.sub, maxbytes) == 0)
-                    continue;
+int pgw_ue_pool_generate(void)
+{
+    pgw_subnet_t *subnet = NULL;
 
-                ogs_debug("[%d] - %x:%x:%x:%x",
-                        poolindex,
-                        ue_ip->addr[0], ue_ip->addr[1],
-                        ue_ip->addr[2], ue_ip->addr[3]);
+    for (subnet = pgw_subnet_first(); 
+        subnet; subnet = pgw_subnet_next(subnet)) {
+        ogs_assert(subnet->family == AF_INET || subnet->family == AF_INET6);
+        ogs_assert(subnet->gen.count == 0);
 
-                poolindex++;
-            }
-        }
-        subnet->pool.size = subnet->pool.avail = poolindex;
+        subnet->gen.range = 0;
+        ue_ip_range_init(subnet);
+        ue_ip_generate_next(subnet);
     }
 
     return OGS_OK;
@@ -1356,6 +1422,17 @@ pgw_ue_ip_t *pgw_ue_ip_alloc(int family, const char *apn, uint8_t *addr)
         memcpy(ue_ip->addr, addr, maxbytes);
     } else {
         ogs_pool_alloc(&subnet->pool, &ue_ip);
+        ogs_assert(ue_ip);
+
+        if (ogs_pool_index(&subnet->pool, ue_ip) > subnet->gen.count) {
+            /* Never used before */
+            memset(ue_ip, 0, sizeof *ue_ip);
+            ue_ip->subnet = subnet;
+            memcpy(ue_ip->addr, subnet->gen.next, maxbytes);
+
+            subnet->gen.count++;
+            ue_ip_generate_next(subnet);
+        }
     }
 
     ogs_assert(ue_ip);
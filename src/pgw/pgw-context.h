@@ -42,6 +42,23 @@ extern int __pgw_log_domain;
 #undef OGS_LOG_DOMAIN
 #define OGS_LOG_DOMAIN __pgw_log_domain
 
+typedef struct pgw_dl_flow_s pgw_dl_flow_t;
+typedef struct pgw_dl_flow_cache_s {
+    int             size;           /* Number of entries (0 : disabled) */
+    pgw_dl_flow_t   *entry;
+
+    /* Written by the owning thread only, read by pgw_dl_flow_cache_stat() */
+    volatile unsigned long hit;
+    volatile unsigned long miss;
+    volatile unsigned long evicted; /* Live entries of another flow replaced */
+} pgw_dl_flow_cache_t;              /* Downlink 5-tuple cache (pgw-ipfw.c) */
+
+typedef struct pgw_dl_flow_cache_stat_s {
+    int             size;           /* Entries of each cache */
+    uint64_t        hit;
+    uint64_t        miss;
+    uint64_t        evicted;
+} pgw_dl_flow_cache_stat_t;
 typedef struct pgw_context_s {
     const char*         diam_conf_path;   /* PGW Diameter conf path */
     ogs_diam_config_t   *diam_config;     /* PGW Diameter config */
@@ -88,11 +105,31 @@ typedef struct pgw_context_s {
     ogs_list_t      ip_pool_list;
 
     ogs_hash_t      *sess_hash;     /* hash table (IMSI+APN) */
+    ogs_ohash_t     *ipv4_hash;     /* hash table (UE IPv4 Address) */
+    ogs_ohash_t     *ipv6_hash;     /* hash table (UE IPv6 Address) */
+
+    pgw_dl_flow_cache_t flow_cache; /* Used by PGW main thread */
+
+#define MAX_NUM_OF_WORKER           64
+    int             num_of_worker;  /* User-plane worker threads */
+    /* Held for writing by PGW main thread while it mutates sessions,
+     * and for reading by user-plane workers while they forward packets */
+    ogs_thread_rwlock_t sess_rwlock;
+
+    bool            tun_offload;    /* TSO super-packets from TUN devices */
+
+    /* S5-U through shared memory with a co-located SGW */
+    struct {
+        const char      *name;
+        ogs_shmring_t   *tx;        /* Downlink to SGW */
+        ogs_shmring_t   *rx;        /* Uplink from SGW */
+    } s5u_shm;
 
     ogs_list_t      sess_list;
 } pgw_context_t;
 
 typedef struct pgw_subnet_s pgw_subnet_t;
+typedef struct pgw_dl_filter_s pgw_dl_filter_t;
 typedef struct pgw_ue_ip_s {
     uint32_t        addr[4];
     bool            static_ip;
@@ -109,6 +146,8 @@ typedef struct pgw_dev_s {
 
     ogs_sockaddr_t  *link_local_addr;
     ogs_poll_t      *poll;
+
+    bool            offload;        /* Opened with IFF_VNET_HDR */
 } pgw_dev_t;
 
 typedef struct pgw_subnet_s {
@@ -133,6 +172,15 @@ typedef struct pgw_subnet_s {
     uint8_t         prefixlen;      /* prefixlen */
     OGS_POOL(pool, pgw_ue_ip_t);
 
+    /* The pool is filled with UE addresses as it is used */
+    struct {
+        int         range;          /* Range being generated */
+        uint32_t    start[4], end[4];
+        uint32_t    inc;
+        uint32_t    next[4];        /* Next address to hand out */
+        int         count;          /* Addresses generated so far */
+    } gen;
+
     pgw_dev_t       *dev;           /* Related Context */
 } pgw_subnet_t;
 
@@ -164,6 +212,11 @@ typedef struct pgw_sess_s {
 
     ogs_list_t      bearer_list;
 
+    /* Downlink Packet Filters of all bearers (see pgw-ipfw.c) */
+    pgw_dl_filter_t *dl_filter;
+    bool            dl_filter_stale;
+    uint64_t        dl_filter_generation;
+
     /* Related Context */
     ogs_gtp_node_t  *gnode;
 } pgw_sess_t;
@@ -246,6 +299,8 @@ void pgw_sess_remove_all(void);
 pgw_sess_t *pgw_sess_find(uint32_t index);
 pgw_sess_t *pgw_sess_find_by_teid(uint32_t teid);
 pgw_sess_t *pgw_sess_find_by_imsi_apn(uint8_t *imsi, int imsi_len, char *apn);
+pgw_sess_t *pgw_sess_find_by_ipv4(uint32_t addr);
+pgw_sess_t *pgw_sess_find_by_ipv6(uint32_t *addr6);
 
 pgw_bearer_t *pgw_bearer_add(pgw_sess_t *sess);
 int pgw_bearer_remove(pgw_bearer_t *bearer);
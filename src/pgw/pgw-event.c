@@ -48,18 +48,18 @@ void pgw_event_init(void)
     pollset_action_setup();
 #endif
 
-    pgw_self()->queue = ogs_queue_create(EVENT_POOL);
+    pgw_self()->pollset = ogs_pollset_create();
+    ogs_assert(pgw_self()->pollset);
+    pgw_self()->queue = ogs_queue_create_type(EVENT_POOL, OGS_QUEUE_MPSC);
     ogs_assert(pgw_self()->queue);
+    ogs_queue_set_pollset(pgw_self()->queue, pgw_self()->pollset);
     pgw_self()->timer_mgr = ogs_timer_mgr_create();
     ogs_assert(pgw_self()->timer_mgr);
-    pgw_self()->pollset = ogs_pollset_create();
-    ogs_assert(pgw_self()->pollset);
 }
 
 void pgw_event_term(void)
 {
     ogs_queue_term(pgw_self()->queue);
-    ogs_pollset_notify(pgw_self()->pollset);
 }
 
 void pgw_event_final(void)
@@ -51,6 +51,9 @@ typedef struct pgw_event_s {
     pgw_sess_t *sess;
 } pgw_event_t;
 
+/* Events popped at once by the main loop */
+#define MAX_NUM_OF_EVENT_BATCH 32
+
 void pgw_event_init(void);
 void pgw_event_term(void);
 void pgw_event_final(void);
@@ -730,8 +730,6 @@ out:
             ogs_pkbuf_free(e->gxbuf);
             ogs_pkbuf_free(e->gtpbuf);
             pgw_event_free(e);
-        } else {
-            ogs_pollset_notify(pgw_self()->pollset);
         }
     } else {
         ogs_diam_gx_message_free(gx_message);
@@ -955,8 +953,6 @@ static int pgw_gx_rar_cb( struct msg **msg, struct avp *avp,
         ogs_diam_gx_message_free(gx_message);
         ogs_pkbuf_free(e->gxbuf);
         pgw_event_free(e);
-    } else {
-        ogs_pollset_notify(pgw_self()->pollset);
     }
 
     /* Set the Auth-Application-Id AVP */
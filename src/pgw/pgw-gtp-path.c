@@ -44,74 +44,312 @@
 uint16_t in_cksum(uint16_t *addr, int len);
 static int pgw_gtp_handle_multicast(ogs_pkbuf_t *recvbuf);
 static int pgw_gtp_handle_slaac(pgw_sess_t *sess, ogs_pkbuf_t *recvbuf);
+static void pgw_gtp_encap(pgw_bearer_t *bearer, ogs_pkbuf_t *sendbuf);
 static int pgw_gtp_send_to_bearer(pgw_bearer_t *bearer, ogs_pkbuf_t *sendbuf);
 static int pgw_gtp_send_router_advertisement(
         pgw_sess_t *sess, uint8_t *ip6_dst);
 
-static void _gtpv1_tun_recv_cb(short when, ogs_socket_t fd, void *data)
+/*
+ * With pgw.worker configured, the TUN device is opened with one queue
+ * per user-plane worker, and each worker polls its own queues.
+ * The kernel spreads downlink flows across the queues.
+ *
+ * Workers only read sessions and bearers while holding the read lock.
+ * PGW main thread keeps ownership of every session update.
+ */
+typedef struct pgw_gtp_worker_s {
+    ogs_thread_t    *thread;
+    ogs_pollset_t   *pollset;
+    bool            terminated;
+
+    ogs_socket_t    fd[MAX_NUM_OF_DEV];
+    ogs_poll_t      *poll[MAX_NUM_OF_DEV];
+    int             num_of_fd;
+
+    pgw_dl_flow_cache_t flow_cache;
+    ogs_gtp_batch_t tx_batch;
+    bool            locked;     /* Read lock is held during a burst */
+    uint8_t         *gso_buf;   /* TUN super-packet with pgw.tun_offload */
+} pgw_gtp_worker_t;
+
+static pgw_gtp_worker_t *gtp_worker;
+
+static ogs_gtp_batch_t tx_batch; /* Used by PGW main thread */
+static uint8_t *gso_buf; /* Used by PGW main thread */
+
+static void gtp_tun_forward(ogs_gtp_batch_t *batch,
+        pgw_bearer_t *bearer, ogs_pkbuf_t *recvbuf)
 {
-    ogs_pkbuf_t *recvbuf = NULL;
-    int n;
     int rv;
+
+    if (bearer) {
+        /* Unicast */
+        pgw_gtp_encap(bearer, recvbuf);
+        ogs_gtp_batch_sendto(batch, bearer->gnode, recvbuf);
+        return;
+    }
+
+    if (ogs_config()->parameter.multicast) {
+        rv = pgw_gtp_handle_multicast(recvbuf);
+        ogs_assert(rv != OGS_ERROR);
+    }
+
+    ogs_pkbuf_free(recvbuf);
+}
+
+static void _gtpv1_tun_recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *recvbuf, ogs_sockaddr_t *from, void *data)
+{
     pgw_bearer_t *bearer = NULL;
+    pgw_gtp_worker_t *worker = data; /* NULL in PGW main thread */
+    pgw_dl_flow_cache_t *flow_cache = NULL;
+    ogs_gtp_batch_t *batch = NULL;
 
-    recvbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
-    ogs_pkbuf_reserve(recvbuf, OGS_GTPV1U_HEADER_LEN);
-    ogs_pkbuf_put(recvbuf, OGS_MAX_SDU_LEN-OGS_GTPV1U_HEADER_LEN);
+    if (worker) {
+        flow_cache = &worker->flow_cache;
+        batch = &worker->tx_batch;
+    } else {
+        flow_cache = &pgw_self()->flow_cache;
+        batch = &tx_batch;
+    }
+
+    /* End of the burst, so send them to SGW at once */
+    if (!recvbuf) {
+        ogs_gtp_batch_flush(batch);
 
-    n = ogs_read(fd, recvbuf->data, recvbuf->len);
-    if (n <= 0) {
-        ogs_log_message(OGS_LOG_WARN, ogs_socket_errno, "ogs_read() failed");
-        ogs_pkbuf_free(recvbuf);
+        if (worker && worker->locked) {
+            ogs_thread_rwlock_rdunlock(&pgw_self()->sess_rwlock);
+            worker->locked = false;
+        }
         return;
     }
 
-    ogs_pkbuf_trim(recvbuf, n);
+    /* The read lock is held until the end of the burst */
+    if (worker && !worker->locked) {
+        ogs_thread_rwlock_rdlock(&pgw_self()->sess_rwlock);
+        worker->locked = true;
+    }
 
     /* Find the bearer by packet filter */
-    bearer = pgw_bearer_find_by_packet(recvbuf);
-    if (bearer) {
-        /* Unicast */
-        rv = pgw_gtp_send_to_bearer(bearer, recvbuf);
-        ogs_assert(rv == OGS_OK);
+    bearer = pgw_bearer_find_by_packet(flow_cache, recvbuf);
+    gtp_tun_forward(batch, bearer, recvbuf);
+}
+
+/*
+ * With pgw.tun_offload, a TCP super-packet is classified once, and
+ * its segments are queued back to back. They have the same size except
+ * for the last one, so the flush sends them as one UDP GSO aggregate.
+ */
+static void _gtpv1_tun_gso_cb(short when, ogs_socket_t fd, void *data)
+{
+    pgw_gtp_worker_t *worker = data; /* NULL in PGW main thread */
+    pgw_dl_flow_cache_t *flow_cache = NULL;
+    ogs_gtp_batch_t *batch = NULL;
+    uint8_t **buf = NULL;
+
+    pgw_bearer_t *bearer = NULL;
+    ogs_pkbuf_t *pkbuf = NULL;
+    ogs_tun_gso_t gso;
+    ssize_t size;
+    int i;
+
+    if (worker) {
+        flow_cache = &worker->flow_cache;
+        batch = &worker->tx_batch;
+        buf = &worker->gso_buf;
     } else {
-        if (ogs_config()->parameter.multicast) {
-            rv = pgw_gtp_handle_multicast(recvbuf);
-            ogs_assert(rv != OGS_ERROR);
+        flow_cache = &pgw_self()->flow_cache;
+        batch = &tx_batch;
+        buf = &gso_buf;
+    }
+
+    if (!*buf) {
+        *buf = ogs_malloc(OGS_TUN_MAX_GSO_LEN);
+        ogs_assert(*buf);
+    }
+
+    for (i = 0; i < OGS_UDP_MAX_BATCH; i++) {
+        size = ogs_tun_read_gso(fd, *buf, OGS_TUN_MAX_GSO_LEN, &gso);
+        if (size <= 0) {
+            if (i == 0 && ogs_socket_errno != OGS_EAGAIN)
+                ogs_log_ratelimited(OGS_LOG_WARN, ogs_socket_errno,
+                        "ogs_tun_read_gso() failed");
+            break;
         }
+
+        pkbuf = ogs_tun_gso_next(&gso, NULL, OGS_GTPV1U_HEADER_LEN);
+        if (!pkbuf)
+            continue;
+
+        /* The read lock is held until the end of the burst */
+        if (worker && !worker->locked) {
+            ogs_thread_rwlock_rdlock(&pgw_self()->sess_rwlock);
+            worker->locked = true;
+        }
+
+        /* Every segment has the 5-tuple of the first one */
+        bearer = pgw_bearer_find_by_packet(flow_cache, pkbuf);
+        do {
+            gtp_tun_forward(batch, bearer, pkbuf);
+        } while ((pkbuf = ogs_tun_gso_next(
+                        &gso, NULL, OGS_GTPV1U_HEADER_LEN)));
     }
 
-    ogs_pkbuf_free(recvbuf);
+    /* End of the burst, so send them to SGW at once */
+    ogs_gtp_batch_flush(batch);
+
+    if (worker && worker->locked) {
+        ogs_thread_rwlock_rdunlock(&pgw_self()->sess_rwlock);
+        worker->locked = false;
+    }
+}
+
+static ogs_poll_t *gtp_tun_add_recv(ogs_pollset_t *pollset,
+        pgw_dev_t *dev, ogs_socket_t fd, pgw_gtp_worker_t *worker)
+{
+    ogs_assert(dev);
+
+    /* A super-packet does not fit the receive buffers of the pollset */
+    if (dev->offload)
+        return ogs_pollset_add(pollset, OGS_POLLIN, fd,
+                _gtpv1_tun_gso_cb, worker);
+
+    return ogs_pollset_add_recv(pollset, fd, NULL, OGS_GTPV1U_HEADER_LEN,
+            _gtpv1_tun_recv_cb, worker);
+}
+
+static void gtp_worker_main(void *data)
+{
+    pgw_gtp_worker_t *worker = data;
+    ogs_assert(worker);
+
+    while (!worker->terminated)
+        ogs_pollset_poll(worker->pollset, OGS_INFINITE_TIME);
+}
+
+static int gtp_worker_open(void)
+{
+    pgw_gtp_worker_t *worker = NULL;
+    pgw_dev_t *dev = NULL;
+    int i, rv;
+
+    gtp_worker = ogs_calloc(pgw_self()->num_of_worker, sizeof *gtp_worker);
+    ogs_assert(gtp_worker);
+
+    for (i = 0; i < pgw_self()->num_of_worker; i++) {
+        worker = &gtp_worker[i];
+
+        worker->pollset = ogs_pollset_create();
+        ogs_assert(worker->pollset);
+
+        worker->flow_cache.size = pgw_self()->flow_cache.size;
+        rv = pgw_dl_flow_cache_init(&worker->flow_cache);
+        if (rv != OGS_OK) return rv;
+
+        for (dev = pgw_dev_first(); dev; dev = pgw_dev_next(dev)) {
+            ogs_socket_t fd = INVALID_SOCKET;
+
+            /* The first queue is also used for uplink in PGW main thread */
+            if (i == 0) {
+                fd = dev->fd;
+            } else {
+                fd = ogs_tun_open(dev->ifname, IFNAMSIZ, 0, 1, dev->offload);
+                if (fd == INVALID_SOCKET) {
+                    ogs_error("tun_open(dev:%s, queue:%d) failed",
+                            dev->ifname, i);
+                    return OGS_ERROR;
+                }
+                rv = ogs_nonblocking(fd);
+                ogs_assert(rv == OGS_OK);
+            }
+
+            ogs_assert(worker->num_of_fd < MAX_NUM_OF_DEV);
+            worker->fd[worker->num_of_fd] = fd;
+            worker->poll[worker->num_of_fd] = gtp_tun_add_recv(
+                    worker->pollset, dev, fd, worker);
+            ogs_assert(worker->poll[worker->num_of_fd]);
+            worker->num_of_fd++;
+        }
+
+        worker->thread = ogs_thread_create(gtp_worker_main, worker);
+        if (!worker->thread) return OGS_ERROR;
+    }
+
+    ogs_info("PGW user-plane : %d workers", pgw_self()->num_of_worker);
+
+    return OGS_OK;
 }
 
-static void _gtpv2_c_recv_cb(short when, ogs_socket_t fd, void *data)
+static void gtp_worker_close(void)
+{
+    pgw_gtp_worker_t *worker = NULL;
+    int i, j;
+
+    if (!gtp_worker)
+        return;
+
+    for (i = 0; i < pgw_self()->num_of_worker; i++) {
+        worker = &gtp_worker[i];
+
+        if (worker->thread) {
+            worker->terminated = true;
+            ogs_pollset_notify(worker->pollset);
+            ogs_thread_destroy(worker->thread);
+        }
+
+        for (j = 0; j < worker->num_of_fd; j++) {
+            ogs_pollset_remove(worker->poll[j]);
+            /* The first queue is closed with pgw_dev_t */
+            if (i != 0)
+                ogs_closesocket(worker->fd[j]);
+        }
+
+        pgw_dl_flow_cache_final(&worker->flow_cache);
+
+        if (worker->gso_buf)
+            ogs_free(worker->gso_buf);
+
+        if (worker->pollset)
+            ogs_pollset_destroy(worker->pollset);
+    }
+
+    ogs_free(gtp_worker);
+    gtp_worker = NULL;
+}
+
+void pgw_gtp_flow_cache_stat(pgw_dl_flow_cache_stat_t *stat)
+{
+    int i;
+
+    ogs_assert(stat);
+
+    memset(stat, 0, sizeof *stat);
+    pgw_dl_flow_cache_stat(&pgw_self()->flow_cache, stat);
+
+    if (!gtp_worker)
+        return;
+
+    for (i = 0; i < pgw_self()->num_of_worker; i++)
+        pgw_dl_flow_cache_stat(&gtp_worker[i].flow_cache, stat);
+}
+
+static void _gtpv2_c_recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
 {
     pgw_event_t *e = NULL;
     int rv;
-    ssize_t size;
-    ogs_pkbuf_t *pkbuf = NULL;
-    ogs_sockaddr_t from;
     ogs_gtp_node_t *gnode = NULL;
 
     ogs_assert(fd != INVALID_SOCKET);
 
-    pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
-    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN);
-
-    size = ogs_recvfrom(fd, pkbuf->data, pkbuf->len, 0, &from);
-    if (size <= 0) {
-        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
-                "ogs_recvfrom() failed");
-        ogs_pkbuf_free(pkbuf);
+    if (!pkbuf)
         return;
-    }
-
-    ogs_pkbuf_trim(pkbuf, size);
+    ogs_assert(from);
 
     e = pgw_event_new(PGW_EVT_S5C_MESSAGE);
-    gnode = ogs_gtp_node_find_by_addr(&pgw_self()->sgw_s5c_list, &from);
+    gnode = ogs_gtp_node_find_by_addr(&pgw_self()->sgw_s5c_list, from);
     if (!gnode) {
-        gnode = ogs_gtp_node_add_by_addr(&pgw_self()->sgw_s5c_list, &from);
+        gnode = ogs_gtp_node_add_by_addr(&pgw_self()->sgw_s5c_list, from);
         ogs_assert(gnode);
         gnode->sock = data;
     }
@@ -127,11 +365,9 @@ static void _gtpv2_c_recv_cb(short when, ogs_socket_t fd, void *data)
     }
 }
 
-static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
+static void pgw_gtp_handle_gtpu(ogs_pkbuf_t *pkbuf)
 {
     int rv;
-    ssize_t size;
-    ogs_pkbuf_t *pkbuf = NULL;
     uint32_t len = OGS_GTPV1U_HEADER_LEN;
     ogs_gtp_header_t *gtp_h = NULL;
     struct ip *ip_h = NULL;
@@ -141,20 +377,7 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
     pgw_sess_t *sess = NULL;
     pgw_subnet_t *subnet = NULL;
     pgw_dev_t *dev = NULL;
-
-    ogs_assert(fd != INVALID_SOCKET);
-
-    pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
-    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN);
-
-    size = ogs_recv(fd, pkbuf->data, pkbuf->len, 0);
-    if (size <= 0) {
-        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
-                "ogs_recv() failed");
-        goto cleanup;
-    }
-
-    ogs_pkbuf_trim(pkbuf, size);
+    ssize_t size;
 
     ogs_assert(pkbuf);
     ogs_assert(pkbuf->len);
@@ -173,7 +396,8 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
 
     bearer = pgw_bearer_find_by_pgw_s5u_teid(teid);
     if (!bearer) {
-        ogs_warn("[DROP] Cannot find PGW S5U bearer : TEID[0x%x]", teid);
+        ogs_warn_ratelimited(
+                "[DROP] Cannot find PGW S5U bearer : TEID[0x%x]", teid);
         goto cleanup;
     }
     sess = bearer->sess;
@@ -186,7 +410,8 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
 
     if (!subnet) {
         ogs_log_hexdump(OGS_LOG_TRACE, pkbuf->data, pkbuf->len);
-        ogs_error("[DROP] Cannot find subnet V:%d, IPv4:%p, IPv6:%p",
+        ogs_error_ratelimited(
+                "[DROP] Cannot find subnet V:%d, IPv4:%p, IPv6:%p",
                 ip_h->ip_v, sess->ipv4, sess->ipv6);
         goto cleanup;
     }
@@ -202,13 +427,74 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
 
     dev = subnet->dev;
     ogs_assert(dev);
-    if (ogs_write(dev->fd, pkbuf->data, pkbuf->len) <= 0)
-        ogs_error("ogs_write() failed");
+    if (dev->offload)
+        size = ogs_tun_write_offload(dev->fd, pkbuf->data, pkbuf->len);
+    else
+        size = ogs_write(dev->fd, pkbuf->data, pkbuf->len);
+    if (size <= 0)
+        ogs_error_ratelimited("ogs_write() failed");
 
 cleanup:
     ogs_pkbuf_free(pkbuf);
 }
 
+static void _gtpv1_u_recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
+{
+    ogs_assert(fd != INVALID_SOCKET);
+
+    /* Nothing is batched on TUN */
+    if (!pkbuf)
+        return;
+
+    pgw_gtp_handle_gtpu(pkbuf);
+}
+
+/*
+ * With pgw.s5u_shm configured, the downlink to a co-located SGW is
+ * pushed to one ring, and the uplink from it is popped from another one
+ * by PGW main thread, like the uplink from GTP-U sockets.
+ */
+static void gtp_shm_open(void)
+{
+    pgw_context_t *self = pgw_self();
+    ogs_sockaddr_t *from = NULL;
+    ogs_poll_t *poll = NULL;
+
+    if (!self->s5u_shm.name)
+        return;
+
+    self->s5u_shm.tx = ogs_gtp_open_shm(self->s5u_shm.name, "dl");
+    self->s5u_shm.rx = ogs_gtp_open_shm(self->s5u_shm.name, "ul");
+    if (!self->s5u_shm.tx || !self->s5u_shm.rx ||
+        ogs_gtp_listen_shm(self->s5u_shm.rx,
+            &self->gtpu_list, &self->gtpu_list6) != OGS_OK) {
+        ogs_warn("S5-U is sent over UDP [%s]", self->s5u_shm.name);
+        if (self->s5u_shm.tx) ogs_shmring_close(self->s5u_shm.tx);
+        if (self->s5u_shm.rx) ogs_shmring_close(self->s5u_shm.rx);
+        self->s5u_shm.tx = self->s5u_shm.rx = NULL;
+        return;
+    }
+
+    from = self->gtpu_addr ? self->gtpu_addr : self->gtpu_addr6;
+    ogs_shmring_connect(self->s5u_shm.tx, from);
+
+    poll = ogs_shmring_add_recv(self->pollset, self->s5u_shm.rx,
+            NULL, 0, _gtpv1_u_recv_cb, NULL);
+    ogs_assert(poll);
+
+    ogs_info("S5-U through shared memory [%s]", self->s5u_shm.name);
+}
+
+static void gtp_shm_close(void)
+{
+    pgw_context_t *self = pgw_self();
+
+    if (self->s5u_shm.rx) ogs_shmring_close(self->s5u_shm.rx);
+    if (self->s5u_shm.tx) ogs_shmring_close(self->s5u_shm.tx);
+    self->s5u_shm.tx = self->s5u_shm.rx = NULL;
+}
+
 int pgw_gtp_open(void)
 {
     pgw_dev_t *dev = NULL;
@@ -221,15 +507,15 @@ int pgw_gtp_open(void)
         sock = ogs_gtp_server(node);
         ogs_assert(sock);
         
-        node->poll = ogs_pollset_add(pgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv2_c_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(pgw_self()->pollset,
+                sock->fd, NULL, 0, _gtpv2_c_recv_cb, sock);
     }
     ogs_list_for_each(&pgw_self()->gtpc_list6, node) {
         sock = ogs_gtp_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(pgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv2_c_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(pgw_self()->pollset,
+                sock->fd, NULL, 0, _gtpv2_c_recv_cb, sock);
     }
 
     pgw_self()->gtpc_sock = ogs_gtp_local_sock_first(&pgw_self()->gtpc_list);
@@ -240,18 +526,24 @@ int pgw_gtp_open(void)
     ogs_assert(pgw_self()->gtpc_addr || pgw_self()->gtpc_addr6);
 
     ogs_list_for_each(&pgw_self()->gtpu_list, node) {
-        sock = ogs_gtp_server(node);
+        sock = ogs_gtpu_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(pgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv1_u_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(pgw_self()->pollset,
+                sock->fd, NULL, 0, _gtpv1_u_recv_cb, sock);
+        if (sock->xsk)
+            ogs_xsk_add_recv(pgw_self()->pollset,
+                    sock->xsk, NULL, 0, _gtpv1_u_recv_cb, sock);
     }
     ogs_list_for_each(&pgw_self()->gtpu_list6, node) {
-        sock = ogs_gtp_server(node);
+        sock = ogs_gtpu_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(pgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv1_u_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(pgw_self()->pollset,
+                sock->fd, NULL, 0, _gtpv1_u_recv_cb, sock);
+        if (sock->xsk)
+            ogs_xsk_add_recv(pgw_self()->pollset,
+                    sock->xsk, NULL, 0, _gtpv1_u_recv_cb, sock);
     }
 
     pgw_self()->gtpu_sock = ogs_gtp_local_sock_first(&pgw_self()->gtpu_list);
@@ -261,6 +553,8 @@ int pgw_gtp_open(void)
 
     ogs_assert(pgw_self()->gtpu_addr || pgw_self()->gtpu_addr6);
 
+    gtp_shm_open();
+
     /* NOTE : tun device can be created via following command.
      *
      * $ sudo ip tuntap add name ogstun mode tun
@@ -274,15 +568,38 @@ int pgw_gtp_open(void)
 
     /* Open Tun interface */
     for (dev = pgw_dev_first(); dev; dev = pgw_dev_next(dev)) {
-        dev->fd = ogs_tun_open(dev->ifname, IFNAMSIZ, 0);
+        dev->offload = pgw_self()->tun_offload;
+        dev->fd = ogs_tun_open(dev->ifname, IFNAMSIZ, 0,
+                pgw_self()->num_of_worker ? 1 : 0, dev->offload);
+        if (dev->fd == INVALID_SOCKET && dev->offload) {
+            ogs_warn("TUN offload not available : dev[%s]", dev->ifname);
+            dev->offload = false;
+            dev->fd = ogs_tun_open(dev->ifname, IFNAMSIZ, 0,
+                    pgw_self()->num_of_worker ? 1 : 0, 0);
+        }
         if (dev->fd == INVALID_SOCKET) {
             ogs_error("tun_open(dev:%s) failed", dev->ifname);
             return OGS_ERROR;
         }
 
-        dev->poll = ogs_pollset_add(pgw_self()->pollset,
-                OGS_POLLIN, dev->fd, _gtpv1_tun_recv_cb, NULL);
-        ogs_assert(dev->poll);
+        /* Each wakeup drains the queue until EAGAIN */
+        rc = ogs_nonblocking(dev->fd);
+        ogs_assert(rc == OGS_OK);
+
+        /* Otherwise, the TUN queues are polled by user-plane workers */
+        if (!pgw_self()->num_of_worker) {
+            dev->poll = gtp_tun_add_recv(pgw_self()->pollset,
+                    dev, dev->fd, NULL);
+            ogs_assert(dev->poll);
+        }
+    }
+
+    if (pgw_self()->num_of_worker) {
+        rc = gtp_worker_open();
+        if (rc != OGS_OK) {
+            ogs_error("gtp_worker_open() failed");
+            return OGS_ERROR;
+        }
     }
 
     /* 
@@ -317,15 +634,25 @@ void pgw_gtp_close(void)
 {
     pgw_dev_t *dev = NULL;
 
+    /* Workers send on GTP-U sockets, so stop them first */
+    gtp_worker_close();
+    gtp_shm_close();
+
     ogs_socknode_remove_all(&pgw_self()->gtpc_list);
     ogs_socknode_remove_all(&pgw_self()->gtpc_list6);
     ogs_socknode_remove_all(&pgw_self()->gtpu_list);
     ogs_socknode_remove_all(&pgw_self()->gtpu_list6);
 
     for (dev = pgw_dev_first(); dev; dev = pgw_dev_next(dev)) {
-        ogs_pollset_remove(dev->poll);
+        if (dev->poll)
+            ogs_pollset_remove(dev->poll);
         ogs_closesocket(dev->fd);
     }
+
+    if (gso_buf) {
+        ogs_free(gso_buf);
+        gso_buf = NULL;
+    }
 }
 
 static int pgw_gtp_handle_multicast(ogs_pkbuf_t *recvbuf)
@@ -396,10 +723,9 @@ static int pgw_gtp_handle_slaac(pgw_sess_t *sess, ogs_pkbuf_t *recvbuf)
     return OGS_OK;
 }
 
-static int pgw_gtp_send_to_bearer(pgw_bearer_t *bearer, ogs_pkbuf_t *sendbuf)
+static void pgw_gtp_encap(pgw_bearer_t *bearer, ogs_pkbuf_t *sendbuf)
 {
     char buf[OGS_ADDRSTRLEN];
-    int rv;
     ogs_gtp_header_t *gtp_h = NULL;
 
     ogs_assert(bearer);
@@ -424,9 +750,13 @@ static int pgw_gtp_send_to_bearer(pgw_bearer_t *bearer, ogs_pkbuf_t *sendbuf)
     ogs_debug("[PGW] SEND GPU-U to SGW[%s] : TEID[0x%x]",
         OGS_ADDR(&bearer->gnode->remote_addr, buf),
         bearer->sgw_s5u_teid);
-    rv =  ogs_gtp_sendto(bearer->gnode, sendbuf);
+}
 
-    return rv;
+static int pgw_gtp_send_to_bearer(pgw_bearer_t *bearer, ogs_pkbuf_t *sendbuf)
+{
+    pgw_gtp_encap(bearer, sendbuf);
+
+    return ogs_gtp_sendto(bearer->gnode, sendbuf);
 }
 
 static int pgw_gtp_send_router_advertisement(
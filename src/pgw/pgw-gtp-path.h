@@ -30,6 +30,9 @@ extern "C" {
 int pgw_gtp_open(void);
 void pgw_gtp_close(void);
 
+/* Sum of the downlink flow caches of PGW main thread and every worker */
+void pgw_gtp_flow_cache_stat(struct pgw_dl_flow_cache_stat_s *stat);
+
 #ifdef __cplusplus
 }
 #endif
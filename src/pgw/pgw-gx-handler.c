@@ -67,7 +67,7 @@ void pgw_gx_handle_cca_initial_request(
     ogs_assert(rv == OGS_OK);
 
     rv = bearer_binding(sess, gx_message);
-    ogs_assert(rv == OGS_OK);
+    ogs_expect(rv == OGS_OK);
 }
 
 void pgw_gx_handle_cca_termination_request(
@@ -115,7 +115,7 @@ void pgw_gx_handle_re_auth_request(
     int rv;
 
     rv = bearer_binding(sess, gx_message);
-    ogs_assert(rv == OGS_OK);
+    ogs_expect(rv == OGS_OK);
 }
 
 static int bearer_binding(pgw_sess_t *sess, ogs_diam_gx_message_t *gx_message)
@@ -230,7 +230,15 @@ static int bearer_binding(pgw_sess_t *sess, ogs_diam_gx_message_t *gx_message)
 
             xact = ogs_gtp_xact_local_create(
                     sess->gnode, &h, pkbuf, timeout, sess);
-            ogs_assert(xact);
+            if (!xact) {
+                ogs_error_ratelimited("[PGW] No GTP transaction for "
+                        "%s Bearer Request",
+                        bearer_created == 1 ? "Create" : "Update");
+                ogs_pkbuf_free(pkbuf);
+                if (bearer_created == 1)
+                    pgw_bearer_remove(bearer);
+                return OGS_ERROR;
+            }
 
             rv = ogs_gtp_xact_commit(xact);
             ogs_assert(rv == OGS_OK);
@@ -247,7 +255,12 @@ static int bearer_binding(pgw_sess_t *sess, ogs_diam_gx_message_t *gx_message)
 
             xact = ogs_gtp_xact_local_create(
                     sess->gnode, &h, pkbuf, timeout, sess);
-            ogs_assert(xact);
+            if (!xact) {
+                ogs_error_ratelimited("[PGW] No GTP transaction for "
+                        "Delete Bearer Request");
+                ogs_pkbuf_free(pkbuf);
+                return OGS_ERROR;
+            }
 
             rv = ogs_gtp_xact_commit(xact);
             ogs_assert(rv == OGS_OK);
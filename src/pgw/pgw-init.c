@@ -18,6 +18,7 @@
  */
 
 #include "pgw-context.h"
+#include "pgw-ipfw.h"
 #include "pgw-event.h"
 #include "pgw-sm.h"
 
@@ -35,12 +36,16 @@ int pgw_initialize()
     pgw_context_init();
     pgw_event_init();
 
-    rv = ogs_gtp_xact_init(pgw_self()->timer_mgr, 512);
+    rv = ogs_gtp_xact_init(pgw_self()->timer_mgr,
+            ogs_config()->pool.xact);
     if (rv != OGS_OK) return rv;
 
     rv = pgw_context_parse_config();
     if (rv != OGS_OK) return rv;
 
+    rv = pgw_dl_flow_cache_init(&pgw_self()->flow_cache);
+    if (rv != OGS_OK) return rv;
+
     rv = ogs_log_config_domain(
             ogs_config()->logger.domain, ogs_config()->logger.level);
     if (rv != OGS_OK) return rv;
@@ -69,6 +74,7 @@ void pgw_terminate(void)
 
     pgw_fd_final();
 
+    pgw_dl_flow_cache_final(&pgw_self()->flow_cache);
     pgw_context_final();
 
     ogs_gtp_xact_final();
@@ -88,14 +94,19 @@ static void pgw_main(void *data)
         ogs_pollset_poll(pgw_self()->pollset,
                 ogs_timer_mgr_next(pgw_self()->timer_mgr));
 
-        /* Process the MESSAGE FIRST.
+        /* Sessions are only modified while holding the write lock,
+         * so that user-plane workers see a consistent view of them.
+         *
+         * Process the MESSAGE FIRST.
          *
          * For example, if UE Context Release Complete is received,
          * the MME_TIMER_UE_CONTEXT_RELEASE is first stopped */
         for ( ;; ) {
-            pgw_event_t *e = NULL;
+            pgw_event_t *e[MAX_NUM_OF_EVENT_BATCH];
+            int i;
 
-            rv = ogs_queue_trypop(pgw_self()->queue, (void**)&e);
+            rv = ogs_queue_trypop_many(pgw_self()->queue,
+                    (void**)e, MAX_NUM_OF_EVENT_BATCH);
             ogs_assert(rv != OGS_ERROR);
 
             if (rv == OGS_DONE)
@@ -104,18 +115,29 @@ static void pgw_main(void *data)
             if (rv == OGS_RETRY)
                 break;
 
-            ogs_assert(e);
-            ogs_fsm_dispatch(&pgw_sm, e);
-            pgw_event_free(e);
+            /* Take the write lock once for the whole batch */
+            ogs_thread_rwlock_wrlock(&pgw_self()->sess_rwlock);
+            for (i = 0; i < rv; i++) {
+                ogs_assert(e[i]);
+                ogs_fsm_dispatch(&pgw_sm, e[i]);
+                pgw_event_free(e[i]);
+            }
+            pgw_dl_filter_commit();
+            ogs_thread_rwlock_wrunlock(&pgw_self()->sess_rwlock);
         }
 
+        ogs_thread_rwlock_wrlock(&pgw_self()->sess_rwlock);
         ogs_timer_mgr_expire(pgw_self()->timer_mgr);
+        pgw_dl_filter_commit();
+        ogs_thread_rwlock_wrunlock(&pgw_self()->sess_rwlock);
 
         /* AND THEN, process the TIMER. */
         for ( ;; ) {
-            pgw_event_t *e = NULL;
+            pgw_event_t *e[MAX_NUM_OF_EVENT_BATCH];
+            int i;
 
-            rv = ogs_queue_trypop(pgw_self()->queue, (void**)&e);
+            rv = ogs_queue_trypop_many(pgw_self()->queue,
+                    (void**)e, MAX_NUM_OF_EVENT_BATCH);
             ogs_assert(rv != OGS_ERROR);
 
             if (rv == OGS_DONE)
@@ -124,9 +146,15 @@ static void pgw_main(void *data)
             if (rv == OGS_RETRY)
                 break;
 
-            ogs_assert(e);
-            ogs_fsm_dispatch(&pgw_sm, e);
-            pgw_event_free(e);
+            /* Take the write lock once for the whole batch */
+            ogs_thread_rwlock_wrlock(&pgw_self()->sess_rwlock);
+            for (i = 0; i < rv; i++) {
+                ogs_assert(e[i]);
+                ogs_fsm_dispatch(&pgw_sm, e[i]);
+                pgw_event_free(e[i]);
+            }
+            pgw_dl_filter_commit();
+            ogs_thread_rwlock_wrunlock(&pgw_self()->sess_rwlock);
         }
     }
 done:
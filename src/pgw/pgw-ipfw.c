@@ -236,7 +236,372 @@ static int decode_ipv6_header(
     return OGS_OK;
 }
 
-pgw_bearer_t *pgw_bearer_find_by_packet(ogs_pkbuf_t *pkt)
+/*
+ * All downlink packet filters of a session are flattened into one array
+ * in the order in which they have to be evaluated (dedicated bearers in
+ * creation order, packet filters in installation order). The array is
+ * then partitioned by protocol so that a TCP or UDP packet only visits
+ * the filters that can possibly match it.
+ */
+typedef struct pgw_dl_rule_s {
+    pgw_rule_t      rule;
+    pgw_bearer_t    *bearer;
+} pgw_dl_rule_t;
+
+typedef struct pgw_dl_filter_s {
+    int             num_of_rule;
+    pgw_dl_rule_t   *rule;      /* All rules */
+
+    int             num_of_tcp;
+    uint16_t        *tcp;       /* Index of rules with TCP or any protocol */
+    int             num_of_udp;
+    uint16_t        *udp;       /* Index of rules with UDP or any protocol */
+} pgw_dl_filter_t;
+
+void pgw_dl_filter_compile(pgw_sess_t *sess)
+{
+    pgw_dl_filter_t *dl_filter = NULL;
+    pgw_bearer_t *bearer = NULL;
+    pgw_pf_t *pf = NULL;
+    int i, num_of_rule = 0;
+    size_t size;
+
+    ogs_assert(sess);
+
+    pgw_dl_filter_free(sess);
+
+    bearer = pgw_default_bearer_in_sess(sess);
+    ogs_assert(bearer);
+    for (bearer = pgw_bearer_next(bearer);
+            bearer; bearer = pgw_bearer_next(bearer)) {
+        if (bearer->ebi == 0) {
+            /* Create Bearer Response is not received */
+            continue;
+        }
+
+        for (pf = pgw_pf_first(bearer); pf; pf = pgw_pf_next(pf))
+            if (pf->direction == 1)
+                num_of_rule++;
+    }
+
+    sess->dl_filter_stale = false;
+
+    if (!num_of_rule)
+        return;
+
+    ogs_assert(num_of_rule <= UINT16_MAX);
+
+    size = sizeof(*dl_filter) + num_of_rule * sizeof(pgw_dl_rule_t) +
+            2 * num_of_rule * sizeof(uint16_t);
+    dl_filter = ogs_calloc(1, size);
+    ogs_assert(dl_filter);
+
+    dl_filter->rule = (pgw_dl_rule_t *)(dl_filter + 1);
+    dl_filter->tcp = (uint16_t *)(dl_filter->rule + num_of_rule);
+    dl_filter->udp = dl_filter->tcp + num_of_rule;
+
+    bearer = pgw_default_bearer_in_sess(sess);
+    for (bearer = pgw_bearer_next(bearer);
+            bearer; bearer = pgw_bearer_next(bearer)) {
+        if (bearer->ebi == 0)
+            continue;
+
+        for (pf = pgw_pf_first(bearer); pf; pf = pgw_pf_next(pf)) {
+            pgw_dl_rule_t *dl_rule = NULL;
+
+            if (pf->direction != 1)
+                continue;
+
+            dl_rule = &dl_filter->rule[dl_filter->num_of_rule];
+            memcpy(&dl_rule->rule, &pf->rule, sizeof(pgw_rule_t));
+            dl_rule->bearer = bearer;
+            dl_filter->num_of_rule++;
+        }
+    }
+    ogs_assert(dl_filter->num_of_rule == num_of_rule);
+
+    for (i = 0; i < dl_filter->num_of_rule; i++) {
+        uint8_t proto = dl_filter->rule[i].rule.proto;
+
+        if (proto == 0 || proto == IPPROTO_TCP)
+            dl_filter->tcp[dl_filter->num_of_tcp++] = i;
+        if (proto == 0 || proto == IPPROTO_UDP)
+            dl_filter->udp[dl_filter->num_of_udp++] = i;
+    }
+
+    ogs_debug("[PGW] Compiled %d downlink filters (TCP:%d, UDP:%d)",
+            dl_filter->num_of_rule,
+            dl_filter->num_of_tcp, dl_filter->num_of_udp);
+
+    sess->dl_filter = dl_filter;
+}
+
+void pgw_dl_filter_free(pgw_sess_t *sess)
+{
+    ogs_assert(sess);
+
+    sess->dl_filter_stale = false;
+
+    if (sess->dl_filter) {
+        ogs_free(sess->dl_filter);
+        sess->dl_filter = NULL;
+    }
+}
+
+static bool dl_rule_match(pgw_rule_t *rule,
+        uint32_t *src_addr, uint32_t *dst_addr, int addr_len,
+        uint8_t proto, uint16_t sport, uint16_t dport)
+{
+    int k;
+
+    for (k = 0; k < addr_len / 4; k++) {
+        if ((src_addr[k] & rule->ip.local.mask[k]) != rule->ip.local.addr[k])
+            return false;
+        if ((dst_addr[k] & rule->ip.remote.mask[k]) != rule->ip.remote.addr[k])
+            return false;
+    }
+
+    /* Protocol match */
+    if (rule->proto == 0) /* IP */
+        return true;    /* No need to match port */
+
+    if (rule->proto != proto)
+        return false;
+
+    if (proto != IPPROTO_TCP && proto != IPPROTO_UDP)
+        return true;    /* No need to match port */
+
+    /* Source port */
+    if (rule->port.local.low && sport < rule->port.local.low)
+        return false;
+    if (rule->port.local.high && sport > rule->port.local.high)
+        return false;
+
+    /* Dst Port*/
+    if (rule->port.remote.low && dport < rule->port.remote.low)
+        return false;
+    if (rule->port.remote.high && dport > rule->port.remote.high)
+        return false;
+
+    return true;
+}
+
+static pgw_bearer_t *dl_filter_match(pgw_sess_t *sess,
+        uint32_t *src_addr, uint32_t *dst_addr, int addr_len,
+        uint8_t proto, uint16_t sport, uint16_t dport)
+{
+    pgw_bearer_t *default_bearer = NULL;
+    pgw_dl_filter_t *dl_filter = NULL;
+    uint16_t *index = NULL;
+    int i, num_of_index = 0;
+
+    ogs_assert(sess);
+
+    /* Save the default bearer */
+    default_bearer = pgw_default_bearer_in_sess(sess);
+    ogs_assert(default_bearer);
+
+    /* Found */
+    ogs_debug("[PGW] Found Session : EBI[%d]", default_bearer->ebi);
+
+    /*
+     * Filters are only compiled by pgw_dl_filter_commit() under the write
+     * lock, since user-plane workers may be matching against them.
+     * A stale session is not expected here, and falls back to the default.
+     */
+    if (sess->dl_filter_stale) {
+        ogs_error_ratelimited("[PGW] Stale downlink filter : EBI[%d]",
+                default_bearer->ebi);
+        return default_bearer;
+    }
+
+    dl_filter = sess->dl_filter;
+    if (!dl_filter)
+        return default_bearer;
+
+    if (proto == IPPROTO_TCP) {
+        index = dl_filter->tcp;
+        num_of_index = dl_filter->num_of_tcp;
+    } else if (proto == IPPROTO_UDP) {
+        index = dl_filter->udp;
+        num_of_index = dl_filter->num_of_udp;
+    } else {
+        num_of_index = dl_filter->num_of_rule;
+    }
+
+    for (i = 0; i < num_of_index; i++) {
+        pgw_dl_rule_t *dl_rule = &dl_filter->rule[index ? index[i] : i];
+
+        if (dl_rule_match(&dl_rule->rule, src_addr, dst_addr, addr_len,
+                    proto, sport, dport)) {
+            ogs_debug("Found Dedicated Bearer : EBI[%d]",
+                    dl_rule->bearer->ebi);
+            return dl_rule->bearer;
+        }
+    }
+
+    return default_bearer;
+}
+
+/*
+ * Most downlink packets belong to a few long-lived flows per UE.
+ * The bearer chosen for a 5-tuple is remembered in a direct-mapped cache
+ * so that those packets skip both the session lookup and filter matching.
+ *
+ * An entry is only valid while the generation of its session is unchanged.
+ * pgw_dl_filter_invalidate() assigns a new generation whenever a packet
+ * filter or bearer of the session is added or removed, and also when
+ * the session itself is created or removed.
+ */
+struct pgw_dl_flow_s {
+    uint32_t        src_addr[4];
+    uint32_t        dst_addr[4];
+    uint16_t        sport;
+    uint16_t        dport;
+    uint8_t         proto;
+    uint8_t         addr_len;
+
+    uint64_t        generation;
+    pgw_sess_t      *sess;
+    pgw_bearer_t    *bearer;
+};
+
+static uint64_t dl_filter_generation;
+
+/*
+ * Sessions invalidated while handling the current event.
+ * pgw_dl_filter_commit() compiles them before PGW main thread releases
+ * the session lock, so that user-plane workers never compile filters.
+ * On overflow, the whole session list is scanned instead.
+ */
+#define MAX_NUM_OF_STALE_SESS   64
+static pgw_sess_t *stale_sess[MAX_NUM_OF_STALE_SESS];
+static int num_of_stale_sess;
+static bool stale_sess_overflow;
+
+void pgw_dl_filter_invalidate(pgw_sess_t *sess)
+{
+    ogs_assert(sess);
+
+    if (!sess->dl_filter_stale) {
+        if (num_of_stale_sess < MAX_NUM_OF_STALE_SESS)
+            stale_sess[num_of_stale_sess++] = sess;
+        else
+            stale_sess_overflow = true;
+    }
+
+    sess->dl_filter_stale = true;
+    sess->dl_filter_generation = ++dl_filter_generation;
+}
+
+void pgw_dl_filter_commit(void)
+{
+    pgw_sess_t *sess = NULL;
+    int i;
+
+    if (stale_sess_overflow) {
+        ogs_list_for_each(&pgw_self()->sess_list, sess) {
+            if (sess->dl_filter_stale)
+                pgw_dl_filter_compile(sess);
+        }
+    } else {
+        /* A removed session is no longer stale, so it is skipped here */
+        for (i = 0; i < num_of_stale_sess; i++) {
+            if (stale_sess[i]->dl_filter_stale)
+                pgw_dl_filter_compile(stale_sess[i]);
+        }
+    }
+
+    num_of_stale_sess = 0;
+    stale_sess_overflow = false;
+}
+
+int pgw_dl_flow_cache_init(pgw_dl_flow_cache_t *cache)
+{
+    int size;
+
+    ogs_assert(cache);
+    ogs_assert(cache->entry == NULL);
+
+    size = cache->size;
+    if (size <= 0) {
+        cache->size = 0;
+        return OGS_OK;
+    }
+
+    /* Round up to a power of 2 so that the hash can be masked */
+    if (size & (size - 1)) {
+        int shift = 0;
+        while ((1 << shift) < size)
+            shift++;
+        size = 1 << shift;
+    }
+
+    cache->entry = calloc(size, sizeof(pgw_dl_flow_t));
+    if (!cache->entry) {
+        ogs_error("Cannot allocate downlink flow cache [%d]", size);
+        return OGS_ERROR;
+    }
+    cache->size = size;
+    cache->hit = 0;
+    cache->miss = 0;
+    cache->evicted = 0;
+
+    return OGS_OK;
+}
+
+void pgw_dl_flow_cache_final(pgw_dl_flow_cache_t *cache)
+{
+    ogs_assert(cache);
+
+    if (!cache->entry)
+        return;
+
+    ogs_info("Downlink flow cache : %d entries, "
+            "%lu hit, %lu miss, %lu evicted",
+            cache->size, cache->hit, cache->miss, cache->evicted);
+
+    free(cache->entry);
+    cache->entry = NULL;
+}
+
+/*
+ * Adds the counters of the cache to stat, so that the caches of
+ * several threads can be summed up. It can be called from any thread.
+ */
+void pgw_dl_flow_cache_stat(pgw_dl_flow_cache_t *cache,
+        pgw_dl_flow_cache_stat_t *stat)
+{
+    ogs_assert(cache);
+    ogs_assert(stat);
+
+    stat->size = cache->size;
+    stat->hit += ogs_atomic_load(&cache->hit);
+    stat->miss += ogs_atomic_load(&cache->miss);
+    stat->evicted += ogs_atomic_load(&cache->evicted);
+}
+
+static pgw_dl_flow_t *dl_flow_cache_slot(pgw_dl_flow_cache_t *cache,
+        uint32_t *src_addr, uint32_t *dst_addr, int addr_len,
+        uint8_t proto, uint16_t sport, uint16_t dport)
+{
+    uint32_t hash = proto ^ (sport << 16 | dport);
+    int k;
+
+    for (k = 0; k < addr_len / 4; k++) {
+        hash ^= src_addr[k];
+        hash *= 0x85ebca6b;
+        hash ^= hash >> 13;
+        hash ^= dst_addr[k];
+        hash *= 0xc2b2ae35;
+        hash ^= hash >> 16;
+    }
+
+    return &cache->entry[hash & (cache->size - 1)];
+}
+
+pgw_bearer_t *pgw_bearer_find_by_packet(
+        pgw_dl_flow_cache_t *cache, ogs_pkbuf_t *pkt)
 {
     struct ip *ip_h =  NULL;
     struct ip6_hdr *ip6_h =  NULL;
@@ -245,8 +610,11 @@ pgw_bearer_t *pgw_bearer_find_by_packet(ogs_pkbuf_t *pkt)
     int addr_len = 0;
     uint8_t proto = 0;
     uint16_t ip_hlen = 0;
+    uint16_t sport = 0, dport = 0;
     char buf[OGS_ADDRSTRLEN];
     pgw_sess_t *sess = NULL;
+    pgw_bearer_t *bearer = NULL;
+    pgw_dl_flow_t *flow = NULL;
 
     ogs_assert(pkt);
     ogs_assert(pkt->len);
@@ -272,8 +640,35 @@ pgw_bearer_t *pgw_bearer_find_by_packet(ogs_pkbuf_t *pkt)
         dst_addr = (uint32_t *)ip6_h->ip6_dst.s6_addr;
         addr_len = 16;
 
-    } else
-        ogs_error("Invalid IP version = %d", ip_h->ip_v);
+    } else {
+        ogs_error_ratelimited("Invalid IP version = %d", ip_h->ip_v);
+        return NULL;
+    }
+
+    if (proto == IPPROTO_TCP) {
+        struct tcphdr *tcph = (struct tcphdr *)((char *)pkt->data + ip_hlen);
+        sport = ntohs(tcph->th_sport);
+        dport = ntohs(tcph->th_dport);
+    } else if (proto == IPPROTO_UDP) {
+        struct udphdr *udph = (struct udphdr *)((char *)pkt->data + ip_hlen);
+        sport = ntohs(udph->uh_sport);
+        dport = ntohs(udph->uh_dport);
+    }
+
+    if (cache && cache->entry) {
+        flow = dl_flow_cache_slot(cache,
+                src_addr, dst_addr, addr_len, proto, sport, dport);
+        if (flow->sess &&
+            flow->generation == flow->sess->dl_filter_generation &&
+            flow->addr_len == addr_len && flow->proto == proto &&
+            flow->sport == sport && flow->dport == dport &&
+            memcmp(flow->dst_addr, dst_addr, addr_len) == 0 &&
+            memcmp(flow->src_addr, src_addr, addr_len) == 0) {
+            cache->hit++;
+            return flow->bearer;
+        }
+        cache->miss++;
+    }
 
     ogs_debug("[PGW] PROTO:%d SRC:%08x %08x %08x %08x",
             proto, ntohl(src_addr[0]), ntohl(src_addr[1]),
@@ -282,180 +677,42 @@ pgw_bearer_t *pgw_bearer_find_by_packet(ogs_pkbuf_t *pkt)
             ip_hlen, ntohl(dst_addr[0]), ntohl(dst_addr[1]),
             ntohl(dst_addr[2]), ntohl(dst_addr[3]));
 
-
-    /* TODO: Need to use the method of FAST matching algorithm and 
-     *          implementation .
-     *       Until be ready, linear searching will be use to find the bearer.
-     */
-
-    ogs_list_for_each(&pgw_self()->sess_list, sess) {
-        if (sess->ipv4)
-            ogs_debug("[PGW] PAA IPv4:%s",
-                    INET_NTOP(&sess->ipv4->addr, buf));
-        if (sess->ipv6)
-            ogs_debug("[PGW] PAA IPv6:%s",
-                    INET6_NTOP(&sess->ipv6->addr, buf));
-
-        if ((sess->ipv4 && memcmp(dst_addr, sess->ipv4->addr, addr_len) == 0) ||
-            (sess->ipv6 && memcmp(dst_addr, sess->ipv6->addr, addr_len) == 0)) {
-            pgw_bearer_t *default_bearer = NULL;
-            pgw_bearer_t *bearer = NULL;
-
-            /* Save the default bearer */
-            default_bearer = pgw_default_bearer_in_sess(sess);
-            ogs_assert(default_bearer);
-
-            /* Found */
-            ogs_debug("[PGW] Found Session : EBI[%d]", default_bearer->ebi);
-
-            bearer = pgw_bearer_next(default_bearer);
-            /* Find the bearer with matched */
-            for (; bearer; bearer = pgw_bearer_next(bearer)) {
-                pgw_pf_t *pf = NULL;
-
-                if (bearer->ebi == 0) {
-                    /* Create Bearer Response is not received */
-                    continue;
-                }
-
-                for (pf = pgw_pf_first(bearer); pf; pf = pgw_pf_next(pf)) {
-                    int k;
-                    uint32_t src_mask[4];
-                    uint32_t dst_mask[4];
-
-                    ogs_debug("DIR:%d PROTO:%d SRC:%d-%d DST:%d-%d",
-                            pf->direction, pf->rule.proto,
-                            pf->rule.port.local.low,
-                            pf->rule.port.local.high,
-                            pf->rule.port.remote.low,
-                            pf->rule.port.remote.high);
-                    ogs_debug("SRC:%08x %08x %08x %08x/%08x %08x %08x %08x",
-                            ntohl(pf->rule.ip.local.addr[0]),
-                            ntohl(pf->rule.ip.local.addr[1]),
-                            ntohl(pf->rule.ip.local.addr[2]),
-                            ntohl(pf->rule.ip.local.addr[3]),
-                            ntohl(pf->rule.ip.local.mask[0]),
-                            ntohl(pf->rule.ip.local.mask[1]),
-                            ntohl(pf->rule.ip.local.mask[2]),
-                            ntohl(pf->rule.ip.local.mask[3]));
-                    ogs_debug("DST:%08x %08x %08x %08x/%08x %08x %08x %08x",
-                            ntohl(pf->rule.ip.remote.addr[0]),
-                            ntohl(pf->rule.ip.remote.addr[1]),
-                            ntohl(pf->rule.ip.remote.addr[2]),
-                            ntohl(pf->rule.ip.remote.addr[3]),
-                            ntohl(pf->rule.ip.remote.mask[0]),
-                            ntohl(pf->rule.ip.remote.mask[1]),
-                            ntohl(pf->rule.ip.remote.mask[2]),
-                            ntohl(pf->rule.ip.remote.mask[3]));
-
-                    if (pf->direction != 1) {
-                        continue;
-                    }
-
-                    for (k = 0; k < 4; k++) {
-                        src_mask[k] = src_addr[k] & pf->rule.ip.local.mask[k];
-                        dst_mask[k] = dst_addr[k] & pf->rule.ip.remote.mask[k];
-                    }
-
-                    if (memcmp(src_mask, pf->rule.ip.local.addr,
-                                addr_len) == 0 &&
-                        memcmp(dst_mask, pf->rule.ip.remote.addr,
-                                addr_len) == 0) {
-                        /* Protocol match */
-                        if (pf->rule.proto == 0) { /* IP */
-                            /* No need to match port */
-                            break;
-                        }
-
-                        if (pf->rule.proto == proto) {
-                            if (pf->rule.proto == IPPROTO_TCP) {
-                                struct tcphdr *tcph = 
-                                    (struct tcphdr *)
-                                    ((char *)pkt->data + ip_hlen);
-
-                                /* Source port */
-                                if (pf->rule.port.local.low && 
-                                      ntohs(tcph->th_sport) < 
-                                              pf->rule.port.local.low) {
-                                    continue;
-                                }
-
-                                if (pf->rule.port.local.high && 
-                                      ntohs(tcph->th_sport) > 
-                                              pf->rule.port.local.high) {
-                                    continue;
-                                }
-
-                                /* Dst Port*/
-                                if (pf->rule.port.remote.low && 
-                                      ntohs(tcph->th_dport) < 
-                                              pf->rule.port.remote.low) {
-                                    continue;
-                                }
-
-                                if (pf->rule.port.remote.high && 
-                                      ntohs(tcph->th_dport) > 
-                                              pf->rule.port.remote.high) {
-                                    continue;
-                                }
-
-                                /* Matched */
-                                break;
-                            } else if (pf->rule.proto == IPPROTO_UDP) {
-                                struct udphdr *udph = 
-                                    (struct udphdr *)
-                                    ((char *)pkt->data + ip_hlen);
-
-                                /* Source port */
-                                if (pf->rule.port.local.low && 
-                                      ntohs(udph->uh_sport) < 
-                                              pf->rule.port.local.low) {
-                                    continue;
-                                }
-
-                                if (pf->rule.port.local.high && 
-                                      ntohs(udph->uh_sport) > 
-                                              pf->rule.port.local.high) {
-                                    continue;
-                                }
-
-                                /* Dst Port*/
-                                if (pf->rule.port.remote.low && 
-                                      ntohs(udph->uh_dport) < 
-                                              pf->rule.port.remote.low) {
-                                    continue;
-                                }
-
-                                if (pf->rule.port.remote.high && 
-                                      ntohs(udph->uh_dport) > 
-                                              pf->rule.port.remote.high) {
-                                    continue;
-                                }
-
-                                /* Matched */
-                                break;
-                            } else {
-                                /* No need to match port */
-                                break;
-                            }
-
-                        }
-                    }
-
-                }
-
-                if (pf) {
-                    bearer = pf->bearer;
-                    ogs_debug("Found Dedicated Bearer : EBI[%d]", bearer->ebi);
-                    break;
-                }
-
-            }
-
-            return (bearer ? bearer : default_bearer);
-        }
+    if (ip_h)
+        sess = pgw_sess_find_by_ipv4(dst_addr[0]);
+    else
+        sess = pgw_sess_find_by_ipv6(dst_addr);
+
+    if (!sess)
+        return NULL;
+
+    if (sess->ipv4)
+        ogs_debug("[PGW] PAA IPv4:%s",
+                INET_NTOP(&sess->ipv4->addr, buf));
+    if (sess->ipv6)
+        ogs_debug("[PGW] PAA IPv6:%s",
+                INET6_NTOP(&sess->ipv6->addr, buf));
+
+    bearer = dl_filter_match(sess,
+            src_addr, dst_addr, addr_len, proto, sport, dport);
+    ogs_assert(bearer);
+
+    /* Not cached, or it would outlive the stale filter */
+    if (flow && !sess->dl_filter_stale) {
+        if (flow->sess &&
+            flow->generation == flow->sess->dl_filter_generation)
+            cache->evicted++;
+
+        memcpy(flow->src_addr, src_addr, addr_len);
+        memcpy(flow->dst_addr, dst_addr, addr_len);
+        flow->sport = sport;
+        flow->dport = dport;
+        flow->proto = proto;
+        flow->addr_len = addr_len;
+
+        flow->generation = sess->dl_filter_generation;
+        flow->sess = sess;
+        flow->bearer = bearer;
     }
 
-    return NULL;
+    return bearer;
 }
-
@@ -27,7 +27,18 @@ extern "C" {
 #endif
 
 int pgw_compile_packet_filter(pgw_rule_t *pf, char *description);
-pgw_bearer_t *pgw_bearer_find_by_packet(ogs_pkbuf_t *pkt);
+
+void pgw_dl_filter_compile(pgw_sess_t *sess);
+void pgw_dl_filter_invalidate(pgw_sess_t *sess);
+void pgw_dl_filter_commit(void);
+void pgw_dl_filter_free(pgw_sess_t *sess);
+
+int pgw_dl_flow_cache_init(pgw_dl_flow_cache_t *cache);
+void pgw_dl_flow_cache_final(pgw_dl_flow_cache_t *cache);
+void pgw_dl_flow_cache_stat(pgw_dl_flow_cache_t *cache,
+        pgw_dl_flow_cache_stat_t *stat);
+pgw_bearer_t *pgw_bearer_find_by_packet(
+        pgw_dl_flow_cache_t *cache, ogs_pkbuf_t *pkt);
 
 #ifdef __cplusplus
 }
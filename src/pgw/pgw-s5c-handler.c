@@ -19,6 +19,7 @@
 
 #include "pgw-event.h"
 #include "pgw-context.h"
+#include "pgw-ipfw.h"
 #include "pgw-gtp-path.h"
 #include "pgw-fd-path.h"
 #include "pgw-s5c-handler.h"
@@ -117,6 +118,7 @@ void pgw_s5c_handle_create_session_request(
         rv = ogs_gtp_connect(
                 pgw_self()->gtpu_sock, pgw_self()->gtpu_sock6, sgw);
         ogs_assert(rv == OGS_OK);
+        ogs_gtp_connect_shm(sgw, pgw_self()->s5u_shm.tx);
     }
     /* Setup GTP Node */
     OGS_SETUP_GTP_NODE(bearer, sgw);
@@ -220,6 +222,9 @@ void pgw_s5c_handle_create_bearer_response(
     /* Set EBI */
     bearer->ebi = req->bearer_contexts.eps_bearer_id.u8;
 
+    /* The bearer now takes part in downlink packet filtering */
+    pgw_dl_filter_invalidate(sess);
+
     /* Data Plane(DL) : SGW-S5U */
     sgw_s5u_teid = req->bearer_contexts.s5_s8_u_sgw_f_teid.data;
     bearer->sgw_s5u_teid = ntohl(sgw_s5u_teid->teid);
@@ -234,6 +239,7 @@ void pgw_s5c_handle_create_bearer_response(
 
         rv = ogs_gtp_connect(pgw_self()->gtpu_sock, pgw_self()->gtpu_sock6, sgw);
         ogs_assert(rv == OGS_OK);
+        ogs_gtp_connect_shm(sgw, pgw_self()->s5u_shm.tx);
     }
     /* Setup GTP Node */
     OGS_SETUP_GTP_NODE(bearer, sgw);
@@ -52,15 +52,26 @@ void sgw_context_init(void)
     ogs_list_init(&self.enb_s1u_list);
     ogs_list_init(&self.pgw_s5u_list);
 
-    ogs_pool_init(&sgw_ue_pool, ogs_config()->pool.ue);
-    ogs_pool_init(&sgw_sess_pool, ogs_config()->pool.sess);
-    ogs_pool_init(&sgw_bearer_pool, ogs_config()->pool.bearer);
-    ogs_pool_init(&sgw_tunnel_pool, ogs_config()->pool.tunnel);
-
-    self.imsi_ue_hash = ogs_hash_make();
+    ogs_pool_init_segmented(&sgw_ue_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.ue),
+            ogs_config()->pool.ue);
+    ogs_pool_init_segmented(&sgw_sess_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.sess),
+            ogs_config()->pool.sess);
+    ogs_pool_init_segmented(&sgw_bearer_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.bearer),
+            ogs_config()->pool.bearer);
+    ogs_pool_init_segmented(&sgw_tunnel_pool,
+            OGS_POOL_CHUNK_SIZE(ogs_config()->pool.tunnel),
+            ogs_config()->pool.tunnel);
+
+    self.imsi_ue_hash = ogs_hash_make_incremental();
 
     ogs_list_init(&self.sgw_ue_list);
 
+    ogs_thread_rwlock_init(&self.tunnel_rwlock);
+    ogs_thread_mutex_init(&self.buffer.mutex);
+
     context_initialized = 1;
 }
 
@@ -70,9 +81,19 @@ void sgw_context_final(void)
 
     sgw_ue_remove_all();
 
+    ogs_info("Downlink buffer : BUFFERED[%llu] FLUSHED[%llu] "
+            "DROPPED[%llu] EVICTED[%llu]",
+            (unsigned long long)self.buffer.buffered,
+            (unsigned long long)self.buffer.flushed,
+            (unsigned long long)self.buffer.dropped,
+            (unsigned long long)self.buffer.evicted);
+
     ogs_assert(self.imsi_ue_hash);
     ogs_hash_destroy(self.imsi_ue_hash);
 
+    ogs_thread_mutex_destroy(&self.buffer.mutex);
+    ogs_thread_rwlock_destroy(&self.tunnel_rwlock);
+
     ogs_pool_final(&sgw_tunnel_pool);
     ogs_pool_final(&sgw_bearer_pool);
     ogs_pool_final(&sgw_sess_pool);
@@ -97,6 +118,11 @@ static int sgw_context_prepare(void)
     self.gtpc_port = OGS_GTPV2_C_UDP_PORT;
     self.gtpu_port = OGS_GTPV1_U_UDP_PORT;
 
+    self.buffer.max_size = 64*1024*1024;
+    self.buffer.ue_max_size = 1024*1024;
+    self.buffer.ue_max_packet = 512;
+    self.buffer.policy = SGW_BUFFER_DROP_NEWEST;
+
     return OGS_OK;
 }
 
@@ -114,6 +140,16 @@ static int sgw_context_validation(void)
                 ogs_config()->file);
         return OGS_RETRY;
     }
+    if (self.buffer.ue_max_packet < 0) {
+        ogs_error("Invalid sgw.buffer.ue_packet [%d] in '%s'",
+                self.buffer.ue_max_packet, ogs_config()->file);
+        return OGS_ERROR;
+    }
+    if (self.num_of_worker < 0 || self.num_of_worker > MAX_NUM_OF_WORKER) {
+        ogs_error("Invalid sgw.worker [%d] in '%s'",
+                self.num_of_worker, ogs_config()->file);
+        return OGS_ERROR;
+    }
     return OGS_OK;
 }
 
@@ -383,6 +419,36 @@ int sgw_context_parse_config(void)
                                 NULL, self.gtpu_port);
                         ogs_assert(rv == OGS_OK);
                     }
+                } else if (!strcmp(sgw_key, "buffer")) {
+                    ogs_yaml_iter_t buffer_iter;
+                    ogs_yaml_iter_recurse(&sgw_iter, &buffer_iter);
+                    while (ogs_yaml_iter_next(&buffer_iter)) {
+                        const char *buffer_key =
+                            ogs_yaml_iter_key(&buffer_iter);
+                        const char *v = NULL;
+                        ogs_assert(buffer_key);
+                        v = ogs_yaml_iter_value(&buffer_iter);
+                        if (!strcmp(buffer_key, "size")) {
+                            if (v) self.buffer.max_size = atoll(v);
+                        } else if (!strcmp(buffer_key, "ue_size")) {
+                            if (v) self.buffer.ue_max_size = atoll(v);
+                        } else if (!strcmp(buffer_key, "ue_packet")) {
+                            if (v) self.buffer.ue_max_packet = atoi(v);
+                        } else if (!strcmp(buffer_key, "policy")) {
+                            if (v && !strcmp(v, "drop-oldest"))
+                                self.buffer.policy = SGW_BUFFER_DROP_OLDEST;
+                            else if (v && !strcmp(v, "drop-newest"))
+                                self.buffer.policy = SGW_BUFFER_DROP_NEWEST;
+                            else
+                                ogs_warn("unknown buffer policy `%s`", v);
+                        } else
+                            ogs_warn("unknown key `%s`", buffer_key);
+                    }
+                } else if (!strcmp(sgw_key, "worker")) {
+                    const char *v = ogs_yaml_iter_value(&sgw_iter);
+                    if (v) self.num_of_worker = atoi(v);
+                } else if (!strcmp(sgw_key, "s5u_shm")) {
+                    self.s5u_shm.name = ogs_yaml_iter_value(&sgw_iter);
                 }
                 else
                     ogs_warn("unknown key `%s`", sgw_key);
@@ -648,8 +714,6 @@ sgw_bearer_t* sgw_bearer_add(sgw_sess_t *sess)
 
 int sgw_bearer_remove(sgw_bearer_t *bearer)
 {
-    int i;
-
     ogs_assert(bearer);
     ogs_assert(bearer->sess);
 
@@ -658,8 +722,7 @@ int sgw_bearer_remove(sgw_bearer_t *bearer)
     sgw_tunnel_remove_all(bearer);
 
     /* Free the buffered packets */
-    for (i = 0; i < bearer->num_buffered_pkt; i++)
-        ogs_pkbuf_free(bearer->buffered_pkts[i]);
+    sgw_bearer_clear_buffer(bearer);
 
     ogs_pool_free(&sgw_bearer_pool, bearer);
 
@@ -732,6 +795,201 @@ sgw_bearer_t *sgw_bearer_next(sgw_bearer_t *bearer)
     return ogs_list_next(bearer);
 }
 
+/* A buffered packet holds its whole cluster */
+#define BUFFER_SIZE_OF(__pKBUF) ((size_t)(__pKBUF)->cluster->size)
+
+static ogs_pkbuf_t *buffer_pop(sgw_bearer_t *bearer)
+{
+    ogs_pkbuf_t *pkbuf = NULL;
+    sgw_ue_t *sgw_ue = NULL;
+
+    if (!bearer->buffer.num)
+        return NULL;
+
+    sgw_ue = bearer->sgw_ue;
+    ogs_assert(sgw_ue);
+
+    pkbuf = bearer->buffer.pkbuf[bearer->buffer.head];
+    bearer->buffer.head = (bearer->buffer.head + 1) % bearer->buffer.size;
+    ogs_atomic_store(&bearer->buffer.num, bearer->buffer.num - 1);
+    bearer->buffer.bytes -= BUFFER_SIZE_OF(pkbuf);
+
+    sgw_ue->buffer.num--;
+    sgw_ue->buffer.size -= BUFFER_SIZE_OF(pkbuf);
+    self.buffer.size -= BUFFER_SIZE_OF(pkbuf);
+
+    return pkbuf;
+}
+
+static void buffer_release(sgw_bearer_t *bearer)
+{
+    ogs_assert(bearer->buffer.num == 0);
+
+    if (bearer->buffer.pkbuf)
+        ogs_free(bearer->buffer.pkbuf);
+    memset(&bearer->buffer, 0, sizeof bearer->buffer);
+}
+
+/* Whether a packet of this size is within all the limits */
+static bool buffer_fits(sgw_ue_t *sgw_ue, size_t size)
+{
+    return sgw_ue->buffer.num < self.buffer.ue_max_packet &&
+        sgw_ue->buffer.size + size <= self.buffer.ue_max_size &&
+        self.buffer.size + size <= self.buffer.max_size;
+}
+
+/*
+ * Whether dropping the packets of this bearer can make enough room.
+ * What the other bearers and the other UEs hold cannot be freed here.
+ */
+static bool buffer_can_evict(sgw_bearer_t *bearer, size_t size)
+{
+    sgw_ue_t *sgw_ue = bearer->sgw_ue;
+
+    if (sgw_ue->buffer.num + 1 - bearer->buffer.num >
+            self.buffer.ue_max_packet)
+        return false;
+    if (sgw_ue->buffer.size + size >
+            self.buffer.ue_max_size + bearer->buffer.bytes)
+        return false;
+    if (self.buffer.size + size >
+            self.buffer.max_size + bearer->buffer.bytes)
+        return false;
+
+    return true;
+}
+
+/*
+ * Hold a downlink packet until the eNB of the idle UE is known.
+ * Each UE may hold up to ue_max_packet packets and ue_max_size bytes,
+ * and all the UEs share max_size bytes. If a limit is reached, either
+ * this packet or the oldest ones of the bearer are dropped. The oldest
+ * ones are evicted only if that makes enough room, and the packets of
+ * the other bearers and UEs are never dropped to make room.
+ *
+ * A bearer may be relayed by more than one user-plane worker, when its
+ * downlink also arrives through shared memory. The rings and the UE and
+ * global accounting are updated under buffer.mutex.
+ */
+void sgw_bearer_buffer_pkbuf(sgw_bearer_t *bearer, ogs_pkbuf_t *pkbuf)
+{
+    sgw_ue_t *sgw_ue = NULL;
+    size_t size;
+
+    ogs_assert(bearer);
+    ogs_assert(pkbuf);
+    sgw_ue = bearer->sgw_ue;
+    ogs_assert(sgw_ue);
+
+    size = BUFFER_SIZE_OF(pkbuf);
+
+    ogs_thread_mutex_lock(&self.buffer.mutex);
+
+    if (!buffer_fits(sgw_ue, size)) {
+        if (self.buffer.policy == SGW_BUFFER_DROP_NEWEST ||
+                !buffer_can_evict(bearer, size)) {
+            self.buffer.dropped++;
+            ogs_warn_ratelimited("[%s] Downlink buffer full : "
+                    "UE[%d/%d] TOTAL[%d/%d] DROPPED[%llu]",
+                    sgw_ue->imsi_bcd, (int)sgw_ue->buffer.size,
+                    (int)self.buffer.ue_max_size, (int)self.buffer.size,
+                    (int)self.buffer.max_size,
+                    (unsigned long long)self.buffer.dropped);
+
+            ogs_thread_mutex_unlock(&self.buffer.mutex);
+            ogs_pkbuf_free(pkbuf);
+            return;
+        }
+
+        while (!buffer_fits(sgw_ue, size)) {
+            ogs_pkbuf_free(buffer_pop(bearer));
+            self.buffer.evicted++;
+        }
+    }
+
+    if (bearer->buffer.num == bearer->buffer.size) {
+        ogs_pkbuf_t **ring = NULL;
+        int i;
+
+        ring = ogs_malloc(sizeof(*ring) *
+                (bearer->buffer.size ? bearer->buffer.size * 2 : 8));
+        ogs_assert(ring);
+        for (i = 0; i < bearer->buffer.num; i++)
+            ring[i] = bearer->buffer.pkbuf[
+                (bearer->buffer.head + i) % bearer->buffer.size];
+
+        if (bearer->buffer.pkbuf)
+            ogs_free(bearer->buffer.pkbuf);
+        bearer->buffer.pkbuf = ring;
+        bearer->buffer.size = bearer->buffer.size ?
+            bearer->buffer.size * 2 : 8;
+        bearer->buffer.head = 0;
+    }
+
+    bearer->buffer.pkbuf[(bearer->buffer.head + bearer->buffer.num) %
+        bearer->buffer.size] = pkbuf;
+    ogs_atomic_store(&bearer->buffer.num, bearer->buffer.num + 1);
+    bearer->buffer.bytes += size;
+
+    sgw_ue->buffer.num++;
+    sgw_ue->buffer.size += size;
+    self.buffer.size += size;
+    self.buffer.buffered++;
+
+    ogs_thread_mutex_unlock(&self.buffer.mutex);
+}
+
+/* Returns the oldest buffered packet, or NULL once all are flushed */
+ogs_pkbuf_t *sgw_bearer_unbuffer_pkbuf(sgw_bearer_t *bearer)
+{
+    ogs_pkbuf_t *pkbuf = NULL;
+
+    ogs_assert(bearer);
+
+    /* Skip the lock while nothing is buffered, which is the common case */
+    if (!ogs_atomic_load(&bearer->buffer.num))
+        return NULL;
+
+    ogs_thread_mutex_lock(&self.buffer.mutex);
+    pkbuf = buffer_pop(bearer);
+    if (pkbuf)
+        self.buffer.flushed++;
+    if (!bearer->buffer.num)
+        buffer_release(bearer);
+    ogs_thread_mutex_unlock(&self.buffer.mutex);
+
+    return pkbuf;
+}
+
+void sgw_bearer_clear_buffer(sgw_bearer_t *bearer)
+{
+    ogs_pkbuf_t *pkbuf = NULL;
+
+    ogs_assert(bearer);
+
+    ogs_thread_mutex_lock(&self.buffer.mutex);
+    while ((pkbuf = buffer_pop(bearer))) {
+        ogs_pkbuf_free(pkbuf);
+        self.buffer.dropped++;
+    }
+    buffer_release(bearer);
+    ogs_thread_mutex_unlock(&self.buffer.mutex);
+}
+
+void sgw_buffer_stat(sgw_buffer_stat_t *stat)
+{
+    ogs_assert(stat);
+
+    ogs_thread_mutex_lock(&self.buffer.mutex);
+    stat->max_size = self.buffer.max_size;
+    stat->size = self.buffer.size;
+    stat->buffered = self.buffer.buffered;
+    stat->flushed = self.buffer.flushed;
+    stat->dropped = self.buffer.dropped;
+    stat->evicted = self.buffer.evicted;
+    ogs_thread_mutex_unlock(&self.buffer.mutex);
+}
+
 sgw_tunnel_t *sgw_tunnel_add(sgw_bearer_t *bearer, uint8_t interface_type)
 {
     sgw_tunnel_t *tunnel = NULL;
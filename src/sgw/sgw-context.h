@@ -34,6 +34,20 @@ extern int __sgw_log_domain;
 
 typedef struct sgw_tunnel_s sgw_tunnel_t;
 
+typedef enum {
+    SGW_BUFFER_DROP_OLDEST = 0,
+    SGW_BUFFER_DROP_NEWEST,
+} sgw_buffer_policy_e;
+
+typedef struct sgw_buffer_stat_s {
+    size_t          max_size;       /* Bytes for all the UEs */
+    size_t          size;           /* Bytes held right now */
+    uint64_t        buffered;
+    uint64_t        flushed;
+    uint64_t        dropped;        /* Never buffered, or cleared */
+    uint64_t        evicted;        /* Oldest ones making room */
+} sgw_buffer_stat_t;
+
 typedef struct sgw_context_s {
     uint32_t        gtpc_port;      /* Default GTPC port */
     uint32_t        gtpu_port;      /* Default GTPU port */
@@ -64,6 +78,36 @@ typedef struct sgw_context_s {
     ogs_hash_t      *imsi_ue_hash;  /* hash table (IMSI : SGW_UE) */
 
     ogs_list_t      sgw_ue_list;    /* SGW_UE List */
+
+#define MAX_NUM_OF_WORKER           64
+    int             num_of_worker;  /* User-plane worker threads */
+    /* Held for writing by SGW main thread while it mutates UEs, bearers
+     * and tunnels, and for reading by user-plane workers while they relay */
+    ogs_thread_rwlock_t tunnel_rwlock;
+
+    /* S5-U through shared memory with a co-located PGW */
+    struct {
+        const char      *name;
+        ogs_shmring_t   *tx;        /* Uplink to PGW */
+        ogs_shmring_t   *rx;        /* Downlink from PGW */
+    } s5u_shm;
+
+    /* Downlink packets held while the UE is idle */
+    struct {
+        size_t      max_size;       /* Bytes for all the UEs */
+        size_t      ue_max_size;    /* Bytes for each UE */
+        int         ue_max_packet;  /* Packets for each UE */
+        sgw_buffer_policy_e policy;
+
+        size_t      size;           /* Bytes held by the buffered clusters */
+        uint64_t    buffered;
+        uint64_t    flushed;
+        uint64_t    dropped;
+        uint64_t    evicted;
+
+        /* Workers relaying the bearers of the same UE share the counters */
+        ogs_thread_mutex_t mutex;
+    } buffer;
 } sgw_context_t;
 
 typedef struct sgw_ue_s {
@@ -86,6 +130,12 @@ typedef struct sgw_ue_s {
 
     uint32_t        state;
 
+    /* Packets buffered in all the bearers of this UE */
+    struct {
+        size_t      size;
+        int         num;
+    } buffer;
+
     ogs_list_t      sess_list;
 
     ogs_gtp_node_t  *gnode;
@@ -123,11 +173,19 @@ typedef struct sgw_bearer_s {
     ogs_tai_t       tai;
     ogs_e_cgi_t     e_cgi;
 
-    /* Pkts which will be buffered in case of UE-IDLE */
-    uint32_t        num_buffered_pkt;
-
-#define MAX_NUM_OF_PACKET_BUFFER      512 
-    ogs_pkbuf_t*    buffered_pkts[MAX_NUM_OF_PACKET_BUFFER];
+    /*
+     * Pkts which will be buffered in case of UE-IDLE.
+     * The ring is only allocated while there are such packets.
+     * num is stored atomically, so that it can be checked without
+     * buffer.mutex.
+     */
+    struct {
+        ogs_pkbuf_t **pkbuf;
+        int         size;
+        int         head;
+        int         num;
+        size_t      bytes;          /* Bytes held by the buffered clusters */
+    } buffer;
 
     ogs_list_t      tunnel_list;
     sgw_sess_t      *sess;
@@ -184,6 +242,11 @@ sgw_bearer_t *sgw_default_bearer_in_sess(sgw_sess_t *sess);
 sgw_bearer_t *sgw_bearer_first(sgw_sess_t *sess);
 sgw_bearer_t *sgw_bearer_next(sgw_bearer_t *bearer);
 
+void sgw_bearer_buffer_pkbuf(sgw_bearer_t *bearer, ogs_pkbuf_t *pkbuf);
+ogs_pkbuf_t *sgw_bearer_unbuffer_pkbuf(sgw_bearer_t *bearer);
+void sgw_bearer_clear_buffer(sgw_bearer_t *bearer);
+void sgw_buffer_stat(sgw_buffer_stat_t *stat);
+
 sgw_tunnel_t *sgw_tunnel_add(
         sgw_bearer_t *bearer, uint8_t interface_type);
 int sgw_tunnel_remove(sgw_tunnel_t *tunnel);
@@ -22,23 +22,27 @@
 
 static OGS_POOL(pool, sgw_event_t);
 
+/* Events are allocated by the main thread and the GTP-U workers */
+static ogs_thread_mutex_t pool_mutex;
+
 #define EVENT_POOL 32 /* FIXME : 32 */
 void sgw_event_init(void)
 {
     ogs_pool_init(&pool, EVENT_POOL);
+    ogs_thread_mutex_init(&pool_mutex);
 
-    sgw_self()->queue = ogs_queue_create(EVENT_POOL);
+    sgw_self()->pollset = ogs_pollset_create();
+    ogs_assert(sgw_self()->pollset);
+    sgw_self()->queue = ogs_queue_create_type(EVENT_POOL, OGS_QUEUE_MPSC);
     ogs_assert(sgw_self()->queue);
+    ogs_queue_set_pollset(sgw_self()->queue, sgw_self()->pollset);
     sgw_self()->timer_mgr = ogs_timer_mgr_create();
     ogs_assert(sgw_self()->timer_mgr);
-    sgw_self()->pollset = ogs_pollset_create();
-    ogs_assert(sgw_self()->pollset);
 }
 
 void sgw_event_term(void)
 {
     ogs_queue_term(sgw_self()->queue);
-    ogs_pollset_notify(sgw_self()->pollset);
 }
 
 void sgw_event_final(void)
@@ -51,13 +55,16 @@ void sgw_event_final(void)
         ogs_queue_destroy(sgw_self()->queue);
 
     ogs_pool_final(&pool);
+    ogs_thread_mutex_destroy(&pool_mutex);
 }
 
 sgw_event_t *sgw_event_new(sgw_event_e id)
 {
     sgw_event_t *e = NULL;
 
+    ogs_thread_mutex_lock(&pool_mutex);
     ogs_pool_alloc(&pool, &e);
+    ogs_thread_mutex_unlock(&pool_mutex);
     ogs_assert(e);
     e->id = id;
 
@@ -67,7 +74,10 @@ sgw_event_t *sgw_event_new(sgw_event_e id)
 void sgw_event_free(sgw_event_t *e)
 {
     ogs_assert(e);
+
+    ogs_thread_mutex_lock(&pool_mutex);
     ogs_pool_free(&pool, e);
+    ogs_thread_mutex_unlock(&pool_mutex);
 }
 
 const char *sgw_event_get_name(sgw_event_t *e)
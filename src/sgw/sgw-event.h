@@ -50,6 +50,9 @@ typedef struct sgw_event_s {
     sgw_bearer_t *bearer;
 } sgw_event_t;
 
+/* Events popped at once by the main loop */
+#define MAX_NUM_OF_EVENT_BATCH 32
+
 void sgw_event_init(void);
 void sgw_event_term(void);
 void sgw_event_final(void);
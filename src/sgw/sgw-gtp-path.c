@@ -23,29 +23,18 @@
 
 static ogs_pkbuf_pool_t *packet_pool = NULL;
 
-static void _gtpv2_c_recv_cb(short when, ogs_socket_t fd, void *data)
+static void _gtpv2_c_recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
 {
     sgw_event_t *e = NULL;
     int rv;
-    ssize_t size;
-    ogs_pkbuf_t *pkbuf = NULL;
-    ogs_sockaddr_t from;
     ogs_gtp_node_t *gnode = NULL;
 
     ogs_assert(fd != INVALID_SOCKET);
 
-    pkbuf = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
-    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN);
-
-    size = ogs_recvfrom(fd, pkbuf->data, pkbuf->len, 0, &from);
-    if (size <= 0) {
-        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
-                "ogs_recvfrom() failed");
-        ogs_pkbuf_free(pkbuf);
+    if (!pkbuf)
         return;
-    }
-
-    ogs_pkbuf_trim(pkbuf, size);
+    ogs_assert(from);
 
     /*
      * 5.5.2 in spec 29.274
@@ -76,17 +65,17 @@ static void _gtpv2_c_recv_cb(short when, ogs_socket_t fd, void *data)
      *   However in this case, the cause code shall not be set to
      *   "Context not found".
      */
-    gnode = ogs_gtp_node_find_by_addr(&sgw_self()->pgw_s5c_list, &from);
+    gnode = ogs_gtp_node_find_by_addr(&sgw_self()->pgw_s5c_list, from);
     if (gnode) {
         e = sgw_event_new(SGW_EVT_S5C_MESSAGE);
         ogs_assert(e);
         e->gnode = gnode;
     } else {
         e = sgw_event_new(SGW_EVT_S11_MESSAGE);
-        gnode = ogs_gtp_node_find_by_addr(&sgw_self()->mme_s11_list, &from);
+        gnode = ogs_gtp_node_find_by_addr(&sgw_self()->mme_s11_list, from);
         if (!gnode) {
             gnode = ogs_gtp_node_add_by_addr(
-                    &sgw_self()->mme_s11_list, &from);
+                    &sgw_self()->mme_s11_list, from);
             ogs_assert(gnode);
             gnode->sock = data;
         }
@@ -104,50 +93,64 @@ static void _gtpv2_c_recv_cb(short when, ogs_socket_t fd, void *data)
     }
 }
 
-static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
+/*
+ * GTP-U is received and relayed in batches. The pollset hands off
+ * a burst of datagrams, and the relayed ones are sent together
+ * once the whole burst is handled.
+ *
+ * With sgw.worker configured, each user-plane worker polls its own
+ * GTP-U sockets bound with SO_REUSEPORT, and the kernel steers
+ * a datagram to the worker of its TEID. The first worker polls
+ * the sockets opened for SGW main thread.
+ *
+ * Workers only read UEs, bearers and tunnels while holding the read
+ * lock. SGW main thread keeps ownership of every update.
+ */
+typedef struct sgw_gtp_worker_s {
+    ogs_thread_t    *thread;
+    ogs_pollset_t   *pollset;
+    bool            terminated;
+
+    ogs_list_t      gtpu_list;      /* GTPU IPv4 Server List */
+    ogs_list_t      gtpu_list6;     /* GTPU IPv6 Server List */
+
+    ogs_gtp_batch_t tx_batch;
+    bool            locked;     /* Read lock is held during a burst */
+} sgw_gtp_worker_t;
+
+static sgw_gtp_worker_t *gtp_worker;
+
+static ogs_gtp_batch_t tx_batch; /* Used by SGW main thread */
+
+static void sgw_gtp_handle_gtpu(ogs_gtp_batch_t *batch,
+        ogs_socket_t fd, ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from)
 {
     char buf[OGS_ADDRSTRLEN];
     int rv;
-    ssize_t size;
-    ogs_pkbuf_t *pkbuf = NULL;
-    ogs_sockaddr_t from;
     ogs_gtp_header_t *gtp_h = NULL;
     sgw_bearer_t *bearer = NULL;
     sgw_tunnel_t *tunnel = NULL;
+    ogs_pkbuf_t *buffered = NULL;
     uint32_t teid;
-    int i;
 
-    ogs_assert(fd != INVALID_SOCKET);
-    ogs_assert(packet_pool);
-
-    pkbuf = ogs_pkbuf_alloc(packet_pool, OGS_MAX_SDU_LEN);
-    ogs_pkbuf_put(pkbuf, OGS_MAX_SDU_LEN);
-
-    size = ogs_recvfrom(fd, pkbuf->data, pkbuf->len, 0, &from);
-    if (size <= 0) {
-        ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
-                "ogs_recvfrom() failed");
-        ogs_pkbuf_free(pkbuf);
-        return;
-    }
-
-    ogs_pkbuf_trim(pkbuf, size);
+    ogs_assert(pkbuf);
+    ogs_assert(from);
 
     gtp_h = (ogs_gtp_header_t *)pkbuf->data;
     if (gtp_h->type == OGS_GTPU_MSGTYPE_ECHO_REQ) {
         ogs_pkbuf_t *echo_rsp;
 
         ogs_debug("[SGW] RECV Echo Request from [%s]",
-                OGS_ADDR(&from, buf));
+                OGS_ADDR(from, buf));
         echo_rsp = ogs_gtp_handle_echo_req(pkbuf);
         if (echo_rsp) {
             ssize_t sent;
 
             /* Echo reply */
             ogs_debug("[SGW] SEND Echo Response to [%s]",
-                    OGS_ADDR(&from, buf));
+                    OGS_ADDR(from, buf));
 
-            sent = ogs_sendto(fd, echo_rsp->data, echo_rsp->len, 0, &from);
+            sent = ogs_sendto(fd, echo_rsp->data, echo_rsp->len, 0, from);
             if (sent < 0 || sent != echo_rsp->len) {
                 ogs_log_message(OGS_LOG_ERROR, ogs_socket_errno,
                         "ogs_sendto() failed");
@@ -159,19 +162,21 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
         teid = ntohl(gtp_h->teid);
         if (gtp_h->type == OGS_GTPU_MSGTYPE_GPDU)
             ogs_debug("[SGW] RECV GPU-U from [%s] : TEID[0x%x]",
-                    OGS_ADDR(&from, buf), teid);
+                    OGS_ADDR(from, buf), teid);
         else if (gtp_h->type == OGS_GTPU_MSGTYPE_END_MARKER)
             ogs_debug("[SGW] RECV End Marker from [%s] : TEID[0x%x]",
-                    OGS_ADDR(&from, buf), teid);
+                    OGS_ADDR(from, buf), teid);
 
         tunnel = sgw_tunnel_find_by_teid(teid);
         if (!tunnel) {
             if (gtp_h->type == OGS_GTPU_MSGTYPE_GPDU)
-                ogs_warn("[SGW] RECV GPU-U from [%s] : No TEID[0x%x]",
-                        OGS_ADDR(&from, buf), teid);
+                ogs_warn_ratelimited(
+                        "[SGW] RECV GPU-U from [%s] : No TEID[0x%x]",
+                        OGS_ADDR(from, buf), teid);
             else if (gtp_h->type == OGS_GTPU_MSGTYPE_END_MARKER)
-                ogs_warn("[SGW] RECV End Marker from [%s] : No TEID[0x%x]",
-                        OGS_ADDR(&from, buf), teid);
+                ogs_warn_ratelimited(
+                        "[SGW] RECV End Marker from [%s] : No TEID[0x%x]",
+                        OGS_ADDR(from, buf), teid);
             ogs_pkbuf_free(pkbuf);
             return;
         }
@@ -191,7 +196,8 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
                 s5u_tunnel->remote_teid);
 
             gtp_h->teid = htonl(s5u_tunnel->remote_teid);
-            ogs_gtp_sendto(s5u_tunnel->gnode, pkbuf);
+            ogs_gtp_batch_sendto(batch, s5u_tunnel->gnode, pkbuf);
+            return;
         } else if (tunnel->interface_type ==
                     OGS_GTP_F_TEID_SGW_GTP_U_FOR_DL_DATA_FORWARDING ||
                 tunnel->interface_type ==
@@ -208,7 +214,8 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
                 indirect_tunnel->remote_teid);
 
             gtp_h->teid = htonl(indirect_tunnel->remote_teid);
-            ogs_gtp_sendto(indirect_tunnel->gnode, pkbuf);
+            ogs_gtp_batch_sendto(batch, indirect_tunnel->gnode, pkbuf);
+            return;
         } else if (tunnel->interface_type == OGS_GTP_F_TEID_S5_S8_SGW_GTP_U) {
             sgw_tunnel_t *s1u_tunnel = NULL;
 
@@ -223,19 +230,19 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
                     s1u_tunnel->remote_teid);
 
                 /* If there is buffered packet, send it first */
-                for (i = 0; i < bearer->num_buffered_pkt; i++) {
+                while ((buffered = sgw_bearer_unbuffer_pkbuf(bearer))) {
                     ogs_gtp_header_t *gtp_h = NULL;
 
-                    gtp_h = (ogs_gtp_header_t *)bearer->buffered_pkts[i]->data;
+                    gtp_h = (ogs_gtp_header_t *)buffered->data;
                     gtp_h->teid = htonl(s1u_tunnel->remote_teid);
 
-                    ogs_gtp_sendto(s1u_tunnel->gnode, bearer->buffered_pkts[i]);
-                    ogs_pkbuf_free(bearer->buffered_pkts[i]);
+                    ogs_gtp_batch_sendto(batch,
+                            s1u_tunnel->gnode, buffered);
                 }
-                bearer->num_buffered_pkt = 0;
 
                 gtp_h->teid = htonl(s1u_tunnel->remote_teid);
-                ogs_gtp_sendto(s1u_tunnel->gnode, pkbuf);
+                ogs_gtp_batch_sendto(batch, s1u_tunnel->gnode, pkbuf);
+                return;
             } else {
                 /* S1U path is deactivated.
                  * Send downlink_data_notification to MME.
@@ -252,6 +259,9 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
                         SGW_GET_UE_STATE(sgw_ue));
                 if ((SGW_GET_UE_STATE(sgw_ue) & SGW_S1U_INACTIVE)) {
                     ogs_debug("    SGW-S1U Inactive");
+
+                    /* Bearers of the UE may be relayed by other workers */
+                    ogs_thread_mutex_lock(&sgw_self()->buffer.mutex);
                     if (!(SGW_GET_UE_STATE(sgw_ue) & SGW_DL_NOTI_SENT)) {
                         sgw_event_t *e;
 
@@ -263,17 +273,15 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
                         if (rv != OGS_OK) {
                             ogs_error("ogs_queue_push() failed:%d", (int)rv);
                             sgw_event_free(e);
+                        } else {
+                            SGW_SET_UE_STATE(sgw_ue, SGW_DL_NOTI_SENT);
                         }
-
-                        SGW_SET_UE_STATE(sgw_ue, SGW_DL_NOTI_SENT);
                     }
+                    ogs_thread_mutex_unlock(&sgw_self()->buffer.mutex);
 
                     /* Buffer the packet */
-                    if (bearer->num_buffered_pkt < MAX_NUM_OF_PACKET_BUFFER) {
-                        bearer->buffered_pkts[bearer->num_buffered_pkt++] = 
-                            pkbuf;
-                        return;
-                    }
+                    sgw_bearer_buffer_pkbuf(bearer, pkbuf);
+                    return;
                 } else {
                     /* UE is S1U_ACTIVE state but there is no s1u teid */
                     ogs_debug("[SGW] UE is ACITVE but there is no matched "
@@ -286,7 +294,214 @@ static void _gtpv1_u_recv_cb(short when, ogs_socket_t fd, void *data)
     }
 
     ogs_pkbuf_free(pkbuf);
-    return;
+}
+
+static void _gtpv1_u_recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
+{
+    sgw_gtp_worker_t *worker = data; /* NULL in SGW main thread */
+    ogs_gtp_batch_t *batch = NULL;
+
+    ogs_assert(fd != INVALID_SOCKET);
+
+    batch = worker ? &worker->tx_batch : &tx_batch;
+
+    /* End of the burst */
+    if (!pkbuf) {
+        ogs_gtp_batch_flush(batch);
+
+        if (worker && worker->locked) {
+            ogs_thread_rwlock_rdunlock(&sgw_self()->tunnel_rwlock);
+            worker->locked = false;
+        }
+        return;
+    }
+
+    /* The read lock is held until the end of the burst */
+    if (worker && !worker->locked) {
+        ogs_thread_rwlock_rdlock(&sgw_self()->tunnel_rwlock);
+        worker->locked = true;
+    }
+
+    sgw_gtp_handle_gtpu(batch, fd, pkbuf, from);
+}
+
+/*
+ * With sgw.s5u_shm configured, the uplink to a co-located PGW is pushed
+ * to one ring, and the downlink from it is popped from another one by
+ * the first worker, or by SGW main thread.
+ */
+static void gtp_shm_open(ogs_pollset_t *pollset, sgw_gtp_worker_t *worker)
+{
+    sgw_context_t *self = sgw_self();
+    ogs_sockaddr_t *from = NULL;
+    ogs_poll_t *poll = NULL;
+
+    if (!self->s5u_shm.name)
+        return;
+
+    self->s5u_shm.tx = ogs_gtp_open_shm(self->s5u_shm.name, "ul");
+    self->s5u_shm.rx = ogs_gtp_open_shm(self->s5u_shm.name, "dl");
+    if (!self->s5u_shm.tx || !self->s5u_shm.rx ||
+        ogs_gtp_listen_shm(self->s5u_shm.rx,
+            &self->gtpu_list, &self->gtpu_list6) != OGS_OK) {
+        ogs_warn("S5-U is sent over UDP [%s]", self->s5u_shm.name);
+        if (self->s5u_shm.tx) ogs_shmring_close(self->s5u_shm.tx);
+        if (self->s5u_shm.rx) ogs_shmring_close(self->s5u_shm.rx);
+        self->s5u_shm.tx = self->s5u_shm.rx = NULL;
+        return;
+    }
+
+    from = self->gtpu_addr ? self->gtpu_addr : self->gtpu_addr6;
+    ogs_shmring_connect(self->s5u_shm.tx, from);
+
+    poll = ogs_shmring_add_recv(pollset, self->s5u_shm.rx,
+            packet_pool, 0, _gtpv1_u_recv_cb, worker);
+    ogs_assert(poll);
+
+    ogs_info("S5-U through shared memory [%s]", self->s5u_shm.name);
+}
+
+static void gtp_shm_close(void)
+{
+    sgw_context_t *self = sgw_self();
+
+    if (self->s5u_shm.rx) ogs_shmring_close(self->s5u_shm.rx);
+    if (self->s5u_shm.tx) ogs_shmring_close(self->s5u_shm.tx);
+    self->s5u_shm.tx = self->s5u_shm.rx = NULL;
+}
+
+static void gtp_worker_main(void *data)
+{
+    sgw_gtp_worker_t *worker = data;
+    ogs_assert(worker);
+
+    while (!worker->terminated)
+        ogs_pollset_poll(worker->pollset, OGS_INFINITE_TIME);
+}
+
+/* The first worker polls the sockets of SGW main thread */
+static void gtp_worker_listen(sgw_gtp_worker_t *worker,
+        ogs_list_t *list, ogs_list_t *worker_list)
+{
+    ogs_socknode_t *node = NULL, *new = NULL;
+    ogs_sockaddr_t *addr = NULL;
+    int rv;
+
+    ogs_list_for_each(list, node) {
+        ogs_assert(node->sock);
+
+        if (worker == &gtp_worker[0]) {
+            new = node;
+        } else {
+            rv = ogs_copyaddrinfo(&addr, node->addr);
+            ogs_assert(rv == OGS_OK);
+            new = ogs_socknode_add(worker_list, AF_UNSPEC, addr);
+            ogs_assert(new);
+
+            ogs_socknode_reuse_port(new, 1);
+            ogs_assert(ogs_gtpu_server(new));
+        }
+
+        new->poll = ogs_pollset_add_recv(worker->pollset,
+                new->sock->fd, packet_pool, 0, _gtpv1_u_recv_cb, worker);
+        ogs_assert(new->poll);
+    }
+}
+
+static void gtp_worker_steer(ogs_list_t *list)
+{
+    ogs_socknode_t *node = NULL;
+
+    ogs_list_for_each(list, node) {
+        if (ogs_gtpu_steer_by_teid(
+                    node->sock, sgw_self()->num_of_worker) != OGS_OK)
+            ogs_warn("GTP-U is spread to the workers by UDP 4-tuple");
+    }
+}
+
+static int gtp_worker_open(void)
+{
+    sgw_gtp_worker_t *worker = NULL;
+    int i;
+
+    gtp_worker = ogs_calloc(sgw_self()->num_of_worker, sizeof *gtp_worker);
+    ogs_assert(gtp_worker);
+
+    for (i = 0; i < sgw_self()->num_of_worker; i++) {
+        worker = &gtp_worker[i];
+
+        worker->pollset = ogs_pollset_create();
+        ogs_assert(worker->pollset);
+
+        ogs_list_init(&worker->gtpu_list);
+        ogs_list_init(&worker->gtpu_list6);
+
+        gtp_worker_listen(worker, &sgw_self()->gtpu_list, &worker->gtpu_list);
+        gtp_worker_listen(worker,
+                &sgw_self()->gtpu_list6, &worker->gtpu_list6);
+    }
+
+    /* Every socket has joined its SO_REUSEPORT group */
+    gtp_worker_steer(&sgw_self()->gtpu_list);
+    gtp_worker_steer(&sgw_self()->gtpu_list6);
+
+    gtp_shm_open(gtp_worker[0].pollset, &gtp_worker[0]);
+
+    for (i = 0; i < sgw_self()->num_of_worker; i++) {
+        worker = &gtp_worker[i];
+
+        worker->thread = ogs_thread_create(gtp_worker_main, worker);
+        if (!worker->thread) return OGS_ERROR;
+    }
+
+    ogs_info("SGW user-plane : %d workers", sgw_self()->num_of_worker);
+
+    return OGS_OK;
+}
+
+static void gtp_worker_close(void)
+{
+    sgw_gtp_worker_t *worker = NULL;
+    ogs_socknode_t *node = NULL;
+    int i;
+
+    if (!gtp_worker)
+        return;
+
+    for (i = 0; i < sgw_self()->num_of_worker; i++) {
+        worker = &gtp_worker[i];
+
+        if (worker->thread) {
+            worker->terminated = true;
+            ogs_pollset_notify(worker->pollset);
+            ogs_thread_destroy(worker->thread);
+        }
+
+        /* The sockets of SGW main thread are closed in sgw_gtp_close() */
+        if (i == 0) {
+            /* The other workers may still push to the uplink ring */
+            if (sgw_self()->s5u_shm.rx)
+                ogs_shmring_close(sgw_self()->s5u_shm.rx);
+            sgw_self()->s5u_shm.rx = NULL;
+
+            ogs_list_for_each(&sgw_self()->gtpu_list, node) {
+                if (node->poll) ogs_pollset_remove(node->poll);
+                node->poll = NULL;
+            }
+            ogs_list_for_each(&sgw_self()->gtpu_list6, node) {
+                if (node->poll) ogs_pollset_remove(node->poll);
+                node->poll = NULL;
+            }
+        }
+        ogs_socknode_remove_all(&worker->gtpu_list);
+        ogs_socknode_remove_all(&worker->gtpu_list6);
+
+        ogs_pollset_destroy(worker->pollset);
+    }
+
+    ogs_free(gtp_worker);
+    gtp_worker = NULL;
 }
 
 int sgw_gtp_open(void)
@@ -297,7 +512,17 @@ int sgw_gtp_open(void)
     ogs_pkbuf_config_t config;
     memset(&config, 0, sizeof config);
 
-    config.cluster_8192_pool = ogs_config()->pool.packet;
+    /*
+     * Packets are copied out of the receive buffers of the pollset into
+     * the best-fit cluster, so only jumbo frames hold an 8K cluster.
+     */
+    config.cluster_128_pool = ogs_config()->pool.packet / 4;
+    config.cluster_256_pool = ogs_config()->pool.packet / 4;
+    config.cluster_512_pool = ogs_config()->pool.packet / 4;
+    config.cluster_1024_pool = ogs_config()->pool.packet / 4;
+    config.cluster_2048_pool = ogs_config()->pool.packet;
+    config.cluster_8192_pool = ogs_max(
+            ogs_config()->pool.packet / 16, 2 * OGS_UDP_MAX_BATCH);
 
     packet_pool = ogs_pkbuf_pool_create(&config);
 
@@ -305,15 +530,15 @@ int sgw_gtp_open(void)
         sock = ogs_gtp_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(sgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv2_c_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(sgw_self()->pollset,
+                sock->fd, NULL, 0, _gtpv2_c_recv_cb, sock);
     }
     ogs_list_for_each(&sgw_self()->gtpc_list6, node) {
         sock = ogs_gtp_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(sgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv2_c_recv_cb, sock);
+        node->poll = ogs_pollset_add_recv(sgw_self()->pollset,
+                sock->fd, NULL, 0, _gtpv2_c_recv_cb, sock);
     }
 
     sgw_self()->gtpc_sock = ogs_gtp_local_sock_first(&sgw_self()->gtpc_list);
@@ -324,18 +549,32 @@ int sgw_gtp_open(void)
     ogs_assert(sgw_self()->gtpc_addr || sgw_self()->gtpc_addr6);
 
     ogs_list_for_each(&sgw_self()->gtpu_list, node) {
-        sock = ogs_gtp_server(node);
+        if (sgw_self()->num_of_worker)
+            ogs_socknode_reuse_port(node, 1);
+
+        sock = ogs_gtpu_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(sgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv1_u_recv_cb, sock);
+        if (!sgw_self()->num_of_worker)
+            node->poll = ogs_pollset_add_recv(sgw_self()->pollset,
+                    sock->fd, packet_pool, 0, _gtpv1_u_recv_cb, NULL);
+        if (sock->xsk)
+            ogs_xsk_add_recv(sgw_self()->pollset,
+                    sock->xsk, packet_pool, 0, _gtpv1_u_recv_cb, NULL);
     }
     ogs_list_for_each(&sgw_self()->gtpu_list6, node) {
-        sock = ogs_gtp_server(node);
+        if (sgw_self()->num_of_worker)
+            ogs_socknode_reuse_port(node, 1);
+
+        sock = ogs_gtpu_server(node);
         ogs_assert(sock);
 
-        node->poll = ogs_pollset_add(sgw_self()->pollset,
-                OGS_POLLIN, sock->fd, _gtpv1_u_recv_cb, sock);
+        if (!sgw_self()->num_of_worker)
+            node->poll = ogs_pollset_add_recv(sgw_self()->pollset,
+                    sock->fd, packet_pool, 0, _gtpv1_u_recv_cb, NULL);
+        if (sock->xsk)
+            ogs_xsk_add_recv(sgw_self()->pollset,
+                    sock->xsk, packet_pool, 0, _gtpv1_u_recv_cb, NULL);
     }
 
     sgw_self()->gtpu_sock = ogs_gtp_local_sock_first(&sgw_self()->gtpu_list);
@@ -345,11 +584,19 @@ int sgw_gtp_open(void)
 
     ogs_assert(sgw_self()->gtpu_addr || sgw_self()->gtpu_addr6);
 
+    if (sgw_self()->num_of_worker)
+        return gtp_worker_open();
+
+    gtp_shm_open(sgw_self()->pollset, NULL);
+
     return OGS_OK;
 }
 
 void sgw_gtp_close(void)
 {
+    gtp_worker_close();
+    gtp_shm_close();
+
     ogs_socknode_remove_all(&sgw_self()->gtpc_list);
     ogs_socknode_remove_all(&sgw_self()->gtpc_list6);
     ogs_socknode_remove_all(&sgw_self()->gtpu_list);
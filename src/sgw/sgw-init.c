@@ -33,7 +33,8 @@ int sgw_initialize()
     sgw_context_init();
     sgw_event_init();
 
-    rv = ogs_gtp_xact_init(sgw_self()->timer_mgr, 512);
+    rv = ogs_gtp_xact_init(sgw_self()->timer_mgr,
+            ogs_config()->pool.xact);
     if (rv != OGS_OK) return rv;
 
     rv = sgw_context_parse_config();
@@ -78,14 +79,20 @@ static void sgw_main(void *data)
         ogs_pollset_poll(sgw_self()->pollset,
                 ogs_timer_mgr_next(sgw_self()->timer_mgr));
 
-        /* Process the MESSAGE FIRST.
+        /* UEs, bearers and tunnels are only modified while holding
+         * the write lock, so that user-plane workers see a consistent
+         * view of them.
+         *
+         * Process the MESSAGE FIRST.
          *
          * For example, if UE Context Release Complete is received,
          * the MME_TIMER_UE_CONTEXT_RELEASE is first stopped */
         for ( ;; ) {
-            sgw_event_t *e = NULL;
+            sgw_event_t *e[MAX_NUM_OF_EVENT_BATCH];
+            int i;
 
-            rv = ogs_queue_trypop(sgw_self()->queue, (void**)&e);
+            rv = ogs_queue_trypop_many(sgw_self()->queue,
+                    (void**)e, MAX_NUM_OF_EVENT_BATCH);
             ogs_assert(rv != OGS_ERROR);
 
             if (rv == OGS_DONE)
@@ -94,18 +101,27 @@ static void sgw_main(void *data)
             if (rv == OGS_RETRY)
                 break;
 
-            ogs_assert(e);
-            ogs_fsm_dispatch(&sgw_sm, e);
-            sgw_event_free(e);
+            /* Take the write lock once for the whole batch */
+            ogs_thread_rwlock_wrlock(&sgw_self()->tunnel_rwlock);
+            for (i = 0; i < rv; i++) {
+                ogs_assert(e[i]);
+                ogs_fsm_dispatch(&sgw_sm, e[i]);
+                sgw_event_free(e[i]);
+            }
+            ogs_thread_rwlock_wrunlock(&sgw_self()->tunnel_rwlock);
         }
 
+        ogs_thread_rwlock_wrlock(&sgw_self()->tunnel_rwlock);
         ogs_timer_mgr_expire(sgw_self()->timer_mgr);
+        ogs_thread_rwlock_wrunlock(&sgw_self()->tunnel_rwlock);
 
         /* AND THEN, process the TIMER. */
         for ( ;; ) {
-            sgw_event_t *e = NULL;
+            sgw_event_t *e[MAX_NUM_OF_EVENT_BATCH];
+            int i;
 
-            rv = ogs_queue_trypop(sgw_self()->queue, (void**)&e);
+            rv = ogs_queue_trypop_many(sgw_self()->queue,
+                    (void**)e, MAX_NUM_OF_EVENT_BATCH);
             ogs_assert(rv != OGS_ERROR);
 
             if (rv == OGS_DONE)
@@ -114,9 +130,14 @@ static void sgw_main(void *data)
             if (rv == OGS_RETRY)
                 break;
 
-            ogs_assert(e);
-            ogs_fsm_dispatch(&sgw_sm, e);
-            sgw_event_free(e);
+            /* Take the write lock once for the whole batch */
+            ogs_thread_rwlock_wrlock(&sgw_self()->tunnel_rwlock);
+            for (i = 0; i < rv; i++) {
+                ogs_assert(e[i]);
+                ogs_fsm_dispatch(&sgw_sm, e[i]);
+                sgw_event_free(e[i]);
+            }
+            ogs_thread_rwlock_wrunlock(&sgw_self()->tunnel_rwlock);
         }
     }
 done:
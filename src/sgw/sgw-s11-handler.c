@@ -198,7 +198,16 @@ void sgw_s11_handle_create_session_request(ogs_gtp_xact_t *s11_xact,
 
     s5c_xact = ogs_gtp_xact_local_create(
             sess->gnode, &message->h, pkbuf, timeout, sess);
-    ogs_assert(s5c_xact);
+    if (!s5c_xact) {
+        ogs_error_ratelimited("[SGW] No GTP transaction for "
+                "Create Session Request");
+        ogs_pkbuf_free(pkbuf);
+        sgw_sess_remove(sess);
+        ogs_gtp_send_error_message(s11_xact, sgw_ue->mme_s11_teid,
+                OGS_GTP_CREATE_SESSION_RESPONSE_TYPE,
+                OGS_GTP_CAUSE_NO_RESOURCES_AVAILABLE);
+        return;
+    }
 
     ogs_gtp_xact_associate(s11_xact, s5c_xact);
 
@@ -422,7 +431,15 @@ void sgw_s11_handle_delete_session_request(ogs_gtp_xact_t *s11_xact,
 
     s5c_xact = ogs_gtp_xact_local_create(
             sess->gnode, &message->h, pkbuf, timeout, sess);
-    ogs_assert(s5c_xact);
+    if (!s5c_xact) {
+        ogs_error_ratelimited("[SGW] No GTP transaction for "
+                "Delete Session Request");
+        ogs_pkbuf_free(pkbuf);
+        ogs_gtp_send_error_message(s11_xact, sgw_ue->mme_s11_teid,
+                OGS_GTP_DELETE_SESSION_RESPONSE_TYPE,
+                OGS_GTP_CAUSE_NO_RESOURCES_AVAILABLE);
+        return;
+    }
 
     ogs_gtp_xact_associate(s11_xact, s5c_xact);
 
@@ -931,7 +948,17 @@ void sgw_s11_handle_lo_dldata_notification(sgw_bearer_t *bearer)
 
     xact = ogs_gtp_xact_local_create(
             sgw_ue->gnode, &message.h, pkbuf, timeout, sgw_ue);
-    ogs_assert(xact);
+    if (!xact) {
+        ogs_error_ratelimited("[SGW] No GTP transaction for "
+                "Downlink Data Notification");
+        ogs_pkbuf_free(pkbuf);
+
+        /* Let the next downlink packet trigger the notification again */
+        ogs_thread_mutex_lock(&sgw_self()->buffer.mutex);
+        SGW_RESET_UE_STATE(sgw_ue, SGW_DL_NOTI_SENT);
+        ogs_thread_mutex_unlock(&sgw_self()->buffer.mutex);
+        return;
+    }
 
     rv = ogs_gtp_xact_commit(xact);
     ogs_assert(rv == OGS_OK);
@@ -173,6 +173,7 @@ void sgw_s5c_handle_create_session_response(ogs_gtp_xact_t *s5c_xact,
         rv = ogs_gtp_connect(
                 sgw_self()->gtpu_sock, sgw_self()->gtpu_sock6, pgw);
         ogs_assert(rv == OGS_OK);
+        ogs_gtp_connect_shm(pgw, sgw_self()->s5u_shm.tx);
     }
     /* Setup GTP Node */
     OGS_SETUP_GTP_NODE(s5u_tunnel, pgw);
@@ -364,6 +365,7 @@ void sgw_s5c_handle_create_bearer_request(ogs_gtp_xact_t *s5c_xact,
         rv = ogs_gtp_connect(
                 sgw_self()->gtpu_sock, sgw_self()->gtpu_sock6, pgw);
         ogs_assert(rv == OGS_OK);
+        ogs_gtp_connect_shm(pgw, sgw_self()->s5u_shm.tx);
     }
     /* Setup GTP Node */
     OGS_SETUP_GTP_NODE(s5u_tunnel, pgw);
@@ -390,7 +392,16 @@ void sgw_s5c_handle_create_bearer_request(ogs_gtp_xact_t *s5c_xact,
 
     s11_xact = ogs_gtp_xact_local_create(
             sgw_ue->gnode, &message->h, pkbuf, timeout, sess);
-    ogs_assert(s11_xact);
+    if (!s11_xact) {
+        ogs_error_ratelimited("[SGW] No GTP transaction for "
+                "Create Bearer Request");
+        ogs_pkbuf_free(pkbuf);
+        sgw_bearer_remove(bearer);
+        ogs_gtp_send_error_message(s5c_xact, sess->pgw_s5c_teid,
+                OGS_GTP_CREATE_BEARER_RESPONSE_TYPE,
+                OGS_GTP_CAUSE_NO_RESOURCES_AVAILABLE);
+        return;
+    }
 
     ogs_gtp_xact_associate(s5c_xact, s11_xact);
 
@@ -452,7 +463,15 @@ void sgw_s5c_handle_update_bearer_request(ogs_gtp_xact_t *s5c_xact,
 
     s11_xact = ogs_gtp_xact_local_create(
             sgw_ue->gnode, &message->h, pkbuf, timeout, sess);
-    ogs_assert(s11_xact);
+    if (!s11_xact) {
+        ogs_error_ratelimited("[SGW] No GTP transaction for "
+                "Update Bearer Request");
+        ogs_pkbuf_free(pkbuf);
+        ogs_gtp_send_error_message(s5c_xact, sess->pgw_s5c_teid,
+                OGS_GTP_UPDATE_BEARER_RESPONSE_TYPE,
+                OGS_GTP_CAUSE_NO_RESOURCES_AVAILABLE);
+        return;
+    }
 
     ogs_gtp_xact_associate(s5c_xact, s11_xact);
 
@@ -513,7 +532,15 @@ void sgw_s5c_handle_delete_bearer_request(ogs_gtp_xact_t *s5c_xact,
 
     s11_xact = ogs_gtp_xact_local_create(
             sgw_ue->gnode, &message->h, pkbuf, timeout, sess);
-    ogs_assert(s11_xact);
+    if (!s11_xact) {
+        ogs_error_ratelimited("[SGW] No GTP transaction for "
+                "Delete Bearer Request");
+        ogs_pkbuf_free(pkbuf);
+        ogs_gtp_send_error_message(s5c_xact, sess->pgw_s5c_teid,
+                OGS_GTP_DELETE_BEARER_RESPONSE_TYPE,
+                OGS_GTP_CAUSE_NO_RESOURCES_AVAILABLE);
+        return;
+    }
 
     ogs_gtp_xact_associate(s5c_xact, s11_xact);
 
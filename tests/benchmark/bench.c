@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#define BENCH_MAX_THREAD    4
+
+static struct {
+    bool json;
+    int max_thread;
+    uint32_t random;
+} self;
+
+void bench_init(int argc, const char *const argv[])
+{
+    ogs_getopt_t options;
+    int opt;
+
+    memset(&self, 0, sizeof(self));
+    self.max_thread = BENCH_MAX_THREAD;
+    self.random = 2463534242U;
+
+    ogs_getopt_init(&options, (char **)argv);
+    while ((opt = ogs_getopt(&options, "jt:")) != -1) {
+        switch (opt) {
+        case 'j':
+            self.json = true;
+            break;
+        case 't':
+            self.max_thread = atoi(options.optarg);
+            break;
+        case '?':
+        default:
+            fprintf(stderr, "%s: %s\n", argv[0], options.errmsg);
+            fprintf(stderr, "Usage: %s [-j] [-t num]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    ogs_assert(self.max_thread > 0);
+
+    ogs_core_initialize();
+
+    /* Keep the hot loops free of log output */
+    ogs_core()->log.level = OGS_LOG_ERROR;
+    ogs_log_set_mask_level(NULL, OGS_LOG_ERROR);
+
+    if (!self.json)
+        printf("suite,name,param,ops,usec,nsec_per_op\n");
+}
+
+void bench_report(const char *suite, const char *name,
+        uint64_t param, uint64_t ops, ogs_time_t elapsed)
+{
+    ogs_assert(suite);
+    ogs_assert(name);
+    ogs_assert(ops);
+
+    if (self.json)
+        printf("{\"suite\":\"%s\",\"name\":\"%s\",\"param\":%llu,"
+                "\"ops\":%llu,\"usec\":%lld,\"nsec_per_op\":%.2f}\n",
+                suite, name,
+                (unsigned long long)param, (unsigned long long)ops,
+                (long long)elapsed, (double)elapsed * 1000 / ops);
+    else
+        printf("%s,%s,%llu,%llu,%lld,%.2f\n", suite, name,
+                (unsigned long long)param, (unsigned long long)ops,
+                (long long)elapsed, (double)elapsed * 1000 / ops);
+    fflush(stdout);
+}
+
+int bench_max_thread(void)
+{
+    return self.max_thread;
+}
+
+/* xorshift32 from a fixed seed */
+uint32_t bench_random32(void)
+{
+    uint32_t x = self.random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return self.random = x;
+}
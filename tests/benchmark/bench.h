@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEST_BENCH_H
+#define TEST_BENCH_H
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Benchmarks print one CSV record per measurement :
+ *
+ *   suite,name,param,ops,usec,nsec_per_op
+ *
+ * so that results from different builds can be diffed or plotted.
+ *
+ * Options :
+ *   -j         One JSON object per line instead of CSV
+ *   -t num     Up to num threads in multi-threaded benchmarks (default: 4)
+ */
+void bench_init(int argc, const char *const argv[]);
+void bench_report(const char *suite, const char *name,
+        uint64_t param, uint64_t ops, ogs_time_t elapsed);
+
+int bench_max_thread(void);
+
+/* The same sequence in every run, unlike ogs_random32() */
+uint32_t bench_random32(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_BENCH_H */
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#define MAX_NUM_OF_KEY      (10*1000*1000)
+
+/* Multiplying by an odd constant keeps the keys unique */
+#define KEY(__iDX) ((uint32_t)(__iDX) * 2654435761U)
+
+/*
+ * S1AP IDs, eNB IDs and UE IP addresses are all 4 byte keys, so compare
+ * ogs_hash_t against ogs_ohash_t for insert, hit, miss and remove with
+ * uint32_t keys. ogs_hash_t keeps a pointer to the key, so its keys live
+ * in a separate array for the duration of the run.
+ */
+static void bench_hash(int num_of_key)
+{
+    ogs_hash_t *h = NULL;
+    uint32_t *key = NULL, miss;
+    ogs_time_t start;
+    int i, found = 0;
+
+    key = calloc(num_of_key, sizeof *key);
+    ogs_assert(key);
+    for (i = 0; i < num_of_key; i++)
+        key[i] = KEY(i);
+
+    h = ogs_hash_make();
+    ogs_assert(h);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++)
+        ogs_hash_set(h, &key[i], sizeof(uint32_t), &key[i]);
+    bench_report("core", "hash-insert", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++)
+        if (ogs_hash_get(h, &key[i], sizeof(uint32_t))) found++;
+    bench_report("core", "hash-hit", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+    ogs_assert(found == num_of_key);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++) {
+        miss = KEY(num_of_key + i);
+        if (ogs_hash_get(h, &miss, sizeof(uint32_t))) found++;
+    }
+    bench_report("core", "hash-miss", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+    ogs_assert(found == num_of_key);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++)
+        ogs_hash_set(h, &key[i], sizeof(uint32_t), NULL);
+    bench_report("core", "hash-remove", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+    ogs_assert(ogs_hash_count(h) == 0);
+
+    ogs_hash_destroy(h);
+    free(key);
+}
+
+/*
+ * imsi_ue_hash holds one IMSI string per UE. Report the total time and
+ * the slowest single insert, which is where doubling the bucket array
+ * shows up when every entry is rehashed at once.
+ */
+static void bench_hash_insert_worst(bool incremental, int num_of_key)
+{
+    const char *name = incremental ? "incremental" : "default";
+    char label[64];
+    ogs_hash_t *h = NULL;
+    char (*imsi)[OGS_MAX_IMSI_BCD_LEN+1] = NULL;
+    ogs_time_t start, now, prev, worst = 0;
+    int i;
+
+    imsi = calloc(num_of_key, sizeof *imsi);
+    ogs_assert(imsi);
+    for (i = 0; i < num_of_key; i++)
+        ogs_snprintf(imsi[i], sizeof *imsi, "00101%010d", i);
+
+    h = incremental ? ogs_hash_make_incremental() : ogs_hash_make();
+    ogs_assert(h);
+
+    start = prev = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++) {
+        ogs_hash_set(h, imsi[i], OGS_HASH_KEY_STRING, imsi[i]);
+        now = ogs_get_monotonic_time();
+        if (now - prev > worst)
+            worst = now - prev;
+        prev = now;
+    }
+    ogs_snprintf(label, sizeof label, "hash-insert-imsi-%s", name);
+    bench_report("core", label, num_of_key, num_of_key, now - start);
+    ogs_snprintf(label, sizeof label, "hash-insert-imsi-%s-worst", name);
+    bench_report("core", label, num_of_key, 1, worst);
+
+    ogs_hash_destroy(h);
+    free(imsi);
+}
+
+static void bench_ohash(int num_of_key)
+{
+    ogs_ohash_t *h = NULL;
+    ogs_time_t start;
+    int i, found = 0;
+
+    h = ogs_ohash_create(sizeof(uint32_t));
+    ogs_assert(h);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++)
+        ogs_ohash_set_u32(h, KEY(i), (void *)(uintptr_t)(i+1));
+    bench_report("core", "ohash-insert", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++)
+        if (ogs_ohash_get_u32(h, KEY(i))) found++;
+    bench_report("core", "ohash-hit", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+    ogs_assert(found == num_of_key);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++)
+        if (ogs_ohash_get_u32(h, KEY(num_of_key + i))) found++;
+    bench_report("core", "ohash-miss", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+    ogs_assert(found == num_of_key);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_key; i++)
+        ogs_ohash_set_u32(h, KEY(i), NULL);
+    bench_report("core", "ohash-remove", num_of_key, num_of_key,
+            ogs_get_monotonic_time() - start);
+    ogs_assert(ogs_ohash_count(h) == 0);
+
+    ogs_ohash_destroy(h);
+}
+
+int main(int argc, const char *const argv[])
+{
+    ogs_pkbuf_config_t config;
+
+    bench_init(argc, argv);
+
+    /* ogs_hash_t takes one small buffer per entry */
+    ogs_pkbuf_default_init(&config);
+    config.cluster_128_pool = MAX_NUM_OF_KEY + 1024;
+    ogs_pkbuf_default_create(&config);
+
+    bench_hash(1000);
+    bench_hash(100000);
+    bench_hash(MAX_NUM_OF_KEY);
+
+    bench_hash_insert_worst(false, 100000);
+    bench_hash_insert_worst(false, MAX_NUM_OF_KEY);
+    bench_hash_insert_worst(true, 100000);
+    bench_hash_insert_worst(true, MAX_NUM_OF_KEY);
+
+    bench_ohash(1000);
+    bench_ohash(100000);
+    bench_ohash(MAX_NUM_OF_KEY);
+
+    ogs_pkbuf_default_destroy();
+    ogs_core_terminate();
+
+    return 0;
+}
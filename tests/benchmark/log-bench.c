@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <unistd.h>
+
+#include "bench.h"
+
+#define NUM_OF_MESSAGE      10000
+
+/*
+ * Time spent by the calling thread per log message, written to a file
+ * synchronously and in async mode. The ring is sized so that nothing
+ * is dropped.
+ */
+static void bench_log(const char *path, bool async)
+{
+    char label[64];
+    ogs_log_t *log = NULL;
+    ogs_log_stat_t stat;
+    ogs_time_t start;
+    int i;
+
+    log = ogs_log_add_file(path);
+    ogs_assert(log);
+
+    if (async)
+        ogs_log_start_async(NUM_OF_MESSAGE);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < NUM_OF_MESSAGE; i++)
+        ogs_error("[%d] Attach request IMSI[%s] ENB_UE_S1AP_ID[%d]",
+                i, "001010123456789", i);
+    ogs_snprintf(label, sizeof label, "log-%s", async ? "async" : "sync");
+    bench_report("core", label, 0, NUM_OF_MESSAGE,
+            ogs_get_monotonic_time() - start);
+
+    if (async) {
+        ogs_log_flush();
+        ogs_log_stat(&stat);
+        ogs_assert(stat.written == NUM_OF_MESSAGE);
+        ogs_log_stop_async();
+    }
+
+    ogs_log_remove(log);
+}
+
+int main(int argc, const char *const argv[])
+{
+    ogs_pkbuf_config_t config;
+    char path[] = "/tmp/ogs-log-bench-XXXXXX";
+    int fd;
+
+    bench_init(argc, argv);
+
+    ogs_pkbuf_default_init(&config);
+    ogs_pkbuf_default_create(&config);
+
+    fd = mkstemp(path);
+    ogs_assert(fd >= 0);
+    close(fd);
+
+    /* Keep the terminal out of the measurement */
+    ogs_assert(freopen("/dev/null", "w", stderr));
+
+    bench_log(path, false);
+    bench_log(path, true);
+
+    unlink(path);
+
+    ogs_pkbuf_default_destroy();
+    ogs_core_terminate();
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "pgw-context.h"
+#include "pgw-ipfw.h"
+
+#include "bench.h"
+
+#define NUM_OF_LOOKUP       1000000
+#define MAX_NUM_OF_SESS     1000000
+#define MAX_NUM_OF_PF_PER_BEARER    16
+#define MAX_NUM_OF_BEARER   (1 + 64 / MAX_NUM_OF_PF_PER_BEARER)
+
+static void bench_downlink_lookup(int num_of_sess)
+{
+    pgw_sess_t *sess = NULL;
+    pgw_bearer_t *bearer = NULL;
+    pgw_subnet_t *subnet = NULL;
+    ogs_pkbuf_t *pkbuf = NULL;
+    struct ip *ip_h = NULL;
+    struct udphdr *udp_h = NULL;
+    uint32_t *addr = NULL;
+    ogs_paa_t paa;
+    ogs_time_t start;
+    int i;
+
+    ogs_config()->pool.sess = num_of_sess;
+    ogs_config()->pool.bearer = num_of_sess;
+    ogs_config()->pool.pf = num_of_sess;
+
+    pgw_context_init();
+
+    subnet = pgw_subnet_add("10.0.0.1", "8", NULL, "ogstun");
+    ogs_assert(subnet);
+    pgw_ue_pool_generate();
+
+    addr = calloc(num_of_sess, sizeof *addr);
+    ogs_assert(addr);
+
+    for (i = 0; i < num_of_sess; i++) {
+        uint8_t imsi[8];
+        uint32_t id = htonl(i);
+
+        memset(imsi, 0, sizeof imsi);
+        memcpy(imsi+4, &id, sizeof id);
+
+        memset(&paa, 0, sizeof paa);
+        paa.pdn_type = OGS_GTP_PDN_TYPE_IPV4;
+
+        sess = pgw_sess_add(imsi, sizeof imsi, (char *)"internet",
+                OGS_GTP_PDN_TYPE_IPV4, 5, &paa);
+        ogs_assert(sess);
+        addr[i] = sess->ipv4->addr[0];
+    }
+    pgw_dl_filter_commit();
+
+    pkbuf = ogs_pkbuf_alloc(NULL, 128);
+    ogs_assert(pkbuf);
+    ogs_pkbuf_put(pkbuf, sizeof *ip_h + sizeof *udp_h);
+    memset(pkbuf->data, 0, pkbuf->len);
+
+    ip_h = (struct ip *)pkbuf->data;
+    ip_h->ip_v = 4;
+    ip_h->ip_hl = sizeof *ip_h / 4;
+    ip_h->ip_p = IPPROTO_UDP;
+    ip_h->ip_src.s_addr = htonl(0x08080808);
+
+    udp_h = (struct udphdr *)(pkbuf->data + sizeof *ip_h);
+    udp_h->uh_sport = htons(443);
+    udp_h->uh_dport = htons(40000);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < NUM_OF_LOOKUP; i++) {
+        sess = pgw_sess_find_by_ipv4(addr[((uint64_t)i * 7919) % num_of_sess]);
+        ogs_assert(sess);
+    }
+    bench_report("pgw", "sess-find-by-ipv4", num_of_sess,
+            NUM_OF_LOOKUP, ogs_get_monotonic_time() - start);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < NUM_OF_LOOKUP; i++) {
+        /* Stride through the sessions to defeat the CPU cache */
+        ip_h->ip_dst.s_addr = addr[((uint64_t)i * 7919) % num_of_sess];
+        bearer = pgw_bearer_find_by_packet(NULL, pkbuf);
+        ogs_assert(bearer);
+    }
+    bench_report("pgw", "downlink-lookup", num_of_sess,
+            NUM_OF_LOOKUP, ogs_get_monotonic_time() - start);
+
+    ogs_pkbuf_free(pkbuf);
+    free(addr);
+
+    pgw_context_final();
+}
+
+static void bench_dl_classify(int num_of_pf, int flow_cache)
+{
+    pgw_sess_t *sess = NULL;
+    pgw_bearer_t *bearer = NULL;
+    pgw_pf_t *pf = NULL;
+    pgw_subnet_t *subnet = NULL;
+    ogs_pkbuf_t *pkbuf = NULL;
+    struct ip *ip_h = NULL;
+    struct udphdr *udp_h = NULL;
+    uint8_t imsi[8];
+    ogs_paa_t paa;
+    ogs_time_t start;
+    int i;
+
+    ogs_config()->pool.sess = 1;
+    ogs_config()->pool.bearer = MAX_NUM_OF_BEARER;
+    ogs_config()->pool.pf = num_of_pf;
+
+    pgw_context_init();
+
+    pgw_self()->flow_cache.size = flow_cache;
+    pgw_dl_flow_cache_init(&pgw_self()->flow_cache);
+
+    subnet = pgw_subnet_add("10.0.0.1", "8", NULL, "ogstun");
+    ogs_assert(subnet);
+    pgw_ue_pool_generate();
+
+    memset(imsi, 0, sizeof imsi);
+    memset(&paa, 0, sizeof paa);
+    paa.pdn_type = OGS_GTP_PDN_TYPE_IPV4;
+
+    sess = pgw_sess_add(imsi, sizeof imsi, (char *)"internet",
+            OGS_GTP_PDN_TYPE_IPV4, 5, &paa);
+    ogs_assert(sess);
+
+    /* Up to 16 packet filters per dedicated bearer */
+    for (i = 0; i < num_of_pf; i++) {
+        if (i % MAX_NUM_OF_PF_PER_BEARER == 0) {
+            bearer = pgw_bearer_add(sess);
+            ogs_assert(bearer);
+            bearer->ebi = 6 + i / MAX_NUM_OF_PF_PER_BEARER;
+        }
+
+        pf = pgw_pf_add(bearer, 0);
+        ogs_assert(pf);
+        pf->direction = 1;
+        pf->rule.proto = IPPROTO_UDP;
+        pf->rule.port.remote.low = 10000 + i;
+        pf->rule.port.remote.high = 10000 + i;
+    }
+    pgw_dl_filter_commit();
+
+    pkbuf = ogs_pkbuf_alloc(NULL, 128);
+    ogs_assert(pkbuf);
+    ogs_pkbuf_put(pkbuf, sizeof *ip_h + sizeof *udp_h);
+    memset(pkbuf->data, 0, pkbuf->len);
+
+    ip_h = (struct ip *)pkbuf->data;
+    ip_h->ip_v = 4;
+    ip_h->ip_hl = sizeof *ip_h / 4;
+    ip_h->ip_p = IPPROTO_UDP;
+    ip_h->ip_src.s_addr = htonl(0x08080808);
+    ip_h->ip_dst.s_addr = sess->ipv4->addr[0];
+
+    /* Matches the last packet filter */
+    udp_h = (struct udphdr *)(pkbuf->data + sizeof *ip_h);
+    udp_h->uh_sport = htons(443);
+    udp_h->uh_dport = htons(10000 + num_of_pf - 1);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < NUM_OF_LOOKUP; i++) {
+        bearer = pgw_bearer_find_by_packet(
+                &pgw_self()->flow_cache, pkbuf);
+        ogs_assert(bearer == pf->bearer);
+    }
+    bench_report("pgw", flow_cache ?
+                "downlink-classify-flow-cache" : "downlink-classify",
+            num_of_pf, NUM_OF_LOOKUP, ogs_get_monotonic_time() - start);
+
+    ogs_pkbuf_free(pkbuf);
+
+    pgw_dl_flow_cache_final(&pgw_self()->flow_cache);
+    pgw_context_final();
+}
+
+/*
+ * Context setup with the pool sizes derived for num_of_ue UEs,
+ * as pgw_initialize() does it before any session is created.
+ */
+static void bench_startup(int num_of_ue)
+{
+    pgw_subnet_t *subnet = NULL;
+    ogs_time_t start;
+
+    ogs_config()->pool.sess = num_of_ue * OGS_MAX_NUM_OF_SESS;
+    ogs_config()->pool.bearer = ogs_config()->pool.sess * 4;
+    ogs_config()->pool.pf = ogs_config()->pool.bearer * 16;
+
+    start = ogs_get_monotonic_time();
+
+    pgw_context_init();
+
+    subnet = pgw_subnet_add("10.0.0.1", "8", NULL, "ogstun");
+    ogs_assert(subnet);
+    pgw_ue_pool_generate();
+
+    bench_report("pgw", "startup", num_of_ue,
+            1, ogs_get_monotonic_time() - start);
+
+    pgw_context_final();
+}
+
+int main(int argc, const char *const argv[])
+{
+    ogs_pkbuf_config_t config;
+
+    bench_init(argc, argv);
+
+    ogs_pkbuf_default_init(&config);
+    /* Hash entries for IMSI+APN and UE IP of every session */
+    config.cluster_128_pool += 2 * MAX_NUM_OF_SESS;
+    ogs_pkbuf_default_create(&config);
+
+    ogs_config_init();
+
+    bench_startup(4096);
+    bench_startup(65536);
+    bench_startup(262144);
+
+    bench_downlink_lookup(1000);
+    bench_downlink_lookup(10000);
+    bench_downlink_lookup(100000);
+    bench_downlink_lookup(MAX_NUM_OF_SESS);
+
+    bench_dl_classify(1, 0);
+    bench_dl_classify(8, 0);
+    bench_dl_classify(64, 0);
+
+    bench_dl_classify(1, 1024);
+    bench_dl_classify(8, 1024);
+    bench_dl_classify(64, 1024);
+
+    ogs_config_final();
+
+    ogs_pkbuf_default_destroy();
+    ogs_core_terminate();
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#define NUM_OF_PKBUF        (4*1024*1024)
+#define BURST               32
+#define MAX_NUM_OF_THREAD   64
+
+typedef enum {
+    BENCH_ALLOC_FREE,
+    BENCH_COPY,
+} bench_op_e;
+
+typedef struct bench_worker_s {
+    ogs_thread_t *thread;
+    bench_op_e op;
+    bool cache;
+    int size;
+    int count;
+} bench_worker_t;
+
+static void worker_main(void *data)
+{
+    bench_worker_t *worker = data;
+    ogs_pkbuf_t *pkbuf[BURST], *orig = NULL;
+    int i, n;
+
+    /* ogs_thread_create() enables the cache */
+    if (!worker->cache)
+        ogs_pkbuf_cache_final();
+
+    if (worker->op == BENCH_COPY) {
+        orig = ogs_pkbuf_alloc(NULL, worker->size);
+        ogs_assert(orig);
+        memset(ogs_pkbuf_put(orig, worker->size), 0xab, worker->size);
+    }
+
+    for (n = 0; n < worker->count; n += BURST) {
+        for (i = 0; i < BURST; i++) {
+            if (orig) {
+                pkbuf[i] = ogs_pkbuf_copy(orig);
+                ogs_assert(pkbuf[i]);
+            } else {
+                pkbuf[i] = ogs_pkbuf_alloc(NULL, worker->size);
+                ogs_assert(pkbuf[i]);
+                ogs_pkbuf_put(pkbuf[i], worker->size);
+            }
+        }
+        for (i = 0; i < BURST; i++)
+            ogs_pkbuf_free(pkbuf[i]);
+    }
+
+    if (orig)
+        ogs_pkbuf_free(orig);
+}
+
+/*
+ * Each GTP-U thread takes a burst of pkbufs from the shared pool and
+ * frees them once sent. Run the same work on 1..N threads, with and
+ * without the per-thread cache in front of the pool mutex.
+ */
+static void bench_pkbuf(bench_op_e op, bool cache, int size, int num_of_thread)
+{
+    const char *name = op == BENCH_COPY ? "copy" : "alloc-free";
+    char label[64];
+    bench_worker_t worker[MAX_NUM_OF_THREAD];
+    ogs_time_t start;
+    int i;
+
+    ogs_assert(num_of_thread <= MAX_NUM_OF_THREAD);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_thread; i++) {
+        worker[i].op = op;
+        worker[i].cache = cache;
+        worker[i].size = size;
+        worker[i].count = NUM_OF_PKBUF / num_of_thread;
+        worker[i].thread = ogs_thread_create(worker_main, &worker[i]);
+        ogs_assert(worker[i].thread);
+    }
+    for (i = 0; i < num_of_thread; i++)
+        ogs_thread_destroy(worker[i].thread);
+
+    ogs_snprintf(label, sizeof label, "pkbuf-%s-%s-%d",
+            name, cache ? "cached" : "shared", size);
+    bench_report("core", label, num_of_thread,
+            (NUM_OF_PKBUF / num_of_thread) * num_of_thread,
+            ogs_get_monotonic_time() - start);
+}
+
+int main(int argc, const char *const argv[])
+{
+    ogs_pkbuf_config_t config;
+    int i;
+
+    bench_init(argc, argv);
+
+    /* Sized like the packet pool of the SGW and PGW */
+    ogs_pkbuf_default_init(&config);
+    config.cluster_128_pool = 16384;
+    config.cluster_2048_pool = 16384;
+    ogs_pkbuf_default_create(&config);
+
+    for (i = 1; i <= bench_max_thread(); i *= 2) {
+        bench_pkbuf(BENCH_ALLOC_FREE, false, 64, i);
+        bench_pkbuf(BENCH_ALLOC_FREE, true, 64, i);
+        bench_pkbuf(BENCH_ALLOC_FREE, false, 1400, i);
+        bench_pkbuf(BENCH_ALLOC_FREE, true, 1400, i);
+        bench_pkbuf(BENCH_COPY, false, 1400, i);
+        bench_pkbuf(BENCH_COPY, true, 1400, i);
+    }
+
+    ogs_pkbuf_default_destroy();
+    ogs_core_terminate();
+
+    return 0;
+}
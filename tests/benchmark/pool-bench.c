@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#define MAX_NUM_OF_NODE     (1024*1024)
+
+/* About the size of a small context such as a bearer */
+typedef struct bench_node_s {
+    uint8_t data[128];
+} bench_node_t;
+
+static OGS_POOL(pool, bench_node_t);
+
+/*
+ * Contexts are taken from their pool and cleared on attach, and
+ * returned on detach. Measure filling up and draining the pool,
+ * and a steady alloc/free pair on the pool in use.
+ */
+static void bench_pool(bool segmented, int num_of_node)
+{
+    const char *name = segmented ? "segmented" : "default";
+    char label[64];
+    bench_node_t **node = NULL;
+    ogs_time_t start;
+    int i;
+
+    node = calloc(num_of_node, sizeof *node);
+    ogs_assert(node);
+
+    if (segmented)
+        ogs_pool_init_segmented(&pool,
+                OGS_POOL_CHUNK_SIZE(num_of_node), num_of_node);
+    else
+        ogs_pool_init(&pool, num_of_node);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_node; i++) {
+        ogs_pool_alloc(&pool, &node[i]);
+        ogs_assert(node[i]);
+        memset(node[i], 0, sizeof *node[i]);
+    }
+    ogs_snprintf(label, sizeof label, "pool-fill-%s", name);
+    bench_report("core", label, num_of_node, num_of_node,
+            ogs_get_monotonic_time() - start);
+
+    /* Detach in a different order than attach */
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_node; i++)
+        ogs_pool_free(&pool, node[(i * 7) % num_of_node]);
+    ogs_snprintf(label, sizeof label, "pool-drain-%s", name);
+    bench_report("core", label, num_of_node, num_of_node,
+            ogs_get_monotonic_time() - start);
+    ogs_assert(ogs_pool_avail(&pool) == ogs_pool_size(&pool));
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_node; i++) {
+        ogs_pool_alloc(&pool, &node[0]);
+        ogs_assert(node[0]);
+        ogs_pool_free(&pool, node[0]);
+    }
+    ogs_snprintf(label, sizeof label, "pool-alloc-free-%s", name);
+    bench_report("core", label, num_of_node, num_of_node,
+            ogs_get_monotonic_time() - start);
+
+    ogs_pool_final(&pool);
+    free(node);
+}
+
+int main(int argc, const char *const argv[])
+{
+    bench_init(argc, argv);
+
+    bench_pool(false, 1024);
+    bench_pool(false, 65536);
+    bench_pool(false, MAX_NUM_OF_NODE);
+
+    bench_pool(true, 1024);
+    bench_pool(true, 65536);
+    bench_pool(true, MAX_NUM_OF_NODE);
+
+    ogs_core_terminate();
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#define NUM_OF_EVENT        (1024*1024)
+#define QUEUE_CAPACITY      8192
+#define BATCH               32
+#define MAX_NUM_OF_PRODUCER 64
+
+typedef struct bench_producer_s {
+    ogs_queue_t *queue;
+    int count;
+} bench_producer_t;
+
+static void producer_main(void *data)
+{
+    bench_producer_t *producer = data;
+    int i, rv;
+
+    for (i = 0; i < producer->count; i++) {
+        /* A woken producer may find the queue full again */
+        do {
+            rv = ogs_queue_push(producer->queue, (void *)(intptr_t)(i+1));
+        } while (rv == OGS_ERROR);
+        ogs_assert(rv == OGS_OK);
+    }
+}
+
+/*
+ * Mirror the NF main loop : producers push events into the queue,
+ * the consumer is woken up by the pollset and drains the queue either
+ * one event at a time or in batches.
+ */
+static void bench_queue(ogs_queue_type_e type, int num_of_producer, int batch)
+{
+    const char *name = type == OGS_QUEUE_MPSC ? "mpsc" : "mutex";
+    char label[64];
+    ogs_queue_t *queue = NULL;
+    ogs_pollset_t *pollset = NULL;
+    ogs_thread_t *thread[MAX_NUM_OF_PRODUCER];
+    bench_producer_t producer;
+    void *e[BATCH];
+    ogs_time_t start;
+    int i, n, popped = 0, total;
+
+    ogs_assert(num_of_producer <= MAX_NUM_OF_PRODUCER);
+    ogs_assert(batch <= BATCH);
+
+    pollset = ogs_pollset_create();
+    ogs_assert(pollset);
+    queue = ogs_queue_create_type(QUEUE_CAPACITY, type);
+    ogs_assert(queue);
+    ogs_queue_set_pollset(queue, pollset);
+
+    producer.queue = queue;
+    producer.count = NUM_OF_EVENT / num_of_producer;
+    total = producer.count * num_of_producer;
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_producer; i++) {
+        thread[i] = ogs_thread_create(producer_main, &producer);
+        ogs_assert(thread[i]);
+    }
+
+    while (popped < total) {
+        ogs_pollset_poll(pollset, ogs_time_from_msec(100));
+        for ( ;; ) {
+            if (batch == 1)
+                n = ogs_queue_trypop(queue, e) == OGS_OK ? 1 : 0;
+            else
+                n = ogs_queue_trypop_many(queue, e, batch);
+            if (n <= 0)
+                break;
+            popped += n;
+        }
+    }
+    ogs_snprintf(label, sizeof label, "queue-%s-batch%d", name, batch);
+    bench_report("core", label, num_of_producer, total,
+            ogs_get_monotonic_time() - start);
+
+    for (i = 0; i < num_of_producer; i++)
+        ogs_thread_destroy(thread[i]);
+
+    ogs_queue_destroy(queue);
+    ogs_pollset_destroy(pollset);
+}
+
+int main(int argc, const char *const argv[])
+{
+    ogs_pkbuf_config_t config;
+
+    bench_init(argc, argv);
+
+    ogs_pkbuf_default_init(&config);
+    ogs_pkbuf_default_create(&config);
+
+    bench_queue(OGS_QUEUE_MUTEX, 1, 1);
+    bench_queue(OGS_QUEUE_MUTEX, bench_max_thread(), 1);
+    bench_queue(OGS_QUEUE_MUTEX, bench_max_thread(), BATCH);
+
+    bench_queue(OGS_QUEUE_MPSC, 1, 1);
+    bench_queue(OGS_QUEUE_MPSC, bench_max_thread(), 1);
+    bench_queue(OGS_QUEUE_MPSC, bench_max_thread(), BATCH);
+
+    ogs_pkbuf_default_destroy();
+    ogs_core_terminate();
+
+    return 0;
+}
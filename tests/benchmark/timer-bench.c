@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bench.h"
+
+#define MAX_NUM_OF_TIMER    (1024*1024)
+
+static int expired;
+static void bench_expire_func(void *data)
+{
+    expired++;
+}
+
+/*
+ * Every UE and transaction holds a few guard timers which are restarted
+ * on each message, so measure start/restart/stop with a large population
+ * of pending timers spread between 1 and 60 seconds.
+ */
+static void bench_timer(ogs_timer_mgr_type_e type, int num_of_timer)
+{
+    const char *name = type == OGS_TIMER_MGR_WHEEL ? "wheel" : "rbtree";
+    char label[64];
+    ogs_timer_mgr_t *manager = NULL;
+    ogs_timer_t **timer = NULL;
+    ogs_time_t *duration = NULL;
+    ogs_time_t start;
+    int i;
+
+    ogs_core()->timer.pool = num_of_timer;
+    manager = ogs_timer_mgr_create_type(type);
+    ogs_assert(manager);
+
+    timer = calloc(num_of_timer, sizeof *timer);
+    ogs_assert(timer);
+    duration = calloc(num_of_timer, sizeof *duration);
+    ogs_assert(duration);
+
+    for (i = 0; i < num_of_timer; i++) {
+        timer[i] = ogs_timer_add(manager, bench_expire_func, NULL);
+        ogs_assert(timer[i]);
+        duration[i] = ogs_time_from_msec(1000 + bench_random32() % 59000);
+    }
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_timer; i++)
+        ogs_timer_start(timer[i], duration[i]);
+    ogs_snprintf(label, sizeof label, "timer-start-%s", name);
+    bench_report("core", label, num_of_timer, num_of_timer,
+            ogs_get_monotonic_time() - start);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_timer; i++)
+        ogs_timer_start(timer[i], duration[num_of_timer - 1 - i]);
+    ogs_snprintf(label, sizeof label, "timer-restart-%s", name);
+    bench_report("core", label, num_of_timer, num_of_timer,
+            ogs_get_monotonic_time() - start);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_timer; i++)
+        ogs_timer_mgr_next(manager);
+    ogs_snprintf(label, sizeof label, "timer-next-%s", name);
+    bench_report("core", label, num_of_timer, num_of_timer,
+            ogs_get_monotonic_time() - start);
+
+    start = ogs_get_monotonic_time();
+    for (i = 0; i < num_of_timer; i++)
+        ogs_timer_stop(timer[i]);
+    ogs_snprintf(label, sizeof label, "timer-stop-%s", name);
+    bench_report("core", label, num_of_timer, num_of_timer,
+            ogs_get_monotonic_time() - start);
+
+    /* All of them are due at once */
+    for (i = 0; i < num_of_timer; i++)
+        ogs_timer_start(timer[i], 1);
+    ogs_msleep(2); /* More than a tick of the wheel */
+
+    expired = 0;
+    start = ogs_get_monotonic_time();
+    ogs_timer_mgr_expire(manager);
+    ogs_assert(expired == num_of_timer);
+    ogs_snprintf(label, sizeof label, "timer-expire-%s", name);
+    bench_report("core", label, num_of_timer, num_of_timer,
+            ogs_get_monotonic_time() - start);
+
+    for (i = 0; i < num_of_timer; i++)
+        ogs_timer_delete(timer[i]);
+
+    free(duration);
+    free(timer);
+
+    ogs_timer_mgr_destroy(manager);
+}
+
+int main(int argc, const char *const argv[])
+{
+    ogs_pkbuf_config_t config;
+    int pool;
+
+    bench_init(argc, argv);
+
+    ogs_pkbuf_default_init(&config);
+    ogs_pkbuf_default_create(&config);
+
+    pool = ogs_core()->timer.pool;
+
+    bench_timer(OGS_TIMER_MGR_RBTREE, 1000);
+    bench_timer(OGS_TIMER_MGR_RBTREE, 100000);
+    bench_timer(OGS_TIMER_MGR_RBTREE, MAX_NUM_OF_TIMER);
+
+    bench_timer(OGS_TIMER_MGR_WHEEL, 1000);
+    bench_timer(OGS_TIMER_MGR_WHEEL, 100000);
+    bench_timer(OGS_TIMER_MGR_WHEEL, MAX_NUM_OF_TIMER);
+
+    ogs_core()->timer.pool = pool;
+
+    ogs_pkbuf_default_destroy();
+    ogs_core_terminate();
+
+    return 0;
+}
@@ -34,9 +34,12 @@ abts_suite *test_thread(abts_suite *suite);
 abts_suite *test_socket(abts_suite *suite);
 abts_suite *test_queue(abts_suite *suite);
 abts_suite *test_poll(abts_suite *suite);
+abts_suite *test_shmring(abts_suite *suite);
 abts_suite *test_tlv(abts_suite *suite);
 abts_suite *test_fsm(abts_suite *suite);
 abts_suite *test_hash(abts_suite *suite);
+abts_suite *test_ohash(abts_suite *suite);
+abts_suite *test_xsk(abts_suite *suite);
 
 const struct testlist {
     abts_suite *(*func)(abts_suite *suite);
@@ -55,9 +58,12 @@ const struct testlist {
     {test_socket},
     {test_queue},
     {test_poll},
+    {test_shmring},
     {test_tlv},
     {test_fsm},
     {test_hash},
+    {test_ohash},
+    {test_xsk},
     {NULL},
 };
 
@@ -386,6 +386,57 @@ static void hash_count_5(abts_case *tc, void *data)
     ogs_hash_destroy(h);
 }
 
+#define NUM_OF_INCREMENTAL_KEY 5000
+
+static void hash_incremental(abts_case *tc, void *data)
+{
+    ogs_hash_t *h = NULL;
+    ogs_hash_index_t *hi;
+    static int key[NUM_OF_INCREMENTAL_KEY];
+    int i, j, count, missing = 0;
+
+    h = ogs_hash_make_incremental();
+    ABTS_PTR_NOTNULL(tc, h);
+
+    /* Every key stays reachable while the buckets are being moved */
+    for (i = 0; i < NUM_OF_INCREMENTAL_KEY; i++) {
+        key[i] = i;
+        ogs_hash_set(h, &key[i], sizeof(int), &key[i]);
+        for (j = 0; j <= i; j += 1 + i / 64)
+            if (ogs_hash_get(h, &key[j], sizeof(int)) != &key[j])
+                missing++;
+    }
+    ABTS_INT_EQUAL(tc, 0, missing);
+    ABTS_INT_EQUAL(tc, NUM_OF_INCREMENTAL_KEY, ogs_hash_count(h));
+
+    /* Iteration covers both arrays exactly once */
+    count = 0;
+    for (hi = ogs_hash_first(h); hi; hi = ogs_hash_next(hi)) {
+        ABTS_PTR_EQUAL(tc, ogs_hash_this_key(hi), ogs_hash_this_val(hi));
+        count++;
+    }
+    ABTS_INT_EQUAL(tc, NUM_OF_INCREMENTAL_KEY, count);
+
+    /* Replacing a value does not add an entry */
+    ogs_hash_set(h, &key[0], sizeof(int), &key[1]);
+    ABTS_PTR_EQUAL(tc, &key[1], ogs_hash_get(h, &key[0], sizeof(int)));
+    ABTS_INT_EQUAL(tc, NUM_OF_INCREMENTAL_KEY, ogs_hash_count(h));
+
+    for (i = 0; i < NUM_OF_INCREMENTAL_KEY; i += 2)
+        ogs_hash_set(h, &key[i], sizeof(int), NULL);
+    ABTS_INT_EQUAL(tc, NUM_OF_INCREMENTAL_KEY / 2, ogs_hash_count(h));
+    for (i = 1; i < NUM_OF_INCREMENTAL_KEY; i += 2)
+        if (ogs_hash_get(h, &key[i], sizeof(int)) != &key[i])
+            missing++;
+    ABTS_INT_EQUAL(tc, 0, missing);
+
+    ogs_hash_clear(h);
+    ABTS_INT_EQUAL(tc, 0, ogs_hash_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_hash_first(h));
+
+    ogs_hash_destroy(h);
+}
+
 abts_suite *test_hash(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -406,6 +457,7 @@ abts_suite *test_hash(abts_suite *suite)
     abts_run_test(suite, hash_clear_test, NULL);
     abts_run_test(suite, hash_traverse, NULL);
     abts_run_test(suite, summation_test, NULL);
+    abts_run_test(suite, hash_incremental, NULL);
 
     return suite;
 }
@@ -103,11 +103,135 @@ static void test_basic(abts_case *tc, void *data)
 #endif
 }
 
+#define NUM_OF_ASYNC_PRODUCER 4
+#define NUM_OF_ASYNC_MESSAGE 1000
+
+static void async_producer(void *data)
+{
+    int i;
+
+    /* Empty messages keep the test output clean */
+    for (i = 0; i < NUM_OF_ASYNC_MESSAGE; i++)
+        ogs_log_print(OGS_LOG_ERROR, "%s", "");
+}
+
+static void test_async(abts_case *tc, void *data)
+{
+    ogs_log_stat_t stat;
+    ogs_thread_t *thread[NUM_OF_ASYNC_PRODUCER];
+    int i;
+
+    ogs_log_start_async(5);
+
+    ogs_log_stat(&stat);
+    ABTS_INT_EQUAL(tc, 8, stat.capacity);
+    ABTS_TRUE(tc, stat.queued == 0);
+
+    for (i = 0; i < NUM_OF_ASYNC_PRODUCER; i++) {
+        thread[i] = ogs_thread_create(async_producer, NULL);
+        ABTS_PTR_NOTNULL(tc, thread[i]);
+    }
+    for (i = 0; i < NUM_OF_ASYNC_PRODUCER; i++)
+        ogs_thread_destroy(thread[i]);
+
+    ogs_log_flush();
+
+    /* Every message was either queued and written, or counted as dropped */
+    ogs_log_stat(&stat);
+    ABTS_TRUE(tc, stat.queued + stat.dropped ==
+            NUM_OF_ASYNC_PRODUCER * NUM_OF_ASYNC_MESSAGE);
+    ABTS_TRUE(tc, stat.written == stat.queued);
+    ABTS_TRUE(tc, stat.sync == 0);
+
+    ogs_log_stop_async();
+
+    ogs_log_stat(&stat);
+    ABTS_INT_EQUAL(tc, 0, stat.capacity);
+}
+
+static volatile int async_running;
+
+static void async_busy_producer(void *data)
+{
+    while (async_running)
+        ogs_log_print(OGS_LOG_ERROR, "%s", "");
+}
+
+/* Stopping must wait for the producers still using the ring */
+static void test_async_stop(abts_case *tc, void *data)
+{
+    ogs_log_stat_t stat;
+    ogs_thread_t *thread[NUM_OF_ASYNC_PRODUCER];
+    int i;
+
+    ogs_log_start_async(8);
+
+    async_running = 1;
+    for (i = 0; i < NUM_OF_ASYNC_PRODUCER; i++) {
+        thread[i] = ogs_thread_create(async_busy_producer, NULL);
+        ABTS_PTR_NOTNULL(tc, thread[i]);
+    }
+    ogs_msleep(10);
+
+    ogs_log_stop_async();
+    async_running = 0;
+
+    ogs_log_stat(&stat);
+    ABTS_INT_EQUAL(tc, 0, stat.capacity);
+
+    for (i = 0; i < NUM_OF_ASYNC_PRODUCER; i++)
+        ogs_thread_destroy(thread[i]);
+}
+
+static int evaluated(int *count)
+{
+    return ++(*count);
+}
+
+static void test_ratelimit(abts_case *tc, void *data)
+{
+    ogs_log_ratelimit_t rs;
+    ogs_time_t interval = ogs_core()->log.ratelimit.interval;
+    int burst = ogs_core()->log.ratelimit.burst;
+    int id = ogs_log_get_domain_id("core");
+    int count = 0, passed = 0;
+    int i;
+
+    /* Arguments are not evaluated if no domain logs at the level */
+    if (__ogs_log_max_level < OGS_LOG_TRACE) {
+        ogs_trace("%d", evaluated(&count));
+        ABTS_INT_EQUAL(tc, 0, count);
+    }
+
+    ogs_core()->log.ratelimit.interval = ogs_time_from_msec(100);
+    ogs_core()->log.ratelimit.burst = 3;
+    memset(&rs, 0, sizeof rs);
+
+    for (i = 0; i < 10; i++)
+        passed += ogs_log_ratelimit(&rs,
+                OGS_LOG_ERROR, id, __FILE__, __LINE__, OGS_FUNC);
+    ABTS_INT_EQUAL(tc, 3, passed);
+    ABTS_INT_EQUAL(tc, 7, rs.suppressed);
+
+    /* The next interval reports the suppressed messages and starts over */
+    ogs_msleep(150);
+    ABTS_INT_EQUAL(tc, 1, ogs_log_ratelimit(&rs,
+                OGS_LOG_ERROR, id, __FILE__, __LINE__, OGS_FUNC));
+    ABTS_INT_EQUAL(tc, 0, rs.suppressed);
+    ABTS_INT_EQUAL(tc, 1, rs.printed);
+
+    ogs_core()->log.ratelimit.interval = interval;
+    ogs_core()->log.ratelimit.burst = burst;
+}
+
 abts_suite *test_log(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, test_basic, NULL);
+    abts_run_test(suite, test_async, NULL);
+    abts_run_test(suite, test_async_stop, NULL);
+    abts_run_test(suite, test_ratelimit, NULL);
 
     return suite;
 }
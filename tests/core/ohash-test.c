@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "ogs-core.h"
+#include "core/abts.h"
+
+#define NUM_OF_KEY 100000
+
+typedef struct test_key_s {
+    uint8_t octet[11];
+} __attribute__ ((packed)) test_key_t;
+
+static int sum_val(void *rec, const void *key, void *val)
+{
+    *(uintptr_t *)rec += (uintptr_t)val;
+    return 1;
+}
+
+static int stop_at_first(void *rec, const void *key, void *val)
+{
+    (*(int *)rec)++;
+    return 0;
+}
+
+static void ohash_u32_test(abts_case *tc, void *data)
+{
+    ogs_ohash_t *h = NULL;
+    uintptr_t sum = 0;
+    int visited = 0;
+
+    h = ogs_ohash_create(sizeof(uint32_t));
+    ABTS_PTR_NOTNULL(tc, h);
+    ABTS_INT_EQUAL(tc, 0, ogs_ohash_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_ohash_get_u32(h, 1));
+
+    ogs_ohash_set_u32(h, 1, (void *)10);
+    ogs_ohash_set_u32(h, 2, (void *)20);
+    ogs_ohash_set_u32(h, 0, (void *)30);
+    ABTS_INT_EQUAL(tc, 3, ogs_ohash_count(h));
+    ABTS_PTR_EQUAL(tc, (void *)10, ogs_ohash_get_u32(h, 1));
+    ABTS_PTR_EQUAL(tc, (void *)20, ogs_ohash_get_u32(h, 2));
+    ABTS_PTR_EQUAL(tc, (void *)30, ogs_ohash_get_u32(h, 0));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_ohash_get_u32(h, 3));
+
+    /* Overwrite keeps the count */
+    ogs_ohash_set_u32(h, 2, (void *)40);
+    ABTS_INT_EQUAL(tc, 3, ogs_ohash_count(h));
+    ABTS_PTR_EQUAL(tc, (void *)40, ogs_ohash_get_u32(h, 2));
+
+    ogs_ohash_do(sum_val, &sum, h);
+    ABTS_INT_EQUAL(tc, 80, sum);
+    ABTS_INT_EQUAL(tc, 0, ogs_ohash_do(stop_at_first, &visited, h));
+    ABTS_INT_EQUAL(tc, 1, visited);
+
+    /* NULL value removes the key, removing twice is harmless */
+    ogs_ohash_set_u32(h, 1, NULL);
+    ogs_ohash_set_u32(h, 1, NULL);
+    ABTS_INT_EQUAL(tc, 2, ogs_ohash_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_ohash_get_u32(h, 1));
+
+    ogs_ohash_clear(h);
+    ABTS_INT_EQUAL(tc, 0, ogs_ohash_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_ohash_get_u32(h, 2));
+
+    ogs_ohash_set_u32(h, 2, (void *)50);
+    ABTS_PTR_EQUAL(tc, (void *)50, ogs_ohash_get_u32(h, 2));
+
+    ogs_ohash_destroy(h);
+}
+
+static void ohash_u64_test(abts_case *tc, void *data)
+{
+    ogs_ohash_t *h = NULL;
+    uint64_t key = 0x123456789abcdef0ULL;
+
+    h = ogs_ohash_create(sizeof(uint64_t));
+    ABTS_PTR_NOTNULL(tc, h);
+
+    ogs_ohash_set_u64(h, key, (void *)1);
+    ogs_ohash_set_u64(h, key >> 32, (void *)2);
+    ogs_ohash_set_u64(h, key << 32, (void *)3);
+    ABTS_INT_EQUAL(tc, 3, ogs_ohash_count(h));
+    ABTS_PTR_EQUAL(tc, (void *)1, ogs_ohash_get_u64(h, key));
+    ABTS_PTR_EQUAL(tc, (void *)2, ogs_ohash_get_u64(h, key >> 32));
+    ABTS_PTR_EQUAL(tc, (void *)3, ogs_ohash_get_u64(h, key << 32));
+
+    /* The generic entry points see the same keys */
+    ABTS_PTR_EQUAL(tc, (void *)1, ogs_ohash_get(h, &key));
+    ogs_ohash_set(h, &key, NULL);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_ohash_get_u64(h, key));
+    ABTS_INT_EQUAL(tc, 2, ogs_ohash_count(h));
+
+    ogs_ohash_destroy(h);
+}
+
+static void ohash_binary_test(abts_case *tc, void *data)
+{
+    ogs_ohash_t *h = NULL;
+    test_key_t key1, key2;
+
+    h = ogs_ohash_create(sizeof(test_key_t));
+    ABTS_PTR_NOTNULL(tc, h);
+
+    memset(&key1, 0x11, sizeof(key1));
+    memcpy(&key2, &key1, sizeof(key2));
+    key2.octet[10] = 0x12;
+
+    ogs_ohash_set(h, &key1, (void *)1);
+    ogs_ohash_set(h, &key2, (void *)2);
+
+    /* Keys are copied into the table */
+    memset(&key1, 0, sizeof(key1));
+    ABTS_PTR_EQUAL(tc, NULL, ogs_ohash_get(h, &key1));
+    memset(&key1, 0x11, sizeof(key1));
+    ABTS_PTR_EQUAL(tc, (void *)1, ogs_ohash_get(h, &key1));
+    ABTS_PTR_EQUAL(tc, (void *)2, ogs_ohash_get(h, &key2));
+
+    ogs_ohash_set(h, &key1, NULL);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_ohash_get(h, &key1));
+    ABTS_PTR_EQUAL(tc, (void *)2, ogs_ohash_get(h, &key2));
+
+    ogs_ohash_destroy(h);
+}
+
+static void ohash_grow_test(abts_case *tc, void *data)
+{
+    ogs_ohash_t *h = NULL;
+    uintptr_t sum = 0, expected = 0;
+    int i, mismatch = 0;
+
+    h = ogs_ohash_create(sizeof(uint32_t));
+    ABTS_PTR_NOTNULL(tc, h);
+
+    for (i = 0; i < NUM_OF_KEY; i++)
+        ogs_ohash_set_u32(h, i * 7919, (void *)(uintptr_t)(i+1));
+    ABTS_INT_EQUAL(tc, NUM_OF_KEY, ogs_ohash_count(h));
+
+    /* Remove every other key */
+    for (i = 0; i < NUM_OF_KEY; i += 2)
+        ogs_ohash_set_u32(h, i * 7919, NULL);
+    ABTS_INT_EQUAL(tc, NUM_OF_KEY / 2, ogs_ohash_count(h));
+
+    for (i = 0; i < NUM_OF_KEY; i++) {
+        void *val = ogs_ohash_get_u32(h, i * 7919);
+        if (i % 2 == 0) {
+            if (val != NULL) mismatch++;
+        } else {
+            if (val != (void *)(uintptr_t)(i+1)) mismatch++;
+            expected += i+1;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, mismatch);
+
+    ogs_ohash_do(sum_val, &sum, h);
+    ABTS_TRUE(tc, sum == expected);
+
+    ogs_ohash_destroy(h);
+}
+
+static void ohash_churn_test(abts_case *tc, void *data)
+{
+    ogs_ohash_t *h = NULL;
+    int i, mismatch = 0;
+
+    h = ogs_ohash_create(sizeof(uint32_t));
+    ABTS_PTR_NOTNULL(tc, h);
+
+    /*
+     * A sliding window of live keys, like S1AP IDs being allocated and
+     * released, leaves tombstones behind which must be reclaimed.
+     */
+    for (i = 0; i < NUM_OF_KEY * 10; i++) {
+        ogs_ohash_set_u32(h, i, (void *)(uintptr_t)(i+1));
+        if (i >= 100) {
+            if (ogs_ohash_get_u32(h, i - 100) != (void *)(uintptr_t)(i-99))
+                mismatch++;
+            ogs_ohash_set_u32(h, i - 100, NULL);
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, mismatch);
+    ABTS_INT_EQUAL(tc, 100, ogs_ohash_count(h));
+
+    for (i = 0; i < NUM_OF_KEY * 10 - 100; i++)
+        if (ogs_ohash_get_u32(h, i)) mismatch++;
+    for (; i < NUM_OF_KEY * 10; i++)
+        if (ogs_ohash_get_u32(h, i) != (void *)(uintptr_t)(i+1)) mismatch++;
+    ABTS_INT_EQUAL(tc, 0, mismatch);
+
+    ogs_ohash_destroy(h);
+}
+
+abts_suite *test_ohash(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, ohash_u32_test, NULL);
+    abts_run_test(suite, ohash_u64_test, NULL);
+    abts_run_test(suite, ohash_binary_test, NULL);
+    abts_run_test(suite, ohash_grow_test, NULL);
+    abts_run_test(suite, ohash_churn_test, NULL);
+
+    return suite;
+}
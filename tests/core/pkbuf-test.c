@@ -70,12 +70,130 @@ static void test2_func(abts_case *tc, void *data)
     ogs_pkbuf_free(p3);
 }
 
+#define PKBUF_THREAD_NUM 4
+#define PKBUF_LOOP 1000
+#define PKBUF_NUM 32
+
+static ogs_pkbuf_t *copy_array[PKBUF_THREAD_NUM][PKBUF_NUM];
+
+static void pkbuf_thread_func(void *data)
+{
+    int i, j, n = (uintptr_t)data;
+    ogs_pkbuf_t *pkbuf[PKBUF_NUM];
+
+    for (i = 0; i < PKBUF_LOOP; i++) {
+        for (j = 0; j < PKBUF_NUM; j++) {
+            pkbuf[j] = ogs_pkbuf_alloc(NULL, 64 + j * 64);
+            ogs_assert(pkbuf[j]);
+            ogs_pkbuf_put(pkbuf[j], 64);
+        }
+        for (j = 0; j < PKBUF_NUM; j++)
+            ogs_pkbuf_free(pkbuf[j]);
+    }
+
+    /* Shared clusters allocated by the main thread */
+    for (j = 0; j < PKBUF_NUM; j++)
+        ogs_pkbuf_free(copy_array[n][j]);
+}
+
+static void test3_func(abts_case *tc, void *data)
+{
+    ogs_pkbuf_stat_t before, after;
+    ogs_pkbuf_t *pkbuf[PKBUF_THREAD_NUM][PKBUF_NUM];
+    ogs_thread_t *thread[PKBUF_THREAD_NUM];
+    int i, j;
+
+    ogs_pkbuf_pool_stat(NULL, &before);
+
+    for (i = 0; i < PKBUF_THREAD_NUM; i++) {
+        for (j = 0; j < PKBUF_NUM; j++) {
+            pkbuf[i][j] = ogs_pkbuf_alloc(NULL, 1000);
+            ABTS_PTR_NOTNULL(tc, pkbuf[i][j]);
+            copy_array[i][j] = ogs_pkbuf_copy(pkbuf[i][j]);
+            ABTS_PTR_NOTNULL(tc, copy_array[i][j]);
+        }
+    }
+
+    ogs_pkbuf_pool_stat(NULL, &after);
+    ABTS_INT_EQUAL(tc, before.pkbuf_avail - PKBUF_THREAD_NUM * PKBUF_NUM * 2,
+            after.pkbuf_avail);
+    ABTS_INT_EQUAL(tc, before.cluster_1024_avail - PKBUF_THREAD_NUM * PKBUF_NUM,
+            after.cluster_1024_avail);
+
+    for (i = 0; i < PKBUF_THREAD_NUM; i++) {
+        thread[i] = ogs_thread_create(pkbuf_thread_func, (void *)(uintptr_t)i);
+        ABTS_PTR_NOTNULL(tc, thread[i]);
+    }
+
+    for (i = 0; i < PKBUF_THREAD_NUM; i++)
+        for (j = 0; j < PKBUF_NUM; j++)
+            ogs_pkbuf_free(pkbuf[i][j]);
+
+    for (i = 0; i < PKBUF_THREAD_NUM; i++)
+        ogs_thread_destroy(thread[i]);
+
+    ogs_pkbuf_pool_stat(NULL, &after);
+    ABTS_INT_EQUAL(tc, before.pkbuf_avail, after.pkbuf_avail);
+    ABTS_INT_EQUAL(tc, before.cluster_128_avail, after.cluster_128_avail);
+    ABTS_INT_EQUAL(tc, before.cluster_256_avail, after.cluster_256_avail);
+    ABTS_INT_EQUAL(tc, before.cluster_512_avail, after.cluster_512_avail);
+    ABTS_INT_EQUAL(tc, before.cluster_1024_avail, after.cluster_1024_avail);
+    ABTS_INT_EQUAL(tc, before.cluster_2048_avail, after.cluster_2048_avail);
+}
+
+static void pool_thread_func(void *data)
+{
+    ogs_pkbuf_pool_t *pool = data;
+    ogs_pkbuf_t *pkbuf[PKBUF_NUM];
+    int i, j;
+
+    for (i = 0; i < PKBUF_LOOP; i++) {
+        for (j = 0; j < PKBUF_NUM; j++) {
+            pkbuf[j] = ogs_pkbuf_alloc(pool, 100);
+            ogs_assert(pkbuf[j]);
+        }
+        for (j = 0; j < PKBUF_NUM; j++)
+            ogs_pkbuf_free(pkbuf[j]);
+    }
+}
+
+/* A thread returns its magazine on exit, before the pool is destroyed */
+static void test4_func(abts_case *tc, void *data)
+{
+    ogs_pkbuf_config_t config;
+    ogs_pkbuf_pool_t *pool = NULL;
+    ogs_pkbuf_stat_t stat;
+    ogs_pkbuf_t *pkbuf = NULL;
+    ogs_thread_t *thread = NULL;
+
+    ogs_pkbuf_default_init(&config);
+    pool = ogs_pkbuf_pool_create(&config);
+    ABTS_PTR_NOTNULL(tc, pool);
+
+    /* The calling thread caches it too */
+    pkbuf = ogs_pkbuf_alloc(pool, 100);
+    ABTS_PTR_NOTNULL(tc, pkbuf);
+    ogs_pkbuf_free(pkbuf);
+
+    thread = ogs_thread_create(pool_thread_func, pool);
+    ABTS_PTR_NOTNULL(tc, thread);
+    ogs_thread_destroy(thread);
+
+    ogs_pkbuf_pool_stat(pool, &stat);
+    ABTS_INT_EQUAL(tc, stat.pkbuf_size, stat.pkbuf_avail);
+    ABTS_INT_EQUAL(tc, config.cluster_128_pool, stat.cluster_128_avail);
+
+    ogs_pkbuf_pool_destroy(pool);
+}
+
 abts_suite *test_pkbuf(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, test1_func, NULL);
     abts_run_test(suite, test2_func, NULL);
+    abts_run_test(suite, test3_func, NULL);
+    abts_run_test(suite, test4_func, NULL);
 
     return suite;
 }
@@ -435,6 +435,180 @@ static void test7_func(abts_case *tc, void *data)
     */
 }
 
+#define TEST8_HEADROOM 16
+#define TEST8_NUM 10
+static int test8_received;
+static int test8_flushed;
+static void test8_handler(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
+{
+    abts_case *tc = data;
+    char buf[OGS_ADDRSTRLEN];
+
+    if (!pkbuf) {
+        test8_flushed++;
+        return;
+    }
+
+    ABTS_INT_EQUAL(tc, TEST8_HEADROOM, ogs_pkbuf_headroom(pkbuf));
+    ABTS_INT_EQUAL(tc, strlen(DATASTR), pkbuf->len);
+    /* Copied out of the posted buffer into the best-fit cluster */
+    ABTS_INT_EQUAL(tc, 128, pkbuf->cluster->size);
+    ABTS_TRUE(tc, memcmp(pkbuf->data, DATASTR, strlen(DATASTR)) == 0);
+    if (from)
+        ABTS_STR_EQUAL(tc, "127.0.0.1", OGS_ADDR(from, buf));
+
+    ogs_pkbuf_free(pkbuf);
+    test8_received++;
+}
+
+static void test8_func(abts_case *tc, void *data)
+{
+    int rv, i;
+    ssize_t size;
+    ogs_sock_t *udp, *client;
+    ogs_sockaddr_t *addr;
+    ogs_socknode_t *node;
+    ogs_poll_t *poll[2];
+    ogs_socket_t fd[2];
+    ogs_pollset_t *pollset = ogs_pollset_create();
+    ABTS_PTR_NOTNULL(tc, pollset);
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.1", PORT, AI_PASSIVE);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node = ogs_socknode_new(addr);
+    ABTS_PTR_NOTNULL(tc, node);
+    udp = ogs_udp_server(node);
+    ABTS_PTR_NOTNULL(tc, udp);
+    client = ogs_udp_socket(AF_INET, NULL);
+    ABTS_PTR_NOTNULL(tc, client);
+
+    /* Not a socket */
+    rv = pipe(fd);
+    ABTS_INT_EQUAL(tc, 0, rv);
+
+    test8_received = 0;
+    test8_flushed = 0;
+
+    poll[0] = ogs_pollset_add_recv(pollset, udp->fd,
+            NULL, TEST8_HEADROOM, test8_handler, tc);
+    ABTS_PTR_NOTNULL(tc, poll[0]);
+    poll[1] = ogs_pollset_add_recv(pollset, fd[0],
+            NULL, TEST8_HEADROOM, test8_handler, tc);
+    ABTS_PTR_NOTNULL(tc, poll[1]);
+
+    for (i = 0; i < TEST8_NUM; i++) {
+        size = ogs_sendto(client->fd, DATASTR, strlen(DATASTR), 0, addr);
+        ABTS_INT_EQUAL(tc, strlen(DATASTR), size);
+    }
+
+    /* A pipe has no packet boundary, so it is written at once */
+    size = ogs_write(fd[1], DATASTR, strlen(DATASTR));
+    ABTS_INT_EQUAL(tc, strlen(DATASTR), size);
+
+    for (i = 0; i < 10 && test8_received < TEST8_NUM + 1; i++) {
+        rv = ogs_pollset_poll(pollset, ogs_time_from_msec(100));
+        ABTS_TRUE(tc, rv == OGS_OK || rv == OGS_TIMEUP);
+    }
+    ABTS_INT_EQUAL(tc, TEST8_NUM + 1, test8_received);
+    ABTS_TRUE(tc, test8_flushed > 0);
+
+    ogs_pollset_remove(poll[0]);
+    ogs_pollset_remove(poll[1]);
+
+    /* Nothing is delivered after the removal */
+    size = ogs_sendto(client->fd, DATASTR, strlen(DATASTR), 0, addr);
+    ABTS_INT_EQUAL(tc, strlen(DATASTR), size);
+    rv = ogs_pollset_poll(pollset, ogs_time_from_msec(10));
+    ABTS_INT_EQUAL(tc, TEST8_NUM + 1, test8_received);
+
+    close(fd[0]);
+    close(fd[1]);
+    ogs_sock_destroy(client);
+    ogs_socknode_free(node);
+
+    ogs_pollset_destroy(pollset);
+}
+
+static void test10_func(abts_case *tc, void *data)
+{
+    int rv, i, n;
+    ogs_sock_t *udp, *client;
+    ogs_sockaddr_t *addr;
+    ogs_sockaddr_t *to[TEST8_NUM];
+    ogs_socknode_t *node;
+    ogs_pkbuf_t *pkbuf[TEST8_NUM];
+    ogs_poll_t *poll;
+    bool no_gso = false;
+    ogs_pollset_t *pollset = ogs_pollset_create();
+    ABTS_PTR_NOTNULL(tc, pollset);
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.1", PORT, AI_PASSIVE);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node = ogs_socknode_new(addr);
+    ABTS_PTR_NOTNULL(tc, node);
+    udp = ogs_udp_server(node);
+    ABTS_PTR_NOTNULL(tc, udp);
+    client = ogs_udp_socket(AF_INET, NULL);
+    ABTS_PTR_NOTNULL(tc, client);
+
+    /* Without UDP GRO, the datagrams are just received one by one */
+    ogs_udp_set_gro(udp->fd);
+
+    test8_received = 0;
+    test8_flushed = 0;
+
+    poll = ogs_pollset_add_recv(pollset, udp->fd,
+            NULL, TEST8_HEADROOM, test8_handler, tc);
+    ABTS_PTR_NOTNULL(tc, poll);
+
+    for (i = 0; i < TEST8_NUM; i++) {
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, strlen(DATASTR));
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+        ogs_pkbuf_put_data(pkbuf[i], DATASTR, strlen(DATASTR));
+        to[i] = addr;
+    }
+
+    n = ogs_udp_sendto_gso_batch(client->fd, pkbuf, to, TEST8_NUM, &no_gso);
+    ABTS_INT_EQUAL(tc, TEST8_NUM, n);
+
+    for (i = 0; i < TEST8_NUM; i++)
+        ogs_pkbuf_free(pkbuf[i]);
+
+    /* The aggregate is split into the datagrams again */
+    for (i = 0; i < 10 && test8_received < TEST8_NUM; i++) {
+        rv = ogs_pollset_poll(pollset, ogs_time_from_msec(100));
+        ABTS_TRUE(tc, rv == OGS_OK || rv == OGS_TIMEUP);
+    }
+    ABTS_INT_EQUAL(tc, TEST8_NUM, test8_received);
+    ABTS_TRUE(tc, test8_flushed > 0);
+
+    ogs_pollset_remove(poll);
+
+    ogs_sock_destroy(client);
+    ogs_socknode_free(node);
+
+    ogs_pollset_destroy(pollset);
+}
+
+/* ogs_pollset_create() chooses the backend only once */
+extern bool ogs_pollset_actions_initialized;
+
+static void test9_func(abts_case *tc, void *data)
+{
+    ogs_core()->socket.io_uring = true;
+    ogs_pollset_actions_initialized = false;
+
+    /* Falls back to the default pollset without io_uring */
+    test5_func(tc, data);
+    test6_func(tc, data);
+    test8_func(tc, data);
+    test10_func(tc, data);
+
+    ogs_core()->socket.io_uring = false;
+    ogs_pollset_actions_initialized = false;
+}
+
 abts_suite *test_poll(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -449,6 +623,9 @@ abts_suite *test_poll(abts_suite *suite)
     abts_run_test(suite, test5_func, NULL);
     abts_run_test(suite, test6_func, NULL);
     abts_run_test(suite, test7_func, NULL);
+    abts_run_test(suite, test8_func, NULL);
+    abts_run_test(suite, test9_func, NULL);
+    abts_run_test(suite, test10_func, NULL);
 
     return suite;
 }
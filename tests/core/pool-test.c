@@ -228,6 +228,58 @@ static void test3_func(abts_case *tc, void *data)
     ogs_pool_final(&testpool);
 }
 
+static OGS_POOL(segpool, pt_type1);
+
+static void test4_func(abts_case *tc, void *data)
+{
+    pt_type1 *node[11] = { NULL, };
+    int i, index;
+
+    /* Grows by 3 nodes up to 10, rounded up to 12 */
+    ogs_pool_init_segmented(&segpool, 3, 10);
+    ABTS_INT_EQUAL(tc, 3, ogs_pool_size(&segpool));
+    ABTS_INT_EQUAL(tc, 12, ogs_pool_max(&segpool));
+
+    for (i = 0; i < 11; i++) {
+        ogs_pool_alloc(&segpool, &node[i]);
+        ABTS_PTR_NOTNULL(tc, node[i]);
+        node[i]->m2 = i;
+    }
+    ABTS_INT_EQUAL(tc, 12, ogs_pool_size(&segpool));
+    ABTS_INT_EQUAL(tc, 1, ogs_pool_avail(&segpool));
+    ABTS_INT_EQUAL(tc, 11, ogs_pool_hwm(&segpool));
+
+    /* Nodes did not move while growing, and indexes follow the chunks */
+    for (i = 0; i < 11; i++) {
+        index = ogs_pool_index(&segpool, node[i]);
+        ABTS_INT_EQUAL(tc, i + 1, index);
+        ABTS_PTR_EQUAL(tc, node[i], ogs_pool_find(&segpool, index));
+        ABTS_INT_EQUAL(tc, i, node[i]->m2);
+    }
+
+    ogs_pool_free(&segpool, node[4]);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_pool_find(&segpool, 5));
+
+    ogs_pool_alloc(&segpool, &node[4]);
+    ABTS_PTR_NOTNULL(tc, node[4]);
+    ogs_pool_alloc(&segpool, &node[4]);
+    ABTS_PTR_NOTNULL(tc, node[4]);
+    ABTS_INT_EQUAL(tc, 0, ogs_pool_avail(&segpool));
+    ABTS_INT_EQUAL(tc, 12, ogs_pool_hwm(&segpool));
+
+    /* Exhausted at the maximum */
+    ogs_pool_alloc(&segpool, &node[0]);
+    ABTS_PTR_EQUAL(tc, NULL, node[0]);
+    ABTS_INT_EQUAL(tc, 1, ogs_pool_failed(&segpool));
+    ABTS_INT_EQUAL(tc, 12, ogs_pool_size(&segpool));
+
+    for (i = 1; i <= 12; i++)
+        ogs_pool_free(&segpool, ogs_pool_find(&segpool, i));
+    ABTS_INT_EQUAL(tc, 12, ogs_pool_avail(&segpool));
+
+    ogs_pool_final(&segpool);
+}
+
 abts_suite *test_pool(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -235,6 +287,7 @@ abts_suite *test_pool(abts_suite *suite)
     abts_run_test(suite, test1_func, NULL);
     abts_run_test(suite, test2_func, NULL);
     abts_run_test(suite, test3_func, NULL);
+    abts_run_test(suite, test4_func, NULL);
 
     return suite;
 }
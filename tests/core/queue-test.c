@@ -166,12 +166,171 @@ static void test_queue_timeout(abts_case *tc, void *data)
     ogs_queue_destroy(q);
 }
 
+static void test_queue_mpsc_bulk(abts_case *tc, void *data)
+{
+    ogs_queue_t *q;
+    ogs_queue_stat_t stat;
+    int rv;
+    uintptr_t i;
+    void *value[16];
+
+    q = ogs_queue_create_type(5, OGS_QUEUE_MPSC);
+    ABTS_PTR_NOTNULL(tc, q);
+
+    ogs_queue_stat(q, &stat);
+    ABTS_INT_EQUAL(tc, 8, stat.capacity);
+
+    for (i = 0; i < 8; i++) {
+        rv = ogs_queue_trypush(q, (void *)i);
+        ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    }
+    rv = ogs_queue_trypush(q, NULL);
+    ABTS_INT_EQUAL(tc, OGS_RETRY, rv);
+    rv = ogs_queue_timedpush(q, NULL, ogs_time_from_msec(1));
+    ABTS_INT_EQUAL(tc, OGS_TIMEUP, rv);
+    ABTS_INT_EQUAL(tc, 8, ogs_queue_size(q));
+
+    rv = ogs_queue_trypop_many(q, value, 3);
+    ABTS_INT_EQUAL(tc, 3, rv);
+    for (i = 0; i < 3; i++)
+        ABTS_TRUE(tc, value[i] == (void *)i);
+
+    rv = ogs_queue_trypop_many(q, value, 16);
+    ABTS_INT_EQUAL(tc, 5, rv);
+    for (i = 0; i < 5; i++)
+        ABTS_TRUE(tc, value[i] == (void *)(i + 3));
+
+    rv = ogs_queue_trypop_many(q, value, 16);
+    ABTS_INT_EQUAL(tc, OGS_RETRY, rv);
+    rv = ogs_queue_timedpop(q, value, ogs_time_from_msec(1));
+    ABTS_INT_EQUAL(tc, OGS_TIMEUP, rv);
+
+    /* The ring wraps around */
+    for (i = 0; i < 6; i++) {
+        rv = ogs_queue_push(q, (void *)i);
+        ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    }
+    for (i = 0; i < 6; i++) {
+        rv = ogs_queue_pop(q, value);
+        ABTS_INT_EQUAL(tc, OGS_OK, rv);
+        ABTS_TRUE(tc, value[0] == (void *)i);
+    }
+
+    ogs_queue_stat(q, &stat);
+    ABTS_INT_EQUAL(tc, 0, stat.depth);
+    ABTS_INT_EQUAL(tc, 8, stat.max_depth);
+    ABTS_INT_EQUAL(tc, 14, stat.pushed);
+    ABTS_INT_EQUAL(tc, 14, stat.popped);
+    ABTS_INT_EQUAL(tc, 2, stat.full);
+
+    rv = ogs_queue_term(q);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    rv = ogs_queue_trypush(q, NULL);
+    ABTS_INT_EQUAL(tc, OGS_DONE, rv);
+    rv = ogs_queue_trypop_many(q, value, 16);
+    ABTS_INT_EQUAL(tc, OGS_DONE, rv);
+
+    ogs_queue_destroy(q);
+}
+
+#define MPSC_PRODUCERS      4
+#define MPSC_ACTIVITY       100000
+
+static void mpsc_producer(void *data)
+{
+    uintptr_t id = (uintptr_t)data;
+    uintptr_t i;
+    int rv;
+
+    for (i = 0; i < MPSC_ACTIVITY; i++) {
+        do {
+            /* OGS_QUEUE_MUTEX may wake up a producer without room */
+            rv = ogs_queue_push(queue, (void *)((id << 24) | i));
+        } while (rv == OGS_ERROR);
+        ogs_assert(rv == OGS_OK);
+    }
+}
+
+static void test_queue_pollset(abts_case *tc, void *data)
+{
+    ogs_queue_type_e type = (uintptr_t)data;
+    ogs_pollset_t *pollset = NULL;
+    ogs_thread_t *producer_thread[MPSC_PRODUCERS];
+    uintptr_t next[MPSC_PRODUCERS];
+    ogs_queue_stat_t stat;
+    void *value[32];
+    int received = 0, misordered = 0;
+    int i, rv;
+
+    queue = ogs_queue_create_type(256, type);
+    ABTS_PTR_NOTNULL(tc, queue);
+    pollset = ogs_pollset_create();
+    ABTS_PTR_NOTNULL(tc, pollset);
+    ogs_queue_set_pollset(queue, pollset);
+
+    for (i = 0; i < MPSC_PRODUCERS; i++) {
+        next[i] = 0;
+        producer_thread[i] = ogs_thread_create(
+                mpsc_producer, (void *)(uintptr_t)i);
+        ABTS_PTR_NOTNULL(tc, producer_thread[i]);
+    }
+
+    while (received < MPSC_PRODUCERS * MPSC_ACTIVITY) {
+        /* A lost wake-up would leave us here until the timeout */
+        rv = ogs_pollset_poll(pollset, ogs_time_from_sec(5));
+        if (rv != OGS_OK)
+            break;
+
+        while ((rv = ogs_queue_trypop_many(queue, value, 32)) > 0) {
+            int j;
+            for (j = 0; j < rv; j++) {
+                uintptr_t id = (uintptr_t)value[j] >> 24;
+                uintptr_t seq = (uintptr_t)value[j] & 0xffffff;
+
+                if (id >= MPSC_PRODUCERS || seq != next[id]) {
+                    misordered++;
+                    continue;
+                }
+                next[id] = seq + 1;
+            }
+            received += rv;
+        }
+        if (rv != OGS_RETRY)
+            break;
+    }
+    ABTS_INT_EQUAL(tc, OGS_RETRY, rv);
+    ABTS_INT_EQUAL(tc, 0, misordered);
+
+    for (i = 0; i < MPSC_PRODUCERS; i++) {
+        ogs_thread_destroy(producer_thread[i]);
+        ABTS_INT_EQUAL(tc, MPSC_ACTIVITY, next[i]);
+    }
+
+    ogs_queue_stat(queue, &stat);
+    ABTS_INT_EQUAL(tc, 0, stat.depth);
+    ABTS_TRUE(tc, stat.pushed == MPSC_PRODUCERS * MPSC_ACTIVITY);
+    ABTS_TRUE(tc, stat.popped == MPSC_PRODUCERS * MPSC_ACTIVITY);
+    ABTS_TRUE(tc, stat.max_depth <= stat.capacity);
+    ABTS_TRUE(tc, stat.wait_max >= 0);
+
+    rv = ogs_queue_term(queue);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    ogs_pollset_destroy(pollset);
+    ogs_queue_destroy(queue);
+}
+
 abts_suite *test_queue(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
 
     abts_run_test(suite, test_queue_producer_consumer, NULL);
     abts_run_test(suite, test_queue_timeout, NULL);
+    abts_run_test(suite, test_queue_mpsc_bulk, NULL);
+    abts_run_test(suite, test_queue_pollset,
+            (void *)OGS_QUEUE_MUTEX);
+    abts_run_test(suite, test_queue_pollset,
+            (void *)OGS_QUEUE_MPSC);
 
     return suite;
 }
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#include "ogs-core.h"
+#include "core/abts.h"
+
+#define NUM_OF_SLOT     8
+#define SLOT_SIZE       64
+
+static char name[32];
+
+static int received;
+static int burst;
+static uint32_t last[8];
+static int misordered;
+static ogs_sockaddr_t received_from;
+
+static void recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
+{
+    uint32_t id, seq;
+
+    if (!pkbuf) {
+        burst++;
+        return;
+    }
+
+    memcpy(&received_from, from, sizeof received_from);
+
+    memcpy(&id, pkbuf->data, sizeof id);
+    memcpy(&seq, pkbuf->data + sizeof id, sizeof seq);
+    if (id >= 8 || seq != last[id])
+        misordered++;
+    else
+        last[id] = seq + 1;
+    received++;
+
+    ogs_pkbuf_free(pkbuf);
+}
+
+static int push(ogs_shmring_t *ring, uint32_t id, uint32_t seq)
+{
+    uint8_t buf[SLOT_SIZE];
+
+    memset(buf, 0, sizeof buf);
+    memcpy(buf, &id, sizeof id);
+    memcpy(buf + sizeof id, &seq, sizeof seq);
+
+    return ogs_shmring_push(ring, buf, sizeof buf);
+}
+
+static void test1_func(abts_case *tc, void *data)
+{
+    ogs_shmring_t *producer, *consumer;
+    ogs_pollset_t *pollset;
+    ogs_sockaddr_t *addr, *from, *other;
+    uint8_t buf[SLOT_SIZE+1];
+    int rv, i;
+
+    ogs_snprintf(name, sizeof name, "/ogs-test-%d", (int)getpid());
+    shm_unlink(name);
+
+    producer = ogs_shmring_open(name, NUM_OF_SLOT, SLOT_SIZE);
+    ABTS_PTR_NOTNULL(tc, producer);
+    consumer = ogs_shmring_open(name, NUM_OF_SLOT, SLOT_SIZE);
+    ABTS_PTR_NOTNULL(tc, consumer);
+
+    /* Both sides must agree on the size */
+    ABTS_PTR_EQUAL(tc, NULL,
+            ogs_shmring_open(name, NUM_OF_SLOT*2, SLOT_SIZE));
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.4", 2152, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    rv = ogs_getaddrinfo(&from, AF_INET, "127.0.0.3", 2152, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    rv = ogs_getaddrinfo(&other, AF_INET, "127.0.0.5", 2152, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    rv = ogs_shmring_listen(consumer, addr);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_TRUE(tc, ogs_shmring_reaches(producer, addr));
+    ABTS_TRUE(tc, !ogs_shmring_reaches(producer, other));
+    ogs_shmring_connect(producer, from);
+
+    pollset = ogs_pollset_create();
+    ABTS_PTR_NOTNULL(tc, pollset);
+    ABTS_PTR_NOTNULL(tc, ogs_shmring_add_recv(
+                pollset, consumer, NULL, 0, recv_cb, NULL));
+
+    memset(last, 0, sizeof last);
+    received = burst = misordered = 0;
+    memset(&received_from, 0, sizeof received_from);
+
+    for (i = 0; i < NUM_OF_SLOT; i++) {
+        rv = push(producer, 0, i);
+        ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    }
+    rv = push(producer, 0, i);
+    ABTS_INT_EQUAL(tc, OGS_RETRY, rv);
+    memset(buf, 0, sizeof buf);
+    rv = ogs_shmring_push(producer, buf, sizeof buf);
+    ABTS_INT_EQUAL(tc, OGS_ERROR, rv);
+
+    ogs_shmring_notify(producer);
+
+    rv = ogs_pollset_poll(pollset, ogs_time_from_msec(100));
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_INT_EQUAL(tc, NUM_OF_SLOT, received);
+    ABTS_INT_EQUAL(tc, 1, burst);
+    ABTS_INT_EQUAL(tc, 0, misordered);
+    ABTS_TRUE(tc, ogs_sockaddr_is_equal(&received_from, from));
+    ABTS_PTR_EQUAL(tc, NULL, received_from.next);
+
+    /* The ring wraps around, and the doorbell is rung again */
+    for (i = NUM_OF_SLOT; i < NUM_OF_SLOT + 5; i++) {
+        rv = push(producer, 0, i);
+        ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    }
+    ogs_shmring_notify(producer);
+
+    rv = ogs_pollset_poll(pollset, ogs_time_from_msec(100));
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_INT_EQUAL(tc, NUM_OF_SLOT + 5, received);
+    ABTS_INT_EQUAL(tc, 2, burst);
+    ABTS_INT_EQUAL(tc, 0, misordered);
+
+    ogs_shmring_close(consumer);
+    ogs_shmring_close(producer);
+    ogs_pollset_destroy(pollset);
+
+    ogs_freeaddrinfo(addr);
+    ogs_freeaddrinfo(from);
+    ogs_freeaddrinfo(other);
+
+    shm_unlink(name);
+}
+
+#define PRODUCERS       4
+#define ACTIVITY        100000
+
+static ogs_shmring_t *ring;
+
+static void producer_main(void *data)
+{
+    uint32_t id = (uintptr_t)data;
+    uint32_t i;
+
+    for (i = 0; i < ACTIVITY; i++) {
+        while (push(ring, id, i) == OGS_RETRY)
+            ogs_shmring_notify(ring);
+        ogs_shmring_notify(ring);
+    }
+}
+
+static void test2_func(abts_case *tc, void *data)
+{
+    ogs_shmring_t *consumer;
+    ogs_pollset_t *pollset;
+    ogs_thread_t *thread[PRODUCERS];
+    ogs_sockaddr_t *addr;
+    int rv, i;
+
+    ogs_snprintf(name, sizeof name, "/ogs-test-%d", (int)getpid());
+    shm_unlink(name);
+
+    consumer = ogs_shmring_open(name, 256, SLOT_SIZE);
+    ABTS_PTR_NOTNULL(tc, consumer);
+    ring = ogs_shmring_open(name, 256, SLOT_SIZE);
+    ABTS_PTR_NOTNULL(tc, ring);
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.4", 2152, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    rv = ogs_shmring_listen(consumer, addr);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ogs_shmring_connect(ring, addr);
+
+    pollset = ogs_pollset_create();
+    ABTS_PTR_NOTNULL(tc, pollset);
+    ABTS_PTR_NOTNULL(tc, ogs_shmring_add_recv(
+                pollset, consumer, NULL, 0, recv_cb, NULL));
+
+    memset(last, 0, sizeof last);
+    received = burst = misordered = 0;
+
+    for (i = 0; i < PRODUCERS; i++) {
+        thread[i] = ogs_thread_create(producer_main, (void *)(uintptr_t)i);
+        ABTS_PTR_NOTNULL(tc, thread[i]);
+    }
+
+    while (received < PRODUCERS * ACTIVITY) {
+        /* A lost wake-up would leave us here until the timeout */
+        rv = ogs_pollset_poll(pollset, ogs_time_from_sec(5));
+        if (rv != OGS_OK)
+            break;
+    }
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_INT_EQUAL(tc, 0, misordered);
+
+    for (i = 0; i < PRODUCERS; i++) {
+        ogs_thread_destroy(thread[i]);
+        ABTS_INT_EQUAL(tc, ACTIVITY, last[i]);
+    }
+
+    ogs_shmring_close(consumer);
+    ogs_shmring_close(ring);
+    ogs_pollset_destroy(pollset);
+
+    ogs_freeaddrinfo(addr);
+
+    shm_unlink(name);
+}
+
+static void test3_func(abts_case *tc, void *data)
+{
+    ogs_shmring_t *producer, *consumer;
+    ogs_pollset_t *pollset;
+    ogs_sockaddr_t *addr;
+    uint8_t *map, *p, *q;
+    uint32_t marker = 0x6f67736d, len;
+    sa_family_t family;
+    int fd, rv;
+
+    ogs_snprintf(name, sizeof name, "/ogs-test-%d", (int)getpid());
+    shm_unlink(name);
+
+    producer = ogs_shmring_open(name, NUM_OF_SLOT, SLOT_SIZE);
+    ABTS_PTR_NOTNULL(tc, producer);
+    consumer = ogs_shmring_open(name, NUM_OF_SLOT, SLOT_SIZE);
+    ABTS_PTR_NOTNULL(tc, consumer);
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.4", 2152, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    rv = ogs_shmring_listen(consumer, addr);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ogs_shmring_connect(producer, addr);
+
+    pollset = ogs_pollset_create();
+    ABTS_PTR_NOTNULL(tc, pollset);
+    ABTS_PTR_NOTNULL(tc, ogs_shmring_add_recv(
+                pollset, consumer, NULL, 0, recv_cb, NULL));
+    rv = ogs_pollset_poll(pollset, ogs_time_from_msec(10));
+
+    memset(last, 0, sizeof last);
+    received = misordered = 0;
+
+    /* The peer overwrites the length of a published packet */
+    rv = push(producer, marker, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    rv = push(producer, 0, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    fd = shm_open(name, O_RDWR, 0);
+    ABTS_TRUE(tc, fd >= 0);
+    map = mmap(NULL, 4096, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ABTS_TRUE(tc, map != MAP_FAILED);
+    close(fd);
+    for (p = map + sizeof len; p < map + 4096 - sizeof marker; p++) {
+        if (memcmp(p, &marker, sizeof marker) == 0) {
+            /* The length is stored right before the packet */
+            len = 1 << 20;
+            memcpy(p - sizeof len, &len, sizeof len);
+            break;
+        }
+    }
+    ABTS_TRUE(tc, p < map + 4096 - sizeof marker);
+    munmap(map, 4096);
+
+    /* It is dropped, and the next packet is received */
+    ogs_shmring_notify(producer);
+    rv = ogs_pollset_poll(pollset, ogs_time_from_msec(100));
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_INT_EQUAL(tc, 1, received);
+    ABTS_INT_EQUAL(tc, 0, misordered);
+
+    /* The peer overwrites the family of the producer address */
+    rv = push(producer, 0, 1);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    fd = shm_open(name, O_RDWR, 0);
+    ABTS_TRUE(tc, fd >= 0);
+    map = mmap(NULL, 4096, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ABTS_TRUE(tc, map != MAP_FAILED);
+    close(fd);
+    /* The consumer address comes first, and the producer one last */
+    for (p = NULL, q = map; q < map + 4096 - sizeof addr->sin; q++) {
+        if (memcmp(q, &addr->sin, sizeof addr->sin) == 0)
+            p = q;
+    }
+    ABTS_PTR_NOTNULL(tc, p);
+    if (p) {
+        family = AF_UNIX;
+        memcpy(p + offsetof(struct sockaddr_in, sin_family),
+                &family, sizeof family);
+    }
+    munmap(map, 4096);
+
+    /* It is dropped rather than handed to the handler */
+    ogs_shmring_notify(producer);
+    rv = ogs_pollset_poll(pollset, ogs_time_from_msec(100));
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ABTS_INT_EQUAL(tc, 1, received);
+
+    /* Once the consumer is gone, the producer gives up the ring */
+    ogs_shmring_close(consumer);
+    ogs_pollset_destroy(pollset);
+
+    rv = push(producer, 0, 2);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ogs_shmring_notify(producer);
+    rv = push(producer, 0, 3);
+    ABTS_INT_EQUAL(tc, OGS_ERROR, rv);
+
+    /* and uses it again once a consumer is back */
+    consumer = ogs_shmring_open(name, NUM_OF_SLOT, SLOT_SIZE);
+    ABTS_PTR_NOTNULL(tc, consumer);
+    rv = ogs_shmring_listen(consumer, addr);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    ogs_msleep(2100);
+    rv = push(producer, 0, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    ogs_shmring_close(consumer);
+    ogs_shmring_close(producer);
+
+    ogs_freeaddrinfo(addr);
+
+    shm_unlink(name);
+}
+
+abts_suite *test_shmring(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test1_func, NULL);
+    abts_run_test(suite, test2_func, NULL);
+    abts_run_test(suite, test3_func, NULL);
+
+    return suite;
+}
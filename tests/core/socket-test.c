@@ -17,9 +17,19 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "core-config-private.h"
+
 #include "ogs-core.h"
 #include "core/abts.h"
 
+#if HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
+
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+#include <sys/syscall.h>
+#endif
+
 #define DATASTR "This is a test"
 #define STRLEN 8092
 #define PORT 7777
@@ -389,11 +399,10 @@ static void test7_func(abts_case *tc, void *data)
     rv = ogs_getaddrinfo(&addr, AF_UNSPEC, "localhost", PORT, 0);
     ABTS_INT_EQUAL(tc, OGS_OK, rv);
 
+    /* The node owns the address list */
     node = ogs_socknode_add(&list, AF_INET, addr);
     ABTS_PTR_NOTNULL(tc, node);
 
-    ogs_freeaddrinfo(addr);
-
     ogs_socknode_remove_all(&list);
 
     rv = ogs_socknode_probe(&list, &list6, NULL, PORT);
@@ -427,6 +436,303 @@ static void test8_func(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, OGS_OK, rv);
 }
 
+#define NUM_OF_BATCH 4
+static void test9_func(abts_case *tc, void *data)
+{
+    int rv, i, n;
+    ogs_sock_t *udp, *client;
+    ogs_sockaddr_t *addr;
+    ogs_sockaddr_t from[NUM_OF_BATCH*2];
+    ogs_sockaddr_t *to[NUM_OF_BATCH];
+    ogs_socknode_t *node;
+    ogs_pkbuf_t *pkbuf[NUM_OF_BATCH*2];
+    char buf[OGS_ADDRSTRLEN];
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.1", PORT, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node = ogs_socknode_new(addr);
+    ABTS_PTR_NOTNULL(tc, node);
+    udp = ogs_udp_server(node);
+    ABTS_PTR_NOTNULL(tc, udp);
+
+    client = ogs_udp_socket(AF_INET, NULL);
+    ABTS_PTR_NOTNULL(tc, client);
+
+    for (i = 0; i < NUM_OF_BATCH; i++) {
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, STRLEN);
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+        ogs_pkbuf_put_data(pkbuf[i], DATASTR, i+1);
+        to[i] = addr;
+    }
+
+    n = ogs_udp_sendto_batch(client->fd, pkbuf, to, NUM_OF_BATCH);
+    ABTS_INT_EQUAL(tc, NUM_OF_BATCH, n);
+
+    for (i = 0; i < NUM_OF_BATCH; i++)
+        ogs_pkbuf_free(pkbuf[i]);
+
+    for (i = 0; i < NUM_OF_BATCH*2; i++) {
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, STRLEN);
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+        ogs_pkbuf_put(pkbuf[i], STRLEN);
+    }
+
+    n = ogs_udp_recv_batch(udp->fd, pkbuf, from, NUM_OF_BATCH*2);
+    ABTS_INT_EQUAL(tc, NUM_OF_BATCH, n);
+    for (i = 0; i < n; i++) {
+        ABTS_INT_EQUAL(tc, i+1, pkbuf[i]->len);
+        ABTS_TRUE(tc, memcmp(pkbuf[i]->data, DATASTR, i+1) == 0);
+        ABTS_STR_EQUAL(tc, "127.0.0.1", OGS_ADDR(&from[i], buf));
+    }
+
+    /* Nothing pending */
+    n = ogs_udp_recv_batch(udp->fd, pkbuf + NUM_OF_BATCH, NULL, NUM_OF_BATCH);
+    ABTS_INT_EQUAL(tc, 0, n);
+
+    for (i = 0; i < NUM_OF_BATCH*2; i++)
+        ogs_pkbuf_free(pkbuf[i]);
+
+    ogs_sock_destroy(client);
+    ogs_socknode_free(node);
+}
+
+#define NUM_OF_SEGMENT 5
+#define SEGMENT_LEN 1000
+static void test10_func(abts_case *tc, void *data)
+{
+    int rv, i, n, len, segsize, num_of_segment;
+    ogs_sock_t *udp, *udp2, *client;
+    ogs_sockaddr_t *addr, *addr2;
+    ogs_sockaddr_t from;
+    ogs_sockaddr_t *to[NUM_OF_SEGMENT];
+    ogs_socknode_t *node, *node2;
+    ogs_pkbuf_t *pkbuf[NUM_OF_SEGMENT];
+    uint8_t *gro_buf;
+    ssize_t size;
+    bool disabled = false;
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.1", PORT, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node = ogs_socknode_new(addr);
+    ABTS_PTR_NOTNULL(tc, node);
+    udp = ogs_udp_server(node);
+    ABTS_PTR_NOTNULL(tc, udp);
+
+    rv = ogs_getaddrinfo(&addr2, AF_INET, "127.0.0.1", PORT2, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node2 = ogs_socknode_new(addr2);
+    ABTS_PTR_NOTNULL(tc, node2);
+    udp2 = ogs_udp_server(node2);
+    ABTS_PTR_NOTNULL(tc, udp2);
+
+    /* Only the first server takes the aggregate as it is */
+    if (ogs_udp_set_gro(udp->fd) == OGS_OK)
+        ABTS_TRUE(tc, ogs_udp_gro_enabled(udp->fd));
+    ABTS_TRUE(tc, !ogs_udp_gro_enabled(udp2->fd));
+
+    client = ogs_udp_socket(AF_INET, NULL);
+    ABTS_PTR_NOTNULL(tc, client);
+
+    /* The last one is shorter, but still in the same aggregate */
+    for (i = 0; i < NUM_OF_SEGMENT; i++) {
+        len = i == NUM_OF_SEGMENT-1 ? SEGMENT_LEN/2 : SEGMENT_LEN;
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, SEGMENT_LEN);
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+        memset(ogs_pkbuf_put(pkbuf[i], len), i, len);
+        to[i] = addr;
+    }
+
+    n = ogs_udp_sendto_gso_batch(
+            client->fd, pkbuf, to, NUM_OF_SEGMENT, &disabled);
+    ABTS_INT_EQUAL(tc, NUM_OF_SEGMENT, n);
+
+    for (i = 0; i < NUM_OF_SEGMENT; i++)
+        to[i] = addr2;
+    n = ogs_udp_sendto_gso_batch(
+            client->fd, pkbuf, to, NUM_OF_SEGMENT, &disabled);
+    ABTS_INT_EQUAL(tc, NUM_OF_SEGMENT, n);
+
+    for (i = 0; i < NUM_OF_SEGMENT; i++)
+        ogs_pkbuf_free(pkbuf[i]);
+
+    gro_buf = ogs_malloc(OGS_UDP_MAX_GRO_LEN);
+    ABTS_PTR_NOTNULL(tc, gro_buf);
+
+    num_of_segment = 0;
+    for (n = 0; (size = ogs_udp_recv_gro(udp->fd, gro_buf,
+                    OGS_UDP_MAX_GRO_LEN, &segsize, &from)) > 0; n++) {
+        for (len = 0; len < size; len += segsize) {
+            ABTS_TRUE(tc, num_of_segment < NUM_OF_SEGMENT);
+            ABTS_INT_EQUAL(tc, num_of_segment, gro_buf[len]);
+            num_of_segment++;
+        }
+    }
+    ABTS_INT_EQUAL(tc, 0, size);
+    ABTS_INT_EQUAL(tc, NUM_OF_SEGMENT, num_of_segment);
+
+    /* Received at once on loopback */
+    if (ogs_udp_gro_enabled(udp->fd) && ogs_udp_gso_supported()) {
+        ABTS_INT_EQUAL(tc, 1, n);
+        ABTS_INT_EQUAL(tc, SEGMENT_LEN, segsize);
+    }
+
+    /* Without UDP_GRO, the kernel splits it again */
+    for (i = 0; i < NUM_OF_SEGMENT; i++) {
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+        ogs_pkbuf_put(pkbuf[i], OGS_MAX_SDU_LEN);
+    }
+
+    n = ogs_udp_recv_batch(udp2->fd, pkbuf, NULL, NUM_OF_SEGMENT);
+    ABTS_INT_EQUAL(tc, NUM_OF_SEGMENT, n);
+    for (i = 0; i < n; i++) {
+        ABTS_INT_EQUAL(tc,
+                i == NUM_OF_SEGMENT-1 ? SEGMENT_LEN/2 : SEGMENT_LEN,
+                pkbuf[i]->len);
+        ABTS_INT_EQUAL(tc, i, pkbuf[i]->data[0]);
+    }
+
+    for (i = 0; i < NUM_OF_SEGMENT; i++)
+        ogs_pkbuf_free(pkbuf[i]);
+
+    ogs_free(gro_buf);
+
+    ogs_sock_destroy(client);
+    ogs_socknode_free(node);
+    ogs_socknode_free(node2);
+}
+
+static void test11_func(abts_case *tc, void *data)
+{
+    int rv;
+    ogs_sock_t *udp, *udp2;
+    ogs_sockaddr_t *addr, *addr2;
+    ogs_socknode_t *node, *node2;
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.1", PORT, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node = ogs_socknode_new(addr);
+    ABTS_PTR_NOTNULL(tc, node);
+    ogs_socknode_reuse_port(node, 1);
+    udp = ogs_udp_server(node);
+    ABTS_PTR_NOTNULL(tc, udp);
+
+    /* Both servers are bound to the same address */
+    rv = ogs_copyaddrinfo(&addr2, addr);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node2 = ogs_socknode_new(addr2);
+    ABTS_PTR_NOTNULL(tc, node2);
+    ogs_socknode_reuse_port(node2, 1);
+    udp2 = ogs_udp_server(node2);
+    ABTS_PTR_NOTNULL(tc, udp2);
+
+    ogs_socknode_free(node);
+    ogs_socknode_free(node2);
+}
+
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+/* The next aggregate fails with this error, as the library calls here */
+static int gso_errno;
+
+int sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    if (gso_errno && vlen && msgvec[0].msg_hdr.msg_controllen) {
+        errno = gso_errno;
+        gso_errno = 0;
+        return -1;
+    }
+
+    return syscall(SYS_sendmmsg, fd, msgvec, vlen, flags);
+}
+
+static int test12_send(abts_case *tc, ogs_sock_t *client, ogs_sock_t *udp,
+        ogs_sockaddr_t *addr, int error, bool *disabled)
+{
+    int i, n;
+    ogs_sockaddr_t *to[NUM_OF_SEGMENT];
+    ogs_pkbuf_t *pkbuf[NUM_OF_SEGMENT];
+
+    for (i = 0; i < NUM_OF_SEGMENT; i++) {
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, SEGMENT_LEN);
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+        memset(ogs_pkbuf_put(pkbuf[i], SEGMENT_LEN), i, SEGMENT_LEN);
+        to[i] = addr;
+    }
+
+    gso_errno = error;
+    n = ogs_udp_sendto_gso_batch(
+            client->fd, pkbuf, to, NUM_OF_SEGMENT, disabled);
+    ABTS_INT_EQUAL(tc, NUM_OF_SEGMENT, n);
+
+    for (i = 0; i < NUM_OF_SEGMENT; i++) {
+        ogs_pkbuf_free(pkbuf[i]);
+        pkbuf[i] = ogs_pkbuf_alloc(NULL, OGS_MAX_SDU_LEN);
+        ABTS_PTR_NOTNULL(tc, pkbuf[i]);
+        ogs_pkbuf_put(pkbuf[i], OGS_MAX_SDU_LEN);
+    }
+    n = ogs_udp_recv_batch(udp->fd, pkbuf, NULL, NUM_OF_SEGMENT);
+    ABTS_INT_EQUAL(tc, NUM_OF_SEGMENT, n);
+    for (i = 0; i < n; i++)
+        ABTS_INT_EQUAL(tc, i, pkbuf[i]->data[0]);
+
+    for (i = 0; i < NUM_OF_SEGMENT; i++)
+        ogs_pkbuf_free(pkbuf[i]);
+
+    /* Not consumed if no aggregate was sent */
+    n = gso_errno;
+    gso_errno = 0;
+
+    return n;
+}
+
+static void test12_func(abts_case *tc, void *data)
+{
+    int rv;
+    ogs_sock_t *udp, *client;
+    ogs_sockaddr_t *addr;
+    ogs_socknode_t *node;
+    bool disabled = false;
+
+    if (!ogs_udp_gso_supported())
+        return;
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, "127.0.0.1", PORT, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node = ogs_socknode_new(addr);
+    ABTS_PTR_NOTNULL(tc, node);
+    udp = ogs_udp_server(node);
+    ABTS_PTR_NOTNULL(tc, udp);
+
+    client = ogs_udp_socket(AF_INET, NULL);
+    ABTS_PTR_NOTNULL(tc, client);
+
+    /* Sent one by one this time, and the offload is kept */
+    ABTS_INT_EQUAL(tc, 0, test12_send(tc, client, udp, addr, EAGAIN,
+                &disabled));
+    ABTS_TRUE(tc, !disabled);
+    ABTS_INT_EQUAL(tc, 0, test12_send(tc, client, udp, addr, ENOBUFS,
+                &disabled));
+    ABTS_TRUE(tc, !disabled);
+    ABTS_INT_EQUAL(tc, 0, test12_send(tc, client, udp, addr, ENOMEM,
+                &disabled));
+    ABTS_TRUE(tc, !disabled);
+    ABTS_INT_EQUAL(tc, 0, test12_send(tc, client, udp, addr, 0,
+                &disabled));
+    ABTS_TRUE(tc, !disabled);
+
+    /* The device refuses it, and no aggregate is tried any more */
+    ABTS_INT_EQUAL(tc, 0, test12_send(tc, client, udp, addr, EIO,
+                &disabled));
+    ABTS_TRUE(tc, disabled);
+    ABTS_INT_EQUAL(tc, EIO, test12_send(tc, client, udp, addr, EIO,
+                &disabled));
+    ABTS_TRUE(tc, disabled);
+
+    ogs_sock_destroy(client);
+    ogs_socknode_free(node);
+}
+#endif
+
 abts_suite *test_socket(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -439,6 +745,14 @@ abts_suite *test_socket(abts_suite *suite)
     abts_run_test(suite, test6_func, NULL);
     abts_run_test(suite, test7_func, NULL);
     abts_run_test(suite, test8_func, NULL);
+    abts_run_test(suite, test9_func, NULL);
+    abts_run_test(suite, test10_func, NULL);
+#if defined(SO_REUSEPORT)
+    abts_run_test(suite, test11_func, NULL);
+#endif
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    abts_run_test(suite, test12_func, NULL);
+#endif
 
     return suite;
 }
@@ -72,6 +72,99 @@ static void final_thread(abts_case *tc, void *data)
     ogs_thread_mutex_destroy(&lock);
 }
 
+static ogs_thread_rwlock_t rwlock;
+static int y[2] = { 0, 0 };
+static int torn = 0;
+
+#define RWLOCK_THREAD_NUM 8
+
+static void rwlock_func(void *data)
+{
+    int i;
+
+    for (i = 0; i < LOCK_LOOP; i++) {
+        if (i % 2) {
+            ogs_thread_rwlock_wrlock(&rwlock);
+            y[0]++;
+            y[1]++;
+            ogs_thread_rwlock_wrunlock(&rwlock);
+        } else {
+            ogs_thread_rwlock_rdlock(&rwlock);
+            if (y[0] != y[1]) torn++;
+            ogs_thread_rwlock_rdunlock(&rwlock);
+        }
+    }
+}
+
+static void test_rwlock(abts_case *tc, void *data)
+{
+    ogs_thread_t *rwlock_thread[RWLOCK_THREAD_NUM];
+    int i;
+
+    ogs_thread_rwlock_init(&rwlock);
+
+    for (i = 0; i < RWLOCK_THREAD_NUM; i++) {
+        rwlock_thread[i] = ogs_thread_create(rwlock_func, NULL);
+        ABTS_PTR_NOTNULL(tc, rwlock_thread[i]);
+    }
+    for (i = 0; i < RWLOCK_THREAD_NUM; i++)
+        ogs_thread_destroy(rwlock_thread[i]);
+
+    ABTS_INT_EQUAL(tc, 0, torn);
+    ABTS_INT_EQUAL(tc, RWLOCK_THREAD_NUM * LOCK_LOOP / 2, y[0]);
+
+    ogs_thread_rwlock_destroy(&rwlock);
+}
+
+#if defined(__GLIBC__)
+#define READER_THREAD_NUM 4
+#define READER_LOOP 1000
+
+static volatile bool reader_stop;
+static volatile int reader_loop;
+
+static void reader_func(void *data)
+{
+    int i;
+
+    for (i = 0; i < READER_LOOP && !reader_stop; i++) {
+        ogs_thread_rwlock_rdlock(&rwlock);
+        ogs_usleep(1000);
+        ogs_thread_rwlock_rdunlock(&rwlock);
+        ogs_atomic_inc(&reader_loop);
+    }
+}
+
+/* The readers always overlap, and yet the writer gets the lock */
+static void test_rwlock_writer(abts_case *tc, void *data)
+{
+    ogs_thread_t *reader_thread[READER_THREAD_NUM];
+    int i, loop;
+
+    ogs_thread_rwlock_init(&rwlock);
+    reader_stop = false;
+    reader_loop = 0;
+
+    for (i = 0; i < READER_THREAD_NUM; i++) {
+        reader_thread[i] = ogs_thread_create(reader_func, NULL);
+        ABTS_PTR_NOTNULL(tc, reader_thread[i]);
+    }
+
+    ogs_msleep(50);
+    ogs_thread_rwlock_wrlock(&rwlock);
+    loop = reader_loop;
+    ogs_thread_rwlock_wrunlock(&rwlock);
+    reader_stop = true;
+
+    for (i = 0; i < READER_THREAD_NUM; i++)
+        ogs_thread_destroy(reader_thread[i]);
+
+    ABTS_TRUE(tc, loop < READER_THREAD_NUM * READER_LOOP);
+
+    ogs_thread_rwlock_destroy(&rwlock);
+}
+#endif
+
 abts_suite *test_thread(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -81,6 +174,10 @@ abts_suite *test_thread(abts_suite *suite)
     abts_run_test(suite, delete_threads, NULL);
     abts_run_test(suite, check_locks, NULL);
     abts_run_test(suite, final_thread, NULL);
+    abts_run_test(suite, test_rwlock, NULL);
+#if defined(__GLIBC__)
+    abts_run_test(suite, test_rwlock_writer, NULL);
+#endif
 
     return suite;
 }
@@ -51,7 +51,7 @@ static void test1_func(abts_case *tc, void *data)
 
     memset(expire_check, 0, TEST_DURATION/TEST_TIMER_PRECISION);
 
-    timer = ogs_timer_mgr_create();
+    timer = ogs_timer_mgr_create_type((uintptr_t)data);
     pollset = ogs_pollset_create();
     ogs_assert(timer);
     for(n = 0; n < sizeof(timer_duration)/sizeof(ogs_time_t); n++) {
@@ -126,7 +126,7 @@ static void test2_func(abts_case *tc, void *data)
     memset(expire_check, 0, TEST_DURATION/TEST_TIMER_PRECISION);
     memset(tm_num, 0, sizeof(int)*(TEST_DURATION/TEST_TIMER_PRECISION));
 
-    timer = ogs_timer_mgr_create();
+    timer = ogs_timer_mgr_create_type((uintptr_t)data);
     ogs_assert(timer);
 
     for(n = 0; n < TEST_TIMER_NUM; n++) {
@@ -168,7 +168,7 @@ static void test3_func(abts_case *tc, void *data)
     memset(expire_check, 0, TEST_DURATION/TEST_TIMER_PRECISION);
     memset(tm_num, 0, sizeof(int)*(TEST_DURATION/TEST_TIMER_PRECISION));
 
-    timer = ogs_timer_mgr_create();
+    timer = ogs_timer_mgr_create_type((uintptr_t)data);
     ogs_assert(timer);
 
     for(n = 0; n < TEST_TIMER_NUM; n++) {
@@ -215,6 +215,9 @@ abts_suite *test_timer(abts_suite *suite)
     abts_run_test(suite, test1_func, NULL);
     abts_run_test(suite, test2_func, NULL);
     abts_run_test(suite, test3_func, NULL);
+    abts_run_test(suite, test1_func, (void *)OGS_TIMER_MGR_WHEEL);
+    abts_run_test(suite, test2_func, (void *)OGS_TIMER_MGR_WHEEL);
+    abts_run_test(suite, test3_func, (void *)OGS_TIMER_MGR_WHEEL);
 
     return suite;
 }
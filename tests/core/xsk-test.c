@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "core-config-private.h"
+
+#include "ogs-core.h"
+#include "core/abts.h"
+
+#if HAVE_AF_XDP
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/capability.h>
+
+#ifndef CAP_BPF
+#define CAP_BPF         39
+#endif
+#endif
+
+#define DATASTR "This is a test"
+#define STRLEN 8092
+#define PORT 7779
+
+#define NETNS "ogs-xsk-test"
+#define DEV "ogsxsk0"
+#define PEER "ogsxsk1"
+#define DEV_ADDR "10.233.0.1"
+#define PEER_ADDR "10.233.0.2"
+#define XSK_PORT 2152
+
+#ifndef AI_PASSIVE
+#define AI_PASSIVE 1
+#endif
+
+static ogs_sock_t *udp_server(abts_case *tc, const char *hostname, int port)
+{
+    int rv;
+    ogs_sockaddr_t *addr;
+    ogs_socknode_t *node;
+    ogs_sock_t *udp;
+
+    rv = ogs_getaddrinfo(&addr, AF_INET, hostname, port, AI_PASSIVE);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    node = ogs_socknode_new(addr);
+    ABTS_PTR_NOTNULL(tc, node);
+    udp = ogs_udp_server(node);
+    ABTS_PTR_NOTNULL(tc, udp);
+
+    /* The socket is kept, and only the node is released */
+    node->sock = NULL;
+    ogs_socknode_free(node);
+
+    return udp;
+}
+
+/* The caller falls back to the UDP socket without an Ethernet device */
+static void test1_func(abts_case *tc, void *data)
+{
+    ogs_sock_t *udp;
+
+    udp = udp_server(tc, NULL, PORT);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_xsk_open(udp));
+    ogs_sock_destroy(udp);
+
+    udp = udp_server(tc, "127.0.0.1", PORT);
+    ABTS_PTR_EQUAL(tc, NULL, ogs_xsk_open(udp));
+    ogs_sock_destroy(udp);
+}
+
+#if HAVE_AF_XDP
+
+static int received;
+static int burst;
+static ogs_sockaddr_t received_from;
+static char received_str[STRLEN];
+
+static void recv_cb(ogs_socket_t fd,
+        ogs_pkbuf_t *pkbuf, ogs_sockaddr_t *from, void *data)
+{
+    if (!pkbuf) {
+        burst++;
+        return;
+    }
+
+    memcpy(&received_from, from, sizeof received_from);
+    memset(received_str, 0, sizeof received_str);
+    memcpy(received_str, pkbuf->data, ogs_min(pkbuf->len, STRLEN-1));
+    received++;
+
+    ogs_pkbuf_free(pkbuf);
+}
+
+static bool has_capability(void)
+{
+    struct __user_cap_header_struct hdr;
+    struct __user_cap_data_struct cap[2];
+
+    memset(&hdr, 0, sizeof hdr);
+    hdr.version = _LINUX_CAPABILITY_VERSION_3;
+    memset(cap, 0, sizeof cap);
+    if (syscall(SYS_capget, &hdr, cap) != 0)
+        return false;
+
+#define HAS_CAP(__cAP) \
+    (cap[(__cAP) / 32].effective & (1u << ((__cAP) % 32)))
+    return HAS_CAP(CAP_NET_ADMIN) &&
+        (HAS_CAP(CAP_BPF) || HAS_CAP(CAP_SYS_ADMIN));
+#undef HAS_CAP
+}
+
+static void cleanup_veth(void)
+{
+    if (system("ip link del " DEV " >/dev/null 2>&1; "
+                "ip netns del " NETNS " >/dev/null 2>&1") != 0)
+        ogs_warn("Cannot remove %s", NETNS);
+}
+
+/* DEV stays here, and PEER is moved to the namespace */
+static bool setup_veth(void)
+{
+    cleanup_veth();
+
+    return system("("
+            "ip netns add " NETNS " && "
+            "ip link add " DEV " type veth peer name " PEER
+                " netns " NETNS " && "
+            "ip addr add " DEV_ADDR "/24 dev " DEV " && "
+            "ip link set " DEV " up && "
+            "ip netns exec " NETNS
+                " ip addr add " PEER_ADDR "/24 dev " PEER " && "
+            "ip netns exec " NETNS " ip link set " PEER " up"
+            ") >/dev/null 2>&1") == 0;
+}
+
+/* The socket belongs to the namespace where it was created */
+static ogs_sock_t *peer_server(abts_case *tc)
+{
+    ogs_sock_t *udp = NULL;
+    int self, netns;
+
+    self = open("/proc/self/ns/net", O_RDONLY);
+    ABTS_TRUE(tc, self >= 0);
+    netns = open("/var/run/netns/" NETNS, O_RDONLY);
+    ABTS_TRUE(tc, netns >= 0);
+
+    if (self >= 0 && netns >= 0 && setns(netns, CLONE_NEWNET) == 0) {
+        udp = udp_server(tc, PEER_ADDR, XSK_PORT);
+        ABTS_INT_EQUAL(tc, 0, setns(self, CLONE_NEWNET));
+    }
+
+    if (netns >= 0)
+        close(netns);
+    if (self >= 0)
+        close(self);
+
+    return udp;
+}
+
+static ssize_t peer_recv(ogs_sock_t *udp, char *str, ogs_sockaddr_t *from)
+{
+    struct pollfd pfd;
+
+    memset(&pfd, 0, sizeof pfd);
+    pfd.fd = udp->fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 1000) != 1)
+        return -1;
+
+    memset(str, 0, STRLEN);
+    return ogs_recvfrom(udp->fd, str, STRLEN, 0, from);
+}
+
+static void test2_func(abts_case *tc, void *data)
+{
+    int rv, i;
+    ogs_sock_t *udp, *peer;
+    ogs_sockaddr_t *peer_addr, *dev_addr, from;
+    ogs_pollset_t *pollset;
+    ogs_pkbuf_t *pkbuf;
+    ogs_xsk_t *xsk;
+    char str[STRLEN];
+    ssize_t size;
+
+    if (!has_capability() || !setup_veth()) {
+        cleanup_veth();
+        ABTS_NOT_IMPL(tc, "AF_XDP needs CAP_NET_ADMIN and CAP_BPF");
+        return;
+    }
+
+    rv = ogs_getaddrinfo(&peer_addr, AF_INET, PEER_ADDR, XSK_PORT, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    rv = ogs_getaddrinfo(&dev_addr, AF_INET, DEV_ADDR, XSK_PORT, 0);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+
+    peer = peer_server(tc);
+    ABTS_PTR_NOTNULL(tc, peer);
+    udp = udp_server(tc, DEV_ADDR, XSK_PORT);
+    ABTS_PTR_NOTNULL(tc, udp);
+    if (!peer || !udp)
+        goto out;
+
+    xsk = ogs_xsk_open(udp);
+    ABTS_PTR_NOTNULL(tc, xsk);
+    if (!xsk)
+        goto out;
+
+    pollset = ogs_pollset_create();
+    ABTS_PTR_NOTNULL(tc, pollset);
+    ABTS_PTR_NOTNULL(tc, ogs_xsk_add_recv(
+                pollset, xsk, NULL, 0, recv_cb, NULL));
+
+    pkbuf = ogs_pkbuf_alloc(NULL, STRLEN);
+    ABTS_PTR_NOTNULL(tc, pkbuf);
+    ogs_pkbuf_put_data(pkbuf, DATASTR, strlen(DATASTR));
+
+    /* No MAC address of the peer yet, so it goes out of the UDP socket */
+    rv = ogs_xsk_sendto(xsk, pkbuf, peer_addr);
+    ABTS_INT_EQUAL(tc, OGS_RETRY, rv);
+    size = ogs_sendto(udp->fd, pkbuf->data, pkbuf->len, 0, peer_addr);
+    ABTS_INT_EQUAL(tc, strlen(DATASTR), size);
+
+    size = peer_recv(peer, str, &from);
+    ABTS_INT_EQUAL(tc, strlen(DATASTR), size);
+    ABTS_STR_EQUAL(tc, DATASTR, str);
+
+    /* RX: the datagram is redirected to AF_XDP */
+    received = burst = 0;
+    size = ogs_sendto(peer->fd, DATASTR, strlen(DATASTR), 0, dev_addr);
+    ABTS_INT_EQUAL(tc, strlen(DATASTR), size);
+
+    for (i = 0; i < 100 && !received; i++)
+        ogs_pollset_poll(pollset, ogs_time_from_msec(10));
+    ABTS_INT_EQUAL(tc, 1, received);
+    ABTS_INT_EQUAL(tc, 1, burst);
+    ABTS_STR_EQUAL(tc, DATASTR, received_str);
+    ABTS_TRUE(tc, ogs_sockaddr_is_equal(&received_from, peer_addr));
+
+    /* The kernel socket has not seen it */
+    size = recv(udp->fd, str, STRLEN, MSG_DONTWAIT);
+    ABTS_INT_EQUAL(tc, -1, size);
+
+    /* TX: the MAC address was learned from the received frame */
+    rv = ogs_xsk_sendto(xsk, pkbuf, &received_from);
+    ABTS_INT_EQUAL(tc, OGS_OK, rv);
+    ogs_xsk_flush(xsk);
+
+    size = peer_recv(peer, str, &from);
+    ABTS_INT_EQUAL(tc, strlen(DATASTR), size);
+    ABTS_STR_EQUAL(tc, DATASTR, str);
+    ABTS_TRUE(tc, ogs_sockaddr_is_equal(&from, dev_addr));
+
+    ogs_pkbuf_free(pkbuf);
+
+    ogs_xsk_close(xsk);
+    ogs_pollset_destroy(pollset);
+
+out:
+    if (udp)
+        ogs_sock_destroy(udp);
+    if (peer)
+        ogs_sock_destroy(peer);
+
+    ogs_freeaddrinfo(peer_addr);
+    ogs_freeaddrinfo(dev_addr);
+
+    cleanup_veth();
+}
+
+#endif /* HAVE_AF_XDP */
+
+abts_suite *test_xsk(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, test1_func, NULL);
+#if HAVE_AF_XDP
+    abts_run_test(suite, test2_func, NULL);
+#endif
+
+    return suite;
+}
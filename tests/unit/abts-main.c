@@ -24,6 +24,8 @@ abts_suite *test_nas_message(abts_suite *suite);
 abts_suite *test_gtp_message(abts_suite *suite);
 abts_suite *test_security(abts_suite *suite);
 abts_suite *test_crash(abts_suite *suite);
+abts_suite *test_tun(abts_suite *suite);
+abts_suite *test_sgw_buffer(abts_suite *suite);
 
 const struct testlist {
     abts_suite *(*func)(abts_suite *suite);
@@ -33,6 +35,8 @@ const struct testlist {
     {test_gtp_message},
     {test_security},
     {test_crash},
+    {test_tun},
+    {test_sgw_buffer},
     {NULL},
 };
 
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "test-app.h"
+#include "sgw/sgw-context.h"
+
+/* Two bearers of the first UE, and one of the second UE */
+static sgw_ue_t ue1, ue2;
+static sgw_bearer_t bearer1, bearer2, bearer3;
+
+/* The size of the cluster of each buffered packet */
+static size_t cluster;
+
+static void buffer_setup(size_t max_size, size_t ue_max_size,
+        int ue_max_packet, sgw_buffer_policy_e policy)
+{
+    sgw_context_t *ctx = sgw_self();
+    ogs_pkbuf_t *pkbuf = NULL;
+
+    /* Only the buffering part of the context is used */
+    if (!__sgw_log_domain)
+        ogs_log_install_domain(&__sgw_log_domain, "sgw",
+                ogs_core()->log.level);
+
+    memset(&ctx->buffer, 0, sizeof ctx->buffer);
+    ogs_thread_mutex_init(&ctx->buffer.mutex);
+    ctx->buffer.max_size = max_size;
+    ctx->buffer.ue_max_size = ue_max_size;
+    ctx->buffer.ue_max_packet = ue_max_packet;
+    ctx->buffer.policy = policy;
+
+    memset(&ue1, 0, sizeof ue1);
+    memset(&ue2, 0, sizeof ue2);
+    memset(&bearer1, 0, sizeof bearer1);
+    memset(&bearer2, 0, sizeof bearer2);
+    memset(&bearer3, 0, sizeof bearer3);
+    bearer1.sgw_ue = bearer2.sgw_ue = &ue1;
+    bearer3.sgw_ue = &ue2;
+
+    pkbuf = ogs_pkbuf_alloc(NULL, 100);
+    ogs_assert(pkbuf);
+    cluster = pkbuf->cluster->size;
+    ogs_pkbuf_free(pkbuf);
+}
+
+static void buffer_teardown(void)
+{
+    sgw_bearer_clear_buffer(&bearer1);
+    sgw_bearer_clear_buffer(&bearer2);
+    sgw_bearer_clear_buffer(&bearer3);
+
+    ogs_thread_mutex_destroy(&sgw_self()->buffer.mutex);
+    memset(&sgw_self()->buffer, 0, sizeof sgw_self()->buffer);
+}
+
+static void buffer(sgw_bearer_t *bearer, uint8_t id, int len)
+{
+    ogs_pkbuf_t *pkbuf = ogs_pkbuf_alloc(NULL, len);
+    ogs_assert(pkbuf);
+    memset(ogs_pkbuf_put(pkbuf, len), id, len);
+
+    sgw_bearer_buffer_pkbuf(bearer, pkbuf);
+}
+
+/* Returns the id of the oldest packet, or -1 if there is none */
+static int unbuffer(sgw_bearer_t *bearer)
+{
+    ogs_pkbuf_t *pkbuf = sgw_bearer_unbuffer_pkbuf(bearer);
+    int id;
+
+    if (!pkbuf)
+        return -1;
+
+    id = pkbuf->data[0];
+    ogs_pkbuf_free(pkbuf);
+
+    return id;
+}
+
+/* The per-UE packet cap with drop-newest */
+static void sgw_buffer_test1(abts_case *tc, void *data)
+{
+    sgw_buffer_stat_t stat;
+    int i;
+
+    buffer_setup(1024*1024, 1024*1024, 4, SGW_BUFFER_DROP_NEWEST);
+
+    for (i = 0; i < 6; i++)
+        buffer(&bearer1, i, 100);
+
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 4, stat.buffered);
+    ABTS_INT_EQUAL(tc, 2, stat.dropped);
+    ABTS_INT_EQUAL(tc, 0, stat.evicted);
+    ABTS_INT_EQUAL(tc, 4 * cluster, stat.size);
+
+    for (i = 0; i < 4; i++)
+        ABTS_INT_EQUAL(tc, i, unbuffer(&bearer1));
+    ABTS_INT_EQUAL(tc, -1, unbuffer(&bearer1));
+
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 4, stat.flushed);
+    ABTS_INT_EQUAL(tc, 0, stat.size);
+
+    buffer_teardown();
+}
+
+/* The per-UE packet cap with drop-oldest */
+static void sgw_buffer_test2(abts_case *tc, void *data)
+{
+    sgw_buffer_stat_t stat;
+    int i;
+
+    buffer_setup(1024*1024, 1024*1024, 4, SGW_BUFFER_DROP_OLDEST);
+
+    for (i = 0; i < 6; i++)
+        buffer(&bearer1, i, 100);
+
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 6, stat.buffered);
+    ABTS_INT_EQUAL(tc, 0, stat.dropped);
+    ABTS_INT_EQUAL(tc, 2, stat.evicted);
+
+    for (i = 2; i < 6; i++)
+        ABTS_INT_EQUAL(tc, i, unbuffer(&bearer1));
+    ABTS_INT_EQUAL(tc, -1, unbuffer(&bearer1));
+
+    buffer_teardown();
+}
+
+/* The per-UE byte cap is held by the other bearer of the UE */
+static void sgw_buffer_test3(abts_case *tc, void *data)
+{
+    sgw_buffer_stat_t stat;
+    int i;
+
+    buffer_setup(1024*1024, 0, 512, SGW_BUFFER_DROP_OLDEST);
+    sgw_self()->buffer.ue_max_size = 4 * cluster;
+
+    for (i = 0; i < 4; i++)
+        buffer(&bearer2, i, 100);
+
+    /* Nothing of the bearer can be evicted, so the new one is dropped */
+    buffer(&bearer1, 10, 100);
+
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 4, stat.buffered);
+    ABTS_INT_EQUAL(tc, 1, stat.dropped);
+    ABTS_INT_EQUAL(tc, 0, stat.evicted);
+    ABTS_INT_EQUAL(tc, -1, unbuffer(&bearer1));
+
+    /* The other bearer is not touched */
+    for (i = 0; i < 4; i++)
+        ABTS_INT_EQUAL(tc, i, unbuffer(&bearer2));
+
+    /* The other UE has its own cap */
+    for (i = 0; i < 4; i++)
+        buffer(&bearer3, i, 100);
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 8, stat.buffered);
+    ABTS_INT_EQUAL(tc, 1, stat.dropped);
+
+    buffer_teardown();
+}
+
+/* The global cap is mostly held by the other UE */
+static void sgw_buffer_test4(abts_case *tc, void *data)
+{
+    sgw_buffer_stat_t stat;
+    int i;
+
+    buffer_setup(0, 1024*1024, 512, SGW_BUFFER_DROP_OLDEST);
+    sgw_self()->buffer.max_size = 4 * cluster;
+
+    for (i = 0; i < 3; i++)
+        buffer(&bearer3, i, 100);
+    buffer(&bearer1, 10, 100);
+
+    /* The oldest one of the bearer makes enough room */
+    buffer(&bearer1, 11, 100);
+
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 5, stat.buffered);
+    ABTS_INT_EQUAL(tc, 0, stat.dropped);
+    ABTS_INT_EQUAL(tc, 1, stat.evicted);
+    ABTS_INT_EQUAL(tc, 4 * cluster, stat.size);
+
+    /* A bigger one cannot fit, and the bearer keeps what it has */
+    buffer(&bearer1, 12, 4 * cluster);
+
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 5, stat.buffered);
+    ABTS_INT_EQUAL(tc, 1, stat.dropped);
+    ABTS_INT_EQUAL(tc, 1, stat.evicted);
+
+    ABTS_INT_EQUAL(tc, 11, unbuffer(&bearer1));
+    ABTS_INT_EQUAL(tc, -1, unbuffer(&bearer1));
+    for (i = 0; i < 3; i++)
+        ABTS_INT_EQUAL(tc, i, unbuffer(&bearer3));
+
+    buffer_teardown();
+}
+
+/* The global cap with drop-newest */
+static void sgw_buffer_test5(abts_case *tc, void *data)
+{
+    sgw_buffer_stat_t stat;
+    int i;
+
+    buffer_setup(0, 1024*1024, 512, SGW_BUFFER_DROP_NEWEST);
+    sgw_self()->buffer.max_size = 4 * cluster;
+
+    for (i = 0; i < 3; i++)
+        buffer(&bearer3, i, 100);
+    buffer(&bearer1, 10, 100);
+    buffer(&bearer1, 11, 100);
+
+    sgw_buffer_stat(&stat);
+    ABTS_INT_EQUAL(tc, 4, stat.buffered);
+    ABTS_INT_EQUAL(tc, 1, stat.dropped);
+    ABTS_INT_EQUAL(tc, 0, stat.evicted);
+
+    ABTS_INT_EQUAL(tc, 10, unbuffer(&bearer1));
+    ABTS_INT_EQUAL(tc, -1, unbuffer(&bearer1));
+
+    buffer_teardown();
+}
+
+abts_suite *test_sgw_buffer(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+    abts_run_test(suite, sgw_buffer_test1, NULL);
+    abts_run_test(suite, sgw_buffer_test2, NULL);
+    abts_run_test(suite, sgw_buffer_test3, NULL);
+    abts_run_test(suite, sgw_buffer_test4, NULL);
+    abts_run_test(suite, sgw_buffer_test5, NULL);
+
+    return suite;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2019 by Sukchan Lee <acetcom@gmail.com>
+ *
+ * This file is part of Open5GS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "test-app.h"
+#include "pgw/ogs-tun.h"
+
+#if defined(__linux__)
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+#endif
+
+#if defined(__linux__) && defined(IFF_VNET_HDR)
+
+#define TCP_HLEN        32      /* With the timestamp option */
+#define TCP_SEQ         0xfffffc00  /* Wraps around in the second segment */
+#define IP_ID           0x1234
+#define GSO_SIZE        1000
+#define PAYLOAD_LEN     2500
+
+#define TCP_FIN         0x01
+#define TCP_PSH         0x08
+#define TCP_ACK         0x10
+#define TCP_CWR         0x80
+
+static uint8_t buf[OGS_TUN_MAX_GSO_LEN];
+
+/* 0xffff if the checksum in the data is correct */
+static uint16_t csum_fold(uint32_t sum, const uint8_t *p, int len)
+{
+    while (len > 1) {
+        sum += (p[0] << 8) | p[1];
+        p += 2;
+        len -= 2;
+    }
+    if (len)
+        sum += p[0] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return sum;
+}
+
+/* A virtio_net_hdr and a TCP super-packet as the kernel passes them */
+static int build_super_packet(uint8_t *p, int family)
+{
+    struct virtio_net_hdr *vnet_h = (struct virtio_net_hdr *)p;
+    uint8_t *ip = p + sizeof *vnet_h, *tcp = NULL;
+    int ip_hlen, i;
+
+    memset(p, 0, sizeof *vnet_h);
+    if (family == AF_INET) {
+        ip_hlen = 20;
+        memset(ip, 0, ip_hlen);
+        ip[0] = 0x45;
+        ip[2] = (ip_hlen + TCP_HLEN + PAYLOAD_LEN) >> 8;
+        ip[3] = (ip_hlen + TCP_HLEN + PAYLOAD_LEN) & 0xff;
+        ip[4] = IP_ID >> 8;
+        ip[5] = IP_ID & 0xff;
+        ip[6] = 0x40;
+        ip[8] = 64;
+        ip[9] = IPPROTO_TCP;
+        memcpy(ip + 12, "\x0a\x2d\x00\x02", 4);
+        memcpy(ip + 16, "\x08\x08\x08\x08", 4);
+        vnet_h->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+    } else {
+        ip_hlen = 40;
+        memset(ip, 0, ip_hlen);
+        ip[0] = 0x60;
+        ip[4] = (TCP_HLEN + PAYLOAD_LEN) >> 8;
+        ip[5] = (TCP_HLEN + PAYLOAD_LEN) & 0xff;
+        ip[6] = IPPROTO_TCP;
+        ip[7] = 64;
+        memcpy(ip + 8, "\x20\x01\x0d\xb8", 4);
+        ip[23] = 2;
+        memcpy(ip + 24, "\x20\x01\x0d\xb8", 4);
+        ip[39] = 1;
+        vnet_h->gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+    }
+
+    vnet_h->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    vnet_h->hdr_len = ip_hlen + TCP_HLEN;
+    vnet_h->gso_size = GSO_SIZE;
+    vnet_h->csum_start = ip_hlen;
+    vnet_h->csum_offset = 16;
+
+    tcp = ip + ip_hlen;
+    memset(tcp, 0, TCP_HLEN);
+    tcp[0] = 40000 >> 8;
+    tcp[1] = 40000 & 0xff;
+    tcp[3] = 80;
+    tcp[4] = (TCP_SEQ >> 24) & 0xff;
+    tcp[5] = (TCP_SEQ >> 16) & 0xff;
+    tcp[6] = (TCP_SEQ >> 8) & 0xff;
+    tcp[7] = TCP_SEQ & 0xff;
+    tcp[11] = 1;
+    tcp[12] = (TCP_HLEN / 4) << 4;
+    tcp[13] = TCP_CWR | TCP_ACK | TCP_PSH | TCP_FIN;
+    tcp[14] = 0xff;
+    tcp[15] = 0xff;
+    /* The checksum field holds the pseudo-header sum */
+    tcp[16] = 0x12;
+    tcp[17] = 0x34;
+    /* NOP, NOP, Timestamp */
+    tcp[20] = 1;
+    tcp[21] = 1;
+    tcp[22] = 8;
+    tcp[23] = 10;
+
+    for (i = 0; i < PAYLOAD_LEN; i++)
+        tcp[TCP_HLEN + i] = i & 0xff;
+
+    return sizeof *vnet_h + ip_hlen + TCP_HLEN + PAYLOAD_LEN;
+}
+
+static void check_segments(abts_case *tc, int family)
+{
+    int fd[2], rv, len, ip_hlen, i, n = 0;
+    ogs_tun_gso_t gso;
+    ogs_pkbuf_t *pkbuf = NULL;
+    uint8_t packet[1024*4];
+    ssize_t size;
+
+    ip_hlen = family == AF_INET ? 20 : 40;
+
+    rv = socketpair(AF_UNIX, SOCK_DGRAM, 0, fd);
+    ABTS_INT_EQUAL(tc, 0, rv);
+
+    len = build_super_packet(packet, family);
+    size = write(fd[1], packet, len);
+    ABTS_INT_EQUAL(tc, len, size);
+
+    size = ogs_tun_read_gso(fd[0], buf, sizeof buf, &gso);
+    ABTS_INT_EQUAL(tc, len, size);
+
+    while ((pkbuf = ogs_tun_gso_next(&gso, NULL, 0))) {
+        uint8_t *ip = pkbuf->data, *tcp = ip + ip_hlen;
+        int payload = ogs_min(PAYLOAD_LEN - n * GSO_SIZE, GSO_SIZE);
+        int tcp_len = TCP_HLEN + payload;
+        bool last = (n + 1) * GSO_SIZE >= PAYLOAD_LEN;
+        uint32_t seq, sum;
+
+        ABTS_INT_EQUAL(tc, ip_hlen + tcp_len, pkbuf->len);
+
+        if (family == AF_INET) {
+            ABTS_INT_EQUAL(tc, ip_hlen + tcp_len, (ip[2] << 8) | ip[3]);
+            ABTS_INT_EQUAL(tc, IP_ID + n, (ip[4] << 8) | ip[5]);
+            ABTS_INT_EQUAL(tc, 0xffff, csum_fold(0, ip, ip_hlen));
+            sum = csum_fold(0, ip + 12, 8);
+        } else {
+            ABTS_INT_EQUAL(tc, tcp_len, (ip[4] << 8) | ip[5]);
+            sum = csum_fold(0, ip + 8, 32);
+        }
+        sum += IPPROTO_TCP + tcp_len;
+        ABTS_INT_EQUAL(tc, 0xffff, csum_fold(sum, tcp, tcp_len));
+
+        seq = ((uint32_t)tcp[4] << 24) | (tcp[5] << 16) |
+            (tcp[6] << 8) | tcp[7];
+        ABTS_TRUE(tc, seq == (uint32_t)(TCP_SEQ + n * GSO_SIZE));
+
+        ABTS_TRUE(tc, tcp[13] & TCP_ACK);
+        ABTS_INT_EQUAL(tc, n == 0, !!(tcp[13] & TCP_CWR));
+        ABTS_INT_EQUAL(tc, last, !!(tcp[13] & TCP_FIN));
+        ABTS_INT_EQUAL(tc, last, !!(tcp[13] & TCP_PSH));
+
+        /* The options are copied to every segment */
+        ABTS_INT_EQUAL(tc, 8, tcp[22]);
+        for (i = 0; i < payload; i++)
+            if (tcp[TCP_HLEN + i] != ((n * GSO_SIZE + i) & 0xff))
+                break;
+        ABTS_INT_EQUAL(tc, payload, i);
+
+        ogs_pkbuf_free(pkbuf);
+        n++;
+    }
+    ABTS_INT_EQUAL(tc, (PAYLOAD_LEN + GSO_SIZE - 1) / GSO_SIZE, n);
+
+    close(fd[0]);
+    close(fd[1]);
+}
+
+static void tun_test1(abts_case *tc, void *data)
+{
+    check_segments(tc, AF_INET);
+}
+
+static void tun_test2(abts_case *tc, void *data)
+{
+    check_segments(tc, AF_INET6);
+}
+
+/* The uplink is written with no checksum offload */
+static void tun_test3(abts_case *tc, void *data)
+{
+    struct virtio_net_hdr *vnet_h = (struct virtio_net_hdr *)buf;
+    int fd[2], rv;
+    uint8_t packet[64];
+    ssize_t size;
+
+    rv = socketpair(AF_UNIX, SOCK_DGRAM, 0, fd);
+    ABTS_INT_EQUAL(tc, 0, rv);
+
+    memset(packet, 0x45, sizeof packet);
+    size = ogs_tun_write_offload(fd[1], packet, sizeof packet);
+    ABTS_INT_EQUAL(tc, sizeof packet, size);
+
+    memset(buf, 0xff, sizeof *vnet_h);
+    size = read(fd[0], buf, sizeof buf);
+    ABTS_INT_EQUAL(tc, sizeof *vnet_h + sizeof packet, size);
+    ABTS_INT_EQUAL(tc, 0, vnet_h->flags);
+    ABTS_INT_EQUAL(tc, VIRTIO_NET_HDR_GSO_NONE, vnet_h->gso_type);
+    ABTS_TRUE(tc, memcmp(buf + sizeof *vnet_h, packet, sizeof packet) == 0);
+
+    close(fd[0]);
+    close(fd[1]);
+}
+
+#endif
+
+abts_suite *test_tun(abts_suite *suite)
+{
+    suite = ADD_SUITE(suite)
+
+#if defined(__linux__) && defined(IFF_VNET_HDR)
+    abts_run_test(suite, tun_test1, NULL);
+    abts_run_test(suite, tun_test2, NULL);
+    abts_run_test(suite, tun_test3, NULL);
+#endif
+
+    return suite;
+}